@@ -0,0 +1,59 @@
+#include "brush_cache.h"
+
+namespace graph
+{
+	BrushCache::BrushCache(const size_t budget) : budget(budget) {}
+
+	std::uint64_t BrushHash(const std::uint32_t key)
+	{
+		//Fibonacci hashing, nearby colors spread over the table
+		const std::uint32_t hash = key * 0x9E3779B1u;
+		return hash ^ hash >> 16;
+	}
+
+	void BrushCache::EvictOldest()
+	{
+		table.erase_oldest();
+		stats.evictions++;
+		stats.size--;
+	}
+
+	const SolidBrush& BrushCache::get(const Color color, D2DGraphics& graphics, const ULONGLONG frame)
+	{
+		const std::uint32_t key = Color32(color).argb;
+		const std::uint64_t hash = BrushHash(key);
+		std::uint32_t entry = table.find(hash, [key](const Entry& e) { return e.key == key; });
+		if (entry != c_no_entry)
+		{
+			stats.hits++;
+			table[entry].frame = frame;
+			table.touch(entry);
+			return *table[entry].brush;
+		}
+		stats.misses++;
+		while (stats.size >= budget && table.get_oldest() != c_no_entry && table[table.get_oldest()].frame < frame)
+		{
+			EvictOldest();
+		}
+		entry = table.insert(hash);
+		Entry& e = table[entry];
+		e.brush = std::make_unique<SolidBrush>(graphics.create_solidbrush(Color32(key)));
+		e.key = key;
+		e.frame = frame;
+		stats.size++;
+		return *e.brush;
+	}
+
+	void BrushCache::trim(const ULONGLONG frame)
+	{
+		while (stats.size > budget && table[table.get_oldest()].frame < frame)
+		{
+			EvictOldest();
+		}
+	}
+
+	void BrushCache::reset_stats()
+	{
+		stats.hits = stats.misses = stats.evictions = 0;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "graph.h"
+#include "lru_table.h"
+
+namespace graph
+{
+	//Solid brushes by packed color in an LruTable. Past the budget the least recently used brush
+	//is dropped, but never one used in the current frame, so references stay valid until the
+	//frame ends.
+	class BrushCache
+	{
+		struct Entry
+		{
+			std::unique_ptr<SolidBrush> brush;
+			std::uint32_t key;
+			ULONGLONG frame;
+		};
+
+		LruTable<Entry> table;
+		size_t budget;
+		BrushCacheStats stats;
+
+		void EvictOldest();
+	public:
+		explicit BrushCache(size_t budget);
+
+		//The brush of color rounded to 8 bits a channel, made by graphics on a miss.
+		//frame is the frame it is used in
+		const SolidBrush& get(Color color, D2DGraphics& graphics, ULONGLONG frame);
+
+		//Drops brushes past the budget that were last used before frame
+		void trim(ULONGLONG frame);
+
+		const BrushCacheStats& get_stats() const { return stats; }
+		void reset_stats();
+	};
+}
@@ -0,0 +1,1336 @@
+#include "command_list.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+
+namespace graph
+{
+	//Blocks are this big unless a single record needs more
+	constexpr size_t c_block_size = 64 * 1024;
+
+	//Every record starts with the op and its size in bytes, header included
+	constexpr size_t c_header_size = 2 * sizeof(std::uint32_t);
+
+	constexpr char c_trace_magic[4] = {'D', '2', 'K', 'L'};
+	constexpr std::uint32_t c_trace_version = 6;
+
+	size_t FieldBytes()
+	{
+		return 0;
+	}
+
+	template <typename T, typename... Rest>
+	size_t FieldBytes(const T&, const Rest&... rest)
+	{
+		static_assert(sizeof(T) % 4 == 0, "fields keep records 4-byte aligned");
+		return sizeof(T) + FieldBytes(rest...);
+	}
+
+	std::uint8_t* PutFields(std::uint8_t* at)
+	{
+		return at;
+	}
+
+	template <typename T, typename... Rest>
+	std::uint8_t* PutFields(std::uint8_t* at, const T& value, const Rest&... rest)
+	{
+		std::memcpy(at, &value, sizeof(T));
+		return PutFields(at + sizeof(T), rest...);
+	}
+
+	//Copies count values, which may be nullptr for none, and returns the byte past them
+	template <typename T>
+	std::uint8_t* PutArray(std::uint8_t* at, const T* values, const size_t count)
+	{
+		if (count != 0)
+		{
+			std::memcpy(at, values, count * sizeof(T));
+		}
+		return at + count * sizeof(T);
+	}
+
+	//Fields are at least 4-byte aligned in a record, only pointers may not be 8-byte aligned
+	struct Reader
+	{
+		const std::uint8_t* at;
+
+		template <typename T>
+		const T& get()
+		{
+			const T& value = *reinterpret_cast<const T*>(at);
+			at += sizeof(T);
+			return value;
+		}
+
+		template <typename T>
+		const T* pointer()
+		{
+			const T* value;
+			std::memcpy(&value, at, sizeof(value));
+			at += sizeof(value);
+			return value;
+		}
+
+		template <typename T>
+		const T* array(const size_t count)
+		{
+			const T* values = reinterpret_cast<const T*>(at);
+			at += count * sizeof(T);
+			return values;
+		}
+	};
+
+	std::uint8_t* CommandList::Allocate(const size_t bytes)
+	{
+		if (blocks.empty() || blocks.back().size - blocks.back().used < bytes)
+		{
+			const size_t size = std::max(c_block_size, bytes);
+			blocks.push_back(Block{std::unique_ptr<std::uint8_t[]>(new std::uint8_t[size]), size, 0});
+		}
+		Block& block = blocks.back();
+		std::uint8_t* at = block.data.get() + block.used;
+		block.used += bytes;
+		return at;
+	}
+
+	template <typename... Fields>
+	std::uint8_t* CommandList::Record(const OP op, const size_t extra, const Fields&... fields)
+	{
+		//Rounded up so the next record's pointers stay as aligned as this one's
+		const size_t total = (c_header_size + FieldBytes(fields...) + extra + 7) & ~static_cast<size_t>(7);
+		std::uint8_t* at = Allocate(total);
+		//Padding is zeroed so equal calls give equal bytes
+		const size_t filled = c_header_size + FieldBytes(fields...) + extra;
+		std::memset(at + filled, 0, total - filled);
+		at = PutFields(at, op, static_cast<std::uint32_t>(total));
+		count++;
+		return PutFields(at, fields...);
+	}
+
+	std::uint32_t CommandList::Paint(Color color)
+	{
+		const auto found = paletteIndex.find(color);
+		if (found != paletteIndex.end())
+		{
+			return found->second;
+		}
+		const auto index = static_cast<std::uint32_t>(palette.size());
+		palette.push_back(color);
+		paletteIndex.emplace(color, index);
+		return index;
+	}
+
+	std::uint32_t CommandList::Paint(const Brush& brush)
+	{
+		Color color = brush.soft_paint;
+		color.alpha *= brush.soft_opacity;
+		return Paint(color);
+	}
+
+	std::uint32_t CommandList::Style(const StrokeStyle& style)
+	{
+		const auto found = styleIndex.find(style);
+		if (found != styleIndex.end())
+		{
+			return found->second;
+		}
+		const auto index = static_cast<std::uint32_t>(styles.size());
+		styles.push_back(style);
+		styleIndex.emplace(style, index);
+		return index;
+	}
+
+	size_t CommandList::bytes() const
+	{
+		size_t res = 0;
+		for (const Block& block : blocks)
+		{
+			res += block.used;
+		}
+		return res;
+	}
+
+	void CommandList::reset()
+	{
+		updates = 0;
+		if (blocks.size() > 1)
+		{
+			blocks.resize(1);
+		}
+		if (!blocks.empty())
+		{
+			blocks[0].used = 0;
+		}
+		count = 0;
+		palette.clear();
+		paletteIndex.clear();
+		styles.clear();
+		styleIndex.clear();
+	}
+
+	//Copies the pixels of an UpdateImage record into its bitmap
+	void ReplayUpdate(D2DGraphics& graphics, Reader& in)
+	{
+		const Rect region = in.get<Rect>();
+		//Recorded from a bitmap that was not const
+		auto* bitmap = const_cast<Bitmap*>(in.pointer<Bitmap>());
+		const std::uint32_t width = in.get<std::uint32_t>();
+		in.get<std::uint32_t>();
+		if (bitmap)
+		{
+			graphics.update_image(*bitmap, region, in.at, static_cast<UINT>(width * sizeof(std::uint32_t)));
+		}
+	}
+
+	void CommandList::replay(D2DGraphics& graphics) const
+	{
+		resolved.resize(palette.size());
+		for (size_t i = 0; i < palette.size(); i++)
+		{
+			resolved[i] = &graphics.get_solidbrush(palette[i]);
+		}
+		const auto brush = [&](Reader& in) -> const Brush& { return *resolved[in.get<std::uint32_t>()]; };
+		const auto style = [&](Reader& in) -> const StrokeStyle& { return styles[in.get<std::uint32_t>()]; };
+		for (const Block& block : blocks)
+		{
+			const std::uint8_t* at = block.data.get();
+			const std::uint8_t* const end = at + block.used;
+			while (at < end)
+			{
+				Reader in{at};
+				const OP op = in.get<OP>();
+				at += in.get<std::uint32_t>();
+				switch (op)
+				{
+					case OP::Clear:
+						graphics.clear(in.get<Color>());
+						break;
+					case OP::DrawLine:
+					{
+						const Point from = in.get<Point>();
+						const Point to = in.get<Point>();
+						const Brush& paint = brush(in);
+						const float width = in.get<float>();
+						graphics.draw_line(from, to, paint, width, style(in));
+						break;
+					}
+					case OP::DrawRect:
+					{
+						const Rect rect = in.get<Rect>();
+						const Brush& paint = brush(in);
+						const float width = in.get<float>();
+						graphics.draw_rect(rect, paint, width, style(in));
+						break;
+					}
+					case OP::DrawEllipse:
+					{
+						const Ellipse ellipse = in.get<Ellipse>();
+						const Brush& paint = brush(in);
+						const float width = in.get<float>();
+						graphics.draw_ellipse(ellipse, paint, width, style(in));
+						break;
+					}
+					case OP::DrawPoly:
+					case OP::DrawPolyline:
+					{
+						const std::uint32_t size = in.get<std::uint32_t>();
+						const Brush& paint = brush(in);
+						const float width = in.get<float>();
+						const StrokeStyle& stroke = style(in);
+						const Point* points = in.array<Point>(size);
+						if (op == OP::DrawPoly)
+						{
+							graphics.draw_poly(points, size, paint, width, stroke);
+						}
+						else
+						{
+							graphics.draw_polyline(points, size, paint, width, stroke);
+						}
+						break;
+					}
+					case OP::DrawImage:
+					{
+						const Rect rect = in.get<Rect>();
+						const Bitmap* bitmap = in.pointer<Bitmap>();
+						const auto interpolation = static_cast<INTERPOLATION_MODE>(in.get<std::uint32_t>());
+						if (bitmap)
+						{
+							graphics.draw_image(rect, *bitmap, interpolation);
+						}
+						break;
+					}
+					case OP::DrawSprites:
+					{
+						in.get<Rect>();
+						const SpriteAtlas* atlas = in.pointer<SpriteAtlas>();
+						const std::uint32_t size = in.get<std::uint32_t>();
+						if (atlas)
+						{
+							graphics.draw_sprites(*atlas, in.array<Sprite>(size), size);
+						}
+						break;
+					}
+					case OP::DrawText:
+					{
+						const Rect rect = in.get<Rect>();
+						const Font* font = in.pointer<Font>();
+						const Brush& paint = brush(in);
+						const auto alignHorizontal = static_cast<TEXT_ALIGN_HORIZONTAL>(in.get<std::uint32_t>());
+						const auto alignVertical = static_cast<TEXT_ALIGN_VERTICAL>(in.get<std::uint32_t>());
+						const std::uint32_t length = in.get<std::uint32_t>();
+						if (font)
+						{
+							const std::wstring text(in.array<wchar_t>(length), length);
+							graphics.draw_text(text, rect, *font, paint, alignHorizontal, alignVertical);
+						}
+						break;
+					}
+					case OP::FillTriangle:
+					{
+						const Point p1 = in.get<Point>();
+						const Point p2 = in.get<Point>();
+						const Point p3 = in.get<Point>();
+						graphics.fill_triangle(p1, p2, p3, brush(in));
+						break;
+					}
+					case OP::FillRect:
+					{
+						const Rect rect = in.get<Rect>();
+						graphics.fill_rect(rect, brush(in));
+						break;
+					}
+					case OP::FillEllipse:
+					{
+						const Ellipse ellipse = in.get<Ellipse>();
+						graphics.fill_ellipse(ellipse, brush(in));
+						break;
+					}
+					case OP::FillPoly:
+					{
+						const std::uint32_t size = in.get<std::uint32_t>();
+						const Brush& paint = brush(in);
+						const auto mode = static_cast<FILL_MODE>(in.get<std::uint32_t>());
+						graphics.fill_poly(in.array<Point>(size), size, paint, mode);
+						break;
+					}
+					case OP::FillPath:
+					case OP::DrawPath:
+					{
+						in.get<Rect>();
+						const Path* path = in.pointer<Path>();
+						in.get<std::uint64_t>();
+						const Brush& paint = brush(in);
+						if (path == nullptr)
+						{
+							break;
+						}
+						if (op == OP::FillPath)
+						{
+							graphics.fill_path(*path, paint);
+							break;
+						}
+						const float width = in.get<float>();
+						graphics.draw_path(*path, paint, width, style(in));
+						break;
+					}
+					case OP::FillRects:
+					{
+						const std::uint32_t size = in.get<std::uint32_t>();
+						const Brush& paint = brush(in);
+						graphics.fill_rects(in.array<Rect>(size), size, paint);
+						break;
+					}
+					case OP::FillRectsColors:
+					{
+						const std::uint32_t size = in.get<std::uint32_t>();
+						const Rect* rects = in.array<Rect>(size);
+						graphics.fill_rects(rects, in.array<Color32>(size), size);
+						break;
+					}
+					case OP::FillEllipses:
+					{
+						const std::uint32_t size = in.get<std::uint32_t>();
+						const Brush& paint = brush(in);
+						graphics.fill_ellipses(in.array<Ellipse>(size), size, paint);
+						break;
+					}
+					case OP::FillEllipsesColors:
+					{
+						const std::uint32_t size = in.get<std::uint32_t>();
+						const Ellipse* ellipses = in.array<Ellipse>(size);
+						graphics.fill_ellipses(ellipses, in.array<Color32>(size), size);
+						break;
+					}
+					case OP::DrawLines:
+					{
+						const std::uint32_t size = in.get<std::uint32_t>();
+						const Brush& paint = brush(in);
+						const float width = in.get<float>();
+						const StrokeStyle& stroke = style(in);
+						graphics.draw_lines(in.array<Point>(2 * static_cast<size_t>(size)), size, paint, width, stroke);
+						break;
+					}
+					case OP::DrawLinesColors:
+					{
+						const std::uint32_t size = in.get<std::uint32_t>();
+						const float width = in.get<float>();
+						const StrokeStyle& stroke = style(in);
+						const Point* ends = in.array<Point>(2 * static_cast<size_t>(size));
+						graphics.draw_lines(ends, in.array<Color32>(size), size, width, stroke);
+						break;
+					}
+					case OP::SetPixel:
+					{
+						const Point point = in.get<Point>();
+						graphics.set_pixel(point, in.get<Color>());
+						break;
+					}
+					case OP::SetPixels:
+					{
+						const std::uint32_t size = in.get<std::uint32_t>();
+						const Point* points = in.array<Point>(size);
+						graphics.set_pixels(points, in.array<Color>(size), size);
+						break;
+					}
+					case OP::SetPixels32:
+					{
+						const std::uint32_t size = in.get<std::uint32_t>();
+						const Point* points = in.array<Point>(size);
+						graphics.set_pixels(points, in.array<Color32>(size), size);
+						break;
+					}
+					case OP::RotateView:
+					{
+						const float angle = in.get<float>();
+						graphics.rotate_view(angle, in.get<Point>());
+						break;
+					}
+					case OP::ResetView:
+						graphics.reset_view();
+						break;
+					case OP::UpdateImage:
+						ReplayUpdate(graphics, in);
+						break;
+				}
+			}
+		}
+	}
+
+	void CommandList::replay_updates(D2DGraphics& graphics) const
+	{
+		if (updates == 0)
+		{
+			return;
+		}
+		for (const Block& block : blocks)
+		{
+			const std::uint8_t* at = block.data.get();
+			const std::uint8_t* const end = at + block.used;
+			while (at < end)
+			{
+				Reader in{at};
+				const OP op = in.get<OP>();
+				at += in.get<std::uint32_t>();
+				if (op == OP::UpdateImage)
+				{
+					ReplayUpdate(graphics, in);
+				}
+			}
+		}
+	}
+
+	//Walks the records of a list across its blocks
+	struct CommandList::Cursor
+	{
+		const std::vector<Block>& blocks;
+		size_t block;
+		size_t offset;
+
+		//nullptr after the last record
+		const std::uint8_t* next()
+		{
+			while (block < blocks.size() && offset >= blocks[block].used)
+			{
+				block++;
+				offset = 0;
+			}
+			if (block == blocks.size())
+			{
+				return nullptr;
+			}
+			const std::uint8_t* at = blocks[block].data.get() + offset;
+			offset += Reader{at + sizeof(OP)}.get<std::uint32_t>();
+			return at;
+		}
+	};
+
+	//What diffing needs to know of a record
+	struct CommandList::Footprint
+	{
+		//Byte offsets of the palette and style indices in the record, 0 for none
+		size_t paintAt = 0, styleAt = 0;
+		bool draws = false;
+		//Clear draws everywhere, area is unused then
+		bool everywhere = false;
+		//Drawn geometry before the view
+		Rect area{0.f, 0.f, 0.f, 0.f};
+		//Grown by this once in device space, for stroke widths and antialiasing
+		float margin = 1.f;
+		//Set by RotateView and ResetView, for the records after them
+		bool setsView = false;
+		soft::Affine view;
+	};
+
+	Rect PointBounds(const Point* points, const size_t count)
+	{
+		const float inf = std::numeric_limits<float>::infinity();
+		Rect res{inf, inf, -inf, -inf};
+		for (size_t i = 0; i < count; i++)
+		{
+			res.left = std::min(res.left, points[i].x);
+			res.top = std::min(res.top, points[i].y);
+			res.right = std::max(res.right, points[i].x);
+			res.bottom = std::max(res.bottom, points[i].y);
+		}
+		return res;
+	}
+
+	Rect RectBounds(const Rect& rect)
+	{
+		return Rect{
+			std::min(rect.left, rect.right),
+			std::min(rect.top, rect.bottom),
+			std::max(rect.left, rect.right),
+			std::max(rect.top, rect.bottom)
+		};
+	}
+
+	Rect EllipseBounds(const Ellipse& ellipse)
+	{
+		const float rx = std::fabs(ellipse.radius_x);
+		const float ry = std::fabs(ellipse.radius_y);
+		return Rect{ellipse.center.x - rx, ellipse.center.y - ry, ellipse.center.x + rx, ellipse.center.y + ry};
+	}
+
+	Rect Union(const Rect& a, const Rect& b)
+	{
+		return Rect{
+			std::min(a.left, b.left),
+			std::min(a.top, b.top),
+			std::max(a.right, b.right),
+			std::max(a.bottom, b.bottom)
+		};
+	}
+
+	//Half the stroke at its widest, miters and square caps stick out past half the width
+	float StrokeMargin(const float width, const StrokeStyle& style)
+	{
+		return 0.5f * std::fabs(width) * std::max(style.miter_limit, 1.5f) + 1.f;
+	}
+
+	void CommandList::Inspect(const std::uint8_t* record, Footprint& footprint) const
+	{
+		Reader in{record};
+		const OP op = in.get<OP>();
+		in.get<std::uint32_t>();
+		const auto paint = [&]()
+		{
+			footprint.paintAt = static_cast<size_t>(in.at - record);
+			in.get<std::uint32_t>();
+		};
+		const auto stroke = [&](const float width)
+		{
+			footprint.styleAt = static_cast<size_t>(in.at - record);
+			footprint.margin = StrokeMargin(width, styles[in.get<std::uint32_t>()]);
+		};
+		footprint.draws = true;
+		switch (op)
+		{
+			case OP::Clear:
+				footprint.everywhere = true;
+				break;
+			case OP::DrawLine:
+			{
+				const Point* ends = in.array<Point>(2);
+				footprint.area = PointBounds(ends, 2);
+				paint();
+				stroke(in.get<float>());
+				break;
+			}
+			case OP::DrawRect:
+				footprint.area = RectBounds(in.get<Rect>());
+				paint();
+				stroke(in.get<float>());
+				break;
+			case OP::DrawEllipse:
+				footprint.area = EllipseBounds(in.get<Ellipse>());
+				paint();
+				stroke(in.get<float>());
+				break;
+			case OP::DrawPoly:
+			case OP::DrawPolyline:
+			{
+				const std::uint32_t size = in.get<std::uint32_t>();
+				paint();
+				stroke(in.get<float>());
+				footprint.area = PointBounds(in.array<Point>(size), size);
+				break;
+			}
+			case OP::DrawSprites:
+				//Already ordered, and left inverted for no sprites
+				footprint.area = in.get<Rect>();
+				break;
+			case OP::DrawImage:
+			case OP::DrawText:
+				footprint.area = RectBounds(in.get<Rect>());
+				if (op == OP::DrawText)
+				{
+					in.pointer<Font>();
+					paint();
+				}
+				break;
+			case OP::FillTriangle:
+				footprint.area = PointBounds(in.array<Point>(3), 3);
+				paint();
+				break;
+			case OP::FillRect:
+				footprint.area = RectBounds(in.get<Rect>());
+				paint();
+				break;
+			case OP::FillEllipse:
+				footprint.area = EllipseBounds(in.get<Ellipse>());
+				paint();
+				break;
+			case OP::FillPoly:
+			{
+				const std::uint32_t size = in.get<std::uint32_t>();
+				paint();
+				in.get<std::uint32_t>();
+				footprint.area = PointBounds(in.array<Point>(size), size);
+				break;
+			}
+			case OP::FillPath:
+			case OP::DrawPath:
+				//Bounds of the path when it was recorded
+				footprint.area = in.get<Rect>();
+				in.pointer<Path>();
+				in.get<std::uint64_t>();
+				paint();
+				if (op == OP::DrawPath)
+				{
+					stroke(in.get<float>());
+				}
+				break;
+			case OP::FillRects:
+			case OP::FillRectsColors:
+			case OP::FillEllipses:
+			case OP::FillEllipsesColors:
+			{
+				const std::uint32_t size = in.get<std::uint32_t>();
+				if (op == OP::FillRects || op == OP::FillEllipses)
+				{
+					paint();
+				}
+				const float inf = std::numeric_limits<float>::infinity();
+				footprint.area = Rect{inf, inf, -inf, -inf};
+				if (op == OP::FillRects || op == OP::FillRectsColors)
+				{
+					const Rect* rects = in.array<Rect>(size);
+					for (std::uint32_t i = 0; i < size; i++)
+					{
+						footprint.area = Union(footprint.area, RectBounds(rects[i]));
+					}
+				}
+				else
+				{
+					const Ellipse* ellipses = in.array<Ellipse>(size);
+					for (std::uint32_t i = 0; i < size; i++)
+					{
+						footprint.area = Union(footprint.area, EllipseBounds(ellipses[i]));
+					}
+				}
+				break;
+			}
+			case OP::DrawLines:
+			case OP::DrawLinesColors:
+			{
+				const std::uint32_t size = in.get<std::uint32_t>();
+				if (op == OP::DrawLines)
+				{
+					paint();
+				}
+				stroke(in.get<float>());
+				footprint.area = PointBounds(in.array<Point>(2 * static_cast<size_t>(size)), 2 * static_cast<size_t>(size));
+				break;
+			}
+			case OP::SetPixel:
+				footprint.area = PointBounds(&in.get<Point>(), 1);
+				break;
+			case OP::SetPixels:
+			case OP::SetPixels32:
+			{
+				const std::uint32_t size = in.get<std::uint32_t>();
+				footprint.area = PointBounds(in.array<Point>(size), size);
+				break;
+			}
+			case OP::RotateView:
+			{
+				const float angle = in.get<float>();
+				footprint.view = soft::Affine::rotation(angle, in.get<Point>());
+				footprint.setsView = true;
+				footprint.draws = false;
+				break;
+			}
+			case OP::ResetView:
+				footprint.setsView = true;
+				footprint.draws = false;
+				break;
+			case OP::UpdateImage:
+				footprint.draws = false;
+				break;
+		}
+	}
+
+	bool CommandList::Same(
+		const std::uint8_t* record,
+		const Footprint& footprint,
+		const CommandList& other,
+		const std::uint8_t* otherRecord,
+		const Footprint& otherFootprint) const
+	{
+		const std::uint32_t total = Reader{record + sizeof(OP)}.get<std::uint32_t>();
+		if (std::memcmp(record, otherRecord, c_header_size) != 0)
+		{
+			return false;
+		}
+		//Indices are compared by what they refer to, the two lists number them apart
+		size_t from = c_header_size;
+		for (const size_t index : {footprint.paintAt, footprint.styleAt})
+		{
+			if (index == 0)
+			{
+				continue;
+			}
+			if (std::memcmp(record + from, otherRecord + from, index - from) != 0)
+			{
+				return false;
+			}
+			from = index + sizeof(std::uint32_t);
+		}
+		if (std::memcmp(record + from, otherRecord + from, total - from) != 0)
+		{
+			return false;
+		}
+		const auto index = [](const std::uint8_t* at, const size_t offset)
+		{
+			return Reader{at + offset}.get<std::uint32_t>();
+		};
+		if (footprint.paintAt != 0 &&
+			!(palette[index(record, footprint.paintAt)] == other.palette[index(otherRecord, otherFootprint.paintAt)]))
+		{
+			return false;
+		}
+		return footprint.styleAt == 0 ||
+			styles[index(record, footprint.styleAt)] == other.styles[index(otherRecord, otherFootprint.styleAt)];
+	}
+
+	//Adds where a record draws under view, in device space
+	void AddDamage(const Rect& area, const float margin, const soft::Affine& view, std::vector<Rect>& damage)
+	{
+		//Nothing valid to draw, the bounds are still inverted
+		if (!(area.left <= area.right && area.top <= area.bottom))
+		{
+			return;
+		}
+		const float inf = std::numeric_limits<float>::infinity();
+		if (!(std::fabs(area.left) < inf && std::fabs(area.top) < inf && std::fabs(area.right) < inf &&
+			std::fabs(area.bottom) < inf))
+		{
+			damage.push_back(Rect{-inf, -inf, inf, inf});
+			return;
+		}
+		const Point corners[4] = {
+			view.apply(Point{area.left, area.top}),
+			view.apply(Point{area.right, area.top}),
+			view.apply(Point{area.left, area.bottom}),
+			view.apply(Point{area.right, area.bottom})
+		};
+		const Rect bounds = PointBounds(corners, 4);
+		if (!(std::fabs(bounds.left) < inf && std::fabs(bounds.top) < inf && std::fabs(bounds.right) < inf &&
+			std::fabs(bounds.bottom) < inf))
+		{
+			damage.push_back(Rect{-inf, -inf, inf, inf});
+			return;
+		}
+		damage.push_back(Rect{bounds.left - margin, bounds.top - margin, bounds.right + margin, bounds.bottom + margin});
+	}
+
+	void CommandList::diff(const CommandList& previous, std::vector<Rect>& damage) const
+	{
+		const float inf = std::numeric_limits<float>::infinity();
+		Cursor mine{blocks, 0, 0}, theirs{previous.blocks, 0, 0};
+		soft::Affine myView, theirView;
+		const std::uint8_t* record = mine.next();
+		const std::uint8_t* otherRecord = theirs.next();
+		while (record || otherRecord)
+		{
+			Footprint footprint, otherFootprint;
+			if (record)
+			{
+				Inspect(record, footprint);
+			}
+			if (otherRecord)
+			{
+				previous.Inspect(otherRecord, otherFootprint);
+			}
+			const bool sameView = std::memcmp(&myView, &theirView, sizeof(soft::Affine)) == 0;
+			if (!(record && otherRecord && sameView && Same(record, footprint, previous, otherRecord, otherFootprint)))
+			{
+				for (const Footprint* changed : {record ? &footprint : nullptr, otherRecord ? &otherFootprint : nullptr})
+				{
+					if (changed == nullptr || !changed->draws)
+					{
+						continue;
+					}
+					if (changed->everywhere)
+					{
+						damage.push_back(Rect{-inf, -inf, inf, inf});
+						continue;
+					}
+					AddDamage(changed->area, changed->margin, changed == &footprint ? myView : theirView, damage);
+				}
+			}
+			if (footprint.setsView)
+			{
+				myView = footprint.view;
+			}
+			if (otherFootprint.setsView)
+			{
+				theirView = otherFootprint.view;
+			}
+			record = record ? mine.next() : nullptr;
+			otherRecord = otherRecord ? theirs.next() : nullptr;
+		}
+	}
+
+	template <typename T>
+	void WriteValue(std::ostream& out, const T& value)
+	{
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template <typename T>
+	bool ReadValue(std::istream& in, T& value)
+	{
+		return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	void CommandList::write(std::ostream& out) const
+	{
+		out.write(c_trace_magic, sizeof(c_trace_magic));
+		WriteValue(out, c_trace_version);
+		WriteValue(out, static_cast<std::uint32_t>(palette.size()));
+		for (const Color& color : palette)
+		{
+			WriteValue(out, color);
+		}
+		WriteValue(out, static_cast<std::uint32_t>(styles.size()));
+		for (const StrokeStyle& style : styles)
+		{
+			WriteValue(out, static_cast<std::uint32_t>(style.start_cap));
+			WriteValue(out, static_cast<std::uint32_t>(style.end_cap));
+			WriteValue(out, static_cast<std::uint32_t>(style.dash_cap));
+			WriteValue(out, static_cast<std::uint32_t>(style.line_join));
+			WriteValue(out, style.miter_limit);
+			WriteValue(out, style.dash_offset);
+			WriteValue(out, static_cast<std::uint32_t>(style.dashes.size()));
+			for (const float dash : style.dashes)
+			{
+				WriteValue(out, dash);
+			}
+		}
+		WriteValue(out, static_cast<std::uint64_t>(count));
+		WriteValue(out, static_cast<std::uint64_t>(bytes()));
+		//Addresses mean nothing in another process, they are written as null
+		const std::uint64_t null = 0;
+		const size_t pointerAt = c_header_size + sizeof(Rect);
+		for (const Block& block : blocks)
+		{
+			const std::uint8_t* at = block.data.get();
+			const std::uint8_t* const end = at + block.used;
+			while (at < end)
+			{
+				Reader in{at};
+				const OP op = in.get<OP>();
+				const std::uint32_t total = in.get<std::uint32_t>();
+				if (op == OP::DrawImage || op == OP::DrawSprites || op == OP::DrawText || op == OP::FillPath ||
+					op == OP::DrawPath || op == OP::UpdateImage)
+				{
+					out.write(reinterpret_cast<const char*>(at), pointerAt);
+					out.write(reinterpret_cast<const char*>(&null), sizeof(const void*));
+					out.write(reinterpret_cast<const char*>(at + pointerAt + sizeof(const void*)),
+					          total - pointerAt - sizeof(const void*));
+				}
+				else
+				{
+					out.write(reinterpret_cast<const char*>(at), total);
+				}
+				at += total;
+			}
+		}
+	}
+
+	bool CommandList::Check(const std::uint8_t* record) const
+	{
+		Reader in{record};
+		const OP op = in.get<OP>();
+		const std::uint32_t total = in.get<std::uint32_t>();
+		//Records are rounded up to 8 bytes as Record makes them
+		const auto sized = [&](const std::uint64_t fields)
+		{
+			return total == ((c_header_size + fields + 7) & ~static_cast<std::uint64_t>(7));
+		};
+		//Fields ahead of an array must be in the record before its count is read
+		const auto holds = [&](const size_t fields) { return total >= c_header_size + fields; };
+		const auto skip = [&](const size_t bytes)
+		{
+			in.at += bytes;
+			return true;
+		};
+		const auto paint = [&]() { return in.get<std::uint32_t>() < palette.size(); };
+		const auto style = [&]() { return in.get<std::uint32_t>() < styles.size(); };
+		const auto null = [&]() { return in.pointer<std::uint8_t>() == nullptr; };
+		const auto below = [&](const std::uint32_t limit) { return in.get<std::uint32_t>() <= limit; };
+		std::uint64_t size = 0;
+		const auto count = [&]()
+		{
+			size = in.get<std::uint32_t>();
+			return true;
+		};
+		constexpr size_t u32 = sizeof(std::uint32_t);
+		constexpr size_t address = sizeof(const void*);
+		switch (op)
+		{
+			case OP::Clear:
+				return sized(sizeof(Color));
+			case OP::DrawLine:
+				return sized(2 * sizeof(Point) + 3 * u32) && skip(2 * sizeof(Point)) && paint() && skip(u32) && style();
+			case OP::DrawRect:
+				return sized(sizeof(Rect) + 3 * u32) && skip(sizeof(Rect)) && paint() && skip(u32) && style();
+			case OP::DrawEllipse:
+				return sized(sizeof(Ellipse) + 3 * u32) && skip(sizeof(Ellipse)) && paint() && skip(u32) && style();
+			case OP::DrawPoly:
+			case OP::DrawPolyline:
+				return holds(4 * u32) && count() && sized(4 * u32 + size * sizeof(Point)) && paint() && skip(u32) && style();
+			case OP::DrawImage:
+				return sized(sizeof(Rect) + address + u32) && skip(sizeof(Rect)) && null() &&
+					below(static_cast<std::uint32_t>(INTERPOLATION_MODE::HighQuality));
+			case OP::DrawSprites:
+				return holds(sizeof(Rect) + address + u32) && skip(sizeof(Rect)) && null() && count() &&
+					sized(sizeof(Rect) + address + u32 + size * sizeof(Sprite));
+			case OP::DrawText:
+				return holds(sizeof(Rect) + address + 4 * u32) && skip(sizeof(Rect)) && null() && paint() &&
+					below((std::max)({
+						static_cast<std::uint32_t>(TEXT_ALIGN_HORIZONTAL::Left),
+						static_cast<std::uint32_t>(TEXT_ALIGN_HORIZONTAL::Center),
+						static_cast<std::uint32_t>(TEXT_ALIGN_HORIZONTAL::Right)
+					})) &&
+					below((std::max)({
+						static_cast<std::uint32_t>(TEXT_ALIGN_VERTICAL::Top),
+						static_cast<std::uint32_t>(TEXT_ALIGN_VERTICAL::Bottom),
+						static_cast<std::uint32_t>(TEXT_ALIGN_VERTICAL::Center)
+					})) &&
+					count() && sized(sizeof(Rect) + address + 4 * u32 + size * sizeof(wchar_t));
+			case OP::FillTriangle:
+				return sized(3 * sizeof(Point) + u32) && skip(3 * sizeof(Point)) && paint();
+			case OP::FillRect:
+				return sized(sizeof(Rect) + u32) && skip(sizeof(Rect)) && paint();
+			case OP::FillEllipse:
+				return sized(sizeof(Ellipse) + u32) && skip(sizeof(Ellipse)) && paint();
+			case OP::FillPoly:
+				return holds(3 * u32) && count() && sized(3 * u32 + size * sizeof(Point)) && paint() &&
+					below(static_cast<std::uint32_t>(FILL_MODE::Winding));
+			case OP::FillPath:
+				return sized(sizeof(Rect) + address + sizeof(std::uint64_t) + u32) && skip(sizeof(Rect)) && null() &&
+					skip(sizeof(std::uint64_t)) && paint();
+			case OP::DrawPath:
+				return sized(sizeof(Rect) + address + sizeof(std::uint64_t) + 3 * u32) && skip(sizeof(Rect)) && null() &&
+					skip(sizeof(std::uint64_t)) && paint() && skip(u32) && style();
+			case OP::FillRects:
+				return holds(2 * u32) && count() && sized(2 * u32 + size * sizeof(Rect)) && paint();
+			case OP::FillRectsColors:
+				return holds(u32) && count() && sized(u32 + size * (sizeof(Rect) + sizeof(Color32)));
+			case OP::FillEllipses:
+				return holds(2 * u32) && count() && sized(2 * u32 + size * sizeof(Ellipse)) && paint();
+			case OP::FillEllipsesColors:
+				return holds(u32) && count() && sized(u32 + size * (sizeof(Ellipse) + sizeof(Color32)));
+			case OP::DrawLines:
+				return holds(4 * u32) && count() && sized(4 * u32 + 2 * size * sizeof(Point)) && paint() && skip(u32) &&
+					style();
+			case OP::DrawLinesColors:
+				return holds(3 * u32) && count() && sized(3 * u32 + size * (2 * sizeof(Point) + sizeof(Color32))) &&
+					skip(u32) && style();
+			case OP::SetPixel:
+				return sized(sizeof(Point) + sizeof(Color));
+			case OP::SetPixels:
+				return holds(u32) && count() && sized(u32 + size * (sizeof(Point) + sizeof(Color)));
+			case OP::SetPixels32:
+				return holds(u32) && count() && sized(u32 + size * (sizeof(Point) + sizeof(Color32)));
+			case OP::RotateView:
+				return sized(sizeof(float) + sizeof(Point));
+			case OP::ResetView:
+				return sized(0);
+			case OP::UpdateImage:
+			{
+				if (!(holds(sizeof(Rect) + address + 2 * u32) && skip(sizeof(Rect)) && null()))
+				{
+					return false;
+				}
+				const std::uint64_t width = in.get<std::uint32_t>();
+				const std::uint64_t height = in.get<std::uint32_t>();
+				//Bounded first, the product of two counts could wrap once multiplied by the pixel size
+				return width * height <= total &&
+					sized(sizeof(Rect) + address + 2 * u32 + width * height * sizeof(std::uint32_t));
+			}
+		}
+		return false;
+	}
+
+	bool CommandList::read(std::istream& in)
+	{
+		reset();
+		char magic[sizeof(c_trace_magic)];
+		std::uint32_t version = 0;
+		if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, c_trace_magic, sizeof(magic)) != 0 ||
+			!ReadValue(in, version) || version != c_trace_version)
+		{
+			return false;
+		}
+		std::uint32_t paletteSize = 0;
+		if (!ReadValue(in, paletteSize))
+		{
+			return false;
+		}
+		for (std::uint32_t i = 0; i < paletteSize; i++)
+		{
+			Color color{0.f, 0.f, 0.f, 0.f};
+			//write has each color once, another would shift the indices after it
+			if (!ReadValue(in, color) || Paint(color) != i)
+			{
+				reset();
+				return false;
+			}
+		}
+		std::uint32_t styleCount = 0;
+		if (!ReadValue(in, styleCount))
+		{
+			reset();
+			return false;
+		}
+		for (std::uint32_t i = 0; i < styleCount; i++)
+		{
+			std::uint32_t caps[4] = {};
+			std::uint32_t dashCount = 0;
+			StrokeStyle style;
+			bool good = ReadValue(in, caps) && ReadValue(in, style.miter_limit) &&
+				ReadValue(in, style.dash_offset) && ReadValue(in, dashCount);
+			style.start_cap = static_cast<CAP_STYLE>(caps[0]);
+			style.end_cap = static_cast<CAP_STYLE>(caps[1]);
+			style.dash_cap = static_cast<CAP_STYLE>(caps[2]);
+			style.line_join = static_cast<LINE_JOIN>(caps[3]);
+			good = good && caps[0] <= static_cast<std::uint32_t>(CAP_STYLE::Triangle) &&
+				caps[1] <= static_cast<std::uint32_t>(CAP_STYLE::Triangle) &&
+				caps[2] <= static_cast<std::uint32_t>(CAP_STYLE::Triangle) &&
+				caps[3] <= static_cast<std::uint32_t>(LINE_JOIN::MiterOrBevel) &&
+				std::isfinite(style.miter_limit) && std::isfinite(style.dash_offset);
+			for (std::uint32_t d = 0; good && d < dashCount; d++)
+			{
+				float dash = 0.f;
+				good = ReadValue(in, dash) && std::isfinite(dash) && dash >= 0.f;
+				style.dashes.push_back(dash);
+			}
+			if (!good || Style(style) != i)
+			{
+				reset();
+				return false;
+			}
+		}
+		std::uint64_t recordCount = 0, recordBytes = 0;
+		if (!ReadValue(in, recordCount) || !ReadValue(in, recordBytes))
+		{
+			reset();
+			return false;
+		}
+		//Read a block at a time, a size the stream does not hold fails at its end instead of
+		//being allocated up front
+		std::vector<std::uint8_t> read;
+		while (read.size() < recordBytes)
+		{
+			const size_t at = read.size();
+			const auto chunk = static_cast<size_t>((std::min)(recordBytes - at, static_cast<std::uint64_t>(c_block_size)));
+			read.resize(at + chunk);
+			if (!in.read(reinterpret_cast<char*>(read.data() + at), static_cast<std::streamsize>(chunk)))
+			{
+				reset();
+				return false;
+			}
+		}
+		std::uint8_t* records = Allocate(read.size());
+		PutArray(records, read.data(), read.size());
+		//Every record is checked against its op, replaying what was read stays in bounds
+		size_t offset = 0, recordsSeen = 0, updatesSeen = 0;
+		while (offset < recordBytes)
+		{
+			if (recordBytes - offset < c_header_size)
+			{
+				reset();
+				return false;
+			}
+			Reader header{records + offset};
+			const auto op = static_cast<std::uint32_t>(header.get<OP>());
+			const std::uint32_t total = header.get<std::uint32_t>();
+			if (op > static_cast<std::uint32_t>(OP::UpdateImage) || total < c_header_size || total % 8 != 0 ||
+				total > recordBytes - offset || !Check(records + offset))
+			{
+				reset();
+				return false;
+			}
+			offset += total;
+			recordsSeen++;
+			updatesSeen += op == static_cast<std::uint32_t>(OP::UpdateImage);
+		}
+		if (recordsSeen != recordCount)
+		{
+			reset();
+			return false;
+		}
+		count = recordsSeen;
+		updates = updatesSeen;
+		return true;
+	}
+
+	void CommandList::clear(const Color color)
+	{
+		Record(OP::Clear, 0, color);
+	}
+
+	void CommandList::draw_line(const Point from, const Point to, const Brush& brush, const float width, const StrokeStyle& style)
+	{
+		Record(OP::DrawLine, 0, from, to, Paint(brush), width, Style(style));
+	}
+
+	void CommandList::draw_rect(const Rect rect, const Brush& brush, const float width, const StrokeStyle& style)
+	{
+		Record(OP::DrawRect, 0, rect, Paint(brush), width, Style(style));
+	}
+
+	void CommandList::draw_ellipse(const Ellipse ellipse, const Brush& brush, const float width, const StrokeStyle& style)
+	{
+		Record(OP::DrawEllipse, 0, ellipse, Paint(brush), width, Style(style));
+	}
+
+	void CommandList::draw_poly(
+		const Point* points,
+		const size_t size,
+		const Brush& brush,
+		const float width,
+		const StrokeStyle& style)
+	{
+		std::uint8_t* at = Record(OP::DrawPoly, size * sizeof(Point),
+		                          static_cast<std::uint32_t>(size), Paint(brush), width, Style(style));
+		PutArray(at, points, size);
+	}
+
+	void CommandList::draw_polyline(
+		const Point* points,
+		const size_t size,
+		const Brush& brush,
+		const float width,
+		const StrokeStyle& style)
+	{
+		std::uint8_t* at = Record(OP::DrawPolyline, size * sizeof(Point),
+		                          static_cast<std::uint32_t>(size), Paint(brush), width, Style(style));
+		PutArray(at, points, size);
+	}
+
+	void CommandList::draw_image(const Rect rect, const Bitmap& bitmap, const INTERPOLATION_MODE interpolation)
+	{
+		const Bitmap* const address = &bitmap;
+		std::uint8_t* at = Record(OP::DrawImage, sizeof(address) + sizeof(std::uint32_t), rect);
+		std::memcpy(at, &address, sizeof(address));
+		PutFields(at + sizeof(address), static_cast<std::uint32_t>(interpolation));
+	}
+
+	void CommandList::draw_sprites(const SpriteAtlas& atlas, const Sprite* sprites, const size_t size)
+	{
+		//Bounds of every sprite first, where the other calls with an address keep their rect
+		const float inf = std::numeric_limits<float>::infinity();
+		Rect bounds{inf, inf, -inf, -inf};
+		for (size_t i = 0; i < size; i++)
+		{
+			bounds = Union(bounds, RectBounds(sprites[i].rect));
+		}
+		const SpriteAtlas* const address = &atlas;
+		std::uint8_t* at = Record(OP::DrawSprites, sizeof(address) + sizeof(std::uint32_t) + size * sizeof(Sprite), bounds);
+		std::memcpy(at, &address, sizeof(address));
+		at = PutFields(at + sizeof(address), static_cast<std::uint32_t>(size));
+		PutArray(at, sprites, size);
+	}
+
+	void CommandList::draw_text(
+		const std::wstring& text,
+		const Rect rect,
+		const Font& font,
+		const Brush& brush,
+		const TEXT_ALIGN_HORIZONTAL alignHorizontal,
+		const TEXT_ALIGN_VERTICAL alignVertical)
+	{
+		const Font* const address = &font;
+		std::uint8_t* at = Record(OP::DrawText, sizeof(address) + 4 * sizeof(std::uint32_t) + text.size() * sizeof(wchar_t), rect);
+		std::memcpy(at, &address, sizeof(address));
+		at = PutFields(at + sizeof(address),
+		               Paint(brush),
+		               static_cast<std::uint32_t>(alignHorizontal),
+		               static_cast<std::uint32_t>(alignVertical),
+		               static_cast<std::uint32_t>(text.size()));
+		PutArray(at, text.data(), text.size());
+	}
+
+	void CommandList::fill_triangle(const Point p1, const Point p2, const Point p3, const Brush& brush)
+	{
+		Record(OP::FillTriangle, 0, p1, p2, p3, Paint(brush));
+	}
+
+	void CommandList::fill_rect(const Rect rect, const Brush& brush)
+	{
+		Record(OP::FillRect, 0, rect, Paint(brush));
+	}
+
+	void CommandList::fill_ellipse(const Ellipse ellipse, const Brush& brush)
+	{
+		Record(OP::FillEllipse, 0, ellipse, Paint(brush));
+	}
+
+	void CommandList::fill_poly(const Point* points, const size_t size, const Brush& brush, const FILL_MODE mode)
+	{
+		std::uint8_t* at = Record(OP::FillPoly, size * sizeof(Point),
+		                          static_cast<std::uint32_t>(size), Paint(brush), static_cast<std::uint32_t>(mode));
+		PutArray(at, points, size);
+	}
+
+	void CommandList::fill_path(const Path& path, const Brush& brush)
+	{
+		const Path* const address = &path;
+		std::uint8_t* at = Record(OP::FillPath, sizeof(address) + sizeof(std::uint64_t) + sizeof(std::uint32_t),
+		                          path.figures.bounds);
+		std::memcpy(at, &address, sizeof(address));
+		PutFields(at + sizeof(address), path.revision, Paint(brush));
+	}
+
+	void CommandList::draw_path(const Path& path, const Brush& brush, const float width, const StrokeStyle& style)
+	{
+		const Path* const address = &path;
+		std::uint8_t* at = Record(OP::DrawPath, sizeof(address) + sizeof(std::uint64_t) + 3 * sizeof(std::uint32_t),
+		                          path.figures.bounds);
+		std::memcpy(at, &address, sizeof(address));
+		PutFields(at + sizeof(address), path.revision, Paint(brush), width, Style(style));
+	}
+
+	void CommandList::fill_rects(const Rect* rects, const size_t size, const Brush& brush)
+	{
+		std::uint8_t* at = Record(OP::FillRects, size * sizeof(Rect), static_cast<std::uint32_t>(size), Paint(brush));
+		PutArray(at, rects, size);
+	}
+
+	void CommandList::fill_rects(const Rect* rects, const Color32* colors, const size_t size)
+	{
+		std::uint8_t* at = Record(OP::FillRectsColors, size * (sizeof(Rect) + sizeof(Color32)),
+		                          static_cast<std::uint32_t>(size));
+		PutArray(at, rects, size);
+		PutArray(at + size * sizeof(Rect), colors, size);
+	}
+
+	void CommandList::fill_ellipses(const Ellipse* ellipses, const size_t size, const Brush& brush)
+	{
+		std::uint8_t* at = Record(OP::FillEllipses, size * sizeof(Ellipse), static_cast<std::uint32_t>(size), Paint(brush));
+		PutArray(at, ellipses, size);
+	}
+
+	void CommandList::fill_ellipses(const Ellipse* ellipses, const Color32* colors, const size_t size)
+	{
+		std::uint8_t* at = Record(OP::FillEllipsesColors, size * (sizeof(Ellipse) + sizeof(Color32)),
+		                          static_cast<std::uint32_t>(size));
+		PutArray(at, ellipses, size);
+		PutArray(at + size * sizeof(Ellipse), colors, size);
+	}
+
+	void CommandList::draw_lines(const Point* ends, const size_t size, const Brush& brush, const float width, const StrokeStyle& style)
+	{
+		std::uint8_t* at = Record(OP::DrawLines, 2 * size * sizeof(Point),
+		                          static_cast<std::uint32_t>(size), Paint(brush), width, Style(style));
+		PutArray(at, ends, 2 * size);
+	}
+
+	void CommandList::draw_lines(
+		const Point* ends,
+		const Color32* colors,
+		const size_t size,
+		const float width,
+		const StrokeStyle& style)
+	{
+		std::uint8_t* at = Record(OP::DrawLinesColors, size * (2 * sizeof(Point) + sizeof(Color32)),
+		                          static_cast<std::uint32_t>(size), width, Style(style));
+		PutArray(at, ends, 2 * size);
+		PutArray(at + 2 * size * sizeof(Point), colors, size);
+	}
+
+	void CommandList::set_pixel(const Point point, const Color color)
+	{
+		Record(OP::SetPixel, 0, point, color);
+	}
+
+	void CommandList::set_pixels(const Point* points, const Color* colors, const size_t size)
+	{
+		std::uint8_t* at = Record(OP::SetPixels, size * (sizeof(Point) + sizeof(Color)), static_cast<std::uint32_t>(size));
+		PutArray(at, points, size);
+		PutArray(at + size * sizeof(Point), colors, size);
+	}
+
+	void CommandList::set_pixels(const Point* points, const Color32* colors, const size_t size)
+	{
+		std::uint8_t* at = Record(OP::SetPixels32, size * (sizeof(Point) + sizeof(Color32)), static_cast<std::uint32_t>(size));
+		PutArray(at, points, size);
+		PutArray(at + size * sizeof(Point), colors, size);
+	}
+
+	void CommandList::rotate_view(const float angle, const Point center)
+	{
+		Record(OP::RotateView, 0, angle, center);
+	}
+
+	void CommandList::reset_view()
+	{
+		Record(OP::ResetView, 0);
+	}
+
+	void CommandList::update_image(Bitmap& bitmap, const Rect region, const void* srcData, const UINT pitch)
+	{
+		//Rows are packed tight, the pixels are read back with the region's width as pitch
+		const auto width = static_cast<std::uint32_t>(std::lround(region.right - region.left));
+		const auto height = static_cast<std::uint32_t>(std::lround(region.bottom - region.top));
+		const size_t rowBytes = width * sizeof(std::uint32_t);
+		const Bitmap* const address = &bitmap;
+		std::uint8_t* at = Record(OP::UpdateImage, sizeof(address) + 2 * sizeof(std::uint32_t) + height * rowBytes, region);
+		std::memcpy(at, &address, sizeof(address));
+		at = PutFields(at + sizeof(address), width, height);
+		const auto* src = static_cast<const std::uint8_t*>(srcData);
+		for (std::uint32_t y = 0; y < height; y++, at += rowBytes, src += pitch)
+		{
+			std::memcpy(at, src, rowBytes);
+		}
+		updates++;
+	}
+}
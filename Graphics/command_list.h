@@ -0,0 +1,164 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "graph.h"
+
+namespace graph
+{
+	//Drawing calls kept in a compact binary encoding to be drawn again any number of times,
+	//onto any backend. Fill one with D2DGraphics::begin_record or by calling it directly,
+	//draw it with D2DGraphics::draw_list.
+	//Records sit back to back in blocks of a bump arena, recording only allocates when a
+	//block fills up or a color or stroke style is seen for the first time.
+	//Brushes are kept as their color, bitmaps, atlases, fonts and paths by address, so those must
+	//outlive the list and belong to the graphics it is drawn on. update_image keeps a copy of the
+	//pixels, the bitmap takes them when the list is drawn, after the calls recorded before.
+	class CommandList
+	{
+		enum class OP : std::uint32_t
+		{
+			Clear,
+			DrawLine,
+			DrawRect,
+			DrawEllipse,
+			DrawPoly,
+			DrawPolyline,
+			DrawImage,
+			DrawSprites,
+			DrawText,
+			FillTriangle,
+			FillRect,
+			FillEllipse,
+			FillPoly,
+			FillPath,
+			DrawPath,
+			FillRects,
+			FillRectsColors,
+			FillEllipses,
+			FillEllipsesColors,
+			DrawLines,
+			DrawLinesColors,
+			SetPixel,
+			SetPixels,
+			SetPixels32,
+			RotateView,
+			ResetView,
+			UpdateImage
+		};
+
+		struct Block
+		{
+			std::unique_ptr<std::uint8_t[]> data;
+			size_t size, used;
+		};
+
+		std::vector<Block> blocks;
+		size_t count = 0;
+		//Of them UpdateImage
+		size_t updates = 0;
+
+		//Brush colors and stroke styles are stored once and referred to by index
+		std::vector<Color> palette;
+		std::map<Color, std::uint32_t> paletteIndex;
+		std::vector<StrokeStyle> styles;
+		std::map<StrokeStyle, std::uint32_t> styleIndex;
+
+		//Brushes of the palette on the graphics being drawn to, reused between draws
+		mutable std::vector<const SolidBrush*> resolved;
+
+		struct Cursor;
+		struct Footprint;
+
+		void Inspect(const std::uint8_t* record, Footprint& footprint) const;
+		bool Same(const std::uint8_t* record, const Footprint& footprint,
+		          const CommandList& other, const std::uint8_t* otherRecord, const Footprint& otherFootprint) const;
+
+		//False unless record is one write could have made, its indices and counts in range and its
+		//addresses null
+		bool Check(const std::uint8_t* record) const;
+
+		std::uint8_t* Allocate(size_t bytes);
+		template <typename... Fields>
+		std::uint8_t* Record(OP op, size_t extra, const Fields&... fields);
+		std::uint32_t Paint(const Brush& brush);
+		std::uint32_t Paint(Color color);
+		std::uint32_t Style(const StrokeStyle& style);
+	public:
+		CommandList() = default;
+		CommandList(const CommandList&) = delete;
+		CommandList(CommandList&&) noexcept = default;
+		CommandList& operator=(const CommandList&) = delete;
+		CommandList& operator=(CommandList&&) noexcept = default;
+
+		//Number of recorded calls
+		size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+		//Number of recorded update_image calls
+		size_t image_updates() const { return updates; }
+
+		//Bytes of encoded calls
+		size_t bytes() const;
+
+		//Drops the calls, the first block is kept for the next recording
+		void reset();
+
+		//Makes the calls on graphics in the order they were recorded
+		void replay(D2DGraphics& graphics) const;
+		//Makes only the update_image calls, for a list that is not drawn
+		void replay_updates(D2DGraphics& graphics) const;
+
+		//Adds to damage the areas, in DIPs, where drawing this list may give other pixels than
+		//drawing previous. The lists are walked side by side and a call that differs adds where
+		//it draws in both, so inserting a call early damages all that follows it.
+		//Both lists are taken to start with a reset view. Bitmaps, atlases and fonts are compared by
+		//address, new content in the same bitmap is not seen, updates of it included, and text is
+		//taken to stay in its rect.
+		//A path is the same while its address and revision are.
+		void diff(const CommandList& previous, std::vector<Rect>& damage) const;
+
+		//Portable trace of the calls, bitmaps, atlases, fonts and paths are left out and their calls skipped
+		void write(std::ostream& out) const;
+		//Replaces the content, false if in is not a trace or any record in it is damaged
+		bool read(std::istream& in);
+
+		void clear(Color color);
+		void draw_line(Point from, Point to, const Brush& brush, float width, const StrokeStyle& style);
+		void draw_rect(Rect rect, const Brush& brush, float width, const StrokeStyle& style);
+		void draw_ellipse(Ellipse ellipse, const Brush& brush, float width, const StrokeStyle& style);
+		void draw_poly(const Point* points, size_t size, const Brush& brush, float width, const StrokeStyle& style);
+		void draw_polyline(const Point* points, size_t size, const Brush& brush, float width, const StrokeStyle& style);
+		void draw_image(Rect rect, const Bitmap& bitmap, INTERPOLATION_MODE interpolation);
+		void draw_sprites(const SpriteAtlas& atlas, const Sprite* sprites, size_t size);
+		void draw_text(
+			const std::wstring& text,
+			Rect rect,
+			const Font& font,
+			const Brush& brush,
+			TEXT_ALIGN_HORIZONTAL alignHorizontal,
+			TEXT_ALIGN_VERTICAL alignVertical);
+		void fill_triangle(Point p1, Point p2, Point p3, const Brush& brush);
+		void fill_rect(Rect rect, const Brush& brush);
+		void fill_ellipse(Ellipse ellipse, const Brush& brush);
+		void fill_poly(const Point* points, size_t size, const Brush& brush, FILL_MODE mode);
+		void fill_path(const Path& path, const Brush& brush);
+		void draw_path(const Path& path, const Brush& brush, float width, const StrokeStyle& style);
+		void fill_rects(const Rect* rects, size_t size, const Brush& brush);
+		void fill_rects(const Rect* rects, const Color32* colors, size_t size);
+		void fill_ellipses(const Ellipse* ellipses, size_t size, const Brush& brush);
+		void fill_ellipses(const Ellipse* ellipses, const Color32* colors, size_t size);
+		void draw_lines(const Point* ends, size_t size, const Brush& brush, float width, const StrokeStyle& style);
+		void draw_lines(const Point* ends, const Color32* colors, size_t size, float width, const StrokeStyle& style);
+		void set_pixel(Point point, Color color);
+		void set_pixels(const Point* points, const Color* colors, size_t size);
+		void set_pixels(const Point* points, const Color32* colors, size_t size);
+		void rotate_view(float angle, Point center);
+		void reset_view();
+		//region in whole pixels inside the bitmap, as D2DGraphics::update_image clips it
+		void update_image(Bitmap& bitmap, Rect region, const void* srcData, UINT pitch);
+	};
+}
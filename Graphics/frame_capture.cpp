@@ -0,0 +1,189 @@
+#include "frame_capture.h"
+#include "soft_encode.h"
+#include <algorithm>
+#include <cstring>
+
+namespace graph
+{
+	//BT.601 limited range from 8-bit RGB, rounded
+	void RgbToYuv(const std::uint32_t r, const std::uint32_t g, const std::uint32_t b,
+	              std::uint8_t& y, std::uint8_t& u, std::uint8_t& v)
+	{
+		const int ri = static_cast<int>(r), gi = static_cast<int>(g), bi = static_cast<int>(b);
+		y = static_cast<std::uint8_t>(16 + ((66 * ri + 129 * gi + 25 * bi + 128) >> 8));
+		u = static_cast<std::uint8_t>(128 + ((-38 * ri - 74 * gi + 112 * bi + 128) >> 8));
+		v = static_cast<std::uint8_t>(128 + ((112 * ri - 94 * gi - 18 * bi + 128) >> 8));
+	}
+
+	FrameCapture::FrameCapture(
+		const std::wstring& path,
+		const CAPTURE_FORMAT format,
+		const int width,
+		const int height,
+		const unsigned frameRate,
+		const size_t bufferCount) :
+		path(path),
+		format(format),
+		width(width),
+		height(height),
+		slots((std::max)(bufferCount, static_cast<size_t>(1)))
+	{
+		if (format != CAPTURE_FORMAT::PngSequence)
+		{
+			file = soft::OpenForWriting(path);
+			if (file == nullptr)
+			{
+				return;
+			}
+		}
+		if (format == CAPTURE_FORMAT::Y4M)
+		{
+			std::fprintf(file, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C444\n", width, height, (std::max)(frameRate, 1u));
+		}
+		for (Slot& slot : slots)
+		{
+			slot.pixels.resize(width, height);
+		}
+		writer = std::thread([this] { WriterMain(); });
+	}
+
+	FrameCapture::~FrameCapture()
+	{
+		stop();
+	}
+
+	void FrameCapture::stop()
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			quit = true;
+		}
+		wake.notify_all();
+		if (writer.joinable())
+		{
+			writer.join();
+		}
+		if (file)
+		{
+			std::fclose(file);
+			file = nullptr;
+		}
+	}
+
+	bool FrameCapture::is_open() const
+	{
+		return format == CAPTURE_FORMAT::PngSequence || file != nullptr;
+	}
+
+	void FrameCapture::push(const soft::Image& frame)
+	{
+		size_t tail;
+		std::uint64_t index;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			index = stats.frames++;
+			if (quit || !is_open() || filled == slots.size() || frame.width() != width || frame.height() != height)
+			{
+				stats.dropped++;
+				return;
+			}
+			tail = (head + filled) % slots.size();
+		}
+		//The writer never touches slots past the filled ones, so the copy needs no lock
+		Slot& slot = slots[tail];
+		slot.pixels.copy_from(frame.row(0), frame.pitch());
+		slot.index = index;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			filled++;
+		}
+		wake.notify_one();
+	}
+
+	CaptureStats FrameCapture::get_stats() const
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return stats;
+	}
+
+	void FrameCapture::WriterMain()
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		for (;;)
+		{
+			wake.wait(guard, [this] { return filled > 0 || quit; });
+			if (filled == 0)
+			{
+				return;
+			}
+			const Slot& slot = slots[head];
+			guard.unlock();
+			const bool ok = Write(slot);
+			guard.lock();
+			stats.written += ok ? 1 : 0;
+			stats.failed += ok ? 0 : 1;
+			head = (head + 1) % slots.size();
+			filled--;
+		}
+	}
+
+	bool FrameCapture::Write(const Slot& slot)
+	{
+		const soft::Image& frame = slot.pixels;
+		const size_t pixelCount = static_cast<size_t>(width) * static_cast<size_t>(height);
+		switch (format)
+		{
+		case CAPTURE_FORMAT::PngSequence:
+			{
+				soft::EncodePng(frame, encoded);
+				std::wstring name = std::to_wstring(slot.index);
+				if (name.size() < 6)
+				{
+					name.insert(0, 6 - name.size(), L'0');
+				}
+				std::FILE* png = soft::OpenForWriting(path + name + L".png");
+				if (png == nullptr)
+				{
+					return false;
+				}
+				const bool ok = std::fwrite(encoded.data(), 1, encoded.size(), png) == encoded.size();
+				return std::fclose(png) == 0 && ok;
+			}
+		case CAPTURE_FORMAT::RawBGRA:
+			{
+				const size_t rowBytes = static_cast<size_t>(width) * sizeof(soft::Pixel);
+				for (int y = 0; y < height; y++)
+				{
+					if (std::fwrite(frame.row(y), 1, rowBytes, file) != rowBytes)
+					{
+						return false;
+					}
+				}
+				return std::fflush(file) == 0;
+			}
+		case CAPTURE_FORMAT::Y4M:
+			{
+				//FRAME then the Y, U and V planes, premultiplied colors are already over black
+				static const char c_frame[] = "FRAME\n";
+				const size_t headerBytes = sizeof(c_frame) - 1;
+				encoded.resize(headerBytes + pixelCount * 3);
+				std::memcpy(encoded.data(), c_frame, headerBytes);
+				std::uint8_t* const planeY = encoded.data() + headerBytes;
+				std::uint8_t* const planeU = planeY + pixelCount;
+				std::uint8_t* const planeV = planeU + pixelCount;
+				size_t i = 0;
+				for (int y = 0; y < height; y++)
+				{
+					const soft::Pixel* src = frame.row(y);
+					for (int x = 0; x < width; x++, i++)
+					{
+						const soft::Pixel p = src[x];
+						RgbToYuv(p >> 16 & 0xFF, p >> 8 & 0xFF, p & 0xFF, planeY[i], planeU[i], planeV[i]);
+					}
+				}
+				return std::fwrite(encoded.data(), 1, encoded.size(), file) == encoded.size() && std::fflush(file) == 0;
+			}
+		}
+		return false;
+	}
+}
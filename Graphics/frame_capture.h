@@ -0,0 +1,70 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "graph_types.h"
+#include "soft_canvas.h"
+
+namespace graph
+{
+	//Frames copied into a ring of buffers allocated up front and written out by a thread of its
+	//own. push never waits for the writer: with every buffer still waiting, the frame is dropped.
+	class FrameCapture
+	{
+		struct Slot
+		{
+			soft::Image pixels;
+			//Number of the frame since the capture started
+			std::uint64_t index = 0;
+		};
+
+		std::wstring path;
+		CAPTURE_FORMAT format;
+		std::FILE* file = nullptr;
+		int width, height;
+
+		std::vector<Slot> slots;
+		//Slots [head, head + filled) wait for the writer in order, the writer holds head until written
+		size_t head = 0, filled = 0;
+		mutable std::mutex lock;
+		std::condition_variable wake;
+		bool quit = false;
+		CaptureStats stats;
+
+		//Of the writer thread, reused from frame to frame
+		std::vector<std::uint8_t> encoded;
+		std::thread writer;
+
+		void WriterMain();
+		bool Write(const Slot& slot);
+	public:
+		//Frames of width by height. Raw and Y4M files are created here, frameRate goes in the Y4M header
+		FrameCapture(
+			const std::wstring& path,
+			CAPTURE_FORMAT format,
+			int width,
+			int height,
+			unsigned frameRate,
+			size_t bufferCount);
+		~FrameCapture();
+
+		FrameCapture(const FrameCapture&) = delete;
+		FrameCapture& operator=(const FrameCapture&) = delete;
+
+		//False if the file could not be created
+		bool is_open() const;
+
+		//Copies frame into a free buffer for the writer, from one thread
+		void push(const soft::Image& frame);
+
+		//Writes what is waiting and closes the file, later frames are dropped
+		void stop();
+
+		CaptureStats get_stats() const;
+	};
+}
@@ -0,0 +1,83 @@
+#include "frame_scheduler.h"
+#include <algorithm>
+#include <thread>
+
+namespace graph
+{
+	FrameScheduler::Clock::duration Period(const float rate)
+	{
+		if (!(rate > 0.f))
+		{
+			return FrameScheduler::Clock::duration::zero();
+		}
+		return std::chrono::duration_cast<FrameScheduler::Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+	}
+
+	FrameScheduler::FrameScheduler(const float targetFps, const float updateRate, const unsigned maxUpdates, const float spinMs) :
+		frameInterval(Period(targetFps)),
+		updateStep(Period(updateRate)),
+		spin(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>((std::max)(spinMs, 0.f)))),
+		maxUpdates((std::max)(maxUpdates, 1u))
+	{
+	}
+
+	void FrameScheduler::wait()
+	{
+		if (frameInterval == Clock::duration::zero())
+		{
+			return;
+		}
+		Clock::time_point now = Clock::now();
+		if (!waited)
+		{
+			waited = true;
+			nextFrame = now + frameInterval;
+			return;
+		}
+		if (nextFrame - now > spin)
+		{
+			std::this_thread::sleep_for(nextFrame - now - spin);
+			now = Clock::now();
+		}
+		while (now < nextFrame)
+		{
+			std::this_thread::yield();
+			now = Clock::now();
+		}
+		nextFrame += frameInterval;
+		if (nextFrame < now)
+		{
+			nextFrame = now + frameInterval;
+		}
+	}
+
+	unsigned FrameScheduler::advance()
+	{
+		const Clock::time_point now = Clock::now();
+		if (!advanced || updateStep == Clock::duration::zero())
+		{
+			advanced = true;
+			lastAdvance = now;
+			return 1;
+		}
+		accumulator += now - lastAdvance;
+		lastAdvance = now;
+		const Clock::rep due = accumulator / updateStep;
+		if (due > static_cast<Clock::rep>(maxUpdates))
+		{
+			accumulator %= updateStep;
+			return maxUpdates;
+		}
+		accumulator -= due * updateStep;
+		return static_cast<unsigned>(due);
+	}
+
+	float FrameScheduler::get_alpha() const
+	{
+		if (updateStep == Clock::duration::zero())
+		{
+			return 1.f;
+		}
+		return static_cast<float>(static_cast<double>(accumulator.count()) / static_cast<double>(updateStep.count()));
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <chrono>
+
+namespace graph
+{
+	//Paces a loop. Frames come at a target rate, waited for by sleeping and then spinning the
+	//last stretch the system timer is too coarse for. Updates have a fixed step and run as many
+	//a frame as the time passed calls for, up to a limit: past it the time is dropped, so a slow
+	//machine slows the simulation down rather than falling further behind.
+	class FrameScheduler
+	{
+	public:
+		typedef std::chrono::steady_clock Clock;
+	private:
+		//Zero for no target rate and for one update a frame
+		Clock::duration frameInterval, updateStep, spin;
+		unsigned maxUpdates;
+		Clock::time_point nextFrame, lastAdvance;
+		Clock::duration accumulator{0};
+		bool waited = false, advanced = false;
+	public:
+		//Rates a second and spin in milliseconds, 0 for a rate turns it off
+		FrameScheduler(float targetFps, float updateRate, unsigned maxUpdates, float spinMs);
+
+		//Until the next frame is due, right away with no target or when late. A frame more
+		//than one interval late starts the schedule again from now instead of rushing frames
+		void wait();
+
+		//Updates to run before this frame, from the time since the last call. The first call
+		//and every call without an update rate give 1
+		unsigned advance();
+
+		//How far the time left over is into the next update, from 0 to 1. 1 without an update rate
+		float get_alpha() const;
+	};
+}
@@ -1,17 +1,40 @@
 #include "graph.h"
+#include "brush_cache.h"
+#include "command_list.h"
+#include "frame_capture.h"
+#include "frame_scheduler.h"
+#include "image_cache.h"
+#include "soft_decode.h"
+#include "soft_pool.h"
+#include "soft_span.h"
+#include "sprite_atlas.h"
+#include "text_layout_cache.h"
+#ifdef _WIN32
 #include <windows.h>
+#include <mmsystem.h>
 #include <d2d1.h>
 #include <dwrite.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <string>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <mutex>
+#include <tuple>
 #include <utility>
+#ifdef _WIN32
 #include <wrl/client.h>
 
 #include "Keyboard.h"
+#endif
 
 namespace graph
 {
+#ifdef _WIN32
 	template <class T>
 	void SafeRelease(T& ptr)
 	{
@@ -96,6 +119,7 @@ namespace graph
 		}
 		return hr;
 	}
+#endif
 
 	const UINT32 c_red_shift = 16;
 	const UINT32 c_green_shift = 8;
@@ -105,6 +129,7 @@ namespace graph
 	const UINT32 c_green_mask = 0xff << c_green_shift;
 	const UINT32 c_blue_mask = 0xff << c_blue_shift;
 
+#ifdef _WIN32
 	D2D1_SIZE_U Size2D2DU(const Size& size)
 	{
 		return D2D1::SizeU(
@@ -122,6 +147,12 @@ namespace graph
 		return D2D1::ColorF(color.red, color.green, color.blue, color.alpha);
 	}
 
+	//Straight alpha 0xAARRGGBB
+	D2D1_COLOR_F Packed2D2D(const Color32 color)
+	{
+		return D2D1::ColorF(color.argb & 0xFFFFFF, static_cast<float>(color.alpha()) / 255.f);
+	}
+
 	D2D1_POINT_2F Point2D2D(const Point& point)
 	{
 		return D2D1::Point2F(point.x, point.y);
@@ -149,6 +180,23 @@ namespace graph
 		                     ellipse.radius_y
 		                    );
 	}
+#endif
+
+	//Straight colors to premultiplied pixels a chunk at a time, so a batch needs no allocation
+	template <typename Draw>
+	void PremultiplyChunks(const Color32* colors, const size_t count, Draw&& draw)
+	{
+		soft::Pixel chunk[256];
+		for (size_t begin = 0; begin < count; begin += 256)
+		{
+			const size_t n = (std::min)(count - begin, static_cast<size_t>(256));
+			for (size_t i = 0; i < n; i++)
+			{
+				chunk[i] = soft::PremultiplyPacked(colors[begin + i].argb);
+			}
+			draw(begin, chunk, n);
+		}
+	}
 
 	Ellipse Rect2Ellipse(const Rect& rect)
 	{
@@ -178,17 +226,24 @@ namespace graph
 		alpha = a;
 	}
 
+	Color::Color(const Color32 color) :
+		Color(color.red(), color.green(), color.blue(), color.alpha()) {}
+
+	Color32::Color32(const Color& color)
+	{
+		//Written so NaN goes to 0
+		const auto channel = [](const float value)
+		{
+			const float clamped = value > 0.f ? (value < 1.f ? value : 1.f) : 0.f;
+			return static_cast<std::uint32_t>(clamped * 255.f + 0.5f);
+		};
+		argb = channel(color.alpha) << 24 | channel(color.red) << 16 | channel(color.green) << 8 | channel(color.blue);
+	}
+
 	bool Color::operator<(const Color& c) const
 	{
-		const UINT color =
-				(static_cast<UINT>(red * 255.f) << c_red_shift) +
-				(static_cast<UINT>(green * 255.f) << c_green_shift) +
-				(static_cast<UINT>(blue * 255.f) << c_blue_shift);
-		const UINT ccolor =
-				(static_cast<UINT>(c.red * 255.f) << c_red_shift) +
-				(static_cast<UINT>(c.green * 255.f) << c_green_shift) +
-				(static_cast<UINT>(c.blue * 255.f) << c_blue_shift);
-		return color < ccolor;
+		//Every channel counts, alpha too, the same ones operator== compares
+		return std::tie(red, green, blue, alpha) < std::tie(c.red, c.green, c.blue, c.alpha);
 	}
 
 	bool Color::operator==(const Color& c) const
@@ -196,28 +251,72 @@ namespace graph
 		return red == c.red && green == c.green && blue == c.blue && alpha == c.alpha;
 	}
 
+	const StrokeStyle& StrokeStyle::preset(const STROKE_STYLE style)
+	{
+		const auto make = [](std::vector<float> dashes)
+		{
+			StrokeStyle res;
+			if (!dashes.empty())
+			{
+				res.start_cap = res.end_cap = res.dash_cap = CAP_STYLE::Round;
+				res.dashes = std::move(dashes);
+			}
+			return res;
+		};
+		static const StrokeStyle presets[] = {
+			make({}),
+			make({2.f, 2.f}),
+			make({2.f, 2.f, 0.f, 2.f}),
+			make({2.f, 2.f, 0.f, 2.f, 0.f, 2.f}),
+			make({0.f, 2.f})
+		};
+		return presets[static_cast<int>(style)];
+	}
+
+	bool StrokeStyle::operator<(const StrokeStyle& s) const
+	{
+		return std::tie(start_cap, end_cap, dash_cap, line_join, miter_limit, dashes, dash_offset) <
+			std::tie(s.start_cap, s.end_cap, s.dash_cap, s.line_join, s.miter_limit, s.dashes, s.dash_offset);
+	}
+
+	bool StrokeStyle::operator==(const StrokeStyle& s) const
+	{
+		return std::tie(start_cap, end_cap, dash_cap, line_join, miter_limit, dashes, dash_offset) ==
+			std::tie(s.start_cap, s.end_cap, s.dash_cap, s.line_join, s.miter_limit, s.dashes, s.dash_offset);
+	}
+
 	Brush::~Brush()
 	{
+#ifdef _WIN32
 		if (is_owner)
 		{
 			SafeRelease(d2d_brush);
 		}
+#endif
 	}
 
 	Brush::Brush(Brush&& brush) noexcept
 	{
 		brush.is_owner = false;
 		std::swap(d2d_brush, brush.d2d_brush);
+		std::swap(soft_paint, brush.soft_paint);
+		std::swap(soft_opacity, brush.soft_opacity);
 	}
 
 	void Brush::set_opacity(const float opacity)
 	{
-		d2d_brush->SetOpacity(opacity);
+		soft_opacity = opacity;
+#ifdef _WIN32
+		if (d2d_brush)
+		{
+			d2d_brush->SetOpacity(opacity);
+		}
+#endif
 	}
 
 	float Brush::get_opacity() const
 	{
-		return d2d_brush->GetOpacity();
+		return soft_opacity;
 	}
 
 	Brush& Brush::operator=(Brush&& brush) noexcept
@@ -226,36 +325,463 @@ namespace graph
 		{
 			brush.is_owner = false;
 			std::swap(d2d_brush, brush.d2d_brush);
+			std::swap(soft_paint, brush.soft_paint);
+			std::swap(soft_opacity, brush.soft_opacity);
 		}
 		return *this;
 	}
 
-	D2DGraphics::D2DGraphics(const GraphSetting& setting) : setting(setting)
+	D2DGraphics::D2DGraphics(const GraphSetting& setting) :
+		setting(setting),
+		brushes(std::make_unique<BrushCache>(setting.brush_cache_size)),
+		decoded_images(std::make_shared<DecodedImages>()),
+		images(std::make_unique<ImageCache>(setting.image_cache_bytes))
 	{
+#ifdef _WIN32
 		CreateDeviceIndependentResources();
+		text_layouts = std::make_unique<TextLayoutCache<ComPtr<IDWriteTextLayout>>>(setting.text_layout_cache_bytes);
+#endif
+		if (setting.headless)
+		{
+			this->setting.backend = GraphSetting::BACKEND::Software;
+		}
+		if (this->setting.backend == GraphSetting::BACKEND::Software)
+		{
+			soft_canvas = std::make_unique<soft::Canvas>(
+			                                             static_cast<int>(setting.width),
+			                                             static_cast<int>(setting.height));
+			soft_canvas->set_threads(setting.render_threads);
+		}
+		if (setting.damage_tracking != GraphSetting::DAMAGE_TRACKING::Off)
+		{
+			frame_list = std::make_unique<CommandList>();
+			last_frame_list = std::make_unique<CommandList>();
+		}
+		if (setting.headless)
+		{
+			InitScene();
+			if (!setting.Scenes.empty() && setting.first_show_scene < setting.Scenes.size())
+			{
+				show_scene(static_cast<int>(setting.first_show_scene));
+			}
+			return;
+		}
+#ifdef _WIN32
 		win_thread = std::thread([this]() { this->InitWindow(); });
+#endif
 	}
 
 	D2DGraphics::~D2DGraphics()
 	{
+		//Loads not started are dropped, running ones finish into decoded_images
+		image_loader.reset();
 		if (win_thread.joinable())
 		{
 			win_thread.join();
 		}
 	}
 
+	void D2DGraphics::render_frame()
+	{
+		RenderFrame(1, 1.f);
+	}
+
+	void D2DGraphics::render_paced_frame()
+	{
+		if (!scheduler)
+		{
+			scheduler = std::make_unique<FrameScheduler>(
+			                                             setting.target_fps,
+			                                             setting.update_rate,
+			                                             setting.max_updates_per_frame,
+			                                             setting.spin_wait_ms);
+		}
+		scheduler->wait();
+		const unsigned updates = scheduler->advance();
+		RenderFrame(updates, scheduler->get_alpha());
+	}
+
+	float D2DGraphics::get_update_step() const
+	{
+		return setting.update_rate > 0.f ? 1.f / setting.update_rate : 0.f;
+	}
+
+	void D2DGraphics::RenderFrame(const unsigned updates, const float alpha)
+	{
+		if (current_scene == nullptr)
+		{
+			return;
+		}
+		//Colors of earlier frames past the cache's budget go before new ones come
+		brushes->trim(frame_counter);
+		UploadDecodedImages();
+		//A scene shown by an update gets the rest of them
+		for (unsigned i = 0; i < updates; i++)
+		{
+			current_scene->update(this);
+		}
+		if (frame_list)
+		{
+			RenderDamage(alpha);
+		}
+		else
+		{
+			begin_draw();
+			current_scene->render(this, alpha);
+			frame_counter++;
+			end_draw();
+		}
+		if (capture)
+		{
+			capture->push(soft_canvas->get_target());
+		}
+	}
+
+	//The copy kept under key this frame, taken over from the last frame or made
+	template <typename Key, typename T, typename Make>
+	T& KeepIn(std::map<Key, std::unique_ptr<T>>& kept, std::map<Key, std::unique_ptr<T>>& lastKept, const Key& key, Make make)
+	{
+		std::unique_ptr<T>& slot = kept[key];
+		if (slot == nullptr)
+		{
+			const auto last = lastKept.find(key);
+			if (last != lastKept.end())
+			{
+				slot = std::move(last->second);
+				lastKept.erase(last);
+			}
+			else
+			{
+				slot = make();
+			}
+		}
+		return *slot;
+	}
+
+	Bitmap& D2DGraphics::Keep(Bitmap& bitmap)
+	{
+		if (frame_list == nullptr || recording != frame_list.get())
+		{
+			return bitmap;
+		}
+		const void* key = bitmap.soft_image ? static_cast<const void*>(bitmap.soft_image.get()) : bitmap.d2d_bitmap;
+		return KeepIn(frame_resources.bitmaps, last_frame_resources.bitmaps, key, [&bitmap]
+		{
+			return std::make_unique<Bitmap>(bitmap);
+		});
+	}
+
+	const Bitmap& D2DGraphics::Keep(const Bitmap& bitmap)
+	{
+		//Only read through, update_image is the one caller that writes
+		return Keep(const_cast<Bitmap&>(bitmap));
+	}
+
+	const SpriteAtlas& D2DGraphics::Keep(const SpriteAtlas& atlas)
+	{
+		if (frame_list == nullptr || recording != frame_list.get())
+		{
+			return atlas;
+		}
+		//Every atlas create_atlas makes has pages of its own
+		const void* key = nullptr;
+		if (!atlas.soft_pages.empty())
+		{
+			key = atlas.soft_pages[0].get();
+		}
+		else if (!atlas.pages.empty())
+		{
+			key = atlas.pages[0].d2d_bitmap;
+		}
+		return KeepIn(frame_resources.atlases, last_frame_resources.atlases, key, [&atlas]
+		{
+			return std::make_unique<SpriteAtlas>(atlas);
+		});
+	}
+
+	const Font& D2DGraphics::Keep(const Font& font)
+	{
+		if (frame_list == nullptr || recording != frame_list.get())
+		{
+			return font;
+		}
+		return KeepIn(frame_resources.fonts, last_frame_resources.fonts, font.id, [&font]
+		{
+			std::unique_ptr<Font> copy(new Font());
+			copy->d2d_font = font.d2d_font;
+#ifdef _WIN32
+			if (copy->d2d_font)
+			{
+				copy->d2d_font->AddRef();
+			}
+#endif
+			copy->soft_name = font.soft_name;
+			copy->soft_size = font.soft_size;
+			copy->id = font.id;
+			return copy;
+		});
+	}
+
+	const Path& D2DGraphics::Keep(const Path& path)
+	{
+		if (frame_list == nullptr || recording != frame_list.get())
+		{
+			return path;
+		}
+		//A revision is never given to another path, so its figures are the same
+		return KeepIn(frame_resources.paths, last_frame_resources.paths, path.revision, [&path]
+		{
+			return std::make_unique<Path>(path);
+		});
+	}
+
+	void D2DGraphics::RenderDamage(const float alpha)
+	{
+		std::swap(frame_list, last_frame_list);
+		frame_list->reset();
+		//What only the list just reset pointed at goes with it
+		std::swap(frame_resources, last_frame_resources);
+		frame_resources = FrameResources();
+		begin_record(*frame_list);
+		current_scene->render(this, alpha);
+		end_record();
+		frame_counter++;
+		if (setting.damage_tracking == GraphSetting::DAMAGE_TRACKING::Diff)
+		{
+			frame_list->diff(*last_frame_list, damage);
+		}
+		if (!MergeDamage())
+		{
+			//Bitmaps updated in the frame take the pixels even where nothing is drawn
+			frame_list->replay_updates(*this);
+			return;
+		}
+		if (frame_list->image_updates() != 0 && damage_boxes.size() > 1)
+		{
+			//Every box draws the whole frame, the updates in it must be made once
+			soft::IntRect all = damage_boxes[0];
+			for (const soft::IntRect& box : damage_boxes)
+			{
+				all = soft::IntRect{
+					(std::min)(all.left, box.left),
+					(std::min)(all.top, box.top),
+					(std::max)(all.right, box.right),
+					(std::max)(all.bottom, box.bottom)
+				};
+			}
+			damage_boxes.assign(1, all);
+		}
+		begin_draw();
+		//Any box drawn with the whole frame gets the pixels a full redraw would
+		for (const soft::IntRect& box : damage_boxes)
+		{
+			if (soft_canvas)
+			{
+				soft_canvas->set_clip(box);
+			}
+#ifdef _WIN32
+			else
+			{
+				m_pRenderTarget->SetTransform(D2D1::Matrix3x2F::Identity());
+				m_pRenderTarget->PushAxisAlignedClip(
+				                                     D2D1::RectF(
+				                                                 static_cast<float>(box.left) / DPI_scaleX,
+				                                                 static_cast<float>(box.top) / DPI_scaleY,
+				                                                 static_cast<float>(box.right) / DPI_scaleX,
+				                                                 static_cast<float>(box.bottom) / DPI_scaleY),
+				                                     D2D1_ANTIALIAS_MODE_ALIASED);
+			}
+#endif
+			reset_view();
+			draw_list(*frame_list);
+#ifdef _WIN32
+			if (soft_canvas == nullptr)
+			{
+				m_pRenderTarget->PopAxisAlignedClip();
+			}
+#endif
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->reset_clip();
+		}
+		end_draw();
+		damage_boxes.clear();
+	}
+
+	//Adds box to disjoint boxes, merging it with those it overlaps
+	void AddDamageBox(std::vector<soft::IntRect>& boxes, soft::IntRect box)
+	{
+		for (size_t i = 0; i < boxes.size();)
+		{
+			if (soft::Intersect(boxes[i], box).empty())
+			{
+				i++;
+				continue;
+			}
+			box = soft::IntRect{
+				(std::min)(box.left, boxes[i].left),
+				(std::min)(box.top, boxes[i].top),
+				(std::max)(box.right, boxes[i].right),
+				(std::max)(box.bottom, boxes[i].bottom)
+			};
+			boxes.erase(boxes.begin() + static_cast<std::ptrdiff_t>(i));
+			//The grown box may reach boxes already passed
+			i = 0;
+		}
+		boxes.push_back(box);
+	}
+
+	std::int64_t BoxArea(const soft::IntRect& box)
+	{
+		return static_cast<std::int64_t>(box.right - box.left) * (box.bottom - box.top);
+	}
+
+	//Every box is drawn with the whole frame, more than this costs more than it saves
+	constexpr size_t c_max_damage_boxes = 8;
+
+	bool D2DGraphics::MergeDamage()
+	{
+		damage_boxes.clear();
+		const Size size = get_pixel_size();
+		const soft::IntRect surface{0, 0, static_cast<int>(size.width), static_cast<int>(size.height)};
+		if (surface.empty())
+		{
+			damage.clear();
+			return false;
+		}
+		if (full_damage)
+		{
+			damage.clear();
+		}
+		for (const Rect& rect : damage)
+		{
+			//Rounded out to device pixels, NaN and infinities go to the edges of the surface
+			const float left = std::floor(rect.left * DPI_scaleX);
+			const float top = std::floor(rect.top * DPI_scaleY);
+			const float right = std::ceil(rect.right * DPI_scaleX);
+			const float bottom = std::ceil(rect.bottom * DPI_scaleY);
+			const soft::IntRect box{
+				left > 0.f ? static_cast<int>((std::min)(left, size.width)) : 0,
+				top > 0.f ? static_cast<int>((std::min)(top, size.height)) : 0,
+				right < size.width ? static_cast<int>((std::max)(right, 0.f)) : surface.right,
+				bottom < size.height ? static_cast<int>((std::max)(bottom, 0.f)) : surface.bottom
+			};
+			if (box.empty())
+			{
+				continue;
+			}
+			AddDamageBox(damage_boxes, box);
+			while (damage_boxes.size() > c_max_damage_boxes)
+			{
+				//Merges the two boxes that waste the least area together
+				size_t first = 0, second = 1;
+				std::int64_t waste = -1;
+				for (size_t i = 0; i < damage_boxes.size(); i++)
+				{
+					for (size_t j = i + 1; j < damage_boxes.size(); j++)
+					{
+						const soft::IntRect& a = damage_boxes[i];
+						const soft::IntRect& b = damage_boxes[j];
+						const soft::IntRect merged{
+							(std::min)(a.left, b.left),
+							(std::min)(a.top, b.top),
+							(std::max)(a.right, b.right),
+							(std::max)(a.bottom, b.bottom)
+						};
+						const std::int64_t grown = BoxArea(merged) - BoxArea(a) - BoxArea(b);
+						if (waste < 0 || grown < waste)
+						{
+							waste = grown;
+							first = i;
+							second = j;
+						}
+					}
+				}
+				const soft::IntRect a = damage_boxes[first];
+				const soft::IntRect b = damage_boxes[second];
+				damage_boxes.erase(damage_boxes.begin() + static_cast<std::ptrdiff_t>(second));
+				damage_boxes.erase(damage_boxes.begin() + static_cast<std::ptrdiff_t>(first));
+				AddDamageBox(damage_boxes, soft::IntRect{
+					             (std::min)(a.left, b.left),
+					             (std::min)(a.top, b.top),
+					             (std::max)(a.right, b.right),
+					             (std::max)(a.bottom, b.bottom)
+				             });
+			}
+		}
+		damage.clear();
+		std::int64_t area = 0;
+		for (const soft::IntRect& box : damage_boxes)
+		{
+			area += BoxArea(box);
+		}
+		//Past half the frame one pass over all of it is cheaper
+		if (full_damage || 2 * area > BoxArea(surface))
+		{
+			damage_boxes.assign(1, surface);
+		}
+		full_damage = false;
+		return !damage_boxes.empty();
+	}
+
+	void D2DGraphics::invalidate(const Rect rect)
+	{
+		if (frame_list)
+		{
+			damage.push_back(rect);
+		}
+	}
+
+	void D2DGraphics::invalidate()
+	{
+		full_damage = true;
+	}
+
+	const soft::Image* D2DGraphics::get_framebuffer() const
+	{
+		return soft_canvas ? &soft_canvas->get_target() : nullptr;
+	}
+
+	soft::Pixel D2DGraphics::SoftPaint(const Brush& brush)
+	{
+		return soft::PremultiplyColor(brush.soft_paint, brush.soft_opacity);
+	}
+
 	void D2DGraphics::clear(const Color color)
 	{
-		m_pRenderTarget->Clear(D2D1::ColorF(color.red, color.green, color.blue, color.alpha));
+		if (recording)
+		{
+			recording->clear(color);
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->clear(soft::PremultiplyColor(color));
+			return;
+		}
+#ifdef _WIN32
+		DrawTarget()->Clear(D2D1::ColorF(color.red, color.green, color.blue, color.alpha));
+#endif
 	}
 
 	void D2DGraphics::begin_draw()
 	{
-		InitD2D();
+#ifdef _WIN32
+		if (soft_canvas == nullptr)
+		{
+			InitD2D();
+		}
+#endif
 		if (!has_began_draw)
 		{
 			DrawingLock();
-			m_pRenderTarget->BeginDraw();
+#ifdef _WIN32
+			if (soft_canvas == nullptr)
+			{
+				m_pRenderTarget->BeginDraw();
+			}
+#endif
 			has_began_draw = true;
 		}
 	}
@@ -264,12 +790,35 @@ namespace graph
 	{
 		if (has_began_draw)
 		{
-			m_pRenderTarget->EndDraw();
+			unlock_pixels();
+			if (soft_canvas)
+			{
+				soft_canvas->flush();
+			}
+#ifdef _WIN32
+			if (soft_canvas == nullptr)
+			{
+				m_pRenderTarget->EndDraw();
+			}
+			else if (m_Hwnd)
+			{
+				const soft::Image& image = soft_canvas->get_target();
+				if (damage_boxes.empty())
+				{
+					PresentSoftCanvas(soft::IntRect{0, 0, image.width(), image.height()});
+				}
+				for (const soft::IntRect& box : damage_boxes)
+				{
+					PresentSoftCanvas(box);
+				}
+			}
+#endif
 			has_began_draw = false;
 			DrawingUnlock();
 		}
 	}
 
+#ifdef _WIN32
 	DirectX::Keyboard::State D2DGraphics::get_keyboard_state()
 	{
 		return m_keyboard->GetState();
@@ -296,6 +845,36 @@ namespace graph
 		return true;
 	}
 
+	void D2DGraphics::PresentSoftCanvas(const soft::IntRect& box)
+	{
+		const soft::Image& image = soft_canvas->get_target();
+		const int height = box.bottom - box.top;
+		//A top-down DIB starting at the box's first row, as wide as the framebuffer
+		BITMAPINFO info{};
+		info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+		info.bmiHeader.biWidth = image.width();
+		info.bmiHeader.biHeight = -height;
+		info.bmiHeader.biPlanes = 1;
+		info.bmiHeader.biBitCount = 32;
+		info.bmiHeader.biCompression = BI_RGB;
+		HDC dc = GetDC(m_Hwnd);
+		SetDIBitsToDevice(
+		                  dc,
+		                  box.left,
+		                  box.top,
+		                  static_cast<DWORD>(box.right - box.left),
+		                  static_cast<DWORD>(height),
+		                  box.left,
+		                  0,
+		                  0,
+		                  static_cast<UINT>(height),
+		                  image.row(box.top),
+		                  &info,
+		                  DIB_RGB_COLORS);
+		ReleaseDC(m_Hwnd, dc);
+	}
+#endif
+
 	void D2DGraphics::draw_line(
 		const Point from,
 		const Point to,
@@ -303,13 +882,35 @@ namespace graph
 		const float width,
 		const STROKE_STYLE style)
 	{
+		draw_line(from, to, brush, width, StrokeStyle::preset(style));
+	}
+
+	void D2DGraphics::draw_line(
+		const Point from,
+		const Point to,
+		const Brush& brush,
+		const float width,
+		const StrokeStyle& style)
+	{
+		if (recording)
+		{
+			recording->draw_line(from, to, brush, width, style);
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->stroke_line(from, to, width, SoftPaint(brush), style);
+			return;
+		}
+#ifdef _WIN32
 		if (brush.d2d_brush == nullptr) { return; }
-		m_pRenderTarget->DrawLine(
-		                          Point2D2D(from),
-		                          Point2D2D(to),
-		                          brush.d2d_brush,
-		                          width,
-		                          AutoGetStrokeStyle(style).Get());
+		DrawTarget()->DrawLine(
+		                       Point2D2D(from),
+		                       Point2D2D(to),
+		                       brush.d2d_brush,
+		                       width,
+		                       GetStrokeStyle(style).Get());
+#endif
 	}
 
 	void D2DGraphics::draw_triangle(
@@ -320,10 +921,8 @@ namespace graph
 		const float width,
 		const STROKE_STYLE style)
 	{
-		if (brush.d2d_brush == nullptr) { return; }
-		draw_line(p1, p2, brush, width, style);
-		draw_line(p2, p3, brush, width, style);
-		draw_line(p3, p1, brush, width, style);
+		const Point points[] = {p1, p2, p3};
+		draw_poly(points, 3, brush, width, style);
 	}
 
 	void D2DGraphics::draw_rect(
@@ -332,51 +931,120 @@ namespace graph
 		const float width,
 		const STROKE_STYLE style)
 	{
-		if (brush.d2d_brush == nullptr) { return; }
-		m_pRenderTarget->DrawRectangle(
-		                               Rect2D2D(rect),
-		                               brush.d2d_brush,
-		                               width,
-		                               AutoGetStrokeStyle(style).Get());
+		draw_rect(rect, brush, width, StrokeStyle::preset(style));
 	}
 
-	void D2DGraphics::draw_ellipse(
-		const Ellipse ellipse,
+	void D2DGraphics::draw_rect(
+		const Rect rect,
 		const Brush& brush,
 		const float width,
-		const STROKE_STYLE style)
+		const StrokeStyle& style)
 	{
+		if (recording)
+		{
+			recording->draw_rect(rect, brush, width, style);
+			return;
+		}
+		if (soft_canvas)
+		{
+			const Point corners[] = {
+				{rect.left, rect.top},
+				{rect.right, rect.top},
+				{rect.right, rect.bottom},
+				{rect.left, rect.bottom}
+			};
+			soft_canvas->stroke_poly(corners, 4, true, width, SoftPaint(brush), style);
+			return;
+		}
+#ifdef _WIN32
 		if (brush.d2d_brush == nullptr) { return; }
-		m_pRenderTarget->DrawEllipse(
-		                             Ellipse2D2D(ellipse),
-		                             brush.d2d_brush,
-		                             width,
-		                             AutoGetStrokeStyle(style).Get());
+		DrawTarget()->DrawRectangle(
+		                            Rect2D2D(rect),
+		                            brush.d2d_brush,
+		                            width,
+		                            GetStrokeStyle(style).Get());
+#endif
 	}
 
 	void D2DGraphics::draw_ellipse(
-		const Rect rect,
+		const Ellipse ellipse,
 		const Brush& brush,
 		const float width,
 		const STROKE_STYLE style)
 	{
-		if (brush.d2d_brush == nullptr) { return; }
-		draw_ellipse(Rect2Ellipse(rect), brush, width, style);
+		draw_ellipse(ellipse, brush, width, StrokeStyle::preset(style));
 	}
 
-	void D2DGraphics::draw_poly(
-		const Point* points,
-		const size_t size,
+	void D2DGraphics::draw_ellipse(
+		const Ellipse ellipse,
 		const Brush& brush,
 		const float width,
-		const STROKE_STYLE style)
+		const StrokeStyle& style)
 	{
+		if (recording)
+		{
+			recording->draw_ellipse(ellipse, brush, width, style);
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->stroke_ellipse(ellipse, width, SoftPaint(brush), style);
+			return;
+		}
+#ifdef _WIN32
 		if (brush.d2d_brush == nullptr) { return; }
-		for (size_t i = 0; i < size - 1; i++)
+		DrawTarget()->DrawEllipse(
+		                          Ellipse2D2D(ellipse),
+		                          brush.d2d_brush,
+		                          width,
+		                          GetStrokeStyle(style).Get());
+#endif
+	}
+
+	void D2DGraphics::draw_ellipse(
+		const Rect rect,
+		const Brush& brush,
+		const float width,
+		const STROKE_STYLE style)
+	{
+		draw_ellipse(Rect2Ellipse(rect), brush, width, style);
+	}
+
+	void D2DGraphics::draw_poly(
+		const Point* points,
+		const size_t size,
+		const Brush& brush,
+		const float width,
+		const STROKE_STYLE style)
+	{
+		draw_poly(points, size, brush, width, StrokeStyle::preset(style));
+	}
+
+	void D2DGraphics::draw_poly(
+		const Point* points,
+		const size_t size,
+		const Brush& brush,
+		const float width,
+		const StrokeStyle& style)
+	{
+		if (recording)
 		{
-			draw_line(points[i], points[i + 1], brush, width, style);
+			recording->draw_poly(points, size, brush, width, style);
+			return;
+		}
+		if (size == 0) { return; }
+		if (soft_canvas)
+		{
+			soft_canvas->stroke_poly(points, size, true, width, SoftPaint(brush), style);
+			return;
 		}
-		draw_line(points[size - 1], points[0], brush, width, style);
+#ifdef _WIN32
+		if (brush.d2d_brush == nullptr) { return; }
+		//One closed figure so the corners get joins and the dashes run on around them
+		const ComPtr<ID2D1PathGeometry> geometry = CreatePolyGeometry(points, size, true, FILL_MODE::Alternate);
+		if (geometry == nullptr) { return; }
+		DrawTarget()->DrawGeometry(geometry.Get(), brush.d2d_brush, width, GetStrokeStyle(style).Get());
+#endif
 	}
 
 	void D2DGraphics::draw_poly(
@@ -385,10 +1053,55 @@ namespace graph
 		const float width,
 		const STROKE_STYLE style)
 	{
-		if (brush.d2d_brush == nullptr) { return; }
 		draw_poly(points.data(), points.size(), brush, width, style);
 	}
 
+	void D2DGraphics::draw_polyline(
+		const Point* points,
+		const size_t size,
+		const Brush& brush,
+		const float width,
+		const STROKE_STYLE style)
+	{
+		draw_polyline(points, size, brush, width, StrokeStyle::preset(style));
+	}
+
+	void D2DGraphics::draw_polyline(
+		const Point* points,
+		const size_t size,
+		const Brush& brush,
+		const float width,
+		const StrokeStyle& style)
+	{
+		if (recording)
+		{
+			recording->draw_polyline(points, size, brush, width, style);
+			return;
+		}
+		if (size < 2) { return; }
+		if (soft_canvas)
+		{
+			soft_canvas->stroke_poly(points, size, false, width, SoftPaint(brush), style);
+			return;
+		}
+#ifdef _WIN32
+		if (brush.d2d_brush == nullptr) { return; }
+		const ComPtr<ID2D1PathGeometry> geometry = CreatePolyGeometry(points, size, false, FILL_MODE::Alternate);
+		if (geometry == nullptr) { return; }
+		DrawTarget()->DrawGeometry(geometry.Get(), brush.d2d_brush, width, GetStrokeStyle(style).Get());
+#endif
+	}
+
+	void D2DGraphics::draw_polyline(
+		const std::vector<Point>& points,
+		const Brush& brush,
+		const float width,
+		const STROKE_STYLE style)
+	{
+		draw_polyline(points.data(), points.size(), brush, width, style);
+	}
+
+#ifdef _WIN32
 	HRESULT LoadBitmapFromFile(
 		ID2D1RenderTarget* pRenderTarget,
 		IWICImagingFactory* pIWICFactory,
@@ -457,16 +1170,260 @@ namespace graph
 		return hr;
 	}
 
+	//Decodes into premultiplied BGRA8 memory for the software backend
+	HRESULT LoadPixelsFromFile(IWICImagingFactory* pIWICFactory, PCWSTR uri, soft::Image& image)
+	{
+		ComPtr<IWICBitmapDecoder> pDecoder;
+		ComPtr<IWICBitmapFrameDecode> pSource;
+		ComPtr<IWICFormatConverter> pConverter;
+
+		HRESULT hr = pIWICFactory->CreateDecoderFromFilename(
+		                                                     uri,
+		                                                     NULL,
+		                                                     GENERIC_READ,
+		                                                     WICDecodeMetadataCacheOnLoad,
+		                                                     pDecoder.GetAddressOf()
+		                                                    );
+		if (SUCCEEDED(hr))
+		{
+			hr = pDecoder->GetFrame(0, pSource.GetAddressOf());
+		}
+		if (SUCCEEDED(hr))
+		{
+			hr = pIWICFactory->CreateFormatConverter(pConverter.GetAddressOf());
+		}
+		if (SUCCEEDED(hr))
+		{
+			hr = pConverter->Initialize(
+			                            pSource.Get(),
+			                            GUID_WICPixelFormat32bppPBGRA,
+			                            WICBitmapDitherTypeNone,
+			                            NULL,
+			                            0.f,
+			                            WICBitmapPaletteTypeMedianCut
+			                           );
+		}
+		UINT width = 0, height = 0;
+		if (SUCCEEDED(hr))
+		{
+			hr = pConverter->GetSize(&width, &height);
+		}
+		if (SUCCEEDED(hr))
+		{
+			image.resize(static_cast<int>(width), static_cast<int>(height));
+			hr = pConverter->CopyPixels(
+			                            nullptr,
+			                            static_cast<UINT>(image.pitch()),
+			                            static_cast<UINT>(image.pitch() * height),
+			                            reinterpret_cast<BYTE*>(image.row(0)));
+		}
+		return hr;
+	}
+#endif
+
+	//Premultiplied pixels of an image file, by the portable decoders or else WIC. Safe on any thread
+	bool DecodeImageFile(const std::wstring& filePath, soft::Image& image)
+	{
+		std::vector<std::uint8_t> data;
+		if (soft::ReadFile(filePath, data) && soft::DecodeImage(data.data(), data.size(), image))
+		{
+			return true;
+		}
+#ifdef _WIN32
+		if (g_pWICImagingFactory == nullptr)
+		{
+			return false;
+		}
+		//Fails on a thread already in another apartment, which can use WIC as it is
+		const HRESULT com = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+		const bool decoded = SUCCEEDED(LoadPixelsFromFile(g_pWICImagingFactory.Get(), filePath.c_str(), image));
+		if (SUCCEEDED(com))
+		{
+			CoUninitialize();
+		}
+		return decoded;
+#else
+		return false;
+#endif
+	}
+
+	struct ImageLoad::State
+	{
+		std::atomic<LOAD_STATE> state{LOAD_STATE::Pending};
+		//Decoded by a worker, moved into the bitmap on the render thread
+		soft::Image pixels;
+		Bitmap bitmap;
+		//Where it goes in the image cache, no path when the file could not be stamped
+		FileStamp stamp;
+	};
+
+	struct D2DGraphics::DecodedImages
+	{
+		std::mutex lock;
+		std::condition_variable idle;
+		//Loads with whether they decoded, in the order they finished
+		std::vector<std::pair<std::shared_ptr<ImageLoad::State>, bool>> done;
+		//Swapped with done to be uploaded outside the lock
+		std::vector<std::pair<std::shared_ptr<ImageLoad::State>, bool>> uploading;
+		size_t pending = 0;
+	};
+
+	LOAD_STATE ImageLoad::get_state() const
+	{
+		return state ? state->state.load() : LOAD_STATE::Failed;
+	}
+
+	const Bitmap& ImageLoad::get_bitmap() const
+	{
+		static const Bitmap c_empty;
+		return state ? state->bitmap : c_empty;
+	}
+
 	Bitmap D2DGraphics::load_image_from_file(const std::wstring& filePath)
+	{
+		FileStamp stamp;
+		const bool stamped = StampFile(filePath, stamp);
+		if (stamped)
+		{
+			if (const Bitmap* cached = images->get(stamp))
+			{
+				return *cached;
+			}
+		}
+		Bitmap res = LoadImageFile(filePath);
+		if (stamped && (res.soft_image || res.d2d_bitmap))
+		{
+			images->put(stamp, res);
+		}
+		return res;
+	}
+
+	Bitmap D2DGraphics::LoadImageFile(const std::wstring& filePath)
 	{
 		Bitmap res;
+		if (soft_canvas)
+		{
+			auto image = std::make_shared<soft::Image>();
+			if (DecodeImageFile(filePath, *image))
+			{
+				res.soft_image = std::move(image);
+			}
+			return res;
+		}
+#ifdef _WIN32
 		LoadBitmapFromFile(m_pRenderTarget.Get(), g_pWICImagingFactory.Get(), filePath.c_str(), 0, 0, &res.d2d_bitmap);
+		//PPM and PGM, which WIC does not read
+		soft::Image image;
+		if (res.d2d_bitmap == nullptr && DecodeImageFile(filePath, image))
+		{
+			res = create_image_from_memory(
+			                               Size{static_cast<float>(image.width()), static_cast<float>(image.height())},
+			                               image.row(0),
+			                               static_cast<UINT>(image.pitch()));
+		}
+#endif
 		return res;
 	}
 
+	ImageLoad D2DGraphics::load_image_async(const std::wstring& filePath)
+	{
+		ImageLoad res;
+		res.state = std::make_shared<ImageLoad::State>();
+		if (StampFile(filePath, res.state->stamp))
+		{
+			if (const Bitmap* cached = images->get(res.state->stamp))
+			{
+				res.state->bitmap = *cached;
+				res.state->state = LOAD_STATE::Ready;
+				return res;
+			}
+		}
+		if (!image_loader)
+		{
+			image_loader = std::make_unique<soft::JobQueue>(setting.image_load_threads);
+		}
+		{
+			std::lock_guard<std::mutex> guard(decoded_images->lock);
+			decoded_images->pending++;
+		}
+		image_loader->push([state = res.state, decoded = decoded_images, filePath]()
+		{
+			const bool ok = DecodeImageFile(filePath, state->pixels);
+			std::lock_guard<std::mutex> guard(decoded->lock);
+			decoded->done.emplace_back(state, ok);
+			if (--decoded->pending == 0)
+			{
+				decoded->idle.notify_all();
+			}
+		});
+		return res;
+	}
+
+	void D2DGraphics::complete_image_loads(const bool wait)
+	{
+		if (wait)
+		{
+			std::unique_lock<std::mutex> guard(decoded_images->lock);
+			decoded_images->idle.wait(guard, [this] { return decoded_images->pending == 0; });
+		}
+		UploadDecodedImages();
+	}
+
+	void D2DGraphics::UploadDecodedImages()
+	{
+		auto& uploading = decoded_images->uploading;
+		{
+			std::lock_guard<std::mutex> guard(decoded_images->lock);
+			if (decoded_images->done.empty())
+			{
+				return;
+			}
+			std::swap(uploading, decoded_images->done);
+		}
+#ifdef _WIN32
+		if (soft_canvas == nullptr)
+		{
+			InitD2D();
+		}
+#endif
+		for (auto& decoded : uploading)
+		{
+			ImageLoad::State& load = *decoded.first;
+			if (decoded.second && soft_canvas)
+			{
+				load.bitmap.soft_image = std::make_shared<soft::Image>(std::move(load.pixels));
+			}
+			else if (decoded.second)
+			{
+				load.bitmap = create_image_from_memory(
+				                                       Size{
+					                                       static_cast<float>(load.pixels.width()),
+					                                       static_cast<float>(load.pixels.height())
+				                                       },
+				                                       load.pixels.row(0),
+				                                       static_cast<UINT>(load.pixels.pitch()));
+			}
+			load.pixels = soft::Image();
+			const bool ready = load.bitmap.soft_image || load.bitmap.d2d_bitmap;
+			if (ready && !load.stamp.path.empty())
+			{
+				images->put(load.stamp, load.bitmap);
+			}
+			load.state = ready ? LOAD_STATE::Ready : LOAD_STATE::Failed;
+		}
+		uploading.clear();
+	}
+
 	Bitmap D2DGraphics::create_image_from_memory(const Size size, const void* srcData, const UINT pitch)
 	{
 		Bitmap res;
+		if (soft_canvas)
+		{
+			res.soft_image = std::make_shared<soft::Image>(static_cast<int>(size.width), static_cast<int>(size.height));
+			res.soft_image->copy_from(srcData, pitch);
+			return res;
+		}
+#ifdef _WIN32
 		HRESULT hr = m_pRenderTarget->CreateBitmap(
 		                                           Size2D2DU(size),
 		                                           D2D1::BitmapProperties(
@@ -476,177 +1433,958 @@ namespace graph
 		                                           &res.d2d_bitmap);
 		if (SUCCEEDED(hr))
 		{
-			hr = res.d2d_bitmap->CopyFromMemory(nullptr, srcData, pitch);
+			hr = res.d2d_bitmap->CopyFromMemory(nullptr, srcData, pitch);
+		}
+#endif
+		return res;
+	}
+
+	Bitmap D2DGraphics::create_image_from_memory(const Size size, const ColorBGRA8bit* srcData)
+	{
+		return create_image_from_memory(size, srcData, 4 * static_cast<UINT>(size.width));
+	}
+
+	//Images converted on one thread, below the cost of waking the others
+	constexpr size_t c_parallel_convert_pixels = 1 << 18;
+
+	soft::TaskPool* D2DGraphics::ConvertPool(const size_t pixels)
+	{
+		const unsigned threads = setting.render_threads != 0
+			                         ? setting.render_threads
+			                         : (std::max)(std::thread::hardware_concurrency(), 1u);
+		if (pixels < c_parallel_convert_pixels || threads == 1)
+		{
+			return nullptr;
+		}
+		if (!convert_pool)
+		{
+			convert_pool = std::make_unique<soft::TaskPool>(threads);
+		}
+		return convert_pool.get();
+	}
+
+	Bitmap D2DGraphics::create_image_from_memory(const Size size, const void* srcData, const UINT pitch, const PIXEL_FORMAT format)
+	{
+		if (format == PIXEL_FORMAT::BGRA8Premultiplied)
+		{
+			return create_image_from_memory(size, srcData, pitch);
+		}
+		const int width = static_cast<int>(size.width);
+		const int height = static_cast<int>(size.height);
+		auto image = std::make_shared<soft::Image>(width, height);
+		if (image->width() > 0 && image->height() > 0)
+		{
+			soft::ConvertPixels(format, width, height, srcData, pitch, image->row(0), image->pitch(),
+			                    ConvertPool(static_cast<size_t>(width) * height));
+		}
+		if (soft_canvas)
+		{
+			Bitmap res;
+			res.soft_image = std::move(image);
+			return res;
+		}
+		return create_image_from_memory(size, image->row(0), static_cast<UINT>(image->pitch()));
+	}
+
+	Bitmap D2DGraphics::wrap_image_memory(const Size size, void* pixels, const UINT pitch, std::function<void()> release)
+	{
+		Bitmap res;
+		const int width = static_cast<int>(size.width);
+		const int height = static_cast<int>(size.height);
+		const bool valid = width > 0 && height > 0 && pixels != nullptr &&
+			reinterpret_cast<std::uintptr_t>(pixels) % alignof(soft::Pixel) == 0 &&
+			pitch % sizeof(soft::Pixel) == 0 && pitch >= static_cast<UINT>(width) * sizeof(soft::Pixel);
+		if (valid && soft_canvas)
+		{
+			res.soft_image = std::make_shared<soft::Image>(soft::Image::borrow(width, height, pixels, pitch, std::move(release)));
+			return res;
+		}
+#ifdef _WIN32
+		if (valid)
+		{
+			res = create_image_from_memory(size, pixels, pitch);
+		}
+#endif
+		if (release)
+		{
+			release();
+		}
+		return res;
+	}
+
+	//Whole pixels of a rect given in pixels
+	soft::IntRect PixelBox(const Rect& rect)
+	{
+		const auto round = [](const float value)
+		{
+			const float limit = static_cast<float>(1 << 30);
+			return static_cast<int>(std::floor((std::min)((std::max)(value, -limit), limit) + 0.5f));
+		};
+		return soft::IntRect{round(rect.left), round(rect.top), round(rect.right), round(rect.bottom)};
+	}
+
+	bool D2DGraphics::update_image(Bitmap& bitmap, const Rect region, const void* srcData, const UINT pitch)
+	{
+		if (bitmap.soft_image == nullptr && bitmap.d2d_bitmap == nullptr)
+		{
+			return false;
+		}
+		const Size size = bitmap.get_size();
+		const soft::IntRect wanted = PixelBox(region);
+		const soft::IntRect box = soft::Intersect(wanted, soft::IntRect{
+			                                          0,
+			                                          0,
+			                                          static_cast<int>(size.width),
+			                                          static_cast<int>(size.height)
+		                                          });
+		if (box.empty())
+		{
+			return false;
+		}
+		//Past the part of region outside the bitmap
+		const auto* src = static_cast<const std::uint8_t*>(srcData) +
+			static_cast<size_t>(box.top - wanted.top) * pitch +
+			static_cast<size_t>(box.left - wanted.left) * sizeof(soft::Pixel);
+		if (recording)
+		{
+			recording->update_image(
+			                        Keep(bitmap),
+			                        Rect{
+				                        static_cast<float>(box.left),
+				                        static_cast<float>(box.top),
+				                        static_cast<float>(box.right),
+				                        static_cast<float>(box.bottom)
+			                        },
+			                        src,
+			                        pitch);
+			return true;
+		}
+		if (bitmap.soft_image)
+		{
+			//Only commands recorded but not drawn yet share it, they get the old pixels
+			if (soft_canvas && bitmap.soft_image.use_count() > 1)
+			{
+				soft_canvas->flush();
+			}
+			soft::Image& image = *bitmap.soft_image;
+			const size_t bytes = static_cast<size_t>(box.right - box.left) * sizeof(soft::Pixel);
+			for (int y = box.top; y < box.bottom; y++, src += pitch)
+			{
+				std::memcpy(image.row(y) + box.left, src, bytes);
+			}
+			image.discard_mips();
+			return true;
+		}
+#ifdef _WIN32
+		const D2D1_RECT_U rect = D2D1::RectU(
+		                                     static_cast<UINT32>(box.left),
+		                                     static_cast<UINT32>(box.top),
+		                                     static_cast<UINT32>(box.right),
+		                                     static_cast<UINT32>(box.bottom));
+		return SUCCEEDED(bitmap.d2d_bitmap->CopyFromMemory(&rect, src, pitch));
+#else
+		return false;
+#endif
+	}
+
+	struct ImageStream::Back
+	{
+		std::mutex lock;
+		soft::Image pixels;
+		//Written since the last update_image, empty for nothing
+		soft::IntRect dirty{0, 0, 0, 0};
+	};
+
+	PixelLock ImageStream::begin_write()
+	{
+		PixelLock res;
+		if (back == nullptr)
+		{
+			return res;
+		}
+		back->lock.lock();
+		res.bits = back->pixels.row(0);
+		res.width = back->pixels.width();
+		res.height = back->pixels.height();
+		res.pitch = back->pixels.pitch();
+		return res;
+	}
+
+	void ImageStream::end_write(const Rect dirty)
+	{
+		if (back == nullptr)
+		{
+			return;
+		}
+		const soft::IntRect box = soft::Intersect(PixelBox(dirty), soft::IntRect{
+			                                          0,
+			                                          0,
+			                                          back->pixels.width(),
+			                                          back->pixels.height()
+		                                          });
+		if (!box.empty())
+		{
+			soft::IntRect& total = back->dirty;
+			total = total.empty()
+				        ? box
+				        : soft::IntRect{
+					        (std::min)(total.left, box.left),
+					        (std::min)(total.top, box.top),
+					        (std::max)(total.right, box.right),
+					        (std::max)(total.bottom, box.bottom)
+				        };
+		}
+		back->lock.unlock();
+	}
+
+	ImageStream D2DGraphics::create_image_stream(const Size size)
+	{
+		ImageStream res;
+		res.back = std::make_shared<ImageStream::Back>();
+		res.back->pixels.resize(static_cast<int>(size.width), static_cast<int>(size.height));
+		if (res.back->pixels.width() > 0 && res.back->pixels.height() > 0)
+		{
+			res.bitmap = create_image_from_memory(size, res.back->pixels.row(0), static_cast<UINT>(res.back->pixels.pitch()));
+		}
+		return res;
+	}
+
+	bool D2DGraphics::update_image(ImageStream& stream)
+	{
+		if (stream.back == nullptr)
+		{
+			return false;
+		}
+		ImageStream::Back& back = *stream.back;
+		//Not waited for, the bitmap keeps the last frame
+		std::unique_lock<std::mutex> guard(back.lock, std::try_to_lock);
+		if (!guard.owns_lock() || back.dirty.empty())
+		{
+			return false;
+		}
+		const soft::IntRect box = back.dirty;
+		back.dirty = soft::IntRect{0, 0, 0, 0};
+		return update_image(
+		                    stream.bitmap,
+		                    Rect{
+			                    static_cast<float>(box.left),
+			                    static_cast<float>(box.top),
+			                    static_cast<float>(box.right),
+			                    static_cast<float>(box.bottom)
+		                    },
+		                    back.pixels.row(box.top) + box.left,
+		                    static_cast<UINT>(back.pixels.pitch()));
+	}
+
+	void D2DGraphics::draw_image(const Rect rect, const Bitmap& bitmap, const INTERPOLATION_MODE interpolation)
+	{
+		if (recording)
+		{
+			recording->draw_image(rect, Keep(bitmap), interpolation);
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->draw_image(rect, bitmap.soft_image, 1.f, interpolation);
+			return;
+		}
+#ifdef _WIN32
+		if (bitmap.d2d_bitmap == nullptr) { return; }
+		DrawTarget()->DrawBitmap(
+		                         bitmap.d2d_bitmap,
+		                         Rect2D2D(rect),
+		                         1.f,
+		                         interpolation == INTERPOLATION_MODE::NearestNeighbor
+			                         ? D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR
+			                         : D2D1_BITMAP_INTERPOLATION_MODE_LINEAR);
+#endif
+	}
+
+	std::atomic<std::uint64_t> g_font_id{0};
+
+	Font D2DGraphics::create_font(
+		const std::wstring& fontName,
+		const float fontSize,
+		FONT_WEIGHT fontWeight,
+		FONT_STYLE fontStyle,
+		FONT_STRETCH fontStretch)
+	{
+		Font res;
+		res.soft_name = fontName;
+		res.soft_size = fontSize;
+		res.id = ++g_font_id;
+		if (soft_canvas)
+		{
+			return res;
+		}
+#ifdef _WIN32
+		g_pDwriteFactory->CreateTextFormat(
+		                                   fontName.c_str(),
+		                                   nullptr,
+		                                   DWRITE_FONT_WEIGHT(fontWeight),
+		                                   DWRITE_FONT_STYLE(fontStyle),
+		                                   DWRITE_FONT_STRETCH(fontStretch),
+		                                   fontSize,
+		                                   L"",
+		                                   &res.d2d_font);
+		res.d2d_font->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER);
+#else
+		//Only DirectWrite has faces of other weights, styles and stretches
+		(void)fontWeight;
+		(void)fontStyle;
+		(void)fontStretch;
+#endif
+		return res;
+	}
+
+	void D2DGraphics::draw_text(
+		const std::wstring& text,
+		const Rect rect,
+		const Font& font,
+		const Brush& brush,
+		TEXT_ALIGN_HORIZONTAL alignHorizontal,
+		TEXT_ALIGN_VERTICAL alignVertical)
+	{
+		if (recording)
+		{
+			recording->draw_text(text, rect, Keep(font), brush, alignHorizontal, alignVertical);
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->draw_text(
+			                       text.c_str(),
+			                       text.size(),
+			                       rect,
+			                       font.soft_size,
+			                       static_cast<soft::TEXT_ALIGN>(alignHorizontal),
+			                       static_cast<soft::TEXT_ALIGN>(alignVertical),
+			                       SoftPaint(brush));
+			return;
+		}
+#ifdef _WIN32
+		if (brush.d2d_brush == nullptr) { return; }
+		IDWriteTextLayout* const layout = GetTextLayout(
+		                                                text,
+		                                                font,
+		                                                rect.right - rect.left,
+		                                                rect.bottom - rect.top,
+		                                                alignHorizontal,
+		                                                alignVertical);
+		if (layout == nullptr) { return; }
+		DrawTarget()->DrawTextLayout(
+		                             D2D1::Point2F(rect.left, rect.top),
+		                             layout,
+		                             brush.d2d_brush);
+#endif
+	}
+
+	TextMetrics D2DGraphics::measure_text(const std::wstring& text, const Font& font, const float maxWidth)
+	{
+		TextMetrics metrics{0.f, 0.f, 0.f, 0};
+		if (soft_canvas)
+		{
+			soft::BreakLines(text.c_str(), text.size(), font.soft_size, maxWidth, measure_lines);
+			for (const soft::TextLine& line : measure_lines)
+			{
+				metrics.width = (std::max)(metrics.width, line.width);
+			}
+			metrics.lines = measure_lines.size();
+			metrics.height = static_cast<float>(metrics.lines) * soft::builtin_font::LineHeight(font.soft_size);
+			metrics.baseline = soft::builtin_font::Ascent(font.soft_size);
+			return metrics;
+		}
+#ifdef _WIN32
+		IDWriteTextLayout* const layout = GetTextLayout(
+		                                                text,
+		                                                font,
+		                                                maxWidth,
+		                                                (std::numeric_limits<float>::max)(),
+		                                                TEXT_ALIGN_HORIZONTAL::Left,
+		                                                TEXT_ALIGN_VERTICAL::Top);
+		DWRITE_TEXT_METRICS textMetrics;
+		if (layout == nullptr || FAILED(layout->GetMetrics(&textMetrics))) { return metrics; }
+		metrics.width = textMetrics.width;
+		metrics.height = textMetrics.height;
+		metrics.lines = textMetrics.lineCount;
+		//Only the first line is wanted, but the call fails unless there is room for all
+		measure_line_metrics.resize(textMetrics.lineCount);
+		UINT32 lineCount = 0;
+		if (textMetrics.lineCount > 0 &&
+			SUCCEEDED(layout->GetLineMetrics(measure_line_metrics.data(), textMetrics.lineCount, &lineCount)))
+		{
+			metrics.baseline = measure_line_metrics[0].baseline;
+		}
+#endif
+		return metrics;
+	}
+
+#ifdef _WIN32
+	IDWriteTextLayout* D2DGraphics::GetTextLayout(
+		const std::wstring& text,
+		const Font& font,
+		const float width,
+		const float height,
+		TEXT_ALIGN_HORIZONTAL alignHorizontal,
+		TEXT_ALIGN_VERTICAL alignVertical)
+	{
+		if (font.d2d_font == nullptr) { return nullptr; }
+		const TextLayoutKey key{
+			text.c_str(),
+			text.size(),
+			font.id,
+			width,
+			height,
+			static_cast<std::uint32_t>(alignHorizontal),
+			static_cast<std::uint32_t>(alignVertical)
+		};
+		//Shaping and line breaking happen once for text laid out again the same way
+		const ComPtr<IDWriteTextLayout>* layout = text_layouts->get(key, [&](ComPtr<IDWriteTextLayout>& made)
+		{
+			const HRESULT hr = g_pDwriteFactory->CreateTextLayout(
+			                                                      text.c_str(),
+			                                                      static_cast<UINT32>(text.size()),
+			                                                      font.d2d_font,
+			                                                      width,
+			                                                      height,
+			                                                      made.GetAddressOf()
+			                                                     );
+			if (FAILED(hr)) { return false; }
+			made->SetTextAlignment(static_cast<DWRITE_TEXT_ALIGNMENT>(alignHorizontal));
+			made->SetParagraphAlignment(static_cast<DWRITE_PARAGRAPH_ALIGNMENT>(alignVertical));
+			return true;
+		});
+		return layout == nullptr ? nullptr : layout->Get();
+	}
+#endif
+
+	void D2DGraphics::fill_triangle(const Point p1, const Point p2, const Point p3, const Brush& brush)
+	{
+		if (recording)
+		{
+			recording->fill_triangle(p1, p2, p3, brush);
+			return;
+		}
+		if (soft_canvas)
+		{
+			const Point points[] = {p1, p2, p3};
+			soft_canvas->fill_poly(points, 3, SoftPaint(brush));
+			return;
+		}
+#ifdef _WIN32
+		if (brush.d2d_brush == nullptr) { return; }
+		const Point points[] = {p1, p2, p3};
+		const ComPtr<ID2D1PathGeometry> geometry = CreatePolyGeometry(points, 3, true, FILL_MODE::Alternate);
+		if (geometry == nullptr) { return; }
+		DrawTarget()->FillGeometry(geometry.Get(), brush.d2d_brush);
+#endif
+	}
+
+	void D2DGraphics::fill_rect(const Rect rect, const Brush& brush)
+	{
+		if (recording)
+		{
+			recording->fill_rect(rect, brush);
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->fill_rect(rect, SoftPaint(brush));
+			return;
+		}
+#ifdef _WIN32
+		if (brush.d2d_brush == nullptr) { return; }
+		DrawTarget()->FillRectangle(
+		                            Rect2D2D(rect),
+		                            brush.d2d_brush);
+#endif
+	}
+
+	void D2DGraphics::fill_ellipse(const Ellipse ellipse, const Brush& brush)
+	{
+		if (recording)
+		{
+			recording->fill_ellipse(ellipse, brush);
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->fill_ellipse(ellipse, SoftPaint(brush));
+			return;
+		}
+#ifdef _WIN32
+		if (brush.d2d_brush == nullptr) { return; }
+		DrawTarget()->FillEllipse(
+		                          Ellipse2D2D(ellipse),
+		                          brush.d2d_brush
+		                         );
+#endif
+	}
+
+	void D2DGraphics::fill_ellipse(const Rect rect, const Brush& brush)
+	{
+		fill_ellipse(Rect2Ellipse(rect), brush);
+	}
+
+	void D2DGraphics::fill_poly(const Point* points, const size_t size, const Brush& brush, const FILL_MODE mode)
+	{
+		if (recording)
+		{
+			recording->fill_poly(points, size, brush, mode);
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->fill_poly(
+			                       points,
+			                       size,
+			                       SoftPaint(brush),
+			                       mode == FILL_MODE::Winding ? soft::FillRule::NonZero : soft::FillRule::EvenOdd);
+			return;
+		}
+#ifdef _WIN32
+		if (size == 0 || brush.d2d_brush == nullptr) { return; }
+		const ComPtr<ID2D1PathGeometry> geometry = CreatePolyGeometry(points, size, true, mode);
+		if (geometry == nullptr) { return; }
+		DrawTarget()->FillGeometry(geometry.Get(), brush.d2d_brush);
+#endif
+	}
+
+	void D2DGraphics::fill_poly(const std::vector<Point>& points, const Brush& brush, const FILL_MODE mode)
+	{
+		fill_poly(points.data(), points.size(), brush, mode);
+	}
+
+	void D2DGraphics::fill_path(const Path& path, const Brush& brush)
+	{
+		if (recording)
+		{
+			recording->fill_path(Keep(path), brush);
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->fill_figures(
+			                          path.figures,
+			                          SoftPaint(brush),
+			                          path.fill_mode == FILL_MODE::Winding ? soft::FillRule::NonZero : soft::FillRule::EvenOdd);
+			return;
+		}
+#ifdef _WIN32
+		if (path.empty() || brush.d2d_brush == nullptr) { return; }
+		ID2D1PathGeometry* geometry = GetPathGeometry(path);
+		if (geometry == nullptr) { return; }
+		DrawTarget()->FillGeometry(geometry, brush.d2d_brush);
+#endif
+	}
+
+	void D2DGraphics::draw_path(const Path& path, const Brush& brush, const float width, const STROKE_STYLE style)
+	{
+		draw_path(path, brush, width, StrokeStyle::preset(style));
+	}
+
+	void D2DGraphics::draw_path(const Path& path, const Brush& brush, const float width, const StrokeStyle& style)
+	{
+		if (recording)
+		{
+			recording->draw_path(Keep(path), brush, width, style);
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->stroke_figures(path.figures, width, SoftPaint(brush), style);
+			return;
+		}
+#ifdef _WIN32
+		if (path.empty() || brush.d2d_brush == nullptr) { return; }
+		ID2D1PathGeometry* geometry = GetPathGeometry(path);
+		if (geometry == nullptr) { return; }
+		DrawTarget()->DrawGeometry(geometry, brush.d2d_brush, width, GetStrokeStyle(style).Get());
+#endif
+	}
+
+	void D2DGraphics::fill_rects(const Rect* rects, const size_t count, const Brush& brush)
+	{
+		if (recording)
+		{
+			recording->fill_rects(rects, count, brush);
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->fill_rects(rects, count, SoftPaint(brush));
+			return;
+		}
+#ifdef _WIN32
+		if (brush.d2d_brush == nullptr) { return; }
+		ID2D1RenderTarget* const target = DrawTarget();
+		for (size_t i = 0; i < count; i++)
+		{
+			target->FillRectangle(Rect2D2D(rects[i]), brush.d2d_brush);
+		}
+#endif
+	}
+
+	void D2DGraphics::fill_rects(const Rect* rects, const Color32* colors, const size_t count)
+	{
+		if (recording)
+		{
+			recording->fill_rects(rects, colors, count);
+			return;
+		}
+		if (soft_canvas)
+		{
+			PremultiplyChunks(colors, count, [&](const size_t begin, const soft::Pixel* chunk, const size_t n)
+			{
+				soft_canvas->fill_rects(rects + begin, chunk, n);
+			});
+			return;
+		}
+#ifdef _WIN32
+		ID2D1SolidColorBrush* const brush = GetBatchBrush();
+		if (brush == nullptr) { return; }
+		ID2D1RenderTarget* const target = DrawTarget();
+		for (size_t i = 0; i < count; i++)
+		{
+			brush->SetColor(Packed2D2D(colors[i]));
+			target->FillRectangle(Rect2D2D(rects[i]), brush);
+		}
+#endif
+	}
+
+	void D2DGraphics::fill_ellipses(const Ellipse* ellipses, const size_t count, const Brush& brush)
+	{
+		if (recording)
+		{
+			recording->fill_ellipses(ellipses, count, brush);
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->fill_ellipses(ellipses, count, SoftPaint(brush));
+			return;
+		}
+#ifdef _WIN32
+		if (brush.d2d_brush == nullptr) { return; }
+		ID2D1RenderTarget* const target = DrawTarget();
+		for (size_t i = 0; i < count; i++)
+		{
+			target->FillEllipse(Ellipse2D2D(ellipses[i]), brush.d2d_brush);
+		}
+#endif
+	}
+
+	void D2DGraphics::fill_ellipses(const Ellipse* ellipses, const Color32* colors, const size_t count)
+	{
+		if (recording)
+		{
+			recording->fill_ellipses(ellipses, colors, count);
+			return;
 		}
-		return res;
+		if (soft_canvas)
+		{
+			PremultiplyChunks(colors, count, [&](const size_t begin, const soft::Pixel* chunk, const size_t n)
+			{
+				soft_canvas->fill_ellipses(ellipses + begin, chunk, n);
+			});
+			return;
+		}
+#ifdef _WIN32
+		ID2D1SolidColorBrush* const brush = GetBatchBrush();
+		if (brush == nullptr) { return; }
+		ID2D1RenderTarget* const target = DrawTarget();
+		for (size_t i = 0; i < count; i++)
+		{
+			brush->SetColor(Packed2D2D(colors[i]));
+			target->FillEllipse(Ellipse2D2D(ellipses[i]), brush);
+		}
+#endif
 	}
 
-	Bitmap D2DGraphics::create_image_from_memory(const Size size, const ColorBGRA8bit* srcData)
+	void D2DGraphics::draw_lines(
+		const Point* ends,
+		const size_t count,
+		const Brush& brush,
+		const float width,
+		const STROKE_STYLE style)
 	{
-		return create_image_from_memory(size, srcData, 4 * static_cast<UINT>(size.width));
+		draw_lines(ends, count, brush, width, StrokeStyle::preset(style));
 	}
 
-	void D2DGraphics::draw_image(const Rect rect, const Bitmap& bitmap)
+	void D2DGraphics::draw_lines(
+		const Point* ends,
+		const size_t count,
+		const Brush& brush,
+		const float width,
+		const StrokeStyle& style)
 	{
-		if (bitmap.d2d_bitmap == nullptr) { return; }
-		m_pRenderTarget->DrawBitmap(bitmap.d2d_bitmap, Rect2D2D(rect));
+		if (recording)
+		{
+			recording->draw_lines(ends, count, brush, width, style);
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->stroke_lines(ends, count, width, SoftPaint(brush), style);
+			return;
+		}
+#ifdef _WIN32
+		if (brush.d2d_brush == nullptr) { return; }
+		ID2D1RenderTarget* const target = DrawTarget();
+		ID2D1StrokeStyle* const strokeStyle = GetStrokeStyle(style).Get();
+		for (size_t i = 0; i < count; i++)
+		{
+			target->DrawLine(Point2D2D(ends[2 * i]), Point2D2D(ends[2 * i + 1]), brush.d2d_brush, width, strokeStyle);
+		}
+#endif
 	}
 
-	Font D2DGraphics::create_font(
-		const std::wstring& fontName,
-		const float fontSize,
-		FONT_WEIGHT fontWeight,
-		FONT_STYLE fontStyle,
-		FONT_STRETCH fontStretch)
+	void D2DGraphics::draw_lines(
+		const Point* ends,
+		const Color32* colors,
+		const size_t count,
+		const float width,
+		const STROKE_STYLE style)
 	{
-		Font res;
-		g_pDwriteFactory->CreateTextFormat(
-		                                   fontName.c_str(),
-		                                   nullptr,
-		                                   DWRITE_FONT_WEIGHT(fontWeight),
-		                                   DWRITE_FONT_STYLE(fontStyle),
-		                                   DWRITE_FONT_STRETCH(fontStretch),
-		                                   fontSize,
-		                                   L"",
-		                                   &res.d2d_font);
-		res.d2d_font->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER);
-		return res;
+		draw_lines(ends, colors, count, width, StrokeStyle::preset(style));
 	}
 
-	void D2DGraphics::draw_text(
-		const std::wstring& text,
-		const Rect rect,
-		const Font& font,
-		const Brush& brush,
-		TEXT_ALIGN_HORIZONTAL alignHorizontal,
-		TEXT_ALIGN_VERTICAL alignVertical)
+	void D2DGraphics::draw_lines(
+		const Point* ends,
+		const Color32* colors,
+		const size_t count,
+		const float width,
+		const StrokeStyle& style)
 	{
-		if (font.d2d_font == nullptr || brush.d2d_brush == nullptr) { return; }
-		IDWriteTextLayout* layout;
-		HRESULT hr = g_pDwriteFactory->CreateTextLayout(
-		                                                text.c_str(),
-		                                                text.size(),
-		                                                font.d2d_font,
-		                                                rect.right - rect.left,
-		                                                rect.bottom - rect.top,
-		                                                &layout
-		                                               );
-		if (FAILED(hr)) { return; }
-		layout->SetTextAlignment(static_cast<DWRITE_TEXT_ALIGNMENT>(alignHorizontal));
-		layout->SetParagraphAlignment(static_cast<DWRITE_PARAGRAPH_ALIGNMENT>(alignVertical));
-		m_pRenderTarget->DrawTextLayout(
-		                                D2D1::Point2F(rect.left, rect.top),
-		                                layout,
-		                                brush.d2d_brush);
+		if (recording)
+		{
+			recording->draw_lines(ends, colors, count, width, style);
+			return;
+		}
+		if (soft_canvas)
+		{
+			PremultiplyChunks(colors, count, [&](const size_t begin, const soft::Pixel* chunk, const size_t n)
+			{
+				soft_canvas->stroke_lines(ends + 2 * begin, chunk, n, width, style);
+			});
+			return;
+		}
+#ifdef _WIN32
+		ID2D1SolidColorBrush* const brush = GetBatchBrush();
+		if (brush == nullptr) { return; }
+		ID2D1RenderTarget* const target = DrawTarget();
+		ID2D1StrokeStyle* const strokeStyle = GetStrokeStyle(style).Get();
+		for (size_t i = 0; i < count; i++)
+		{
+			brush->SetColor(Packed2D2D(colors[i]));
+			target->DrawLine(Point2D2D(ends[2 * i]), Point2D2D(ends[2 * i + 1]), brush, width, strokeStyle);
+		}
+#endif
 	}
 
-	void D2DGraphics::fill_triangle(const Point p1, const Point p2, const Point p3, const Brush& brush)
+	void D2DGraphics::set_pixel(const float x, const float y, const Color color)
 	{
-		if (brush.d2d_brush == nullptr) { return; }
-		ID2D1PathGeometry* geometry = NULL;
-		HRESULT hr = g_pD2DFactory->CreatePathGeometry(&geometry);
-		if (FAILED(hr))
+		if (recording)
 		{
-			MessageBox(m_Hwnd, TEXT("Create Geometry Fail"), TEXT("Error"), MB_OK);
+			recording->set_pixel(Point{x, y}, color);
 			return;
 		}
-		ID2D1GeometrySink* pSink = NULL;
-		hr = geometry->Open(&pSink);
-		if (FAILED(hr))
+		if (soft_canvas)
 		{
-			MessageBox(m_Hwnd, TEXT("Open Geometry Fail"), TEXT("Error"), MB_OK);
+			soft_canvas->set_pixel(Point{x, y}, soft::PremultiplyColor(color));
 			return;
 		}
-		pSink->BeginFigure(Point2D2D(p1), D2D1_FIGURE_BEGIN_FILLED);
-		D2D1_POINT_2F points[] = {
-			Point2D2D(p1), Point2D2D(p2), Point2D2D(p3)
-		};
-		pSink->AddLines(points, 3);
-		pSink->EndFigure(D2D1_FIGURE_END_CLOSED);
-		pSink->Close();
-		SafeRelease(pSink);
-		m_pRenderTarget->FillGeometry(geometry, brush.d2d_brush);
-		SafeRelease(geometry);
+		draw_line(Point{x, y}, Point{x + 0.5f, y + 0.5f}, get_solidbrush(color));
 	}
 
-	void D2DGraphics::fill_rect(const Rect rect, const Brush& brush)
+	void D2DGraphics::set_pixel(const Point point, const Color color)
 	{
-		if (brush.d2d_brush == nullptr) { return; }
-		m_pRenderTarget->FillRectangle(
-		                               Rect2D2D(rect),
-		                               brush.d2d_brush);
+		set_pixel(point.x, point.y, color);
 	}
 
-	void D2DGraphics::fill_ellipse(const Ellipse ellipse, const Brush& brush)
+	void D2DGraphics::set_pixels(const Point* points, const Color* colors, const size_t count)
 	{
-		if (brush.d2d_brush == nullptr) { return; }
-		m_pRenderTarget->FillEllipse(
-		                             Ellipse2D2D(ellipse),
-		                             brush.d2d_brush
-		                            );
+		if (recording)
+		{
+			recording->set_pixels(points, colors, count);
+			return;
+		}
+		if (soft_canvas)
+		{
+			//Converted a chunk at a time so a large batch needs no allocation
+			soft::Pixel chunk[256];
+			for (size_t begin = 0; begin < count; begin += 256)
+			{
+				const size_t n = (std::min)(count - begin, static_cast<size_t>(256));
+				for (size_t i = 0; i < n; i++)
+				{
+					chunk[i] = soft::PremultiplyColor(colors[begin + i]);
+				}
+				soft_canvas->set_pixels(points + begin, chunk, n);
+			}
+			return;
+		}
+#ifdef _WIN32
+		ScatterPixels(points, count, [&](const size_t i) { return soft::PremultiplyColor(colors[i]); });
+#endif
 	}
 
-	void D2DGraphics::fill_ellipse(const Rect rect, const Brush& brush)
+	void D2DGraphics::set_pixels(const Point* points, const Color32* colors, const size_t count)
 	{
-		if (brush.d2d_brush == nullptr) { return; }
-		fill_ellipse(Rect2Ellipse(rect), brush);
+		if (recording)
+		{
+			recording->set_pixels(points, colors, count);
+			return;
+		}
+		if (soft_canvas)
+		{
+			PremultiplyChunks(colors, count, [&](const size_t begin, const soft::Pixel* chunk, const size_t n)
+			{
+				soft_canvas->set_pixels(points + begin, chunk, n);
+			});
+			return;
+		}
+#ifdef _WIN32
+		ScatterPixels(points, count, [&](const size_t i) { return soft::PremultiplyPacked(colors[i].argb); });
+#endif
 	}
 
-	void D2DGraphics::fill_poly(const Point* points, const size_t size, const Brush& brush)
+#ifdef _WIN32
+	template <typename Premultiply>
+	void D2DGraphics::ScatterPixels(const Point* points, const size_t count, Premultiply premultiply)
 	{
-		if (brush.d2d_brush == nullptr) { return; }
-		ID2D1PathGeometry* geometry = NULL;
-		HRESULT hr = g_pD2DFactory->CreatePathGeometry(&geometry);
-		if (FAILED(hr))
+		D2D1_MATRIX_3X2_F view;
+		DrawTarget()->GetTransform(&view);
+		const D2D1_SIZE_U size = DrawTarget()->GetPixelSize();
+		const auto toPixel = [&](const Point p)
 		{
-			MessageBox(
-			           m_Hwnd,
-			           TEXT("Create Geometry Fail"),
-			           TEXT("Error"),
-			           MB_OK);
-			return;
+			return Point{
+				(p.x * view._11 + p.y * view._21 + view._31) * DPI_scaleX,
+				(p.x * view._12 + p.y * view._22 + view._32) * DPI_scaleY
+			};
+		};
+		const auto inside = [&](const Point p)
+		{
+			return p.x >= 0.f && p.x < static_cast<float>(size.width) &&
+				p.y >= 0.f && p.y < static_cast<float>(size.height);
+		};
+		//Blend into a bitmap of just the area the points cover and draw that once
+		int left = static_cast<int>(size.width), top = static_cast<int>(size.height), right = -1, bottom = -1;
+		for (size_t i = 0; i < count; i++)
+		{
+			const Point p = toPixel(points[i]);
+			if (inside(p))
+			{
+				left = (std::min)(left, static_cast<int>(p.x));
+				top = (std::min)(top, static_cast<int>(p.y));
+				right = (std::max)(right, static_cast<int>(p.x));
+				bottom = (std::max)(bottom, static_cast<int>(p.y));
+			}
 		}
-		ID2D1GeometrySink* pSink = NULL;
-		hr = geometry->Open(&pSink);
-		if (FAILED(hr))
+		if (right < left)
 		{
-			MessageBox(
-			           m_Hwnd,
-			           TEXT("Open Geometry Fail"),
-			           TEXT("Error"),
-			           MB_OK);
 			return;
 		}
-		pSink->BeginFigure(Point2D2D(points[0]), D2D1_FIGURE_BEGIN_FILLED);
-		std::vector<D2D1_POINT_2F> d2dPoints(size);
-		for (size_t i = 0; i < size; i++)
+		const int width = right - left + 1;
+		const int height = bottom - top + 1;
+		scatter_pixels.assign(static_cast<size_t>(width) * height, 0);
+		for (size_t i = 0; i < count; i++)
 		{
-			d2dPoints[i] = Point2D2D(points[i]);
+			const Point p = toPixel(points[i]);
+			if (inside(p))
+			{
+				std::uint32_t& dst = scatter_pixels[static_cast<size_t>(static_cast<int>(p.y) - top) * width +
+					(static_cast<int>(p.x) - left)];
+				dst = soft::BlendPixel(dst, premultiply(i));
+			}
 		}
-		pSink->AddLines(d2dPoints.data(), static_cast<UINT32>(size));
-		pSink->EndFigure(D2D1_FIGURE_END_CLOSED);
-		pSink->Close();
-		SafeRelease(pSink);
-		m_pRenderTarget->FillGeometry(geometry, brush.d2d_brush);
-		SafeRelease(geometry);
+		DrawPixels(left, top, width, height, scatter_pixels.data(), static_cast<size_t>(width) * 4);
 	}
+#endif
 
-	void D2DGraphics::fill_poly(const std::vector<Point>& points, const Brush& brush)
+	PixelLock D2DGraphics::lock_pixels()
 	{
-		if (brush.d2d_brush == nullptr) { return; }
-		fill_poly(points.data(), points.size(), brush);
+		if (locked_pixels.bits)
+		{
+			return locked_pixels;
+		}
+		//Writes to the pixels could not be played back
+		if (recording)
+		{
+			return PixelLock();
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->flush();
+			soft::Image& target = soft_canvas->get_target();
+			if (target.width() == 0 || target.height() == 0)
+			{
+				return PixelLock();
+			}
+			locked_pixels.bits = target.row(0);
+			locked_pixels.width = target.width();
+			locked_pixels.height = target.height();
+			locked_pixels.pitch = target.pitch();
+			return locked_pixels;
+		}
+#ifdef _WIN32
+		const D2D1_SIZE_U size = DrawTarget()->GetPixelSize();
+		if (size.width == 0 || size.height == 0)
+		{
+			return PixelLock();
+		}
+		//Kept while the size holds, a simulation only has to write what changed
+		if (locked_pixels.width != static_cast<int>(size.width) ||
+			locked_pixels.height != static_cast<int>(size.height))
+		{
+			staging_pixels.assign(static_cast<size_t>(size.width) * size.height, 0);
+		}
+		locked_pixels.bits = staging_pixels.data();
+		locked_pixels.width = static_cast<int>(size.width);
+		locked_pixels.height = static_cast<int>(size.height);
+		locked_pixels.pitch = static_cast<size_t>(size.width) * sizeof(std::uint32_t);
+#endif
+		return locked_pixels;
 	}
 
-	void D2DGraphics::set_pixel(const float x, const float y, const Color color)
+	void D2DGraphics::write_span(int x, const int y, const ColorBGRA8bit* src, size_t count)
 	{
-		draw_line(Point{x, y}, Point{x + 0.5f, y + 0.5f}, get_solidbrush(color));
+		static_assert(sizeof(ColorBGRA8bit) == sizeof(std::uint32_t), "ColorBGRA8bit must be one pixel");
+		if (locked_pixels.bits == nullptr || y < 0 || y >= locked_pixels.height || x >= locked_pixels.width)
+		{
+			return;
+		}
+		if (x < 0)
+		{
+			const size_t skip = static_cast<size_t>(-static_cast<long long>(x));
+			if (count <= skip)
+			{
+				return;
+			}
+			src += skip;
+			count -= skip;
+			x = 0;
+		}
+		count = (std::min)(count, static_cast<size_t>(locked_pixels.width - x));
+		std::memcpy(locked_pixels.row(y) + x, src, count * sizeof(std::uint32_t));
 	}
 
-	void D2DGraphics::set_pixel(const Point point, const Color color)
+	void D2DGraphics::unlock_pixels()
 	{
-		set_pixel(point.x, point.y, color);
+		if (locked_pixels.bits == nullptr)
+		{
+			return;
+		}
+		locked_pixels.bits = nullptr;
+#ifdef _WIN32
+		if (soft_canvas == nullptr)
+		{
+			DrawPixels(0, 0, locked_pixels.width, locked_pixels.height, staging_pixels.data(), locked_pixels.pitch);
+		}
+#endif
 	}
 
+#ifdef _WIN32
 	void D2DGraphics::InitializeDPIScale(const HWND hwnd)
 	{
 #ifdef  NTDDI_WIN10
@@ -664,6 +2402,7 @@ namespace graph
 		DPI_scaleY = dpiy / 96.0f;
 #endif
 	}
+#endif
 
 	void D2DGraphics::DrawingLock()
 	{
@@ -697,56 +2436,104 @@ namespace graph
 
 	Point D2DGraphics::get_relative_pos()
 	{
+#ifndef _WIN32
+		return Point{0.f, 0.f};
+#else
+		if (m_Hwnd == NULL) { return Point{0.f, 0.f}; }
 		POINT pos;
 		GetCursorPos(&pos);
 		ScreenToClient(m_Hwnd, &pos);
 		const Point dipPos = PixelsToDips(pos.x, pos.y);
 		return dipPos;
+#endif
 	}
 
 	Size D2DGraphics::get_dip_size()
 	{
-		const auto size = m_pRenderTarget->GetSize();
-		return Size{static_cast<float>(size.width), static_cast<float>(size.height)};
+#ifdef _WIN32
+		if (soft_canvas == nullptr)
+		{
+			const auto size = m_pRenderTarget->GetSize();
+			return Size{static_cast<float>(size.width), static_cast<float>(size.height)};
+		}
+#endif
+		return get_pixel_size();
 	}
 
 	Size D2DGraphics::get_pixel_size()
 	{
-		const auto size = m_pRenderTarget->GetPixelSize();
-		return Size{static_cast<float>(size.width), static_cast<float>(size.height)};
+#ifdef _WIN32
+		if (soft_canvas == nullptr)
+		{
+			const auto size = m_pRenderTarget->GetPixelSize();
+			return Size{static_cast<float>(size.width), static_cast<float>(size.height)};
+		}
+#endif
+		const soft::Image& image = soft_canvas->get_target();
+		return Size{static_cast<float>(image.width()), static_cast<float>(image.height())};
 	}
 
 	std::wstring D2DGraphics::get_caption()
 	{
+#ifdef _WIN32
+		if (m_Hwnd == NULL) { return setting.window_caption; }
 		const size_t len = GetWindowTextLength(m_Hwnd);
 		auto* buf = new wchar_t[len + 5];
 		GetWindowText(m_Hwnd, buf, static_cast<int>(len + 5));
 		setting.window_caption = buf;
 		delete[] buf;
+#endif
 		return setting.window_caption;
 	}
 
 	void D2DGraphics::set_caption(const std::wstring& caption)
 	{
 		setting.window_caption = caption;
+#ifdef _WIN32
 		SetWindowText(m_Hwnd, caption.c_str());
+#endif
 	}
 
 	void D2DGraphics::rotate_view(float angle, const Point center)
 	{
-		m_pRenderTarget->SetTransform(D2D1::Matrix3x2F::Rotation(
-		                                                         angle / TWO_PI * 360.f,
-		                                                         Point2D2D(center)));
+		if (recording)
+		{
+			recording->rotate_view(angle, center);
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->set_transform(soft::Affine::rotation(angle, center));
+			return;
+		}
+#ifdef _WIN32
+		DrawTarget()->SetTransform(D2D1::Matrix3x2F::Rotation(
+		                                                      angle / TWO_PI * 360.f,
+		                                                      Point2D2D(center)));
+#endif
 	}
 
 	void D2DGraphics::reset_view()
 	{
-		m_pRenderTarget->SetTransform(D2D1::Matrix3x2F::Identity());
+		if (recording)
+		{
+			recording->reset_view();
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->set_transform(soft::Affine{});
+			return;
+		}
+#ifdef _WIN32
+		DrawTarget()->SetTransform(D2D1::Matrix3x2F::Identity());
+#endif
 	}
 
 	void D2DGraphics::show_scene(const int index)
 	{
 		current_scene = setting.Scenes[index];
+		full_damage = true;
 		static std::vector<bool> inited(setting.Scenes.size(), false);
 		if (setting.Init_option == GraphSetting::INIT_OPTION::INIT_ONCE_BEFORE_USING && !inited[index])
 		{
@@ -761,11 +2548,22 @@ namespace graph
 
 	void D2DGraphics::close()
 	{
+#ifdef _WIN32
 		SendMessage(m_Hwnd,WM_DESTROY, 0, 0);
+#endif
 	}
 
 	void D2DGraphics::reset_size(const UINT width, const UINT height)
 	{
+		if (setting.headless)
+		{
+			DrawingLock();
+			soft_canvas->resize(static_cast<int>(width), static_cast<int>(height));
+			full_damage = true;
+			DrawingUnlock();
+			return;
+		}
+#ifdef _WIN32
 		RECT winRect{};
 		GetWindowRect(m_Hwnd, &winRect);
 
@@ -794,6 +2592,7 @@ namespace graph
 
 		AdjustWindowRect(&newRect, wStyle, FALSE);
 		MoveWindow(m_Hwnd, winRect.left, winRect.top, newRect.right - newRect.left, newRect.bottom - newRect.top, TRUE);
+#endif
 	}
 
 	void D2DGraphics::pause()
@@ -808,160 +2607,228 @@ namespace graph
 
 	LONGLONG get_time()
 	{
+#ifdef _WIN32
 		LARGE_INTEGER tick;
 		QueryPerformanceCounter(&tick);
 		return tick.QuadPart;
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		                                                           std::chrono::steady_clock::now().time_since_epoch()).
+			count();
+#endif
+	}
+
+	void convert_colors(const Color32* src, Color* dst, const size_t count)
+	{
+		soft::UnpackColors(src, dst, count);
+	}
+
+	void convert_colors(const Color* src, Color32* dst, const size_t count)
+	{
+		soft::PackColors(src, dst, count);
 	}
 
+#ifdef _WIN32
 	//Resize will waiting when renderTarget is in drawing
 	bool D2DGraphics::Resize(const unsigned width, const unsigned height)
 	{
+		if (soft_canvas)
+		{
+			DrawingLock();
+			soft_canvas->resize(static_cast<int>(width), static_cast<int>(height));
+			full_damage = true;
+			DrawingUnlock();
+			return true;
+		}
 		if (m_pRenderTarget != nullptr)
 		{
 			DrawingLock();
 			const HRESULT hr = m_pRenderTarget->Resize(D2D1::SizeU(width, height));
+			full_damage = true;
 			DrawingUnlock();
 			return SUCCEEDED(hr);
 		}
 		return true;
 	}
 
-	ComPtr<ID2D1StrokeStyle> D2DGraphics::GetDashStyle()
+	ComPtr<ID2D1StrokeStyle> D2DGraphics::GetStrokeStyle(const StrokeStyle& style)
 	{
-		if (stroke_style_dash == nullptr)
+		if (style == StrokeStyle())
 		{
-			HRESULT hr = g_pD2DFactory->CreateStrokeStyle(
-			                                              D2D1::StrokeStyleProperties(
-			                                                                          D2D1_CAP_STYLE_ROUND,
-			                                                                          D2D1_CAP_STYLE_ROUND,
-			                                                                          D2D1_CAP_STYLE_ROUND,
-			                                                                          D2D1_LINE_JOIN_MITER,
-			                                                                          10.0f,
-			                                                                          D2D1_DASH_STYLE_DASH,
-			                                                                          0.0f
-			                                                                         ),
-			                                              NULL,
-			                                              0,
-			                                              stroke_style_dash.GetAddressOf()
-			                                             );
-			if (FAILED(hr))
-			{
-				MessageBox(
-				           m_Hwnd,
-				           TEXT("CreateStrokeStyle Dash Fail"),
-				           TEXT("Error"),
-				           MB_OK);
-				return NULL;
-			}
+			return nullptr;
+		}
+		const auto found = stroke_styles.find(style);
+		if (found != stroke_styles.end())
+		{
+			return found->second;
+		}
+		ComPtr<ID2D1StrokeStyle> strokeStyle;
+		const HRESULT hr = g_pD2DFactory->CreateStrokeStyle(
+		                                                    D2D1::StrokeStyleProperties(
+		                                                                                static_cast<D2D1_CAP_STYLE>(style.start_cap),
+		                                                                                static_cast<D2D1_CAP_STYLE>(style.end_cap),
+		                                                                                static_cast<D2D1_CAP_STYLE>(style.dash_cap),
+		                                                                                static_cast<D2D1_LINE_JOIN>(style.line_join),
+		                                                                                style.miter_limit,
+		                                                                                style.dashes.empty()
+		                                                                                ? D2D1_DASH_STYLE_SOLID
+		                                                                                : D2D1_DASH_STYLE_CUSTOM,
+		                                                                                style.dash_offset
+		                                                                               ),
+		                                                    style.dashes.empty() ? NULL : style.dashes.data(),
+		                                                    static_cast<UINT32>(style.dashes.size()),
+		                                                    strokeStyle.GetAddressOf()
+		                                                   );
+		if (FAILED(hr))
+		{
+			MessageBox(m_Hwnd, TEXT("CreateStrokeStyle Fail"), TEXT("Error"), MB_OK);
+			return nullptr;
 		}
-		return stroke_style_dash;
+		stroke_styles.emplace(style, strokeStyle);
+		return strokeStyle;
 	}
 
-	ComPtr<ID2D1StrokeStyle> D2DGraphics::GetDashDotStyle()
+	ID2D1SolidColorBrush* D2DGraphics::GetBatchBrush()
 	{
-		if (!stroke_style_dashdot)
+		if (batch_brush == nullptr)
 		{
-			HRESULT hr = g_pD2DFactory->CreateStrokeStyle(
-			                                              D2D1::StrokeStyleProperties(
-			                                                                          D2D1_CAP_STYLE_ROUND,
-			                                                                          D2D1_CAP_STYLE_ROUND,
-			                                                                          D2D1_CAP_STYLE_ROUND,
-			                                                                          D2D1_LINE_JOIN_MITER,
-			                                                                          10.0f,
-			                                                                          D2D1_DASH_STYLE_DASH_DOT,
-			                                                                          0.0f
-			                                                                         ),
-			                                              NULL,
-			                                              0,
-			                                              stroke_style_dashdot.GetAddressOf()
-			                                             );
+			const HRESULT hr = m_pRenderTarget->CreateSolidColorBrush(D2D1::ColorF(0.f, 0.f, 0.f), batch_brush.GetAddressOf());
 			if (FAILED(hr))
 			{
-				MessageBox(
-				           m_Hwnd,
-				           TEXT("CreateStrokeStyle DashDot Fail"),
-				           TEXT("Error"),
-				           MB_OK);
-				return NULL;
+				MessageBox(m_Hwnd, TEXT("Create Batch Brush Fail"), TEXT("Error"), MB_OK);
+				return nullptr;
 			}
 		}
-		return stroke_style_dashdot;
+		return batch_brush.Get();
 	}
 
-	ComPtr<ID2D1StrokeStyle> D2DGraphics::GetDashDotDotStyle()
+	void D2DGraphics::DrawPixels(
+		const int left,
+		const int top,
+		const int width,
+		const int height,
+		const void* pixels,
+		const size_t pitch)
 	{
-		if (stroke_style_dashdotdot == nullptr)
+		//Only grows, so one bitmap serves every size drawn so far
+		const D2D1_SIZE_U have = staging_bitmap ? staging_bitmap->GetPixelSize() : D2D1::SizeU(0, 0);
+		if (have.width < static_cast<UINT32>(width) || have.height < static_cast<UINT32>(height))
 		{
-			HRESULT hr = g_pD2DFactory->CreateStrokeStyle(
-			                                              D2D1::StrokeStyleProperties(
-			                                                                          D2D1_CAP_STYLE_ROUND,
-			                                                                          D2D1_CAP_STYLE_ROUND,
-			                                                                          D2D1_CAP_STYLE_ROUND,
-			                                                                          D2D1_LINE_JOIN_MITER,
-			                                                                          10.0f,
-			                                                                          D2D1_DASH_STYLE_DASH_DOT_DOT,
-			                                                                          0.0f
-			                                                                         ),
-			                                              NULL,
-			                                              0,
-			                                              stroke_style_dashdotdot.GetAddressOf()
-			                                             );
+			staging_bitmap.Reset();
+			const HRESULT hr = m_pRenderTarget->CreateBitmap(
+			                                                 D2D1::SizeU(
+			                                                             (std::max)(have.width, static_cast<UINT32>(width)),
+			                                                             (std::max)(have.height, static_cast<UINT32>(height))),
+			                                                 D2D1::BitmapProperties(
+			                                                                        D2D1::PixelFormat(
+			                                                                                          DXGI_FORMAT_B8G8R8A8_UNORM,
+			                                                                                          D2D1_ALPHA_MODE_PREMULTIPLIED)),
+			                                                 staging_bitmap.GetAddressOf());
 			if (FAILED(hr))
 			{
-				MessageBox(
-				           m_Hwnd,
-				           TEXT("CreateStrokeStyle DashDotDot Fail"),
-				           TEXT("Error"),
-				           MB_OK);
-				return NULL;
+				MessageBox(m_Hwnd, TEXT("Create Staging Bitmap Fail"), TEXT("Error"), MB_OK);
+				return;
 			}
 		}
-		return stroke_style_dashdotdot;
+		const D2D1_RECT_U area = D2D1::RectU(0, 0, static_cast<UINT32>(width), static_cast<UINT32>(height));
+		staging_bitmap->CopyFromMemory(&area, pixels, static_cast<UINT32>(pitch));
+		D2D1_MATRIX_3X2_F view;
+		DrawTarget()->GetTransform(&view);
+		DrawTarget()->SetTransform(D2D1::Matrix3x2F::Identity());
+		DrawTarget()->DrawBitmap(
+		                         staging_bitmap.Get(),
+		                         D2D1::RectF(
+		                                     static_cast<float>(left) / DPI_scaleX,
+		                                     static_cast<float>(top) / DPI_scaleY,
+		                                     static_cast<float>(left + width) / DPI_scaleX,
+		                                     static_cast<float>(top + height) / DPI_scaleY),
+		                         1.f,
+		                         D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR,
+		                         D2D1::RectF(0.f, 0.f, static_cast<float>(width), static_cast<float>(height)));
+		DrawTarget()->SetTransform(view);
+	}
+
+	ComPtr<ID2D1PathGeometry> D2DGraphics::CreatePolyGeometry(
+		const Point* points,
+		const size_t size,
+		const bool closed,
+		const FILL_MODE mode)
+	{
+		ComPtr<ID2D1PathGeometry> geometry;
+		HRESULT hr = g_pD2DFactory->CreatePathGeometry(geometry.GetAddressOf());
+		if (FAILED(hr))
+		{
+			MessageBox(
+			           m_Hwnd,
+			           TEXT("Create Geometry Fail"),
+			           TEXT("Error"),
+			           MB_OK);
+			return nullptr;
+		}
+		ComPtr<ID2D1GeometrySink> pSink;
+		hr = geometry->Open(pSink.GetAddressOf());
+		if (FAILED(hr))
+		{
+			MessageBox(
+			           m_Hwnd,
+			           TEXT("Open Geometry Fail"),
+			           TEXT("Error"),
+			           MB_OK);
+			return nullptr;
+		}
+		pSink->SetFillMode(mode == FILL_MODE::Winding ? D2D1_FILL_MODE_WINDING : D2D1_FILL_MODE_ALTERNATE);
+		pSink->BeginFigure(Point2D2D(points[0]), closed ? D2D1_FIGURE_BEGIN_FILLED : D2D1_FIGURE_BEGIN_HOLLOW);
+		//Points are handed over as they are, without a copy
+		static_assert(sizeof(Point) == sizeof(D2D1_POINT_2F), "Point matches D2D1_POINT_2F");
+		pSink->AddLines(reinterpret_cast<const D2D1_POINT_2F*>(points + 1), static_cast<UINT32>(size - 1));
+		pSink->EndFigure(closed ? D2D1_FIGURE_END_CLOSED : D2D1_FIGURE_END_OPEN);
+		pSink->Close();
+		return geometry;
 	}
 
-	ComPtr<ID2D1StrokeStyle> D2DGraphics::GetDotStyle()
+	ID2D1PathGeometry* D2DGraphics::GetPathGeometry(const Path& path)
 	{
-		if (stroke_style_dot == nullptr)
+		if (path.d2d_geometry)
+		{
+			return path.d2d_geometry.Get();
+		}
+		const soft::Figures& figures = path.figures;
+		ComPtr<ID2D1PathGeometry> geometry;
+		HRESULT hr = g_pD2DFactory->CreatePathGeometry(geometry.GetAddressOf());
+		if (FAILED(hr))
+		{
+			MessageBox(
+			           m_Hwnd,
+			           TEXT("Create Geometry Fail"),
+			           TEXT("Error"),
+			           MB_OK);
+			return nullptr;
+		}
+		ComPtr<ID2D1GeometrySink> pSink;
+		hr = geometry->Open(pSink.GetAddressOf());
+		if (FAILED(hr))
 		{
-			HRESULT hr = g_pD2DFactory->CreateStrokeStyle(
-			                                              D2D1::StrokeStyleProperties(
-			                                                                          D2D1_CAP_STYLE_ROUND,
-			                                                                          D2D1_CAP_STYLE_ROUND,
-			                                                                          D2D1_CAP_STYLE_ROUND,
-			                                                                          D2D1_LINE_JOIN_MITER,
-			                                                                          10.0f,
-			                                                                          D2D1_DASH_STYLE_DOT,
-			                                                                          0.0f
-			                                                                         ),
-			                                              NULL,
-			                                              0,
-			                                              stroke_style_dot.GetAddressOf()
-			                                             );
-			if (FAILED(hr))
-			{
-				MessageBox(m_Hwnd, TEXT("CreateStrokeStyle Fail"), TEXT("Error"), MB_OK);
-				return NULL;
-			}
+			MessageBox(
+			           m_Hwnd,
+			           TEXT("Open Geometry Fail"),
+			           TEXT("Error"),
+			           MB_OK);
+			return nullptr;
 		}
-		return stroke_style_dot;
-	}
-
-	ComPtr<ID2D1StrokeStyle> D2DGraphics::AutoGetStrokeStyle(const STROKE_STYLE style)
-	{
-		switch (style)
+		pSink->SetFillMode(path.fill_mode == FILL_MODE::Winding ? D2D1_FILL_MODE_WINDING : D2D1_FILL_MODE_ALTERNATE);
+		size_t begin = 0;
+		for (size_t i = 0; i < figures.ends.size(); i++)
 		{
-			case STROKE_STYLE::Dash:
-				return GetDashStyle();
-			case STROKE_STYLE::DashDot:
-				return GetDashDotStyle();
-			case STROKE_STYLE::DashDotDot:
-				return GetDashDotDotStyle();
-			case STROKE_STYLE::Dot:
-				return GetDotStyle();
-			case STROKE_STYLE::Soild:
-				return 0;
+			const size_t end = figures.ends[i];
+			pSink->BeginFigure(Point2D2D(figures.points[begin]), D2D1_FIGURE_BEGIN_FILLED);
+			pSink->AddLines(reinterpret_cast<const D2D1_POINT_2F*>(figures.points.data() + begin + 1),
+			                static_cast<UINT32>(end - begin - 1));
+			pSink->EndFigure(figures.closed[i] ? D2D1_FIGURE_END_CLOSED : D2D1_FIGURE_END_OPEN);
+			begin = end;
 		}
-		return nullptr;
+		pSink->Close();
+		path.d2d_geometry = geometry;
+		return geometry.Get();
 	}
 
 	DWORD D2DGraphics::InitWindow()
@@ -1030,13 +2897,24 @@ namespace graph
 		                       );
 		UpdateWindow(m_Hwnd);
 		ShowWindow(m_Hwnd, SW_SHOW);
-		InitD2D();
+		if (soft_canvas)
+		{
+			RECT rc;
+			GetClientRect(m_Hwnd, &rc);
+			soft_canvas->resize(rc.right - rc.left, rc.bottom - rc.top);
+		}
+		else
+		{
+			InitD2D();
+		}
 		InitScene();
 		if (!setting.Scenes.empty() && 0 <= setting.first_show_scene && setting.first_show_scene < setting.Scenes.size()
 		)
 		{
 			show_scene(setting.first_show_scene);
 		}
+		//Sleeps of a millisecond rather than the default 15.6 for the waits between frames
+		timeBeginPeriod(1);
 		MSG msg;
 		ZeroMemory(&msg, sizeof(msg));
 		while (msg.message != WM_QUIT)
@@ -1048,16 +2926,21 @@ namespace graph
 			}
 			else
 			{
-				if (current_scene && m_pRenderTarget->CheckWindowState() != D2D1_WINDOW_STATE_OCCLUDED)
+				const bool occluded = soft_canvas
+					                      ? IsIconic(m_Hwnd) != FALSE
+					                      : m_pRenderTarget->CheckWindowState() == D2D1_WINDOW_STATE_OCCLUDED;
+				if (!occluded)
+				{
+					render_paced_frame();
+				}
+				else
 				{
-					current_scene->update(this);
-					begin_draw();
-					current_scene->render(this);
-					frame_counter++;
-					end_draw();
+					//Nothing to draw, wake for messages or to look again now and then
+					MsgWaitForMultipleObjects(0, nullptr, FALSE, 50, QS_ALLINPUT);
 				}
 			}
 		}
+		timeEndPeriod(1);
 
 		return 0;
 	}
@@ -1074,6 +2957,8 @@ namespace graph
 					PAINTSTRUCT ps;
 					BeginPaint(hwnd, &ps);
 					EndPaint(hwnd, &ps);
+					//Shown again after being covered, what was on screen is gone
+					full_damage = true;
 					break;
 				}
 
@@ -1130,6 +3015,12 @@ namespace graph
 		return DefWindowProc(hwnd, message, wParam, lParam);
 	}
 
+	ID2D1RenderTarget* D2DGraphics::DrawTarget() const
+	{
+		//Only targets that were made get here, the others record into discarded
+		return target_scopes.empty() ? m_pRenderTarget.Get() : target_scopes.back().target->d2d_target;
+	}
+
 	bool D2DGraphics::InitD2D()
 	{
 		if (!m_pRenderTarget)
@@ -1145,7 +3036,11 @@ namespace graph
 			                                                                                    D2D1::SizeU(rc.right -
 			                                                                                                rc.left,
 			                                                                                                rc.bottom -
-			                                                                                                rc.top)
+			                                                                                                rc.top),
+			                                                                                    //Damage tracking draws over the last frame
+			                                                                                    frame_list
+				                                                                                    ? D2D1_PRESENT_OPTIONS_RETAIN_CONTENTS
+				                                                                                    : D2D1_PRESENT_OPTIONS_NONE
 			                                                                                   ),
 			                                                   m_pRenderTarget.GetAddressOf()
 			                                                  );
@@ -1162,6 +3057,7 @@ namespace graph
 		}
 		return true;
 	}
+#endif
 
 	void D2DGraphics::InitScene()
 	{
@@ -1180,12 +3076,17 @@ namespace graph
 		}
 	}
 
-	SolidBrush::SolidBrush(const Color color) : Brush(), color(color) {}
+	SolidBrush::SolidBrush(const Color color) : Brush(), color(color)
+	{
+		soft_paint = color;
+	}
 
 	SolidBrush::SolidBrush(SolidBrush&& preBrush) noexcept
 	{
 		preBrush.is_owner = false;
 		std::swap(d2d_brush, preBrush.d2d_brush);
+		std::swap(soft_paint, preBrush.soft_paint);
+		std::swap(soft_opacity, preBrush.soft_opacity);
 		std::swap(color, preBrush.color);
 	}
 
@@ -1195,11 +3096,235 @@ namespace graph
 		{
 			preBrush.is_owner = false;
 			std::swap(d2d_brush, preBrush.d2d_brush);
+			std::swap(soft_paint, preBrush.soft_paint);
+			std::swap(soft_opacity, preBrush.soft_opacity);
 			std::swap(color, preBrush.color);
 		}
 		return *this;
 	}
 
+	SpriteAtlas D2DGraphics::create_atlas(const AtlasBuilder& builder)
+	{
+		SpriteAtlas res;
+		for (size_t i = 0; i < builder.get_page_count(); i++)
+		{
+			const soft::Image& page = builder.get_page(i);
+			if (soft_canvas)
+			{
+				res.soft_pages.push_back(std::make_shared<const soft::Image>(page));
+				continue;
+			}
+			res.pages.push_back(create_image_from_memory(
+			                                             Size{static_cast<float>(page.width()), static_cast<float>(page.height())},
+			                                             page.row(0),
+			                                             static_cast<UINT>(page.pitch())));
+		}
+		res.regions = builder.get_regions();
+		return res;
+	}
+
+	void D2DGraphics::draw_sprites(const SpriteAtlas& atlas, const Sprite* sprites, const size_t count)
+	{
+		if (recording)
+		{
+			recording->draw_sprites(Keep(atlas), sprites, count);
+			return;
+		}
+		if (soft_canvas)
+		{
+			soft_canvas->draw_sprites(
+			                          atlas.soft_pages.data(),
+			                          atlas.soft_pages.size(),
+			                          atlas.regions.data(),
+			                          atlas.regions.size(),
+			                          sprites,
+			                          count);
+			return;
+		}
+#ifdef _WIN32
+		for (size_t i = 0; i < count; i++)
+		{
+			const Sprite& sprite = sprites[i];
+			if (sprite.index >= atlas.regions.size())
+			{
+				continue;
+			}
+			const AtlasRegion& region = atlas.regions[sprite.index];
+			if (region.page >= atlas.pages.size() || atlas.pages[region.page].d2d_bitmap == nullptr)
+			{
+				continue;
+			}
+			const D2D1_RECT_F source = D2D1::RectF(
+			                                       static_cast<float>(region.x),
+			                                       static_cast<float>(region.y),
+			                                       static_cast<float>(region.x + region.width),
+			                                       static_cast<float>(region.y + region.height));
+			DrawTarget()->DrawBitmap(
+			                         atlas.pages[region.page].d2d_bitmap,
+			                         Rect2D2D(sprite.rect),
+			                         sprite.opacity,
+			                         D2D1_BITMAP_INTERPOLATION_MODE_LINEAR,
+			                         source);
+		}
+#endif
+	}
+
+	RenderTarget D2DGraphics::create_render_target(const Size size)
+	{
+		RenderTarget res;
+		const int width = static_cast<int>(std::ceil(size.width));
+		const int height = static_cast<int>(std::ceil(size.height));
+		if (width <= 0 || height <= 0)
+		{
+			return res;
+		}
+		if (soft_canvas)
+		{
+			//The canvas borrows the pixels of the bitmap, which copies of it keep alive
+			auto image = std::make_shared<soft::Image>(width, height);
+			res.soft_canvas = std::make_unique<soft::Canvas>(0, 0);
+			res.soft_canvas->set_target(soft::Image::borrow(width, height, image->row(0), image->pitch(), nullptr));
+			res.bitmap.soft_image = std::move(image);
+			return res;
+		}
+#ifdef _WIN32
+		InitD2D();
+		if (SUCCEEDED(m_pRenderTarget->CreateCompatibleRenderTarget(Size2D2D(size), &res.d2d_target)))
+		{
+			res.d2d_target->GetBitmap(&res.bitmap.d2d_bitmap);
+			//A new target holds whatever the memory did
+			res.d2d_target->BeginDraw();
+			res.d2d_target->Clear(D2D1::ColorF(0.f, 0.f, 0.f, 0.f));
+			res.d2d_target->EndDraw();
+		}
+#endif
+		return res;
+	}
+
+	void D2DGraphics::begin_target(RenderTarget& target)
+	{
+		unlock_pixels();
+		//Drawing recorded so far may read the target's pixels
+		if (soft_canvas)
+		{
+			soft_canvas->flush();
+		}
+		target_scopes.push_back(TargetScope{&target, recording, std::move(outer_recordings)});
+		outer_recordings.clear();
+		recording = nullptr;
+		if (target.soft_canvas)
+		{
+			std::swap(soft_canvas, target.soft_canvas);
+			return;
+		}
+#ifdef _WIN32
+		if (target.d2d_target)
+		{
+			target.d2d_target->BeginDraw();
+			return;
+		}
+#endif
+		if (!discarded)
+		{
+			discarded = std::make_unique<CommandList>();
+		}
+		recording = discarded.get();
+	}
+
+	void D2DGraphics::end_target()
+	{
+		if (target_scopes.empty())
+		{
+			return;
+		}
+		unlock_pixels();
+		TargetScope scope = std::move(target_scopes.back());
+		target_scopes.pop_back();
+		RenderTarget& target = *scope.target;
+		if (recording == discarded.get() && discarded)
+		{
+			discarded->reset();
+		}
+		//Holds the outer canvas while its own is drawn into
+		else if (target.soft_canvas)
+		{
+			soft_canvas->flush();
+			std::swap(soft_canvas, target.soft_canvas);
+			target.bitmap.soft_image->discard_mips();
+		}
+#ifdef _WIN32
+		else if (target.d2d_target)
+		{
+			target.d2d_target->EndDraw();
+		}
+#endif
+		recording = scope.recording;
+		outer_recordings = std::move(scope.outer_recordings);
+	}
+
+	const Bitmap& D2DGraphics::render_to_bitmap(
+		Layer& layer,
+		const Size size,
+		const std::uint64_t key,
+		const std::function<void(D2DGraphics*)>& draw)
+	{
+		const bool sameSize = layer.size.width == size.width && layer.size.height == size.height;
+		if (layer.valid && layer.key == key && sameSize)
+		{
+			return layer.get_bitmap();
+		}
+		if (!sameSize || !(layer.target.soft_canvas || layer.target.d2d_target))
+		{
+			layer.target = create_render_target(size);
+		}
+		begin_target(layer.target);
+		clear(Color(0.f, 0.f, 0.f, 0.f));
+		draw(this);
+		end_target();
+		layer.size = size;
+		layer.key = key;
+		layer.valid = true;
+		invalidate();
+		return layer.get_bitmap();
+	}
+
+	RenderTarget::~RenderTarget()
+	{
+#ifdef _WIN32
+		SafeRelease(d2d_target);
+#endif
+	}
+
+	RenderTarget::RenderTarget(RenderTarget&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	RenderTarget& RenderTarget::operator=(RenderTarget&& other) noexcept
+	{
+		if (&other != this)
+		{
+			std::swap(bitmap, other.bitmap);
+			std::swap(soft_canvas, other.soft_canvas);
+			std::swap(d2d_target, other.d2d_target);
+		}
+		return *this;
+	}
+
+	Size RenderTarget::get_size() const
+	{
+		if (soft_canvas || d2d_target)
+		{
+			return bitmap.get_size();
+		}
+		return Size{0.f, 0.f};
+	}
+
+	Size SpriteAtlas::get_sprite_size(const size_t index) const
+	{
+		return Size{static_cast<float>(regions[index].width), static_cast<float>(regions[index].height)};
+	}
+
 	Color SolidBrush::get_color() const
 	{
 		return color;
@@ -1207,57 +3332,92 @@ namespace graph
 
 	Bitmap::Bitmap(const std::wstring& filePath, D2DGraphics& graphics)
 	{
-		LoadBitmapFromFile(
-		                   graphics.m_pRenderTarget.Get(),
-		                   g_pWICImagingFactory.Get(),
-		                   filePath.c_str(),
-		                   0,
-		                   0,
-		                   &d2d_bitmap);
+		*this = graphics.load_image_from_file(filePath);
 	}
 
 	Bitmap::~Bitmap()
 	{
+#ifdef _WIN32
 		if (is_owner)
 		{
 			SafeRelease(d2d_bitmap);
 		}
+#endif
+	}
+
+	Bitmap::Bitmap(const Bitmap& other) : d2d_bitmap(other.d2d_bitmap), soft_image(other.soft_image)
+	{
+#ifdef _WIN32
+		if (d2d_bitmap)
+		{
+			d2d_bitmap->AddRef();
+		}
+#endif
+	}
+
+	Bitmap& Bitmap::operator=(const Bitmap& other)
+	{
+		if (&other != this)
+		{
+			//The old bitmap goes with the copy
+			Bitmap copy(other);
+			std::swap(is_owner, copy.is_owner);
+			std::swap(d2d_bitmap, copy.d2d_bitmap);
+			std::swap(soft_image, copy.soft_image);
+		}
+		return *this;
 	}
 
 	Bitmap::Bitmap(Bitmap&& preBitmap) noexcept
 	{
 		preBitmap.is_owner = false;
 		std::swap(d2d_bitmap, preBitmap.d2d_bitmap);
+		std::swap(soft_image, preBitmap.soft_image);
 	}
 
 	Bitmap& Bitmap::operator=(Bitmap&& preBitmap) noexcept
 	{
 		if (&preBitmap != this)
 		{
-			preBitmap.is_owner = false;
+			//The old bitmap goes with preBitmap, shared ones must not leak
+			std::swap(is_owner, preBitmap.is_owner);
 			std::swap(d2d_bitmap, preBitmap.d2d_bitmap);
+			std::swap(soft_image, preBitmap.soft_image);
 		}
 		return *this;
 	}
 
 	Size Bitmap::get_size() const
 	{
+		if (soft_image)
+		{
+			return Size{static_cast<float>(soft_image->width()), static_cast<float>(soft_image->height())};
+		}
+#ifdef _WIN32
 		const D2D1_SIZE_F size = d2d_bitmap->GetSize();
 		return Size{size.width, size.height};
+#else
+		return Size{0.f, 0.f};
+#endif
 	}
 
 	Font::~Font()
 	{
+#ifdef _WIN32
 		if (is_owner)
 		{
 			SafeRelease(d2d_font);
 		}
+#endif
 	}
 
 	Font::Font(Font&& preFont) noexcept
 	{
 		preFont.is_owner = false;
 		std::swap(d2d_font, preFont.d2d_font);
+		std::swap(soft_name, preFont.soft_name);
+		std::swap(soft_size, preFont.soft_size);
+		std::swap(id, preFont.id);
 	}
 
 	Font& Font::operator=(Font&& preFont) noexcept
@@ -1266,36 +3426,250 @@ namespace graph
 		{
 			preFont.is_owner = false;
 			std::swap(d2d_font, preFont.d2d_font);
+			std::swap(soft_name, preFont.soft_name);
+			std::swap(soft_size, preFont.soft_size);
+			std::swap(id, preFont.id);
 		}
 		return *this;
 	}
 
 	std::wstring Font::get_name() const
 	{
+#ifndef _WIN32
+		return soft_name;
+#else
+		if (d2d_font == nullptr) { return soft_name; }
 		const size_t len = d2d_font->GetFontFamilyNameLength();
 		auto* buf = new WCHAR[len + 5];
 		d2d_font->GetFontFamilyName(buf, static_cast<UINT32>(len));
 		std::wstring name(buf);
 		delete[] buf;
 		return name;
+#endif
+	}
+
+	//Shared by all paths so a recorded one is never mistaken for what later took its place
+	std::atomic<std::uint64_t> g_path_revision{0};
+
+	Path::Path(const FILL_MODE mode) : fill_mode(mode), revision(++g_path_revision)
+	{
+	}
+
+	void Path::Changed()
+	{
+		revision = ++g_path_revision;
+		figures.stroked = false;
+#ifdef _WIN32
+		d2d_geometry.Reset();
+#endif
+	}
+
+	void GrowBounds(Rect& bounds, const Point point)
+	{
+		if (!(bounds.left <= bounds.right))
+		{
+			bounds = Rect{point.x, point.y, point.x, point.y};
+			return;
+		}
+		bounds.left = (std::min)(bounds.left, point.x);
+		bounds.top = (std::min)(bounds.top, point.y);
+		bounds.right = (std::max)(bounds.right, point.x);
+		bounds.bottom = (std::max)(bounds.bottom, point.y);
+	}
+
+	Path& Path::move_to(const Point point)
+	{
+		figures.points.push_back(point);
+		figures.ends.push_back(figures.points.size());
+		figures.closed.push_back(0);
+		GrowBounds(figures.bounds, point);
+		building = true;
+		Changed();
+		return *this;
+	}
+
+	Path& Path::line_to(const Point point)
+	{
+		if (!building)
+		{
+			return move_to(point);
+		}
+		figures.points.push_back(point);
+		figures.ends.back() = figures.points.size();
+		GrowBounds(figures.bounds, point);
+		Changed();
+		return *this;
+	}
+
+	Path& Path::close()
+	{
+		if (building)
+		{
+			figures.closed.back() = 1;
+			building = false;
+			Changed();
+		}
+		return *this;
+	}
+
+	void Path::clear()
+	{
+		figures.clear();
+		building = false;
+		Changed();
+	}
+
+	bool Path::empty() const
+	{
+		return figures.points.empty();
+	}
+
+	Rect Path::get_bounds() const
+	{
+		return figures.bounds;
+	}
+
+	FILL_MODE Path::get_fill_mode() const
+	{
+		return fill_mode;
+	}
+
+	void Path::set_fill_mode(const FILL_MODE mode)
+	{
+		if (mode != fill_mode)
+		{
+			fill_mode = mode;
+			Changed();
+		}
+	}
+
+	void D2DGraphics::begin_record(CommandList& list)
+	{
+		if (recording)
+		{
+			outer_recordings.push_back(recording);
+		}
+		recording = &list;
+	}
+
+	void D2DGraphics::end_record()
+	{
+		if (outer_recordings.empty())
+		{
+			recording = nullptr;
+			return;
+		}
+		recording = outer_recordings.back();
+		outer_recordings.pop_back();
+	}
+
+	bool D2DGraphics::start_capture(const std::wstring& path, const CAPTURE_FORMAT format)
+	{
+		stop_capture();
+		if (soft_canvas == nullptr)
+		{
+			return false;
+		}
+		const soft::Image& frame = soft_canvas->get_target();
+		auto made = std::make_unique<FrameCapture>(
+		                                           path,
+		                                           format,
+		                                           frame.width(),
+		                                           frame.height(),
+		                                           setting.capture_frame_rate,
+		                                           setting.capture_buffers);
+		if (!made->is_open())
+		{
+			return false;
+		}
+		capture = std::move(made);
+		return true;
+	}
+
+	void D2DGraphics::stop_capture()
+	{
+		if (capture)
+		{
+			capture->stop();
+			last_capture_stats = capture->get_stats();
+			capture.reset();
+		}
+	}
+
+	CaptureStats D2DGraphics::get_capture_stats() const
+	{
+		return capture ? capture->get_stats() : last_capture_stats;
+	}
+
+	void D2DGraphics::draw_list(const CommandList& list)
+	{
+		//Drawing a list into itself would never end
+		if (recording == &list)
+		{
+			return;
+		}
+		list.replay(*this);
 	}
 
 	SolidBrush D2DGraphics::create_solidbrush(const Color color)
 	{
 		SolidBrush solidBrush(color);
+		if (soft_canvas)
+		{
+			return solidBrush;
+		}
+#ifdef _WIN32
 		InitD2D();
 		m_pRenderTarget->CreateSolidColorBrush(
 		                                       Color2D2D(color),
 		                                       reinterpret_cast<ID2D1SolidColorBrush**>(&solidBrush.d2d_brush));
+#endif
 		return solidBrush;
 	}
 
 	const SolidBrush& D2DGraphics::get_solidbrush(const Color color)
 	{
-		if (brushes.find(color) == brushes.end())
-		{
-			brushes[color] = std::make_unique<SolidBrush>(create_solidbrush(color));
-		}
-		return *brushes[color];
+		return brushes->get(color, *this, frame_counter);
+	}
+
+	BrushCacheStats D2DGraphics::get_brush_cache_stats() const
+	{
+		return brushes->get_stats();
+	}
+
+	void D2DGraphics::reset_brush_cache_stats()
+	{
+		brushes->reset_stats();
+	}
+
+	TextLayoutCacheStats D2DGraphics::get_text_layout_cache_stats() const
+	{
+#ifdef _WIN32
+		return text_layouts->get_stats();
+#else
+		return TextLayoutCacheStats();
+#endif
+	}
+
+	void D2DGraphics::reset_text_layout_cache_stats()
+	{
+#ifdef _WIN32
+		text_layouts->reset_stats();
+#endif
+	}
+
+	ImageCacheStats D2DGraphics::get_image_cache_stats() const
+	{
+		return images->get_stats();
+	}
+
+	void D2DGraphics::reset_image_cache_stats()
+	{
+		images->reset_stats();
+	}
+
+	void D2DGraphics::clear_image_cache()
+	{
+		images->clear();
 	}
 }
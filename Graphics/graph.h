@@ -1,28 +1,51 @@
 #pragma once
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN             //  Windows ͷļųʹõ
 #pragma comment(lib, "d2d1.lib")
 #pragma comment(lib, "dwrite.lib")
+#pragma comment(lib, "winmm.lib")
+#endif
 #include <atomic>
+#include <cstdint>
 #include <condition_variable>
 #include <functional>
-#include <d2d1.h>
-#include <dwrite.h>
+#include <limits>
 #include <map>
+#include <memory>
 #include <string>
-#include <wincodec.h>
+#include <thread>
 #include <vector>
+#ifdef _WIN32
+#include <d2d1.h>
+#include <dwrite.h>
+#include <wincodec.h>
 #include <wrl/client.h>
 #include "Keyboard.h"
+#else
+#include "win_compat.h"
+#endif
+#include "graph_types.h"
+#include "soft_canvas.h"
 #ifndef UNICODE
 #define UNICODE
 #endif
 
 namespace graph
 {
-	constexpr float TWO_PI = 6.28318530718f;
-	constexpr float PI =  3.1415926535f;
-	
 	class D2DGraphics;
+	class CommandList;
+	class BrushCache;
+	class ImageCache;
+	class FrameCapture;
+	class FrameScheduler;
+	template <typename Layout>
+	class TextLayoutCache;
+	class AtlasBuilder;
+	namespace soft
+	{
+		class JobQueue;
+		class TaskPool;
+	}
 
 	class Scene
 	{
@@ -30,7 +53,16 @@ namespace graph
 		virtual ~Scene() = default;
 		virtual void init(D2DGraphics*) = 0;
 		virtual void update(D2DGraphics*) = 0;
-		virtual void render(D2DGraphics*) = 0;
+		virtual void render(D2DGraphics*) {}
+
+		//What D2DGraphics calls. alpha is how far the frame is from the last update towards the
+		//next, from 0 to 1, to draw what moves between its last two states. 1 when updates
+		//are not fixed, see GraphSetting::update_rate
+		virtual void render(D2DGraphics* graphics, float alpha)
+		{
+			(void)alpha;
+			render(graphics);
+		}
 	};
 
 	struct GraphSetting
@@ -58,191 +90,74 @@ namespace graph
 		};
 
 		INIT_OPTION Init_option = INIT_OPTION::INIT_ALL_SCENE_BEFORE_RUN;
-	};
-	
-	typedef std::function<void()> proc;
 
-	struct Point
-	{
-		float x, y;
-	};
-
-	struct Size
-	{
-		float width, height;
-	};
-
-	struct Rect
-	{
-		float left, top, right, bottom;
-	};
+		enum class BACKEND
+		{
+			Direct2D,
+			//CPU rasterizer drawing into an in-memory BGRA8 premultiplied framebuffer
+			Software
+		};
 
-	struct Ellipse
-	{
-		Point center;
-		float radius_x, radius_y;
-	};
+#ifdef _WIN32
+		BACKEND backend = BACKEND::Direct2D;
 
-	enum class COLORS
-	{
-		AliceBlue = 0xF0F8FF,
-		AntiqueWhite = 0xFAEBD7,
-		Aqua = 0x00FFFF,
-		Aquamarine = 0x7FFFD4,
-		Azure = 0xF0FFFF,
-		Beige = 0xF5F5DC,
-		Bisque = 0xFFE4C4,
-		Black = 0x000000,
-		BlanchedAlmond = 0xFFEBCD,
-		Blue = 0x0000FF,
-		BlueViolet = 0x8A2BE2,
-		Brown = 0xA52A2A,
-		BurlyWood = 0xDEB887,
-		CadetBlue = 0x5F9EA0,
-		Chartreuse = 0x7FFF00,
-		Chocolate = 0xD2691E,
-		Coral = 0xFF7F50,
-		CornflowerBlue = 0x6495ED,
-		Cornsilk = 0xFFF8DC,
-		Crimson = 0xDC143C,
-		Cyan = 0x00FFFF,
-		DarkBlue = 0x00008B,
-		DarkCyan = 0x008B8B,
-		DarkGoldenrod = 0xB8860B,
-		DarkGray = 0xA9A9A9,
-		DarkGreen = 0x006400,
-		DarkKhaki = 0xBDB76B,
-		DarkMagenta = 0x8B008B,
-		DarkOliveGreen = 0x556B2F,
-		DarkOrange = 0xFF8C00,
-		DarkOrchid = 0x9932CC,
-		DarkRed = 0x8B0000,
-		DarkSalmon = 0xE9967A,
-		DarkSeaGreen = 0x8FBC8F,
-		DarkSlateBlue = 0x483D8B,
-		DarkSlateGray = 0x2F4F4F,
-		DarkTurquoise = 0x00CED1,
-		DarkViolet = 0x9400D3,
-		DeepPink = 0xFF1493,
-		DeepSkyBlue = 0x00BFFF,
-		DimGray = 0x696969,
-		DodgerBlue = 0x1E90FF,
-		Firebrick = 0xB22222,
-		FloralWhite = 0xFFFAF0,
-		ForestGreen = 0x228B22,
-		Fuchsia = 0xFF00FF,
-		Gainsboro = 0xDCDCDC,
-		GhostWhite = 0xF8F8FF,
-		Gold = 0xFFD700,
-		Goldenrod = 0xDAA520,
-		Gray = 0x808080,
-		Green = 0x008000,
-		GreenYellow = 0xADFF2F,
-		Honeydew = 0xF0FFF0,
-		HotPink = 0xFF69B4,
-		IndianRed = 0xCD5C5C,
-		Indigo = 0x4B0082,
-		Ivory = 0xFFFFF0,
-		Khaki = 0xF0E68C,
-		Lavender = 0xE6E6FA,
-		LavenderBlush = 0xFFF0F5,
-		LawnGreen = 0x7CFC00,
-		LemonChiffon = 0xFFFACD,
-		LightBlue = 0xADD8E6,
-		LightCoral = 0xF08080,
-		LightCyan = 0xE0FFFF,
-		LightGoldenrodYellow = 0xFAFAD2,
-		LightGreen = 0x90EE90,
-		LightGray = 0xD3D3D3,
-		LightPink = 0xFFB6C1,
-		LightSalmon = 0xFFA07A,
-		LightSeaGreen = 0x20B2AA,
-		LightSkyBlue = 0x87CEFA,
-		LightSlateGray = 0x778899,
-		LightSteelBlue = 0xB0C4DE,
-		LightYellow = 0xFFFFE0,
-		Lime = 0x00FF00,
-		LimeGreen = 0x32CD32,
-		Linen = 0xFAF0E6,
-		Magenta = 0xFF00FF,
-		Maroon = 0x800000,
-		MediumAquamarine = 0x66CDAA,
-		MediumBlue = 0x0000CD,
-		MediumOrchid = 0xBA55D3,
-		MediumPurple = 0x9370DB,
-		MediumSeaGreen = 0x3CB371,
-		MediumSlateBlue = 0x7B68EE,
-		MediumSpringGreen = 0x00FA9A,
-		MediumTurquoise = 0x48D1CC,
-		MediumVioletRed = 0xC71585,
-		MidnightBlue = 0x191970,
-		MintCream = 0xF5FFFA,
-		MistyRose = 0xFFE4E1,
-		Moccasin = 0xFFE4B5,
-		NavajoWhite = 0xFFDEAD,
-		Navy = 0x000080,
-		OldLace = 0xFDF5E6,
-		Olive = 0x808000,
-		OliveDrab = 0x6B8E23,
-		Orange = 0xFFA500,
-		OrangeRed = 0xFF4500,
-		Orchid = 0xDA70D6,
-		PaleGoldenrod = 0xEEE8AA,
-		PaleGreen = 0x98FB98,
-		PaleTurquoise = 0xAFEEEE,
-		PaleVioletRed = 0xDB7093,
-		PapayaWhip = 0xFFEFD5,
-		PeachPuff = 0xFFDAB9,
-		Peru = 0xCD853F,
-		Pink = 0xFFC0CB,
-		Plum = 0xDDA0DD,
-		PowderBlue = 0xB0E0E6,
-		Purple = 0x800080,
-		Red = 0xFF0000,
-		RosyBrown = 0xBC8F8F,
-		RoyalBlue = 0x4169E1,
-		SaddleBrown = 0x8B4513,
-		Salmon = 0xFA8072,
-		SandyBrown = 0xF4A460,
-		SeaGreen = 0x2E8B57,
-		SeaShell = 0xFFF5EE,
-		Sienna = 0xA0522D,
-		Silver = 0xC0C0C0,
-		SkyBlue = 0x87CEEB,
-		SlateBlue = 0x6A5ACD,
-		SlateGray = 0x708090,
-		Snow = 0xFFFAFA,
-		SpringGreen = 0x00FF7F,
-		SteelBlue = 0x4682B4,
-		Tan = 0xD2B48C,
-		Teal = 0x008080,
-		Thistle = 0xD8BFD8,
-		Tomato = 0xFF6347,
-		Turquoise = 0x40E0D0,
-		Violet = 0xEE82EE,
-		Wheat = 0xF5DEB3,
-		White = 0xFFFFFF,
-		WhiteSmoke = 0xF5F5F5,
-		Yellow = 0xFFFF00,
-		YellowGreen = 0x9ACD32,
-	};
+		//No window is created, frames are driven by render_frame, implies BACKEND::Software
+		bool headless = false;
+#else
+		BACKEND backend = BACKEND::Software;
 
-	struct ColorBGRA8bit
-	{
-		UINT8 b, g, r, a;
-	};
+		bool headless = true;
+#endif
 
-	struct Color
-	{
-		float red, green, blue, alpha;
-		Color(UINT8, UINT8, UINT8, UINT8);
-		Color(float, float, float, float);
-		Color(COLORS, float = 1.0f);
+		//Threads the software backend draws with, 0 uses every core, 1 draws on the render thread
+		unsigned int render_threads = 0;
 
-		bool operator<(const Color& c) const;
+		enum class DAMAGE_TRACKING
+		{
+			//Every frame is drawn whole
+			Off,
+			//Only what D2DGraphics::invalidate marked is drawn again
+			Manual,
+			//Also where the drawing calls differ from the last frame's, see CommandList::diff
+			Diff
+		};
 
-		bool operator==(const Color& c) const;
+		//Other than Off, the render of a frame is recorded and drawn again clipped to what changed,
+		//a frame where nothing changed is not drawn or presented. Each frame starts with a reset
+		//view, and should paint over what it owns, for instance starting with clear.
+		//The recording keeps its own copies of the bitmaps, atlases, fonts and paths drawn, so those
+		//may be locals of render. Pixels given to update_image are copied too.
+		DAMAGE_TRACKING damage_tracking = DAMAGE_TRACKING::Off;
+
+		//Brushes get_solidbrush keeps, more are kept while all are used in the same frame
+		size_t brush_cache_size = 1024;
+
+		//Estimated bytes of the text layouts draw_text keeps for text it draws again
+		size_t text_layout_cache_bytes = 8 << 20;
+
+		//Threads load_image_async decodes with, started with the first load
+		unsigned int image_load_threads = 2;
+
+		//Bytes of pixels load_image_from_file and load_image_async keep for files loaded again, 0 keeps none
+		size_t image_cache_bytes = 256 << 20;
+
+		//Frames start_capture can hold while they wait to be written, each the size of the framebuffer
+		size_t capture_buffers = 4;
+		//Frames a second written in Y4M headers
+		unsigned int capture_frame_rate = 60;
+
+		//Frames a second the window's loop waits for between frames, 0 draws as fast as it can
+		float target_fps = 60.f;
+		//Scene::update calls a second of the window's loop, each standing for the same step of time,
+		//as many a frame as the time passed calls for. 0 updates once a frame
+		float update_rate = 60.f;
+		//Most updates a frame catching up, time past them is dropped so the scenes slow down instead
+		unsigned int max_updates_per_frame = 5;
+		//Milliseconds at the end of a wait spent spinning rather than sleeping, as sleeps oversleep
+		float spin_wait_ms = 2.f;
 	};
+	
+	typedef std::function<void()> proc;
 
 	class Brush
 	{
@@ -250,7 +165,11 @@ namespace graph
 		// ID2D1Brush* Ȩ
 		bool is_owner = true;
 		ID2D1Brush* d2d_brush = nullptr;
+		//Used by the software backend
+		Color soft_paint{0.f, 0.f, 0.f, 0.f};
+		float soft_opacity = 1.f;
 		friend D2DGraphics;
+		friend CommandList;
 	public:
 		Brush() = default;
 		~Brush();
@@ -279,29 +198,111 @@ namespace graph
 		Color get_color() const;
 	};
 
+	//Copies share the bitmap, which lives until the last of them is gone
 	class Bitmap
 	{
 		bool is_owner = true;
 		ID2D1Bitmap* d2d_bitmap = nullptr;
+		std::shared_ptr<soft::Image> soft_image;
 		friend D2DGraphics;
 	public:
 		Bitmap() = default;
 		Bitmap(const std::wstring&, D2DGraphics&);
 		~Bitmap();
-		Bitmap(const Bitmap&) = delete;
+		Bitmap(const Bitmap&);
 		Bitmap(Bitmap&&) noexcept;
-		Bitmap& operator=(const Bitmap&) = delete;
+		Bitmap& operator=(const Bitmap&);
 		Bitmap& operator=(Bitmap&&) noexcept;
 		Size get_size() const;
 	};
 
-	enum class STROKE_STYLE
+	enum class LOAD_STATE
+	{
+		Pending,
+		Ready,
+		Failed
+	};
+
+	//An image load_image_async is loading, copies share the load.
+	//State and bitmap only change at the start of a frame, on the render thread
+	class ImageLoad
+	{
+		struct State;
+		std::shared_ptr<State> state;
+		friend D2DGraphics;
+	public:
+		//Failed for a handle not from load_image_async
+		LOAD_STATE get_state() const;
+		//Empty until Ready
+		const Bitmap& get_bitmap() const;
+	};
+
+	//Pages of an AtlasBuilder made into bitmaps by D2DGraphics::create_atlas, for draw_sprites
+	class SpriteAtlas
+	{
+		std::vector<Bitmap> pages;
+		std::vector<std::shared_ptr<const soft::Image>> soft_pages;
+		std::vector<AtlasRegion> regions;
+		friend D2DGraphics;
+	public:
+		size_t get_sprite_count() const { return regions.size(); }
+		Size get_sprite_size(size_t index) const;
+	};
+
+	//A bitmap fed by a producer thread, made by D2DGraphics::create_image_stream. The producer
+	//writes the next frame into a back buffer while the bitmap is drawn, and update_image copies
+	//what it changed into the bitmap. The back buffer keeps its pixels, a frame only has to
+	//write where it differs from the last.
+	class ImageStream
+	{
+		struct Back;
+		std::shared_ptr<Back> back;
+		Bitmap bitmap;
+		friend D2DGraphics;
+	public:
+		//Producer side, from one thread at a time. The back buffer, locked until end_write
+		PixelLock begin_write();
+		//Hands over what was written, dirty is where in pixels
+		void end_write(Rect dirty);
+
+		const Bitmap& get_bitmap() const { return bitmap; }
+	};
+
+	//An offscreen bitmap made by D2DGraphics::create_render_target. Drawing calls between
+	//D2DGraphics::begin_target and end_target go into it, then its bitmap is drawn like any other
+	class RenderTarget
+	{
+		Bitmap bitmap;
+		//Software: draws into the pixels of bitmap
+		std::unique_ptr<soft::Canvas> soft_canvas;
+		ID2D1BitmapRenderTarget* d2d_target = nullptr;
+		friend D2DGraphics;
+	public:
+		RenderTarget() = default;
+		~RenderTarget();
+		RenderTarget(const RenderTarget&) = delete;
+		RenderTarget(RenderTarget&&) noexcept;
+		RenderTarget& operator=(const RenderTarget&) = delete;
+		RenderTarget& operator=(RenderTarget&&) noexcept;
+
+		//Shares the pixels, drawing into the target again changes every copy
+		const Bitmap& get_bitmap() const { return bitmap; }
+		Size get_size() const;
+	};
+
+	//A RenderTarget kept by D2DGraphics::render_to_bitmap and drawn again only when its key,
+	//standing for what went into it, or its size changes, or after invalidate
+	class Layer
 	{
-		Soild,
-		Dash,
-		DashDot,
-		DashDotDot,
-		Dot
+		RenderTarget target;
+		Size size{0.f, 0.f};
+		std::uint64_t key = 0;
+		bool valid = false;
+		friend D2DGraphics;
+	public:
+		void invalidate() { valid = false; }
+		bool is_valid() const { return valid; }
+		const Bitmap& get_bitmap() const { return target.get_bitmap(); }
 	};
 
 	enum class FONT_WEIGHT
@@ -365,6 +366,10 @@ namespace graph
 	{
 		bool is_owner = true;
 		IDWriteTextFormat* d2d_font = nullptr;
+		std::wstring soft_name;
+		float soft_size = 0.f;
+		//Tells fonts apart in the layout cache, an address could be reused
+		std::uint64_t id = 0;
 		friend D2DGraphics;
 		Font() = default;
 	public:
@@ -376,6 +381,43 @@ namespace graph
 		std::wstring get_name() const;
 	};
 
+	//Figures of straight lines built once and drawn any number of times with fill_path and draw_path.
+	//What the backends prepare from it, the Direct2D geometry, the bounds and the last stroke
+	//outline, is kept on it until it changes.
+	class Path
+	{
+		mutable soft::Figures figures;
+		FILL_MODE fill_mode;
+		//Whether line_to adds to the last figure
+		bool building = false;
+		//Changes on every edit, no two paths share one
+		std::uint64_t revision;
+#ifdef _WIN32
+		mutable Microsoft::WRL::ComPtr<ID2D1PathGeometry> d2d_geometry;
+#endif
+		void Changed();
+		friend D2DGraphics;
+		friend CommandList;
+	public:
+		explicit Path(FILL_MODE = FILL_MODE::Alternate);
+
+		//Starts a figure
+		Path& move_to(Point);
+		//Starts a figure when none is, like move_to
+		Path& line_to(Point);
+		//Joins the figure back to its start, the next one needs a move_to
+		Path& close();
+
+		void clear();
+		bool empty() const;
+
+		//Inverted, right left of left, while empty
+		Rect get_bounds() const;
+
+		FILL_MODE get_fill_mode() const;
+		void set_fill_mode(FILL_MODE);
+	};
+
 	class D2DGraphics
 	{
 		friend Bitmap;
@@ -385,16 +427,77 @@ namespace graph
 		//std::condition_variable running;
 		//std::mutex running_mutex;
 
+#ifdef _WIN32
 		std::unique_ptr<DirectX::Keyboard> m_keyboard = std::make_unique<DirectX::Keyboard>();
+#endif
 		
-		std::atomic_flag in_drawing;
+		std::atomic_flag in_drawing = ATOMIC_FLAG_INIT;
 
 		std::thread win_thread;
 
 		bool has_began_draw = false;
 
-		std::atomic_flag can_pause;
+		std::atomic_flag can_pause = ATOMIC_FLAG_INIT;
+
+		//Set for BACKEND::Software, every drawing call goes here instead of Direct2D
+		std::unique_ptr<soft::Canvas> soft_canvas;
+
+		//What lock_pixels handed out, bits is nullptr while unlocked
+		PixelLock locked_pixels;
+
+		//Set between begin_record and end_record, drawing calls go here instead
+		CommandList* recording = nullptr;
+		//Lists being recorded when begin_record was called again
+		std::vector<CommandList*> outer_recordings;
+
+		//What begin_target set aside, restored by end_target
+		struct TargetScope
+		{
+			RenderTarget* target;
+			CommandList* recording;
+			std::vector<CommandList*> outer_recordings;
+		};
+
+		std::vector<TargetScope> target_scopes;
+		//Takes the drawing into a target that could not be made
+		std::unique_ptr<CommandList> discarded;
+
+		//This frame and the last one with damage tracking
+		std::unique_ptr<CommandList> frame_list, last_frame_list;
+
+		//Copies frame_list records in place of the bitmaps, atlases, fonts and paths render draws,
+		//which may be locals gone by the time the list is drawn. Found again by the image, font id
+		//or path revision they copy, so what the last frame drew keeps its address for the diff
+		struct FrameResources
+		{
+			std::map<const void*, std::unique_ptr<Bitmap>> bitmaps;
+			std::map<const void*, std::unique_ptr<SpriteAtlas>> atlases;
+			std::map<std::uint64_t, std::unique_ptr<Font>> fonts;
+			std::map<std::uint64_t, std::unique_ptr<Path>> paths;
+		};
+
+		//Those of frame_list, and those only last_frame_list still points at
+		FrameResources frame_resources, last_frame_resources;
+
+		//While frame_list records, the copy kept for what is drawn, otherwise it as it is
+		Bitmap& Keep(Bitmap& bitmap);
+		const Bitmap& Keep(const Bitmap& bitmap);
+		const SpriteAtlas& Keep(const SpriteAtlas& atlas);
+		const Font& Keep(const Font& font);
+		const Path& Keep(const Path& path);
+		//Marked by invalidate or found by diffing, in DIPs
+		std::vector<Rect> damage;
+		bool full_damage = true;
+		//What the current frame draws and presents in device pixels, empty for all of it
+		std::vector<soft::IntRect> damage_boxes;
+
+		//Renders the frame after its updates
+		void RenderDamage(float alpha);
+
+		//Turns damage into a few disjoint boxes, false if nothing has to be drawn
+		bool MergeDamage();
 		
+#ifdef _WIN32
 		HWND m_Hwnd = NULL;
 		HANDLE m_winHandle = NULL;
 
@@ -408,31 +511,65 @@ namespace graph
 
 		bool InitD2D();
 
-		void InitScene();
+		//Where drawing goes, the window or the target of begin_target
+		ID2D1RenderTarget* DrawTarget() const;
 
 		bool GetSolidColorBrush(const Color& color, ID2D1SolidColorBrush*& solidBrush);
 
 		bool Resize(unsigned width, unsigned height);
 
-		Microsoft::WRL::ComPtr<ID2D1StrokeStyle> stroke_style_dash;
-		Microsoft::WRL::ComPtr<ID2D1StrokeStyle> stroke_style_dashdot;
-		Microsoft::WRL::ComPtr<ID2D1StrokeStyle> stroke_style_dashdotdot;
-		Microsoft::WRL::ComPtr<ID2D1StrokeStyle> stroke_style_dot;
+		//Copy a box of the software framebuffer to the window
+		void PresentSoftCanvas(const soft::IntRect& box);
 
-		Microsoft::WRL::ComPtr<ID2D1StrokeStyle> GetDashStyle();
+		//Backing of lock_pixels for Direct2D
+		std::vector<std::uint32_t> staging_pixels;
+		//Scattered points of set_pixels for Direct2D
+		std::vector<std::uint32_t> scatter_pixels;
+		Microsoft::WRL::ComPtr<ID2D1Bitmap> staging_bitmap;
 
-		Microsoft::WRL::ComPtr<ID2D1StrokeStyle> GetDashDotStyle();
+		//Recolored for every shape of a batch with per-shape colors
+		Microsoft::WRL::ComPtr<ID2D1SolidColorBrush> batch_brush;
 
-		Microsoft::WRL::ComPtr<ID2D1StrokeStyle> GetDashDotDotStyle();
+		ID2D1SolidColorBrush* GetBatchBrush();
 
-		Microsoft::WRL::ComPtr<ID2D1StrokeStyle> GetDotStyle();
+		//Draws premultiplied pixels 1:1 at left, top in device pixels, ignoring the view
+		void DrawPixels(int left, int top, int width, int height, const void* pixels, size_t pitch);
 
-		Microsoft::WRL::ComPtr<ID2D1StrokeStyle> AutoGetStrokeStyle(const STROKE_STYLE style);
+		//set_pixels for Direct2D, premultiply(i) gives the pixel of points[i]
+		template <typename Premultiply>
+		void ScatterPixels(const Point* points, size_t count, Premultiply premultiply);
 
-		float DPI_scaleX = 1.f;
-		float DPI_scaleY = 1.f;
+		std::map<StrokeStyle, Microsoft::WRL::ComPtr<ID2D1StrokeStyle>> stroke_styles;
+
+		//nullptr for the default solid style, each distinct style is created once
+		Microsoft::WRL::ComPtr<ID2D1StrokeStyle> GetStrokeStyle(const StrokeStyle& style);
+
+		//Cached by everything it depends on, valid until the next call
+		IDWriteTextLayout* GetTextLayout(
+			const std::wstring& text,
+			const Font& font,
+			float width,
+			float height,
+			TEXT_ALIGN_HORIZONTAL alignHorizontal,
+			TEXT_ALIGN_VERTICAL alignVertical);
+
+		std::vector<DWRITE_LINE_METRICS> measure_line_metrics;
+
+		//One figure through the points, closed and filled for fill_poly, open for draw_polyline
+		Microsoft::WRL::ComPtr<ID2D1PathGeometry> CreatePolyGeometry(const Point*, size_t, bool closed, FILL_MODE);
+
+		//Created on first use and kept on the path
+		ID2D1PathGeometry* GetPathGeometry(const Path&);
 
 		void InitializeDPIScale(const HWND hwnd);
+#endif
+
+		void InitScene();
+
+		static soft::Pixel SoftPaint(const Brush& brush);
+
+		float DPI_scaleX = 1.f;
+		float DPI_scaleY = 1.f;
 
 		template <typename T>
 		Point PixelsToDips(T x, T y)
@@ -452,13 +589,46 @@ namespace graph
 
 		Scene* current_scene = nullptr;
 
-		std::map<Color, std::unique_ptr<SolidBrush>> brushes;
+		std::unique_ptr<BrushCache> brushes;
+
+		//Lines of measure_text on the software backend
+		std::vector<soft::TextLine> measure_lines;
+
+#ifdef _WIN32
+		std::unique_ptr<TextLayoutCache<Microsoft::WRL::ComPtr<IDWriteTextLayout>>> text_layouts;
+#endif
+
+		//Loads the workers have decoded, shared with them so they never touch this object
+		struct DecodedImages;
+		std::shared_ptr<DecodedImages> decoded_images;
+		std::unique_ptr<soft::JobQueue> image_loader;
+
+		//Bitmaps of files by canonical path and time written
+		std::unique_ptr<ImageCache> images;
+
+		//Made by the first render_paced_frame
+		std::unique_ptr<FrameScheduler> scheduler;
+		void RenderFrame(unsigned updates, float alpha);
+
+		//Set between start_capture and stop_capture, stats of the last one after
+		std::unique_ptr<FrameCapture> capture;
+		CaptureStats last_capture_stats;
+		Bitmap LoadImageFile(const std::wstring&);
+
+		//Creates the bitmaps of what has been decoded since the last call
+		void UploadDecodedImages();
+
+		//Threads converting big images from other pixel formats, made by the first one
+		std::unique_ptr<soft::TaskPool> convert_pool;
+		soft::TaskPool* ConvertPool(size_t pixels);
 
 		void begin_draw();
 		void end_draw();
 	public:
 
+#ifdef _WIN32
 		DirectX::Keyboard::State get_keyboard_state();
+#endif
 		
 		//Only useful with using bind_rander_proc
 		ULONGLONG get_frame_counter();
@@ -475,6 +645,20 @@ namespace graph
 		D2DGraphics(D2DGraphics&&) noexcept = default;
 		D2DGraphics& operator=(D2DGraphics&&) noexcept = default;
 
+		//Runs one update and render of the current scene,
+		//headless programs call this instead of having a window loop
+		void render_frame();
+
+		//What the window's loop runs: waits until the next frame is due by GraphSetting::target_fps,
+		//runs the fixed updates the time since the last frame calls for, then renders with their alpha
+		void render_paced_frame();
+
+		//Seconds each Scene::update stands for with fixed updates, 0 without
+		float get_update_step() const;
+
+		//The software backend's BGRA8 premultiplied framebuffer, nullptr with Direct2D
+		const soft::Image* get_framebuffer() const;
+
 		void clear(Color color);
 
 		void draw_line(Point, Point, const Brush&, float = 1.f, STROKE_STYLE = STROKE_STYLE::Soild);
@@ -485,9 +669,27 @@ namespace graph
 		void draw_ellipse(Rect, const Brush&, float = 1.f, STROKE_STYLE = STROKE_STYLE::Soild);
 		void draw_poly(const Point*, size_t, const Brush&, float = 1.f, STROKE_STYLE = STROKE_STYLE::Soild);
 		void draw_poly(const std::vector<Point>&, const Brush&, float = 1.f, STROKE_STYLE = STROKE_STYLE::Soild);
+		void draw_polyline(const Point*, size_t, const Brush&, float = 1.f, STROKE_STYLE = STROKE_STYLE::Soild);
+		void draw_polyline(const std::vector<Point>&, const Brush&, float = 1.f, STROKE_STYLE = STROKE_STYLE::Soild);
+
+		//Custom dashes, caps, joins and miter limit, see StrokeStyle
+		void draw_line(Point, Point, const Brush&, float, const StrokeStyle&);
+		void draw_rect(Rect, const Brush&, float, const StrokeStyle&);
+		void draw_ellipse(Ellipse, const Brush&, float, const StrokeStyle&);
+		void draw_poly(const Point*, size_t, const Brush&, float, const StrokeStyle&);
+		void draw_polyline(const Point*, size_t, const Brush&, float, const StrokeStyle&);
 
 		Bitmap load_image_from_file(const std::wstring&);
 
+		//Reads and decodes the file on a worker thread, PNG, BMP and PPM/PGM everywhere, and on
+		//Windows whatever WIC reads too. The bitmap is created at the start of a later render_frame,
+		//loads not decoded when this object is destroyed stay Pending
+		ImageLoad load_image_async(const std::wstring&);
+
+		//Creates the bitmaps of the loads decoded so far, with wait after every load started is
+		//decoded. For loading outside render_frame, before the first frame for instance
+		void complete_image_loads(bool wait = false);
+
 		//Pixel Format: DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED
 		//srcData need continuous in memory
 		//pitch is byte count of a scanline (one row of pixels in memory)
@@ -497,7 +699,61 @@ namespace graph
 		//srcData need continuous in memory
 		Bitmap create_image_from_memory(Size, const ColorBGRA8bit* srcData);
 
-		void draw_image(Rect, const Bitmap&);
+		//srcData in format is converted to the format above with SIMD kernels, big images by as
+		//many threads as GraphSetting::render_threads. pitch is byte count of a scanline
+		Bitmap create_image_from_memory(Size, const void* srcData, UINT pitch, PIXEL_FORMAT format);
+
+		//Same pixel format. A bitmap reading pixels where they are, without a copy, on the
+		//software backend. pixels is 4-byte aligned and pitch a multiple of 4. release is called,
+		//maybe on the render thread, once the bitmap and every drawing of it recorded are gone,
+		//the memory is the caller's until then. Drawing reads it in the draw call, or as late as
+		//the end of render_frame when commands are recorded, so write it between frames only.
+		//Damage tracking does not see writes, invalidate where the bitmap is drawn.
+		//Direct2D copies the pixels once and calls release right away, update_image refreshes them.
+		//An empty bitmap, with release called, for an empty size or bad alignment
+		Bitmap wrap_image_memory(Size, void* pixels, UINT pitch, std::function<void()> release = nullptr);
+
+		//Copies the pixels of region, in whole pixels of the bitmap, from srcData into the bitmap
+		//without reallocating it. srcData starts at the region's top left, pitch is byte count of
+		//its scanlines. While recording, a copy of the pixels is recorded and the bitmap takes them
+		//when the list is drawn, so drawing before keeps the old pixels. Damage tracking does not
+		//see the change, invalidate where the bitmap is drawn. False for an empty bitmap or region
+		bool update_image(Bitmap&, Rect region, const void* srcData, UINT pitch);
+
+		//A stream of frames of this size, transparent until the first is written
+		ImageStream create_image_stream(Size);
+
+		//Copies what the producer changed since the last call into the stream's bitmap. False if
+		//nothing changed, or the producer is writing, then its frame comes with a later call
+		bool update_image(ImageStream&);
+
+		//Linear is what Direct2D draws by default. HighQuality on the software backend samples a
+		//mip level of about the drawn size, built on first use, for bitmaps drawn much smaller;
+		//Direct2D draws it Linear
+		void draw_image(Rect, const Bitmap&, INTERPOLATION_MODE interpolation = INTERPOLATION_MODE::Linear);
+
+		SpriteAtlas create_atlas(const AtlasBuilder&);
+
+		//Draws like draw_image of each sprite's region in order, Linear, as one batch per atlas
+		//page. Sprites whose index is not in the atlas are skipped
+		void draw_sprites(const SpriteAtlas&, const Sprite*, size_t);
+
+		//A transparent offscreen target of this size in DIPs, empty for an empty size.
+		//Software draws into it on the calling thread, whatever render_threads is
+		RenderTarget create_render_target(Size);
+
+		//Drawing calls from here on go into target, with its own view and clip, until end_target.
+		//Targets nest. Calls are drawn right away even while recording or with damage tracking,
+		//the recording goes on after end_target. Do not draw the target's bitmap into itself.
+		//Damage tracking does not see the change, invalidate where the bitmap is drawn
+		void begin_target(RenderTarget&);
+		void end_target();
+
+		//The layer's bitmap, drawn by draw into a transparent target first if key or size
+		//changed since it was last drawn, or it was invalidated. Expensive drawing that rarely
+		//changes is then one draw_image a frame. With damage tracking, a frame that draws the
+		//layer again is drawn whole
+		const Bitmap& render_to_bitmap(Layer&, Size, std::uint64_t key, const std::function<void(D2DGraphics*)>& draw);
 
 		Font create_font(
 			const std::wstring& fontName,
@@ -506,6 +762,7 @@ namespace graph
 			FONT_STYLE fontStyle = FONT_STYLE::Noraml,
 			FONT_STRETCH fontStretch = FONT_STRETCH::Normal);
 
+		//The software backend draws every font with a built-in bitmap face
 		void draw_text(
 			const std::wstring&,
 			Rect,
@@ -515,20 +772,106 @@ namespace graph
 			TEXT_ALIGN_VERTICAL = TEXT_ALIGN_VERTICAL::Top
 		);
 
+		//Extent of text as draw_text lays it out in a rect maxWidth wide and unbounded in height.
+		//Direct2D reuses the layout for the same text measured again, the software backend
+		//breaks the lines each time, which costs about what looking them up would
+		TextMetrics measure_text(
+			const std::wstring&,
+			const Font&,
+			float maxWidth = (std::numeric_limits<float>::max)());
+
 		void fill_triangle(Point, Point, Point, const Brush&);
 		void fill_rect(Rect, const Brush&);
 		void fill_ellipse(Ellipse, const Brush&);
 		void fill_ellipse(Rect, const Brush&);
-		void fill_poly(const Point*, size_t, const Brush&);
-		void fill_poly(const std::vector<Point>&, const Brush&);
+		void fill_poly(const Point*, size_t, const Brush&, FILL_MODE = FILL_MODE::Alternate);
+		void fill_poly(const std::vector<Point>&, const Brush&, FILL_MODE = FILL_MODE::Alternate);
+
+		//Open figures are filled as if closed, with the path's fill mode
+		void fill_path(const Path&, const Brush&);
+		void draw_path(const Path&, const Brush&, float = 1.f, STROKE_STYLE = STROKE_STYLE::Soild);
+		void draw_path(const Path&, const Brush&, float, const StrokeStyle&);
+
+		//Batches draw like one call per shape, in order.
+		//colors has one per shape
+		void fill_rects(const Rect*, size_t, const Brush&);
+		void fill_rects(const Rect*, const Color32* colors, size_t);
+		void fill_ellipses(const Ellipse*, size_t, const Brush&);
+		void fill_ellipses(const Ellipse*, const Color32* colors, size_t);
+
+		//count lines, line i runs from ends[2 * i] to ends[2 * i + 1]
+		void draw_lines(const Point* ends, size_t count, const Brush&, float = 1.f, STROKE_STYLE = STROKE_STYLE::Soild);
+		void draw_lines(const Point* ends, size_t count, const Brush&, float, const StrokeStyle&);
+		void draw_lines(
+			const Point* ends,
+			const Color32* colors,
+			size_t count,
+			float = 1.f,
+			STROKE_STYLE = STROKE_STYLE::Soild);
+		void draw_lines(const Point* ends, const Color32* colors, size_t count, float, const StrokeStyle&);
 
 		void set_pixel(float, float, Color);
 		void set_pixel(Point, Color);
 
+		//set_pixel for many points in one pass, without a brush per color
+		void set_pixels(const Point*, const Color*, size_t);
+		void set_pixels(const Point*, const Color32*, size_t);
+
+		//Direct access to the frame in device pixels, the view transform does not apply.
+		//Software: the framebuffer itself, drawing done before the lock is in it.
+		//Direct2D: a staging buffer kept from frame to frame, unlock_pixels draws it over the frame.
+		//No other drawing until unlock_pixels, end_draw unlocks if still locked.
+		//Gives no pixels while recording, so neither with damage tracking.
+		PixelLock lock_pixels();
+
+		//Copies count pixels into row y of the locked pixels from column x, clipped to them
+		void write_span(int x, int y, const ColorBGRA8bit* src, size_t count);
+
+		void unlock_pixels();
+
+		//Drawing calls from here on are recorded into list instead of drawn, until end_record.
+		//Pixel locks are not recorded.
+		void begin_record(CommandList& list);
+		void end_record();
+
+		//Makes the calls recorded in list, see CommandList
+		void draw_list(const CommandList& list);
+
+		//Copies every frame render_frame makes from now on, drawn or not with damage tracking, into
+		//one of GraphSetting::capture_buffers that a thread of its own writes to path. Never waits:
+		//frames with no buffer free are dropped and counted. A capture running is stopped first.
+		//Software backend only, false on Direct2D or if the file cannot be created
+		bool start_capture(const std::wstring& path, CAPTURE_FORMAT format);
+		//Waits for the frames taken to be written
+		void stop_capture();
+		//Of the capture running, or the last one once stopped
+		CaptureStats get_capture_stats() const;
+
+		//With damage tracking, has a rect in DIPs drawn again this frame, the view does not apply.
+		//Marks made during update or render count for the frame being made.
+		void invalidate(Rect);
+		//Has the whole frame drawn again
+		void invalidate();
+
 		SolidBrush create_solidbrush(Color);
 
+		//Cached by the color rounded to 8 bits a channel, valid until the end of the frame it was got in.
+		//Keep a brush from create_solidbrush to hold it longer
 		const SolidBrush& get_solidbrush(Color);
 
+		BrushCacheStats get_brush_cache_stats() const;
+		void reset_brush_cache_stats();
+
+		//Layouts of draw_text and measure_text, kept by text, font, rect size and alignment
+		TextLayoutCacheStats get_text_layout_cache_stats() const;
+		void reset_text_layout_cache_stats();
+
+		//Bitmaps of load_image_from_file and load_image_async, kept by file. They are shared,
+		//update_image on one changes it for every scene holding it
+		ImageCacheStats get_image_cache_stats() const;
+		void reset_image_cache_stats();
+		void clear_image_cache();
+
 		//GetCursorPos |> ScreenToClient |> PiexlToDips
 		Point get_relative_pos();
 
@@ -556,4 +899,9 @@ namespace graph
 	};
 
 	LONGLONG get_time();
+
+	//Color32 and Color for many colors at once, vectorized where the CPU allows.
+	//Give the same results as converting one by one
+	void convert_colors(const Color32* src, Color* dst, size_t count);
+	void convert_colors(const Color* src, Color32* dst, size_t count);
 }
@@ -0,0 +1,384 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace graph
+{
+	constexpr float TWO_PI = 6.28318530718f;
+	constexpr float PI =  3.1415926535f;
+
+	struct Point
+	{
+		float x, y;
+	};
+
+	struct Size
+	{
+		float width, height;
+	};
+
+	struct Rect
+	{
+		float left, top, right, bottom;
+	};
+
+	struct Ellipse
+	{
+		Point center;
+		float radius_x, radius_y;
+	};
+
+	enum class COLORS
+	{
+		AliceBlue = 0xF0F8FF,
+		AntiqueWhite = 0xFAEBD7,
+		Aqua = 0x00FFFF,
+		Aquamarine = 0x7FFFD4,
+		Azure = 0xF0FFFF,
+		Beige = 0xF5F5DC,
+		Bisque = 0xFFE4C4,
+		Black = 0x000000,
+		BlanchedAlmond = 0xFFEBCD,
+		Blue = 0x0000FF,
+		BlueViolet = 0x8A2BE2,
+		Brown = 0xA52A2A,
+		BurlyWood = 0xDEB887,
+		CadetBlue = 0x5F9EA0,
+		Chartreuse = 0x7FFF00,
+		Chocolate = 0xD2691E,
+		Coral = 0xFF7F50,
+		CornflowerBlue = 0x6495ED,
+		Cornsilk = 0xFFF8DC,
+		Crimson = 0xDC143C,
+		Cyan = 0x00FFFF,
+		DarkBlue = 0x00008B,
+		DarkCyan = 0x008B8B,
+		DarkGoldenrod = 0xB8860B,
+		DarkGray = 0xA9A9A9,
+		DarkGreen = 0x006400,
+		DarkKhaki = 0xBDB76B,
+		DarkMagenta = 0x8B008B,
+		DarkOliveGreen = 0x556B2F,
+		DarkOrange = 0xFF8C00,
+		DarkOrchid = 0x9932CC,
+		DarkRed = 0x8B0000,
+		DarkSalmon = 0xE9967A,
+		DarkSeaGreen = 0x8FBC8F,
+		DarkSlateBlue = 0x483D8B,
+		DarkSlateGray = 0x2F4F4F,
+		DarkTurquoise = 0x00CED1,
+		DarkViolet = 0x9400D3,
+		DeepPink = 0xFF1493,
+		DeepSkyBlue = 0x00BFFF,
+		DimGray = 0x696969,
+		DodgerBlue = 0x1E90FF,
+		Firebrick = 0xB22222,
+		FloralWhite = 0xFFFAF0,
+		ForestGreen = 0x228B22,
+		Fuchsia = 0xFF00FF,
+		Gainsboro = 0xDCDCDC,
+		GhostWhite = 0xF8F8FF,
+		Gold = 0xFFD700,
+		Goldenrod = 0xDAA520,
+		Gray = 0x808080,
+		Green = 0x008000,
+		GreenYellow = 0xADFF2F,
+		Honeydew = 0xF0FFF0,
+		HotPink = 0xFF69B4,
+		IndianRed = 0xCD5C5C,
+		Indigo = 0x4B0082,
+		Ivory = 0xFFFFF0,
+		Khaki = 0xF0E68C,
+		Lavender = 0xE6E6FA,
+		LavenderBlush = 0xFFF0F5,
+		LawnGreen = 0x7CFC00,
+		LemonChiffon = 0xFFFACD,
+		LightBlue = 0xADD8E6,
+		LightCoral = 0xF08080,
+		LightCyan = 0xE0FFFF,
+		LightGoldenrodYellow = 0xFAFAD2,
+		LightGreen = 0x90EE90,
+		LightGray = 0xD3D3D3,
+		LightPink = 0xFFB6C1,
+		LightSalmon = 0xFFA07A,
+		LightSeaGreen = 0x20B2AA,
+		LightSkyBlue = 0x87CEFA,
+		LightSlateGray = 0x778899,
+		LightSteelBlue = 0xB0C4DE,
+		LightYellow = 0xFFFFE0,
+		Lime = 0x00FF00,
+		LimeGreen = 0x32CD32,
+		Linen = 0xFAF0E6,
+		Magenta = 0xFF00FF,
+		Maroon = 0x800000,
+		MediumAquamarine = 0x66CDAA,
+		MediumBlue = 0x0000CD,
+		MediumOrchid = 0xBA55D3,
+		MediumPurple = 0x9370DB,
+		MediumSeaGreen = 0x3CB371,
+		MediumSlateBlue = 0x7B68EE,
+		MediumSpringGreen = 0x00FA9A,
+		MediumTurquoise = 0x48D1CC,
+		MediumVioletRed = 0xC71585,
+		MidnightBlue = 0x191970,
+		MintCream = 0xF5FFFA,
+		MistyRose = 0xFFE4E1,
+		Moccasin = 0xFFE4B5,
+		NavajoWhite = 0xFFDEAD,
+		Navy = 0x000080,
+		OldLace = 0xFDF5E6,
+		Olive = 0x808000,
+		OliveDrab = 0x6B8E23,
+		Orange = 0xFFA500,
+		OrangeRed = 0xFF4500,
+		Orchid = 0xDA70D6,
+		PaleGoldenrod = 0xEEE8AA,
+		PaleGreen = 0x98FB98,
+		PaleTurquoise = 0xAFEEEE,
+		PaleVioletRed = 0xDB7093,
+		PapayaWhip = 0xFFEFD5,
+		PeachPuff = 0xFFDAB9,
+		Peru = 0xCD853F,
+		Pink = 0xFFC0CB,
+		Plum = 0xDDA0DD,
+		PowderBlue = 0xB0E0E6,
+		Purple = 0x800080,
+		Red = 0xFF0000,
+		RosyBrown = 0xBC8F8F,
+		RoyalBlue = 0x4169E1,
+		SaddleBrown = 0x8B4513,
+		Salmon = 0xFA8072,
+		SandyBrown = 0xF4A460,
+		SeaGreen = 0x2E8B57,
+		SeaShell = 0xFFF5EE,
+		Sienna = 0xA0522D,
+		Silver = 0xC0C0C0,
+		SkyBlue = 0x87CEEB,
+		SlateBlue = 0x6A5ACD,
+		SlateGray = 0x708090,
+		Snow = 0xFFFAFA,
+		SpringGreen = 0x00FF7F,
+		SteelBlue = 0x4682B4,
+		Tan = 0xD2B48C,
+		Teal = 0x008080,
+		Thistle = 0xD8BFD8,
+		Tomato = 0xFF6347,
+		Turquoise = 0x40E0D0,
+		Violet = 0xEE82EE,
+		Wheat = 0xF5DEB3,
+		White = 0xFFFFFF,
+		WhiteSmoke = 0xF5F5F5,
+		Yellow = 0xFFFF00,
+		YellowGreen = 0x9ACD32,
+	};
+
+	struct ColorBGRA8bit
+	{
+		std::uint8_t b, g, r, a;
+	};
+
+	struct Color;
+
+	//Straight alpha color packed as 0xAARRGGBB, a quarter the size of Color.
+	//Batch calls take one per shape
+	struct Color32
+	{
+		std::uint32_t argb;
+
+		Color32() = default;
+		constexpr explicit Color32(const std::uint32_t argb) : argb(argb) {}
+		//alpha from 0 to 255
+		constexpr Color32(const COLORS rgb, const std::uint8_t alpha = 255) :
+			argb(static_cast<std::uint32_t>(alpha) << 24 | static_cast<std::uint32_t>(rgb)) {}
+		constexpr Color32(const std::uint8_t r, const std::uint8_t g, const std::uint8_t b, const std::uint8_t a = 255) :
+			argb(static_cast<std::uint32_t>(a) << 24 | static_cast<std::uint32_t>(r) << 16 |
+				static_cast<std::uint32_t>(g) << 8 | b) {}
+		//Channels rounded to 8 bits, out of range clamped and NaN taken as 0
+		explicit Color32(const Color& color);
+
+		constexpr std::uint8_t red() const { return static_cast<std::uint8_t>(argb >> 16); }
+		constexpr std::uint8_t green() const { return static_cast<std::uint8_t>(argb >> 8); }
+		constexpr std::uint8_t blue() const { return static_cast<std::uint8_t>(argb); }
+		constexpr std::uint8_t alpha() const { return static_cast<std::uint8_t>(argb >> 24); }
+
+		constexpr bool operator==(const Color32 c) const { return argb == c.argb; }
+		constexpr bool operator!=(const Color32 c) const { return argb != c.argb; }
+	};
+
+	struct Color
+	{
+		float red, green, blue, alpha;
+		Color(std::uint8_t, std::uint8_t, std::uint8_t, std::uint8_t);
+		Color(float, float, float, float);
+		Color(COLORS, float = 1.0f);
+		Color(Color32);
+
+		bool operator<(const Color& c) const;
+
+		bool operator==(const Color& c) const;
+	};
+
+	enum class STROKE_STYLE
+	{
+		Soild,
+		Dash,
+		DashDot,
+		DashDotDot,
+		Dot
+	};
+
+	//Same values as D2D1_CAP_STYLE
+	enum class CAP_STYLE
+	{
+		Flat,
+		Square,
+		Round,
+		Triangle
+	};
+
+	//Same values as D2D1_LINE_JOIN
+	enum class LINE_JOIN
+	{
+		Miter,
+		Bevel,
+		Round,
+		MiterOrBevel
+	};
+
+	struct StrokeStyle
+	{
+		CAP_STYLE start_cap = CAP_STYLE::Flat;
+		CAP_STYLE end_cap = CAP_STYLE::Flat;
+		//Ends of the dashes, other than where the figure starts and ends
+		CAP_STYLE dash_cap = CAP_STYLE::Flat;
+		LINE_JOIN line_join = LINE_JOIN::Miter;
+		//Longest miter in half stroke widths, Miter cuts it there, MiterOrBevel bevels instead
+		float miter_limit = 10.f;
+		//Alternating dash and gap lengths in stroke widths, empty for a solid line
+		std::vector<float> dashes;
+		//Where in the pattern the figure starts, in stroke widths
+		float dash_offset = 0.f;
+
+		//What a STROKE_STYLE has always drawn, round caps and the Direct2D dash patterns
+		static const StrokeStyle& preset(STROKE_STYLE style);
+
+		bool operator<(const StrokeStyle& s) const;
+
+		bool operator==(const StrokeStyle& s) const;
+	};
+
+	//How self-overlapping polygons are filled, same as D2D1_FILL_MODE
+	enum class FILL_MODE
+	{
+		Alternate,
+		Winding
+	};
+
+	//Pixel layouts images can be made from, channels in memory order. All but the first have
+	//straight alpha, the ones without alpha are opaque
+	enum class PIXEL_FORMAT
+	{
+		//DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED, what bitmaps hold
+		BGRA8Premultiplied,
+		BGRA8,
+		RGBA8,
+		RGB8,
+		Gray8,
+		//Four floats per pixel from 0 to 1
+		RGBA32Float
+	};
+
+	//How a bitmap is sampled when drawn, the first two same as D2D1_BITMAP_INTERPOLATION_MODE
+	enum class INTERPOLATION_MODE
+	{
+		NearestNeighbor,
+		Linear,
+		//Linear from a prefiltered level of about the drawn size, for bitmaps drawn much smaller
+		HighQuality
+	};
+
+	//What D2DGraphics::start_capture writes
+	enum class CAPTURE_FORMAT
+	{
+		//A PNG a frame, frame n to the path followed by n in six digits and .png. n counts every
+		//frame rendered since the start, so dropped frames leave gaps
+		PngSequence,
+		//One file of frames one after another, premultiplied BGRA as in the framebuffer, top row first
+		RawBGRA,
+		//One YUV4MPEG2 file, 8-bit 4:4:4 BT.601 limited range, colors as if over black
+		Y4M
+	};
+
+	struct CaptureStats
+	{
+		//Frames rendered while capturing, written out and dropped for want of a free buffer
+		//or for a size other than the first frame's
+		std::uint64_t frames = 0, written = 0, dropped = 0;
+		//Frames taken that could not be written, such as for a full disk
+		std::uint64_t failed = 0;
+	};
+
+	//Pixels handed out by D2DGraphics::lock_pixels
+	struct PixelLock
+	{
+		//Premultiplied B8G8R8A8, read as 0xAARRGGBB from a little-endian word
+		std::uint32_t* bits = nullptr;
+		int width = 0, height = 0;
+		//Byte count of a scanline
+		size_t pitch = 0;
+
+		std::uint32_t* row(int y) const
+		{
+			return reinterpret_cast<std::uint32_t*>(reinterpret_cast<std::uint8_t*>(bits) + y * pitch);
+		}
+	};
+
+	//Counters of the cache behind D2DGraphics::get_solidbrush, many misses per frame mean
+	//more colors are in use than it holds
+	struct BrushCacheStats
+	{
+		std::uint64_t hits = 0, misses = 0, evictions = 0;
+		//Brushes held now
+		size_t size = 0;
+	};
+
+	//Extent of text laid out from the top left of its rect
+	struct TextMetrics
+	{
+		float width, height;
+		//From the top to the baseline of the first line
+		float baseline;
+		size_t lines;
+	};
+
+	//Counters of the layout cache behind D2DGraphics::draw_text, misses every frame mean the
+	//labels drawn do not fit the budget
+	struct TextLayoutCacheStats
+	{
+		std::uint64_t hits = 0, misses = 0, evictions = 0;
+		//Layouts held now and their estimated bytes
+		size_t size = 0, bytes = 0;
+	};
+
+	struct ImageCacheStats
+	{
+		std::uint64_t hits = 0, misses = 0, evictions = 0;
+		//Bitmaps held now and their bytes of pixels
+		size_t size = 0, bytes = 0;
+	};
+
+	//Where a sprite sits in an atlas, in pixels of its page
+	struct AtlasRegion
+	{
+		std::uint32_t page;
+		int x, y, width, height;
+	};
+
+	//One sprite of D2DGraphics::draw_sprites, the region index of the atlas stretched over rect
+	struct Sprite
+	{
+		std::uint32_t index;
+		Rect rect;
+		float opacity;
+	};
+}
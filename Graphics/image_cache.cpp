@@ -0,0 +1,126 @@
+#include "image_cache.h"
+#include "soft_decode.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#endif
+
+namespace graph
+{
+	bool StampFile(const std::wstring& path, FileStamp& stamp)
+	{
+#ifdef _WIN32
+		const DWORD length = GetFullPathNameW(path.c_str(), 0, nullptr, nullptr);
+		if (length == 0)
+		{
+			return false;
+		}
+		std::wstring full(length, L'\0');
+		full.resize(GetFullPathNameW(path.c_str(), length, &full[0], nullptr));
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (full.empty() || !GetFileAttributesExW(full.c_str(), GetFileExInfoStandard, &data) ||
+			(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+		{
+			return false;
+		}
+		CharLowerBuffW(&full[0], static_cast<DWORD>(full.size()));
+		stamp.path = std::move(full);
+		stamp.modified = static_cast<std::int64_t>(
+			static_cast<std::uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32 | data.ftLastWriteTime.dwLowDateTime);
+		stamp.size = static_cast<std::uint64_t>(data.nFileSizeHigh) << 32 | data.nFileSizeLow;
+		return true;
+#else
+		char* canonical = realpath(soft::Utf8(path).c_str(), nullptr);
+		if (canonical == nullptr)
+		{
+			return false;
+		}
+		struct stat info;
+		const bool file = stat(canonical, &info) == 0 && S_ISREG(info.st_mode);
+		if (file)
+		{
+			//Only a key, the UTF-8 bytes are kept as they are
+			stamp.path.assign(canonical, canonical + std::strlen(canonical));
+#ifdef __APPLE__
+			stamp.modified = static_cast<std::int64_t>(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+			stamp.modified = static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+			stamp.size = static_cast<std::uint64_t>(info.st_size);
+		}
+		std::free(canonical);
+		return file;
+#endif
+	}
+
+	ImageCache::ImageCache(const size_t budget) : budget(budget) {}
+
+	void ImageCache::Erase(const std::unordered_map<std::wstring, Entry>::iterator entry)
+	{
+		uses.erase(entry->second.use);
+		stats.size--;
+		stats.bytes -= entry->second.bytes;
+		entries.erase(entry);
+	}
+
+	const Bitmap* ImageCache::get(const FileStamp& stamp)
+	{
+		const auto found = entries.find(stamp.path);
+		if (found == entries.end())
+		{
+			stats.misses++;
+			return nullptr;
+		}
+		Entry& entry = found->second;
+		if (entry.modified != stamp.modified || entry.size != stamp.size)
+		{
+			stats.misses++;
+			Erase(found);
+			return nullptr;
+		}
+		stats.hits++;
+		uses.splice(uses.begin(), uses, entry.use);
+		return &entry.bitmap;
+	}
+
+	void ImageCache::put(const FileStamp& stamp, const Bitmap& bitmap)
+	{
+		const Size size = bitmap.get_size();
+		const size_t bytes = static_cast<size_t>(size.width) * static_cast<size_t>(size.height) * 4;
+		const auto found = entries.find(stamp.path);
+		if (found != entries.end())
+		{
+			Erase(found);
+		}
+		if (bytes == 0 || bytes > budget)
+		{
+			return;
+		}
+		while (stats.bytes + bytes > budget)
+		{
+			Erase(entries.find(*uses.back()));
+			stats.evictions++;
+		}
+		const auto added = entries.emplace(stamp.path, Entry{bitmap, stamp.modified, stamp.size, bytes, {}}).first;
+		uses.push_front(&added->first);
+		added->second.use = uses.begin();
+		stats.size++;
+		stats.bytes += bytes;
+	}
+
+	void ImageCache::clear()
+	{
+		entries.clear();
+		uses.clear();
+		stats.size = 0;
+		stats.bytes = 0;
+	}
+
+	void ImageCache::reset_stats()
+	{
+		stats.hits = stats.misses = stats.evictions = 0;
+	}
+}
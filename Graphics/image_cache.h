@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include "graph.h"
+
+namespace graph
+{
+	//A file and what tells its versions apart
+	struct FileStamp
+	{
+		//Canonical, in lower case on Windows where names ignore case
+		std::wstring path;
+		std::int64_t modified = 0;
+		std::uint64_t size = 0;
+	};
+
+	//Stamps an existing file, false for anything else
+	bool StampFile(const std::wstring& path, FileStamp& stamp);
+
+	//Bitmaps loaded from files, by canonical path: a hash map in front of entries kept in use order.
+	//Bitmaps are shared with whoever loaded them. Past the budget in bytes the least recently used
+	//are dropped from the cache, holders keep theirs. A file written since it was loaded misses
+	//and its entry is dropped. Loads are rare next to drawing, so this is not tuned like BrushCache.
+	class ImageCache
+	{
+		struct Entry
+		{
+			Bitmap bitmap;
+			std::int64_t modified;
+			std::uint64_t size;
+			size_t bytes;
+			std::list<const std::wstring*>::iterator use;
+		};
+
+		std::unordered_map<std::wstring, Entry> entries;
+		//Keys of entries, newest first
+		std::list<const std::wstring*> uses;
+		size_t budget;
+		ImageCacheStats stats;
+
+		void Erase(std::unordered_map<std::wstring, Entry>::iterator entry);
+	public:
+		explicit ImageCache(size_t budget);
+
+		//The bitmap of the file as stamped, null on a miss. Valid until the next put or clear
+		const Bitmap* get(const FileStamp& stamp);
+
+		//Keeps a share of bitmap for the file as stamped. One over the whole budget is not kept
+		void put(const FileStamp& stamp, const Bitmap& bitmap);
+
+		void clear();
+
+		const ImageCacheStats& get_stats() const { return stats; }
+		void reset_stats();
+	};
+}
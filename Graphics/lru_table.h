@@ -0,0 +1,195 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace graph
+{
+	//No entry, for lookups that miss and past either end of the use order
+	constexpr std::uint32_t c_no_entry = 0xFFFFFFFF;
+
+	//Entries by a hash of their key: an open addressing table with linear probing in front of
+	//entries kept in use order. What the key is and when to evict is up to the cache built on it,
+	//entries are Value and referred to by index, which stays the same until the entry is erased.
+	template <typename Value>
+	class LruTable
+	{
+		//Slots to start with, grown as entries are added
+		static constexpr size_t c_initial_slots = 64;
+
+		struct Slot
+		{
+			std::uint64_t hash;
+			//c_no_entry for an empty slot
+			std::uint32_t entry;
+		};
+
+		struct Entry
+		{
+			Value value;
+			std::uint64_t hash;
+			//Neighbours in use order, c_no_entry past either end
+			std::uint32_t newer, older;
+		};
+
+		//Size is a power of two, at most half full
+		std::vector<Slot> slots;
+		std::vector<Entry> entries;
+		std::vector<std::uint32_t> freeEntries;
+		std::uint32_t newest = c_no_entry, oldest = c_no_entry;
+		size_t count = 0;
+
+		size_t Home(const std::uint64_t hash) const
+		{
+			return static_cast<size_t>(hash) & (slots.size() - 1);
+		}
+
+		//The empty slot ending the probe of hash
+		size_t FreeSlot(const std::uint64_t hash) const
+		{
+			const size_t mask = slots.size() - 1;
+			size_t slot = Home(hash);
+			while (slots[slot].entry != c_no_entry)
+			{
+				slot = (slot + 1) & mask;
+			}
+			return slot;
+		}
+
+		//Slot of an entry in the table
+		size_t Find(const std::uint32_t entry) const
+		{
+			const size_t mask = slots.size() - 1;
+			size_t slot = Home(entries[entry].hash);
+			while (slots[slot].entry != entry)
+			{
+				slot = (slot + 1) & mask;
+			}
+			return slot;
+		}
+
+		void EraseSlot(size_t slot)
+		{
+			//Later slots of the run move back into the hole if that keeps them past their home
+			const size_t mask = slots.size() - 1;
+			size_t next = (slot + 1) & mask;
+			while (slots[next].entry != c_no_entry)
+			{
+				const size_t home = Home(slots[next].hash);
+				if (((next - home) & mask) >= ((next - slot) & mask))
+				{
+					slots[slot] = slots[next];
+					slot = next;
+				}
+				next = (next + 1) & mask;
+			}
+			slots[slot].entry = c_no_entry;
+		}
+
+		void Rehash(const size_t size)
+		{
+			std::vector<Slot> old(size, Slot{0, c_no_entry});
+			old.swap(slots);
+			for (const Slot& slot : old)
+			{
+				if (slot.entry != c_no_entry)
+				{
+					slots[FreeSlot(slot.hash)] = slot;
+				}
+			}
+		}
+
+		void Unlink(const std::uint32_t entry)
+		{
+			Entry& e = entries[entry];
+			(e.newer == c_no_entry ? newest : entries[e.newer].older) = e.older;
+			(e.older == c_no_entry ? oldest : entries[e.older].newer) = e.newer;
+			e.newer = e.older = c_no_entry;
+		}
+
+		void PushNewest(const std::uint32_t entry)
+		{
+			Entry& e = entries[entry];
+			e.newer = c_no_entry;
+			e.older = newest;
+			(newest == c_no_entry ? oldest : entries[newest].newer) = entry;
+			newest = entry;
+		}
+	public:
+		LruTable()
+		{
+			slots.assign(c_initial_slots, Slot{0, c_no_entry});
+		}
+
+		size_t size() const { return count; }
+
+		//Least recently used, c_no_entry when empty
+		std::uint32_t get_oldest() const { return oldest; }
+
+		Value& operator[](const std::uint32_t entry) { return entries[entry].value; }
+		const Value& operator[](const std::uint32_t entry) const { return entries[entry].value; }
+
+		//Entry of hash that matches(value) accepts, c_no_entry if there is none.
+		//hash is used as it is, so its low bits should be well mixed
+		template <typename Matches>
+		std::uint32_t find(const std::uint64_t hash, Matches&& matches) const
+		{
+			const size_t mask = slots.size() - 1;
+			for (size_t slot = Home(hash); slots[slot].entry != c_no_entry; slot = (slot + 1) & mask)
+			{
+				if (slots[slot].hash == hash && matches(entries[slots[slot].entry].value))
+				{
+					return slots[slot].entry;
+				}
+			}
+			return c_no_entry;
+		}
+
+		//Makes entry the most recently used
+		void touch(const std::uint32_t entry)
+		{
+			if (entry != newest)
+			{
+				Unlink(entry);
+				PushNewest(entry);
+			}
+		}
+
+		//A new most recently used entry for a key not in the table yet, its value is Value()
+		std::uint32_t insert(const std::uint64_t hash)
+		{
+			if (2 * (count + 1) > slots.size())
+			{
+				Rehash(2 * slots.size());
+			}
+			std::uint32_t entry;
+			if (freeEntries.empty())
+			{
+				entry = static_cast<std::uint32_t>(entries.size());
+				entries.emplace_back();
+			}
+			else
+			{
+				entry = freeEntries.back();
+				freeEntries.pop_back();
+			}
+			entries[entry].hash = hash;
+			PushNewest(entry);
+			slots[FreeSlot(hash)] = Slot{hash, entry};
+			count++;
+			return entry;
+		}
+
+		//Drops the least recently used entry, its value is reset to free what it holds
+		void erase_oldest()
+		{
+			const std::uint32_t entry = oldest;
+			EraseSlot(Find(entry));
+			Unlink(entry);
+			entries[entry].value = Value();
+			freeEntries.push_back(entry);
+			count--;
+		}
+	};
+}
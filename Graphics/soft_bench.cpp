@@ -0,0 +1,154 @@
+#include "soft_bench.h"
+#include "soft_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace graph
+{
+	namespace soft
+	{
+		template <typename F>
+		double TimeMs(const int repeat, F&& func)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < repeat; i++)
+			{
+				func();
+			}
+			const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			return elapsed.count() / repeat;
+		}
+
+		void NaiveSpan(Pixel* dst, const size_t count, const Pixel color)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				dst[i] = BlendPixel(dst[i], color);
+			}
+		}
+
+		SpanBenchmark BenchmarkSpanKernels(
+			const SIMD_LEVEL level,
+			const int width,
+			const int height,
+			const int rectCount,
+			const int repeat)
+		{
+			const SIMD_LEVEL previous = GetSimdLevel();
+			SetSimdLevel(level);
+
+			Canvas canvas(width, height);
+			Image& image = canvas.get_target();
+
+			std::vector<IntRect> rects(rectCount);
+			std::uint32_t seed = 12345;
+			const auto next = [&seed](const int range)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				return static_cast<int>((seed >> 8) % static_cast<std::uint32_t>(range));
+			};
+			for (auto& rect : rects)
+			{
+				const int w = 4 + next(32);
+				const int h = 4 + next(16);
+				rect.left = next(width - w);
+				rect.top = next(height - h);
+				rect.right = rect.left + w;
+				rect.bottom = rect.top + h;
+			}
+
+			const Pixel opaque = 0xFF3366CC;
+			const Pixel translucent = 0x80102030;
+			const auto spans = [&](void (*span)(Pixel*, size_t, Pixel), const Pixel color)
+			{
+				for (const auto& rect : rects)
+				{
+					for (int y = rect.top; y < rect.bottom; y++)
+					{
+						span(image.row(y) + rect.left, static_cast<size_t>(rect.right - rect.left), color);
+					}
+				}
+			};
+			const size_t pixelCount = static_cast<size_t>(width) * height;
+
+			SpanBenchmark result{};
+			result.level = GetSimdLevel();
+			result.naive_clear_ms = TimeMs(repeat, [&] { NaiveSpan(image.row(0), pixelCount, opaque); });
+			result.clear_ms = TimeMs(repeat, [&] { FillSpanOpaque(image.row(0), pixelCount, opaque); });
+			result.naive_opaque_rects_ms = TimeMs(repeat, [&] { spans(NaiveSpan, opaque); });
+			result.opaque_rects_ms = TimeMs(repeat, [&] { spans(FillSpanOpaque, opaque); });
+			result.naive_blend_rects_ms = TimeMs(repeat, [&] { spans(NaiveSpan, translucent); });
+			result.blend_rects_ms = TimeMs(repeat, [&] { spans(BlendSpan, translucent); });
+			result.frame_ms = TimeMs(repeat, [&]
+			{
+				canvas.clear(0xFFFFFFFF);
+				for (size_t i = 0; i < rects.size(); i++)
+				{
+					const auto& rect = rects[i];
+					canvas.fill_rect(
+						Rect{
+							static_cast<float>(rect.left),
+							static_cast<float>(rect.top),
+							static_cast<float>(rect.right),
+							static_cast<float>(rect.bottom)
+						},
+						i % 2 ? translucent : opaque);
+				}
+			});
+
+			SetSimdLevel(previous);
+			return result;
+		}
+
+		ConvertBenchmark BenchmarkConvert(
+			const SIMD_LEVEL level,
+			const int width,
+			const int height,
+			const int repeat)
+		{
+			const SIMD_LEVEL previous = GetSimdLevel();
+			SetSimdLevel(level);
+
+			const size_t pixelCount = static_cast<size_t>(width) * height;
+			std::vector<Pixel> dst(pixelCount);
+			//Enough for the widest format, bytes for 8 bit channels and floats from 0 to 1 for RGBA32Float
+			std::vector<std::uint8_t> src(pixelCount * FormatBytes(PIXEL_FORMAT::RGBA32Float));
+			std::uint32_t seed = 12345;
+			for (auto& byte : src)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				byte = static_cast<std::uint8_t>(seed >> 24);
+			}
+			std::vector<std::uint8_t> floats(src.size());
+			for (size_t i = 0; i < src.size() / sizeof(float); i++)
+			{
+				const float value = static_cast<float>(src[i]) / 255.f;
+				std::memcpy(floats.data() + i * sizeof(float), &value, sizeof(float));
+			}
+			TaskPool pool((std::max)(std::thread::hardware_concurrency(), 1u));
+
+			ConvertBenchmark result{};
+			result.level = GetSimdLevel();
+			for (int i = 0; i < c_format_count; i++)
+			{
+				const auto format = static_cast<PIXEL_FORMAT>(i);
+				const std::uint8_t* pixels = format == PIXEL_FORMAT::RGBA32Float ? floats.data() : src.data();
+				const size_t bytes = FormatBytes(format);
+				const double gigabytes = static_cast<double>(pixelCount * bytes) / 1e9;
+				const double spanMs = TimeMs(repeat, [&] { ConvertSpan(format, pixels, dst.data(), pixelCount); });
+				const double pixelsMs = TimeMs(repeat, [&]
+				{
+					ConvertPixels(format, width, height, pixels, width * bytes, dst.data(), width * sizeof(Pixel), &pool);
+				});
+				result.span_gbps[i] = gigabytes / (spanMs / 1000.0);
+				result.pixels_gbps[i] = gigabytes / (pixelsMs / 1000.0);
+			}
+
+			SetSimdLevel(previous);
+			return result;
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "soft_span.h"
+
+namespace graph
+{
+	namespace soft
+	{
+		//Milliseconds per run, naive is a per-pixel BlendPixel loop over the same spans
+		struct SpanBenchmark
+		{
+			SIMD_LEVEL level;
+			double clear_ms, naive_clear_ms;
+			double opaque_rects_ms, naive_opaque_rects_ms;
+			double blend_rects_ms, naive_blend_rects_ms;
+			//Canvas::clear plus rectCount fill_rect calls, half of them translucent
+			double frame_ms;
+		};
+
+		//Runs at the given level on a width x height surface with rectCount rects of 4x4 to 35x19
+		SpanBenchmark BenchmarkSpanKernels(
+			SIMD_LEVEL level,
+			int width = 1920,
+			int height = 1080,
+			int rectCount = 50000,
+			int repeat = 10);
+
+		constexpr int c_format_count = static_cast<int>(PIXEL_FORMAT::RGBA32Float) + 1;
+
+		//GB/s of source pixels read, indexed by PIXEL_FORMAT
+		struct ConvertBenchmark
+		{
+			SIMD_LEVEL level;
+			//ConvertSpan of the whole surface as one span, on the calling thread
+			double span_gbps[c_format_count];
+			//ConvertPixels with a pool of every core
+			double pixels_gbps[c_format_count];
+		};
+
+		//Runs at the given level, converting a width x height surface of every format
+		ConvertBenchmark BenchmarkConvert(
+			SIMD_LEVEL level,
+			int width = 1920,
+			int height = 1080,
+			int repeat = 10);
+	}
+}
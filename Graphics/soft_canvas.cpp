@@ -0,0 +1,1512 @@
+#include "soft_canvas.h"
+#include "soft_pool.h"
+#include "soft_span.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+namespace graph
+{
+	namespace soft
+	{
+		const int c_tile_size = 64;
+		//Sprites batched into one command at most
+		const size_t c_sprites_per_command = 64;
+		//Image pixels sampled at once before they are composited. Runs start on multiples of it,
+		//and tiles do too, so fixed point positions stepped from there do not depend on the tile
+		const int c_sample_run = 64;
+
+		Pixel PremultiplyColor(const Color& color, const float opacity)
+		{
+			const auto clamp01 = [](const float v) { return v < 0.f ? 0.f : (v > 1.f ? 1.f : v); };
+			const float alpha = clamp01(color.alpha * opacity);
+			const auto channel = [&](const float v)
+			{
+				return static_cast<Pixel>(clamp01(v) * alpha * 255.f + 0.5f);
+			};
+			return (static_cast<Pixel>(alpha * 255.f + 0.5f) << 24) |
+				(channel(color.red) << 16) |
+				(channel(color.green) << 8) |
+				channel(color.blue);
+		}
+
+		bool Affine::invert(Affine& inverse) const
+		{
+			const float det = m11 * m22 - m12 * m21;
+			if (std::fabs(det) < 1e-12f)
+			{
+				return false;
+			}
+			inverse.m11 = m22 / det;
+			inverse.m12 = -m12 / det;
+			inverse.m21 = -m21 / det;
+			inverse.m22 = m11 / det;
+			inverse.dx = (m21 * dy - m22 * dx) / det;
+			inverse.dy = (m12 * dx - m11 * dy) / det;
+			return true;
+		}
+
+		Affine Affine::rotation(const float radians, const Point center)
+		{
+			const float c = std::cos(radians);
+			const float s = std::sin(radians);
+			Affine res;
+			res.m11 = c;
+			res.m12 = s;
+			res.m21 = -s;
+			res.m22 = c;
+			res.dx = center.x - center.x * c + center.y * s;
+			res.dy = center.y - center.x * s - center.y * c;
+			return res;
+		}
+
+		Image::Image(const int width, const int height)
+		{
+			resize(width, height);
+		}
+
+		Image::~Image()
+		{
+			Release();
+		}
+
+		Image::Image(const Image& image)
+		{
+			*this = image;
+		}
+
+		Image::Image(Image&& image) noexcept
+		{
+			*this = std::move(image);
+		}
+
+		Image& Image::operator=(const Image& image)
+		{
+			if (&image != this)
+			{
+				resize(image.w, image.h);
+				if (w > 0 && h > 0)
+				{
+					copy_from(image.row(0), image.stride);
+				}
+			}
+			return *this;
+		}
+
+		Image& Image::operator=(Image&& image) noexcept
+		{
+			if (&image != this)
+			{
+				Release();
+				w = image.w;
+				h = image.h;
+				//Moving the vector keeps its buffer, bits stays valid
+				pixels = std::move(image.pixels);
+				mips = std::move(image.mips);
+				bits = image.bits;
+				stride = image.stride;
+				release = std::move(image.release);
+				image.w = image.h = 0;
+				image.pixels.clear();
+				image.mips.clear();
+				image.bits = nullptr;
+				image.stride = 0;
+				image.release = nullptr;
+			}
+			return *this;
+		}
+
+		Image Image::borrow(
+			const int width,
+			const int height,
+			void* memory,
+			const size_t pitch,
+			std::function<void()> release)
+		{
+			Image res;
+			res.w = std::max(width, 0);
+			res.h = std::max(height, 0);
+			res.bits = static_cast<Pixel*>(memory);
+			res.stride = pitch;
+			res.release = std::move(release);
+			return res;
+		}
+
+		void Image::Release()
+		{
+			if (release)
+			{
+				const std::function<void()> call = std::move(release);
+				release = nullptr;
+				call();
+			}
+		}
+
+		void Image::resize(const int width, const int height)
+		{
+			Release();
+			mips.clear();
+			w = std::max(width, 0);
+			h = std::max(height, 0);
+			pixels.assign(static_cast<size_t>(w) * h, 0);
+			bits = pixels.data();
+			stride = static_cast<size_t>(w) * sizeof(Pixel);
+		}
+
+		std::shared_ptr<const Image> Image::mip(const int level) const
+		{
+			const Image* from = mips.empty() ? this : mips.back().get();
+			while (static_cast<int>(mips.size()) < level && (from->w > 1 || from->h > 1))
+			{
+				auto next = std::make_shared<Image>(std::max(from->w / 2, 1), std::max(from->h / 2, 1));
+				for (int y = 0; y < next->h; y++)
+				{
+					//An odd last row or column is left out, a side of one is averaged with itself
+					const Pixel* row0 = from->row(std::min(2 * y, from->h - 1));
+					const Pixel* row1 = from->row(std::min(2 * y + 1, from->h - 1));
+					if (from->w > 1)
+					{
+						HalveSpan(next->row(y), row0, row1, static_cast<size_t>(next->w));
+						continue;
+					}
+					const Pixel pair0[] = {row0[0], row0[0]}, pair1[] = {row1[0], row1[0]};
+					HalveSpan(next->row(y), pair0, pair1, 1);
+				}
+				from = next.get();
+				mips.push_back(std::move(next));
+			}
+			if (level <= 0 || mips.empty())
+			{
+				return nullptr;
+			}
+			return mips[std::min(static_cast<size_t>(level), mips.size()) - 1];
+		}
+
+		void Image::copy_from(const void* srcData, const size_t srcPitch)
+		{
+			mips.clear();
+			const auto* src = static_cast<const std::uint8_t*>(srcData);
+			for (int y = 0; y < h; y++)
+			{
+				std::memcpy(row(y), src + srcPitch * y, static_cast<size_t>(w) * sizeof(Pixel));
+			}
+		}
+
+		Canvas::Canvas(const int width, const int height)
+		{
+			resize(width, height);
+		}
+
+		Canvas::~Canvas() = default;
+
+		void Canvas::resize(const int width, const int height)
+		{
+			DropCommands();
+			target.resize(width, height);
+			FitTarget();
+		}
+
+		void Canvas::set_target(Image&& image)
+		{
+			DropCommands();
+			target = std::move(image);
+			FitTarget();
+		}
+
+		void Canvas::FitTarget()
+		{
+			clip = IntRect{0, 0, target.width(), target.height()};
+			rasterizer.set_clip(clip);
+			bands.resize(static_cast<size_t>((target.height() + c_tile_size - 1) / c_tile_size));
+		}
+
+		void Canvas::set_threads(unsigned count)
+		{
+			if (count == 0)
+			{
+				count = std::max(std::thread::hardware_concurrency(), 1u);
+			}
+			flush();
+			if (count == 1)
+			{
+				pool.reset();
+				workerRasterizers.clear();
+				return;
+			}
+			pool = std::make_unique<TaskPool>(count);
+			workerRasterizers.resize(count);
+		}
+
+		unsigned Canvas::get_threads() const
+		{
+			return pool ? pool->size() : 1;
+		}
+
+		void Canvas::set_clip(const IntRect& rect)
+		{
+			flush();
+			clip = Intersect(rect, IntRect{0, 0, target.width(), target.height()});
+			if (clip.empty())
+			{
+				clip = IntRect{0, 0, 0, 0};
+			}
+			rasterizer.set_clip(clip);
+		}
+
+		void Canvas::reset_clip()
+		{
+			set_clip(IntRect{0, 0, target.width(), target.height()});
+		}
+
+		void Canvas::DropCommands()
+		{
+			commands.clear();
+			pendingLines.clear();
+			maskQuads.clear();
+			spriteQuads.clear();
+			for (auto& band : bands)
+			{
+				band.items.clear();
+				band.lines.clear();
+			}
+		}
+
+		void Canvas::flush()
+		{
+			if (commands.empty())
+			{
+				return;
+			}
+			const size_t columns = static_cast<size_t>((target.width() + c_tile_size - 1) / c_tile_size);
+			pool->run(columns * bands.size(), [&](const size_t tile, const unsigned worker)
+			{
+				DrawTile(tile, workerRasterizers[worker]);
+			});
+			DropCommands();
+		}
+
+		void Canvas::DrawTile(const size_t tile, Rasterizer& raster)
+		{
+			const size_t columns = static_cast<size_t>((target.width() + c_tile_size - 1) / c_tile_size);
+			const int left = static_cast<int>(tile % columns) * c_tile_size;
+			const int top = static_cast<int>(tile / columns) * c_tile_size;
+			const IntRect area = Intersect(clip, IntRect{left, top, left + c_tile_size, top + c_tile_size});
+			const Band& band = bands[tile / columns];
+			for (const auto& item : band.items)
+			{
+				const Command& command = commands[item.command];
+				if (!Intersect(command.bounds, area).empty())
+				{
+					Execute(command, area, raster, band.lines.data() + item.lineBegin, item.lineEnd - item.lineBegin);
+				}
+			}
+		}
+
+		void Canvas::Record(Command&& command)
+		{
+			if (!Deferred())
+			{
+				Execute(command, clip, rasterizer, pendingLines.data(), pendingLines.size());
+				pendingLines.clear();
+				return;
+			}
+			const IntRect bounds = Intersect(command.bounds, clip);
+			if (bounds.empty())
+			{
+				pendingLines.clear();
+				return;
+			}
+			//Nothing drawn before shows through a full clear
+			if (command.kind == COMMAND::Clear && bounds.left == clip.left && bounds.top == clip.top &&
+				bounds.right == clip.right && bounds.bottom == clip.bottom)
+			{
+				DropCommands();
+			}
+			const size_t index = commands.size();
+			const COMMAND kind = command.kind;
+			commands.push_back(std::move(command));
+			const int firstBand = bounds.top / c_tile_size;
+			const int lastBand = (bounds.bottom - 1) / c_tile_size;
+			for (int b = firstBand; b <= lastBand; b++)
+			{
+				const size_t begin = bands[b].lines.size();
+				bands[b].items.push_back(Band::Item{index, begin, begin});
+			}
+			if (kind != COMMAND::Coverage)
+			{
+				return;
+			}
+			for (const Line& line : pendingLines)
+			{
+				const float minY = std::min(line.from.y, line.to.y);
+				const float maxY = std::max(line.from.y, line.to.y);
+				if (!(minY <= maxY) || maxY < static_cast<float>(bounds.top) || minY >= static_cast<float>(bounds.bottom))
+				{
+					continue;
+				}
+				const int first = std::max(firstBand, static_cast<int>(std::floor(minY)) / c_tile_size);
+				const int last = std::min(lastBand, static_cast<int>(std::floor(maxY)) / c_tile_size);
+				for (int b = first; b <= last; b++)
+				{
+					bands[b].lines.push_back(line);
+				}
+			}
+			pendingLines.clear();
+			for (int b = firstBand; b <= lastBand; b++)
+			{
+				Band& band = bands[b];
+				band.items.back().lineEnd = band.lines.size();
+				if (band.items.back().lineBegin == band.items.back().lineEnd)
+				{
+					band.items.pop_back();
+				}
+			}
+		}
+
+		//Offset of a mapping to image pixels that moves by whole pixels and nothing else,
+		//false for any other mapping
+		bool WholePixelOffset(const Affine& toImage, int& offsetX, int& offsetY)
+		{
+			if (toImage.m11 != 1.f || toImage.m22 != 1.f || toImage.m12 != 0.f || toImage.m21 != 0.f ||
+				toImage.dx != std::floor(toImage.dx) || toImage.dy != std::floor(toImage.dy) ||
+				!(std::fabs(toImage.dx) < 1e9f) || !(std::fabs(toImage.dy) < 1e9f))
+			{
+				return false;
+			}
+			offsetX = static_cast<int>(toImage.dx);
+			offsetY = static_cast<int>(toImage.dy);
+			return true;
+		}
+
+		//Pixels [first, last) of a row within [left, right) whose centers map inside the image,
+		//start being where the row's pixel 0 maps. Positions grow monotonically along the row
+		//and the image is convex, so they are one run
+		void InsideRun(
+			const Point& start,
+			const Affine& toImage,
+			const float width,
+			const float height,
+			const int left,
+			const int right,
+			int& first,
+			int& last)
+		{
+			const auto inside = [&](const int x)
+			{
+				const auto fx = static_cast<float>(x);
+				const float u = start.x + fx * toImage.m11;
+				const float v = start.y + fx * toImage.m12;
+				return u >= 0.f && v >= 0.f && u < width && v < height;
+			};
+			//Solved per axis with a pixel to spare, then narrowed by the exact test
+			double lo = left, hi = right;
+			const auto limit = [&](const double origin, const double step, const double size)
+			{
+				if (step == 0.0)
+				{
+					if (!(origin >= 0.0 && origin < size))
+					{
+						hi = lo;
+					}
+					return;
+				}
+				double enter = -origin / step, leave = (size - origin) / step;
+				if (enter > leave)
+				{
+					std::swap(enter, leave);
+				}
+				lo = std::max(lo, std::floor(enter) - 1.0);
+				hi = std::min(hi, std::ceil(leave) + 1.0);
+			};
+			limit(start.x, toImage.m11, width);
+			limit(start.y, toImage.m12, height);
+			first = last = left;
+			if (!(lo < hi))
+			{
+				return;
+			}
+			first = static_cast<int>(lo);
+			last = static_cast<int>(hi);
+			while (first < last && !inside(first))
+			{
+				first++;
+			}
+			while (last > first && !inside(last - 1))
+			{
+				last--;
+			}
+		}
+
+		//Draws the part of command inside area, the pixels do not depend on area
+		void Canvas::Execute(
+			const Command& command,
+			const IntRect& area,
+			Rasterizer& raster,
+			const Line* lines,
+			const size_t lineCount)
+		{
+			const IntRect box = Intersect(command.bounds, area);
+			if (box.empty())
+			{
+				return;
+			}
+			switch (command.kind)
+			{
+				case COMMAND::Clear:
+					//Without padding between rows, a full-width box is a single span
+					if (box.left == 0 && box.right == target.width() &&
+						target.pitch() == static_cast<size_t>(target.width()) * sizeof(Pixel))
+					{
+						FillSpanOpaque(target.row(box.top), static_cast<size_t>(box.bottom - box.top) * target.width(), command.color);
+						break;
+					}
+					for (int y = box.top; y < box.bottom; y++)
+					{
+						FillSpanOpaque(target.row(y) + box.left, static_cast<size_t>(box.right - box.left), command.color);
+					}
+					break;
+				case COMMAND::Rect:
+					for (int y = box.top; y < box.bottom; y++)
+					{
+						FillSpan(target.row(y) + box.left, static_cast<size_t>(box.right - box.left), command.color);
+					}
+					break;
+				case COMMAND::Coverage:
+				{
+					raster.set_clip(area);
+					const auto right = static_cast<float>(area.right);
+					for (size_t i = 0; i < lineCount; i++)
+					{
+						//Lines right of the area leave no cells in it
+						if (std::min(lines[i].from.x, lines[i].to.x) < right)
+						{
+							raster.add_line(lines[i].from, lines[i].to);
+						}
+					}
+					const Pixel color = command.color;
+					raster.sweep(command.rule, [&](const int y, const int x, const int count, const int coverage)
+					{
+						const Pixel paint = coverage == 255 ? color : ScalePixel(color, coverage);
+						//Edge pixels come one at a time, thin shapes are mostly edge
+						if (count == 1)
+						{
+							Pixel& dst = target.row(y)[x];
+							dst = (paint >> 24) == 255 ? paint : BlendPixel(dst, paint);
+							return;
+						}
+						FillSpan(target.row(y) + x, static_cast<size_t>(count), paint);
+					});
+					break;
+				}
+				case COMMAND::Image:
+				{
+					const Image& image = *command.image;
+					const Affine& toImage = command.toImage;
+					int offsetX, offsetY;
+					//Unscaled on whole pixels every mode hits texel centers, rows are composited as they are
+					if (WholePixelOffset(toImage, offsetX, offsetY))
+					{
+						const IntRect inside = Intersect(box, IntRect{
+							                                 -offsetX,
+							                                 -offsetY,
+							                                 image.width() - offsetX,
+							                                 image.height() - offsetY
+						                                 });
+						for (int y = inside.top; y < inside.bottom; y++)
+						{
+							CompositeSpan(
+							              target.row(y) + inside.left,
+							              image.row(y + offsetY) + inside.left + offsetX,
+							              static_cast<size_t>(inside.right - inside.left),
+							              command.alpha);
+						}
+						break;
+					}
+					const auto iw = static_cast<float>(image.width());
+					const auto ih = static_cast<float>(image.height());
+					Pixel samples[c_sample_run];
+					for (int y = box.top; y < box.bottom; y++)
+					{
+						//Sample positions come from x itself, not from stepping across the box
+						const Point start = toImage.apply(Point{0.5f, static_cast<float>(y) + 0.5f});
+						int first, last;
+						InsideRun(start, toImage, iw, ih, box.left, box.right, first, last);
+						for (int x = first; x < last;)
+						{
+							const int anchor = x - x % c_sample_run;
+							const int count = std::min(last, anchor + c_sample_run) - x;
+							if (command.interpolation == INTERPOLATION_MODE::NearestNeighbor)
+							{
+								for (int i = 0; i < count; i++)
+								{
+									const auto fx = static_cast<float>(x + i);
+									samples[i] = image.row(static_cast<int>(start.y + fx * toImage.m12))[
+										static_cast<int>(start.x + fx * toImage.m11)];
+								}
+							}
+							else
+							{
+								//Texel centers are half a pixel in, 16.16 fixed point from here on
+								const auto fx = static_cast<double>(anchor);
+								const std::int64_t du = std::llround(toImage.m11 * 65536.0);
+								const std::int64_t dv = std::llround(toImage.m12 * 65536.0);
+								SampleSpanLinear(
+								                 samples,
+								                 image,
+								                 std::llround((start.x + fx * toImage.m11 - 0.5) * 65536.0) + (x - anchor) * du,
+								                 std::llround((start.y + fx * toImage.m12 - 0.5) * 65536.0) + (x - anchor) * dv,
+								                 du,
+								                 dv,
+								                 static_cast<size_t>(count));
+							}
+							CompositeSpan(target.row(y) + x, samples, static_cast<size_t>(count), command.alpha);
+							x += count;
+						}
+					}
+					break;
+				}
+				case COMMAND::Mask:
+				{
+					const Mask& mask = *command.mask;
+					const Pixel color = command.color;
+					for (size_t i = command.quadBegin; i < command.quadEnd; i++)
+					{
+						const MaskQuad& quad = maskQuads[i];
+						const IntRect part = Intersect(box, IntRect{quad.x, quad.y, quad.x + quad.width, quad.y + quad.height});
+						for (int y = part.top; y < part.bottom; y++)
+						{
+							const std::uint8_t* src = mask.row(quad.v + y - quad.y) + quad.u - quad.x;
+							Pixel* dst = target.row(y);
+							for (int x = part.left; x < part.right; x++)
+							{
+								const std::uint32_t coverage = src[x];
+								if (coverage == 0)
+								{
+									continue;
+								}
+								const Pixel paint = coverage == 255 ? color : ScalePixel(color, coverage);
+								dst[x] = (paint >> 24) == 255 ? paint : BlendPixel(dst[x], paint);
+							}
+						}
+					}
+					break;
+				}
+				case COMMAND::Sprites:
+				{
+					const Image& page = *command.image;
+					for (size_t i = command.quadBegin; i < command.quadEnd; i++)
+					{
+						const SpriteQuad& quad = spriteQuads[i];
+						const IntRect part = Intersect(box, quad.bounds);
+						if (part.empty())
+						{
+							continue;
+						}
+						const Affine& toImage = quad.toImage;
+						const IntRect& region = quad.region;
+						const int width = region.right - region.left, height = region.bottom - region.top;
+						//Unscaled on whole pixels, rows of the page are composited as they are
+						int offsetX, offsetY;
+						if (WholePixelOffset(toImage, offsetX, offsetY))
+						{
+							const IntRect inside = Intersect(part, IntRect{-offsetX, -offsetY, width - offsetX, height - offsetY});
+							for (int y = inside.top; y < inside.bottom; y++)
+							{
+								CompositeSpan(
+								              target.row(y) + inside.left,
+								              page.row(region.top + y + offsetY) + region.left + inside.left + offsetX,
+								              static_cast<size_t>(inside.right - inside.left),
+								              quad.alpha);
+							}
+							continue;
+						}
+						//Sampled Linear as the Image command does, the border around each region
+						//repeats its edges, so neighbours on the page do not bleed in
+						const std::int64_t du = std::llround(toImage.m11 * 65536.0);
+						const std::int64_t dv = std::llround(toImage.m12 * 65536.0);
+						const std::int64_t regionU = static_cast<std::int64_t>(region.left) << 16;
+						const std::int64_t regionV = static_cast<std::int64_t>(region.top) << 16;
+						Pixel samples[c_sample_run];
+						for (int y = part.top; y < part.bottom; y++)
+						{
+							const Point start = toImage.apply(Point{0.5f, static_cast<float>(y) + 0.5f});
+							int first, last;
+							InsideRun(start, toImage, static_cast<float>(width), static_cast<float>(height), part.left, part.right, first, last);
+							for (int x = first; x < last;)
+							{
+								const int anchor = x - x % c_sample_run;
+								const int count = std::min(last, anchor + c_sample_run) - x;
+								const auto fx = static_cast<double>(anchor);
+								SampleSpanLinear(
+								                 samples,
+								                 page,
+								                 regionU + std::llround((start.x + fx * toImage.m11 - 0.5) * 65536.0) + (x - anchor) * du,
+								                 regionV + std::llround((start.y + fx * toImage.m12 - 0.5) * 65536.0) + (x - anchor) * dv,
+								                 du,
+								                 dv,
+								                 static_cast<size_t>(count));
+								CompositeSpan(target.row(y) + x, samples, static_cast<size_t>(count), quad.alpha);
+								x += count;
+							}
+						}
+					}
+					break;
+				}
+			}
+		}
+
+		void Canvas::AddLine(const Point from, const Point to)
+		{
+			pendingLines.push_back(Line{from, to});
+		}
+
+		void Canvas::AddContour(const Point* points, const size_t count)
+		{
+			if (count < 3)
+			{
+				return;
+			}
+			const Point first = transform.apply(points[0]);
+			Point from = first;
+			for (size_t i = 1; i < count; i++)
+			{
+				const Point to = transform.apply(points[i]);
+				AddLine(from, to);
+				from = to;
+			}
+			AddLine(from, first);
+		}
+
+		void Canvas::FillCoverage(const Pixel color, const FillRule rule)
+		{
+			if ((color >> 24) == 0 || pendingLines.empty())
+			{
+				pendingLines.clear();
+				return;
+			}
+			float minX = pendingLines[0].from.x, maxX = minX;
+			float minY = pendingLines[0].from.y, maxY = minY;
+			for (const Line& line : pendingLines)
+			{
+				minX = std::min(minX, std::min(line.from.x, line.to.x));
+				maxX = std::max(maxX, std::max(line.from.x, line.to.x));
+				minY = std::min(minY, std::min(line.from.y, line.to.y));
+				maxY = std::max(maxY, std::max(line.from.y, line.to.y));
+			}
+			//One pixel of slack for the rounding to 24.8
+			const float limit = static_cast<float>(1 << 30);
+			//NaN goes left as in the rasterizer, a box it makes empty is culled
+			const auto toInt = [limit](const float v) { return static_cast<int>(v > -limit ? std::min(v, limit) : -limit); };
+			Command command{};
+			command.kind = COMMAND::Coverage;
+			command.color = color;
+			command.rule = rule;
+			command.bounds = IntRect{
+				toInt(std::floor(minX)) - 1,
+				toInt(std::floor(minY)) - 1,
+				toInt(std::ceil(maxX)) + 1,
+				toInt(std::ceil(maxY)) + 1
+			};
+			Record(std::move(command));
+		}
+
+		void Canvas::FlattenEllipse(const Ellipse& ellipse)
+		{
+			const float scale = std::sqrt(std::fabs(transform.m11 * transform.m22 - transform.m12 * transform.m21));
+			const float radius = std::max(std::fabs(ellipse.radius_x), std::fabs(ellipse.radius_y)) * scale;
+			size_t count = 8;
+			if (radius > 0.25f)
+			{
+				//Keep the chord error under a quarter pixel
+				const float step = std::acos(1.f - 0.25f / radius);
+				count = std::min<size_t>(1024, std::max<size_t>(8, static_cast<size_t>(std::ceil(PI / step))));
+			}
+			//Ellipses in a batch mostly share a size, the circle is only redone when it changes
+			if (unitCircle.size() != count)
+			{
+				unitCircle.resize(count);
+				for (size_t i = 0; i < count; i++)
+				{
+					const float t = TWO_PI * static_cast<float>(i) / static_cast<float>(count);
+					unitCircle[i] = Point{std::cos(t), std::sin(t)};
+				}
+			}
+			scratch.resize(count);
+			for (size_t i = 0; i < count; i++)
+			{
+				scratch[i] = Point{
+					ellipse.center.x + ellipse.radius_x * unitCircle[i].x,
+					ellipse.center.y + ellipse.radius_y * unitCircle[i].y
+				};
+			}
+		}
+
+		void Canvas::clear(const Pixel color)
+		{
+			Command command{};
+			command.kind = COMMAND::Clear;
+			command.color = color;
+			command.bounds = clip;
+			Record(std::move(command));
+		}
+
+		void Canvas::FillRectPoly(const Rect& rect, const Pixel color)
+		{
+			const Point corners[] = {
+				{rect.left, rect.top},
+				{rect.right, rect.top},
+				{rect.right, rect.bottom},
+				{rect.left, rect.bottom}
+			};
+			fill_poly(corners, 4, color, FillRule::NonZero);
+		}
+
+		void Canvas::FillRects(const Rect* rects, const Pixel* colors, const size_t colorStep, const size_t count)
+		{
+			if (!transform.is_translation())
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					if ((colors[i * colorStep] >> 24) != 0)
+					{
+						FillRectPoly(rects[i], colors[i * colorStep]);
+					}
+				}
+				return;
+			}
+			//Edges are worked out a block at a time into plain arrays so the loop vectorizes
+			constexpr size_t block = 256;
+			float left[block], top[block], right[block], bottom[block];
+			const float dx = transform.dx;
+			const float dy = transform.dy;
+			const float limit = static_cast<float>(1 << 30);
+			for (size_t begin = 0; begin < count; begin += block)
+			{
+				const Rect* const batch = rects + begin;
+				const size_t n = std::min(block, count - begin);
+				for (size_t i = 0; i < n; i++)
+				{
+					left[i] = std::min(batch[i].left, batch[i].right) + dx;
+					right[i] = std::max(batch[i].left, batch[i].right) + dx;
+					top[i] = std::min(batch[i].top, batch[i].bottom) + dy;
+					bottom[i] = std::max(batch[i].top, batch[i].bottom) + dy;
+				}
+				for (size_t i = 0; i < n; i++)
+				{
+					const Pixel color = colors[(begin + i) * colorStep];
+					if ((color >> 24) == 0)
+					{
+						continue;
+					}
+					//Only a rect on the pixel grid has no partially covered edge pixels
+					if (std::floor(left[i]) != left[i] || std::floor(right[i]) != right[i] ||
+						std::floor(top[i]) != top[i] || std::floor(bottom[i]) != bottom[i])
+					{
+						FillRectPoly(batch[i], color);
+						continue;
+					}
+					const IntRect bounds{
+						static_cast<int>(std::max(left[i], -limit)),
+						static_cast<int>(std::max(top[i], -limit)),
+						static_cast<int>(std::min(right[i], limit)),
+						static_cast<int>(std::min(bottom[i], limit))
+					};
+					if (Deferred())
+					{
+						Command command{};
+						command.kind = COMMAND::Rect;
+						command.color = color;
+						command.bounds = bounds;
+						Record(std::move(command));
+						continue;
+					}
+					const IntRect box = Intersect(bounds, clip);
+					if (box.empty())
+					{
+						continue;
+					}
+					for (int y = box.top; y < box.bottom; y++)
+					{
+						FillSpan(target.row(y) + box.left, static_cast<size_t>(box.right - box.left), color);
+					}
+				}
+			}
+		}
+
+		bool Canvas::OffClip(const Ellipse& ellipse, const float margin) const
+		{
+			//Bounds of the axes after the transform
+			const float spanX = std::fabs(transform.m11) + std::fabs(transform.m21);
+			const float spanY = std::fabs(transform.m12) + std::fabs(transform.m22);
+			const Point center = transform.apply(ellipse.center);
+			const float radius = std::max(std::fabs(ellipse.radius_x), std::fabs(ellipse.radius_y)) + margin;
+			const float extentX = radius * spanX + 1.f;
+			const float extentY = radius * spanY + 1.f;
+			return !(center.x + extentX > static_cast<float>(clip.left) && center.x - extentX < static_cast<float>(clip.right) &&
+				center.y + extentY > static_cast<float>(clip.top) && center.y - extentY < static_cast<float>(clip.bottom));
+		}
+
+		bool Canvas::OffClip(const Rect& bounds, const float margin) const
+		{
+			const Point corners[] = {
+				transform.apply(Point{bounds.left - margin, bounds.top - margin}),
+				transform.apply(Point{bounds.right + margin, bounds.top - margin}),
+				transform.apply(Point{bounds.left - margin, bounds.bottom + margin}),
+				transform.apply(Point{bounds.right + margin, bounds.bottom + margin})
+			};
+			float minX = corners[0].x, maxX = minX, minY = corners[0].y, maxY = minY;
+			for (const Point& corner : corners)
+			{
+				minX = std::min(minX, corner.x);
+				maxX = std::max(maxX, corner.x);
+				minY = std::min(minY, corner.y);
+				maxY = std::max(maxY, corner.y);
+			}
+			//NaN bounds are not culled here, the rasterizer drops what it cannot place
+			return maxX + 1.f <= static_cast<float>(clip.left) || minX - 1.f >= static_cast<float>(clip.right) ||
+				maxY + 1.f <= static_cast<float>(clip.top) || minY - 1.f >= static_cast<float>(clip.bottom);
+		}
+
+		Rect Canvas::StrokeArea(const Rect& bounds, const StrokeStyle& style) const
+		{
+			const float infinity = std::numeric_limits<float>::infinity();
+			const Rect everything{-infinity, -infinity, infinity, infinity};
+			if (style.dashes.empty())
+			{
+				return everything;
+			}
+			//A singular transform shows nothing, an inverted rect keeps every dash out
+			Affine inverse;
+			if (!transform.invert(inverse))
+			{
+				return Rect{infinity, infinity, -infinity, -infinity};
+			}
+			//A device pixel around the clip for antialiasing
+			const float left = static_cast<float>(clip.left) - 1.f;
+			const float top = static_cast<float>(clip.top) - 1.f;
+			const float right = static_cast<float>(clip.right) + 1.f;
+			const float bottom = static_cast<float>(clip.bottom) + 1.f;
+			const Point corners[] = {
+				inverse.apply(Point{left, top}),
+				inverse.apply(Point{right, top}),
+				inverse.apply(Point{left, bottom}),
+				inverse.apply(Point{right, bottom})
+			};
+			Rect area{corners[0].x, corners[0].y, corners[0].x, corners[0].y};
+			for (const Point& corner : corners)
+			{
+				area.left = std::min(area.left, corner.x);
+				area.top = std::min(area.top, corner.y);
+				area.right = std::max(area.right, corner.x);
+				area.bottom = std::max(area.bottom, corner.y);
+			}
+			if (bounds.left >= area.left && bounds.top >= area.top && bounds.right <= area.right && bounds.bottom <= area.bottom)
+			{
+				return everything;
+			}
+			return area;
+		}
+
+		void Canvas::FillEllipses(const Ellipse* ellipses, const Pixel* colors, const size_t colorStep, const size_t count)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				const Pixel color = colors[i * colorStep];
+				if ((color >> 24) == 0)
+				{
+					continue;
+				}
+				const Ellipse& ellipse = ellipses[i];
+				if (OffClip(ellipse, 0.f))
+				{
+					continue;
+				}
+				FlattenEllipse(ellipse);
+				AddContour(scratch.data(), scratch.size());
+				FillCoverage(color);
+			}
+		}
+
+		void Canvas::StrokeLines(
+			const Point* ends,
+			const Pixel* colors,
+			const size_t colorStep,
+			const size_t count,
+			const float width,
+			const StrokeStyle& style)
+		{
+			//Without dashes or caps each line is one quad, the stroker and its cache are skipped
+			const bool plain = style.dashes.empty() && style.start_cap == CAP_STYLE::Flat && style.end_cap == CAP_STYLE::Flat;
+			if (!plain)
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					stroke_poly(ends + 2 * i, 2, false, width, colors[i * colorStep], style);
+				}
+				return;
+			}
+			if (!(width > 0.f))
+			{
+				return;
+			}
+			const float half = width * 0.5f;
+			for (size_t i = 0; i < count; i++)
+			{
+				const Pixel color = colors[i * colorStep];
+				const Point from = ends[2 * i];
+				const Point to = ends[2 * i + 1];
+				const float dx = to.x - from.x;
+				const float dy = to.y - from.y;
+				const float length = std::sqrt(dx * dx + dy * dy);
+				if ((color >> 24) == 0 || !(length > 1e-5f))
+				{
+					continue;
+				}
+				//Same rounding as the stroker, a batch draws what single lines do
+				const float inverse = 1.f / length;
+				const float nx = -(dy * inverse) * half;
+				const float ny = dx * inverse * half;
+				const Point quad[] = {
+					{from.x + nx, from.y + ny},
+					{to.x + nx, to.y + ny},
+					{to.x - nx, to.y - ny},
+					{from.x - nx, from.y - ny}
+				};
+				AddContour(quad, 4);
+				FillCoverage(color);
+			}
+		}
+
+		void Canvas::fill_rect(const Rect rect, const Pixel color)
+		{
+			FillRects(&rect, &color, 0, 1);
+		}
+
+		void Canvas::fill_rects(const Rect* rects, const size_t count, const Pixel color)
+		{
+			FillRects(rects, &color, 0, count);
+		}
+
+		void Canvas::fill_rects(const Rect* rects, const Pixel* colors, const size_t count)
+		{
+			FillRects(rects, colors, 1, count);
+		}
+
+		void Canvas::fill_ellipse(const Ellipse& ellipse, const Pixel color)
+		{
+			FillEllipses(&ellipse, &color, 0, 1);
+		}
+
+		void Canvas::fill_ellipses(const Ellipse* ellipses, const size_t count, const Pixel color)
+		{
+			FillEllipses(ellipses, &color, 0, count);
+		}
+
+		void Canvas::fill_ellipses(const Ellipse* ellipses, const Pixel* colors, const size_t count)
+		{
+			FillEllipses(ellipses, colors, 1, count);
+		}
+
+		void Canvas::fill_poly(const Point* points, const size_t count, const Pixel color, const FillRule rule)
+		{
+			AddContour(points, count);
+			FillCoverage(color, rule);
+		}
+
+		void Canvas::fill_figures(const Figures& figures, const Pixel color, const FillRule rule)
+		{
+			if ((color >> 24) == 0 || !(figures.bounds.left <= figures.bounds.right) || OffClip(figures.bounds, 0.f))
+			{
+				return;
+			}
+			size_t begin = 0;
+			for (const size_t end : figures.ends)
+			{
+				AddContour(figures.points.data() + begin, end - begin);
+				begin = end;
+			}
+			FillCoverage(color, rule);
+		}
+
+		void Canvas::stroke_figures(Figures& figures, const float width, const Pixel color, const StrokeStyle& style)
+		{
+			const float margin = 0.5f * std::fabs(width) * std::max(style.miter_limit, 1.5f);
+			if ((color >> 24) == 0 || !(figures.bounds.left <= figures.bounds.right) || OffClip(figures.bounds, margin))
+			{
+				return;
+			}
+			const float scale = std::sqrt(std::fabs(transform.m11 * transform.m22 - transform.m12 * transform.m21));
+			const float tolerance = 0.25f / std::max(scale, 1e-6f);
+			const Rect area = StrokeArea(figures.bounds, style);
+			Outline& outline = figures.stroke;
+			if (!figures.stroked || figures.strokeWidth != width || figures.strokeTolerance != tolerance ||
+				!(figures.strokeStyle == style) || std::memcmp(&figures.strokeArea, &area, sizeof(area)) != 0)
+			{
+				outline.clear();
+				size_t begin = 0;
+				for (size_t i = 0; i < figures.ends.size(); i++)
+				{
+					const size_t end = figures.ends[i];
+					StrokeOutline(figures.points.data() + begin, end - begin, figures.closed[i] != 0,
+					              width, style, tolerance, area, strokeScratch);
+					const size_t offset = outline.points.size();
+					outline.points.insert(outline.points.end(), strokeScratch.points.begin(), strokeScratch.points.end());
+					for (const size_t contourEnd : strokeScratch.ends)
+					{
+						outline.ends.push_back(offset + contourEnd);
+					}
+					begin = end;
+				}
+				figures.stroked = true;
+				figures.strokeWidth = width;
+				figures.strokeTolerance = tolerance;
+				figures.strokeStyle = style;
+				figures.strokeArea = area;
+			}
+			size_t begin = 0;
+			for (const size_t end : outline.ends)
+			{
+				AddContour(outline.points.data() + begin, end - begin);
+				begin = end;
+			}
+			FillCoverage(color);
+		}
+
+		void Canvas::stroke_line(const Point from, const Point to, const float width, const Pixel color, const StrokeStyle& style)
+		{
+			const Point points[] = {from, to};
+			stroke_poly(points, 2, false, width, color, style);
+		}
+
+		void Canvas::stroke_lines(const Point* ends, const size_t count, const float width, const Pixel color, const StrokeStyle& style)
+		{
+			StrokeLines(ends, &color, 0, count, width, style);
+		}
+
+		void Canvas::stroke_lines(
+			const Point* ends,
+			const Pixel* colors,
+			const size_t count,
+			const float width,
+			const StrokeStyle& style)
+		{
+			StrokeLines(ends, colors, 1, count, width, style);
+		}
+
+		void Canvas::stroke_poly(
+			const Point* points,
+			const size_t count,
+			const bool closed,
+			const float width,
+			const Pixel color,
+			const StrokeStyle& style)
+		{
+			if (count == 0 || (color >> 24) == 0)
+			{
+				return;
+			}
+			//Outlines are built before the transform, round parts stay within a quarter device pixel
+			const float scale = std::sqrt(std::fabs(transform.m11 * transform.m22 - transform.m12 * transform.m21));
+			const float tolerance = 0.25f / std::max(scale, 1e-6f);
+			Rect bounds{points[0].x, points[0].y, points[0].x, points[0].y};
+			if (!style.dashes.empty())
+			{
+				for (size_t i = 1; i < count; i++)
+				{
+					bounds.left = std::min(bounds.left, points[i].x);
+					bounds.top = std::min(bounds.top, points[i].y);
+					bounds.right = std::max(bounds.right, points[i].x);
+					bounds.bottom = std::max(bounds.bottom, points[i].y);
+				}
+			}
+			const Outline& outline = strokeCache.stroke(points, count, closed, width, style, tolerance,
+			                                            StrokeArea(bounds, style), strokeScratch);
+			size_t begin = 0;
+			for (const size_t end : outline.ends)
+			{
+				AddContour(outline.points.data() + begin, end - begin);
+				begin = end;
+			}
+			FillCoverage(color);
+		}
+
+		void Canvas::stroke_ellipse(const Ellipse& ellipse, const float width, const Pixel color, const StrokeStyle& style)
+		{
+			//Miters and square caps reach past half the width
+			if (OffClip(ellipse, 0.5f * std::fabs(width) * std::max(style.miter_limit, 1.5f)))
+			{
+				return;
+			}
+			FlattenEllipse(ellipse);
+			stroke_poly(scratch.data(), scratch.size(), true, width, color, style);
+		}
+
+		//Maps width x height image pixels onto rect under transform, false if that is degenerate.
+		//bounds gets the device pixels it touches
+		bool MapImage(
+			const Affine& transform,
+			const Rect& rect,
+			const float width,
+			const float height,
+			Affine& toImage,
+			IntRect& bounds)
+		{
+			//Image pixel space -> destination rect -> device
+			Affine toDevice;
+			const float sx = (rect.right - rect.left) / width;
+			const float sy = (rect.bottom - rect.top) / height;
+			toDevice.m11 = sx * transform.m11;
+			toDevice.m12 = sx * transform.m12;
+			toDevice.m21 = sy * transform.m21;
+			toDevice.m22 = sy * transform.m22;
+			const Point origin = transform.apply(Point{rect.left, rect.top});
+			toDevice.dx = origin.x;
+			toDevice.dy = origin.y;
+			if (!toDevice.invert(toImage))
+			{
+				return false;
+			}
+			const Point corners[] = {
+				toDevice.apply(Point{0.f, 0.f}),
+				toDevice.apply(Point{width, 0.f}),
+				toDevice.apply(Point{width, height}),
+				toDevice.apply(Point{0.f, height})
+			};
+			float minX = corners[0].x, maxX = corners[0].x, minY = corners[0].y, maxY = corners[0].y;
+			for (const Point& p : corners)
+			{
+				minX = std::min(minX, p.x);
+				maxX = std::max(maxX, p.x);
+				minY = std::min(minY, p.y);
+				maxY = std::max(maxY, p.y);
+			}
+			const float limit = static_cast<float>(1 << 30);
+			bounds = IntRect{
+				static_cast<int>(std::floor(std::max(minX, -limit))),
+				static_cast<int>(std::floor(std::max(minY, -limit))),
+				static_cast<int>(std::ceil(std::min(maxX, limit))),
+				static_cast<int>(std::ceil(std::min(maxY, limit)))
+			};
+			return true;
+		}
+
+		std::uint32_t OpacityAlpha(const float opacity)
+		{
+			return static_cast<std::uint32_t>(std::min(std::max(opacity, 0.f), 1.f) * 255.f + 0.5f);
+		}
+
+		void Canvas::draw_image(
+			const Rect rect,
+			std::shared_ptr<const Image> image,
+			const float opacity,
+			const INTERPOLATION_MODE interpolation)
+		{
+			if (image == nullptr || image->width() == 0 || image->height() == 0 ||
+				rect.right == rect.left || rect.bottom == rect.top)
+			{
+				return;
+			}
+			const std::uint32_t alpha = OpacityAlpha(opacity);
+			if (alpha == 0)
+			{
+				return;
+			}
+			Command command{};
+			if (!MapImage(transform, rect, static_cast<float>(image->width()), static_cast<float>(image->height()),
+			              command.toImage, command.bounds))
+			{
+				return;
+			}
+			command.interpolation = interpolation;
+			//Levels are not built for images drawn out of sight
+			if (interpolation == INTERPOLATION_MODE::HighQuality && !Intersect(command.bounds, clip).empty())
+			{
+				//Image pixels per device pixel along the axis the most of them fall on
+				const Affine& toImage = command.toImage;
+				const float footprint = std::max(std::hypot(toImage.m11, toImage.m12), std::hypot(toImage.m21, toImage.m22));
+				//Borrowed pixels change unseen, levels made from them would go stale
+				if (footprint >= 2.f && footprint < 1e9f && !image->borrowed())
+				{
+					if (auto level = image->mip(static_cast<int>(std::log2(footprint))))
+					{
+						//Odd sizes halve unevenly, the level is mapped by its own size
+						const float sx = static_cast<float>(level->width()) / static_cast<float>(image->width());
+						const float sy = static_cast<float>(level->height()) / static_cast<float>(image->height());
+						command.toImage.m11 *= sx;
+						command.toImage.m21 *= sx;
+						command.toImage.dx *= sx;
+						command.toImage.m12 *= sy;
+						command.toImage.m22 *= sy;
+						command.toImage.dy *= sy;
+						image = std::move(level);
+					}
+				}
+			}
+			if (interpolation == INTERPOLATION_MODE::HighQuality)
+			{
+				command.interpolation = INTERPOLATION_MODE::Linear;
+			}
+			command.kind = COMMAND::Image;
+			command.image = std::move(image);
+			command.alpha = alpha;
+			Record(std::move(command));
+		}
+
+		void Canvas::draw_sprites(
+			const std::shared_ptr<const Image>* pages,
+			const size_t pageCount,
+			const AtlasRegion* regions,
+			const size_t regionCount,
+			const Sprite* sprites,
+			const size_t count)
+		{
+			std::shared_ptr<const Image> page;
+			size_t run = spriteQuads.size();
+			for (size_t i = 0; i < count; i++)
+			{
+				const Sprite& sprite = sprites[i];
+				if (sprite.index >= regionCount)
+				{
+					continue;
+				}
+				const AtlasRegion& region = regions[sprite.index];
+				const Rect& rect = sprite.rect;
+				const std::uint32_t alpha = OpacityAlpha(sprite.opacity);
+				if (region.page >= pageCount || pages[region.page] == nullptr || region.width <= 0 ||
+					region.height <= 0 || alpha == 0 || rect.right == rect.left || rect.bottom == rect.top)
+				{
+					continue;
+				}
+				SpriteQuad quad;
+				if (!MapImage(transform, rect, static_cast<float>(region.width), static_cast<float>(region.height),
+				              quad.toImage, quad.bounds) || Intersect(quad.bounds, clip).empty())
+				{
+					continue;
+				}
+				quad.region = IntRect{region.x, region.y, region.x + region.width, region.y + region.height};
+				quad.alpha = alpha;
+				//A command holds one page, and few enough sprites that a tile does not walk many it misses
+				if (pages[region.page] != page || spriteQuads.size() - run == c_sprites_per_command)
+				{
+					DrawSpriteQuads(std::move(page), run);
+					page = pages[region.page];
+					run = spriteQuads.size();
+				}
+				spriteQuads.push_back(quad);
+			}
+			DrawSpriteQuads(std::move(page), run);
+		}
+
+		void Canvas::DrawSpriteQuads(std::shared_ptr<const Image> page, const size_t begin)
+		{
+			if (begin == spriteQuads.size())
+			{
+				return;
+			}
+			Command command{};
+			command.kind = COMMAND::Sprites;
+			command.bounds = spriteQuads[begin].bounds;
+			for (size_t i = begin; i < spriteQuads.size(); i++)
+			{
+				const IntRect& bounds = spriteQuads[i].bounds;
+				command.bounds.left = std::min(command.bounds.left, bounds.left);
+				command.bounds.top = std::min(command.bounds.top, bounds.top);
+				command.bounds.right = std::max(command.bounds.right, bounds.right);
+				command.bounds.bottom = std::max(command.bounds.bottom, bounds.bottom);
+			}
+			command.image = std::move(page);
+			command.quadBegin = begin;
+			command.quadEnd = spriteQuads.size();
+			Record(std::move(command));
+			if (!Deferred())
+			{
+				spriteQuads.clear();
+			}
+		}
+
+		void Canvas::FillMasks(std::shared_ptr<const Mask> mask, const size_t begin, const Pixel color)
+		{
+			if (begin == maskQuads.size())
+			{
+				return;
+			}
+			Command command{};
+			command.kind = COMMAND::Mask;
+			command.color = color;
+			command.bounds = IntRect{maskQuads[begin].x, maskQuads[begin].y, maskQuads[begin].x, maskQuads[begin].y};
+			for (size_t i = begin; i < maskQuads.size(); i++)
+			{
+				const MaskQuad& quad = maskQuads[i];
+				command.bounds.left = std::min(command.bounds.left, quad.x);
+				command.bounds.top = std::min(command.bounds.top, quad.y);
+				command.bounds.right = std::max(command.bounds.right, quad.x + quad.width);
+				command.bounds.bottom = std::max(command.bounds.bottom, quad.y + quad.height);
+			}
+			command.mask = std::move(mask);
+			command.quadBegin = begin;
+			command.quadEnd = maskQuads.size();
+			Record(std::move(command));
+			if (!Deferred())
+			{
+				maskQuads.clear();
+			}
+		}
+
+		void Canvas::AddGlyphCells(const std::uint32_t code, const Point origin, const float size)
+		{
+			using namespace builtin_font;
+			const std::uint8_t* rows = builtin_font::Glyph(code);
+			const float cell = Cell(size);
+			for (int r = 0; r < c_rows; r++)
+			{
+				//A run of lit cells in a row is one rectangle
+				for (int c = 0; c < c_columns;)
+				{
+					if (!(rows[r] & (0x10 >> c)))
+					{
+						c++;
+						continue;
+					}
+					const int first = c;
+					while (c < c_columns && (rows[r] & (0x10 >> c)))
+					{
+						c++;
+					}
+					const float left = origin.x + static_cast<float>(first) * cell;
+					const float right = origin.x + static_cast<float>(c) * cell;
+					const float top = origin.y - static_cast<float>(c_rows - r) * cell;
+					const Point corners[] = {{left, top}, {right, top}, {right, top + cell}, {left, top + cell}};
+					AddContour(corners, 4);
+				}
+			}
+		}
+
+		void Canvas::draw_text(
+			const wchar_t* text,
+			const size_t length,
+			const Rect rect,
+			const float size,
+			const TEXT_ALIGN alignHorizontal,
+			const TEXT_ALIGN alignVertical,
+			const Pixel color)
+		{
+			if ((color >> 24) == 0 || length == 0 || !(size > 0.f && size < 1e6f))
+			{
+				return;
+			}
+			BreakLines(text, length, size, rect.right - rect.left, textLines);
+			const float lineHeight = builtin_font::LineHeight(size);
+			const float advance = builtin_font::Advance(size);
+			const float height = static_cast<float>(textLines.size()) * lineHeight;
+			const auto align = [](const TEXT_ALIGN align, const float from, const float to, const float extent)
+			{
+				switch (align)
+				{
+					case TEXT_ALIGN::Far:
+						return to - extent;
+					case TEXT_ALIGN::Center:
+						return (from + to - extent) / 2.f;
+					default:
+						return from;
+				}
+			};
+			const float top = align(alignVertical, rect.top, rect.bottom, height) + builtin_font::Ascent(size);
+			const bool shapes = !transform.is_translation() || size > GlyphAtlas::c_max_size;
+			//Quads of one command share a page, getting a glyph can start a new one
+			std::shared_ptr<const Mask> page = glyphAtlas.get_page();
+			size_t run = maskQuads.size();
+			for (size_t i = 0; i < textLines.size(); i++)
+			{
+				const TextLine& line = textLines[i];
+				const float baseline = top + static_cast<float>(i) * lineHeight;
+				float x = align(alignHorizontal, rect.left, rect.right, line.width);
+				for (size_t k = line.begin; k < line.end; k++, x += advance)
+				{
+					const auto code = static_cast<std::uint32_t>(text[k]);
+					if (code == L' ')
+					{
+						continue;
+					}
+					if (shapes)
+					{
+						AddGlyphCells(code, Point{x, baseline}, size);
+						continue;
+					}
+					//Pens snap to quarter pixels across and whole pixels down
+					const Point pen = transform.apply(Point{x, baseline});
+					if (!(std::fabs(pen.x) < 1e9f && std::fabs(pen.y) < 1e9f))
+					{
+						continue;
+					}
+					const auto quarters = static_cast<long long>(std::floor(pen.x * 4.f + 0.5f));
+					const GlyphAtlas::Glyph* glyph = glyphAtlas.get(code, size, static_cast<int>(quarters & 3));
+					if (glyphAtlas.get_page() != page)
+					{
+						FillMasks(std::move(page), run, color);
+						page = glyphAtlas.get_page();
+						run = maskQuads.size();
+					}
+					if (glyph == nullptr)
+					{
+						continue;
+					}
+					const auto penX = static_cast<int>(quarters >> 2);
+					const auto penY = static_cast<int>(std::floor(pen.y + 0.5f));
+					maskQuads.push_back(MaskQuad{
+						penX + glyph->left,
+						penY + glyph->top,
+						glyph->u,
+						glyph->v,
+						glyph->width,
+						glyph->height
+					});
+				}
+			}
+			if (shapes)
+			{
+				FillCoverage(color, FillRule::NonZero);
+				return;
+			}
+			FillMasks(std::move(page), run, color);
+		}
+
+		void Canvas::set_pixel(const Point point, const Pixel color)
+		{
+			const Point p = transform.apply(point);
+			if (!(std::fabs(p.x) < 1e9f && std::fabs(p.y) < 1e9f))
+			{
+				return;
+			}
+			const auto x = static_cast<int>(std::floor(p.x));
+			const auto y = static_cast<int>(std::floor(p.y));
+			Command command{};
+			command.kind = COMMAND::Rect;
+			command.color = color;
+			command.bounds = IntRect{x, y, x + 1, y + 1};
+			Record(std::move(command));
+		}
+
+		void Canvas::set_pixels(const Point* points, const Pixel* colors, const size_t count)
+		{
+			flush();
+			for (size_t i = 0; i < count; i++)
+			{
+				const Pixel color = colors[i];
+				if ((color >> 24) == 0)
+				{
+					continue;
+				}
+				const Point p = transform.apply(points[i]);
+				//Also false for NaN, the clip is never left of 0 so truncating floors
+				if (!(p.x >= clip.left && p.x < clip.right && p.y >= clip.top && p.y < clip.bottom))
+				{
+					continue;
+				}
+				Pixel& dst = target.row(static_cast<int>(p.y))[static_cast<int>(p.x)];
+				dst = (color >> 24) == 255 ? color : BlendPixel(dst, color);
+			}
+		}
+	}
+}
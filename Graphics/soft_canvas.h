@@ -0,0 +1,380 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "graph_types.h"
+#include "soft_raster.h"
+#include "soft_stroke.h"
+#include "soft_text.h"
+
+namespace graph
+{
+	namespace soft
+	{
+		//Premultiplied B8G8R8A8, read as 0xAARRGGBB from a little-endian word
+		typedef std::uint32_t Pixel;
+
+		Pixel PremultiplyColor(const Color& color, float opacity = 1.f);
+
+		//Same layout and multiply order as D2D1_MATRIX_3X2_F
+		struct Affine
+		{
+			float m11 = 1.f, m12 = 0.f;
+			float m21 = 0.f, m22 = 1.f;
+			float dx = 0.f, dy = 0.f;
+
+			Point apply(Point point) const
+			{
+				return Point{
+					point.x * m11 + point.y * m21 + dx,
+					point.x * m12 + point.y * m22 + dy
+				};
+			}
+
+			bool is_translation() const { return m11 == 1.f && m12 == 0.f && m21 == 0.f && m22 == 1.f; }
+
+			bool invert(Affine& inverse) const;
+
+			static Affine rotation(float radians, Point center);
+		};
+
+		//Premultiplied BGRA8 pixels, tightly packed in memory of its own, or rows pitch bytes
+		//apart in memory borrowed from the caller
+		class Image
+		{
+			int w = 0, h = 0;
+			std::vector<Pixel> pixels;
+			//First row, pixels.data() unless borrowed
+			Pixel* bits = nullptr;
+			size_t stride = 0;
+			//Called once borrowed memory is no longer used
+			std::function<void()> release;
+			//Levels from 1 on, built by mip
+			mutable std::vector<std::shared_ptr<const Image>> mips;
+
+			void Release();
+		public:
+			Image() = default;
+			Image(int width, int height);
+			~Image();
+
+			//Copies own their pixels, borrowed or not
+			Image(const Image& image);
+			Image(Image&& image) noexcept;
+			Image& operator=(const Image& image);
+			Image& operator=(Image&& image) noexcept;
+
+			//Reads and writes memory of the caller, which is 4-byte aligned with a pitch
+			//that is a multiple of 4, until the image is destroyed or resized, then calls release
+			static Image borrow(int width, int height, void* memory, size_t pitch, std::function<void()> release);
+
+			void resize(int width, int height);
+
+			int width() const { return w; }
+			int height() const { return h; }
+
+			//Byte count of a scanline
+			size_t pitch() const { return stride; }
+
+			bool borrowed() const { return bits != nullptr && bits != pixels.data(); }
+
+			//The image halved level times by averaging 2x2 blocks, down to 1x1 at most, null for
+			//level 0 and for an image of one pixel. Levels are
+			//built on first use and kept until resize, copy_from, assignment or discard_mips, which
+			//is up to whoever writes through row(). Not for one image drawn by several threads at once
+			std::shared_ptr<const Image> mip(int level) const;
+			void discard_mips() const { mips.clear(); }
+
+			Pixel* row(int y) { return reinterpret_cast<Pixel*>(reinterpret_cast<std::uint8_t*>(bits) + static_cast<size_t>(y) * stride); }
+
+			const Pixel* row(int y) const
+			{
+				return reinterpret_cast<const Pixel*>(reinterpret_cast<const std::uint8_t*>(bits) + static_cast<size_t>(y) * stride);
+			}
+
+			//pitch is byte count of a scanline of srcData
+			void copy_from(const void* srcData, size_t srcPitch);
+		};
+
+		//Polylines of a Path and what the canvas prepares from them, kept between draws
+		struct Figures
+		{
+			std::vector<Point> points;
+			//Figure i is points [ends[i - 1], ends[i])
+			std::vector<size_t> ends;
+			//Nonzero for figures joined back to their start
+			std::vector<std::uint8_t> closed;
+			//Bounds of points, inverted while there are none
+			Rect bounds{0.f, 0.f, -1.f, -1.f};
+
+			//Last stroke outline and what it was made with
+			Outline stroke;
+			bool stroked = false;
+			float strokeWidth = 0.f, strokeTolerance = 0.f;
+			StrokeStyle strokeStyle;
+			Rect strokeArea{0.f, 0.f, 0.f, 0.f};
+
+			void clear()
+			{
+				points.clear();
+				ends.clear();
+				closed.clear();
+				bounds = Rect{0.f, 0.f, -1.f, -1.f};
+				stroked = false;
+			}
+		};
+
+		class TaskPool;
+
+		//Rasterizer drawing into an Image with src-over blending.
+		//Coordinates are pixels, shapes are antialiased by their exact area coverage.
+		//With one thread every call draws immediately. With more, calls are recorded in
+		//device space and binned into 64x64 tiles, flush() then draws the tiles in parallel,
+		//each in call order. Both give the same pixels.
+		class Canvas
+		{
+			enum class COMMAND
+			{
+				Clear,
+				Rect,
+				Coverage,
+				Image,
+				Mask,
+				Sprites
+			};
+
+			struct Command
+			{
+				COMMAND kind;
+				Pixel color;
+				IntRect bounds;
+				FillRule rule;
+				std::shared_ptr<const Image> image;
+				Affine toImage;
+				INTERPOLATION_MODE interpolation;
+				std::uint32_t alpha;
+				//Mask commands copy coverage by maskQuads [quadBegin, quadEnd),
+				//Sprites commands draw spriteQuads in that range from image
+				std::shared_ptr<const Mask> mask;
+				size_t quadBegin, quadEnd;
+			};
+
+			//A sprite in device pixels, toImage maps to the pixels of its region of the page
+			struct SpriteQuad
+			{
+				IntRect bounds;
+				Affine toImage;
+				IntRect region;
+				std::uint32_t alpha;
+			};
+
+			struct Line
+			{
+				Point from, to;
+			};
+
+			//Commands touching a row of tiles, lines of Coverage commands are copied to
+			//every band they cross so a tile only walks the lines near it
+			struct Band
+			{
+				struct Item
+				{
+					size_t command;
+					size_t lineBegin, lineEnd;
+				};
+
+				std::vector<Item> items;
+				std::vector<Line> lines;
+			};
+
+			Image target;
+			IntRect clip{0, 0, 0, 0};
+			Affine transform;
+
+			Rasterizer rasterizer;
+			std::vector<Point> scratch;
+			//cos and sin of the last ellipse flattening, reused while the step count holds
+			std::vector<Point> unitCircle;
+			StrokeCache strokeCache;
+			Outline strokeScratch;
+
+			std::unique_ptr<TaskPool> pool;
+			std::vector<Rasterizer> workerRasterizers;
+			std::vector<Command> commands;
+			std::vector<Band> bands;
+			std::vector<Line> pendingLines;
+
+			GlyphAtlas glyphAtlas;
+			std::vector<MaskQuad> maskQuads;
+			std::vector<TextLine> textLines;
+			std::vector<SpriteQuad> spriteQuads;
+
+			bool Deferred() const { return pool != nullptr; }
+			void AddLine(Point from, Point to);
+			void AddContour(const Point* points, size_t count);
+			void FillCoverage(Pixel color, FillRule rule = FillRule::NonZero);
+			void FlattenEllipse(const Ellipse& ellipse);
+			//True if the ellipse grown by margin cannot touch the clip
+			bool OffClip(const Ellipse& ellipse, float margin) const;
+			bool OffClip(const Rect& bounds, float margin) const;
+			//Clip in user space for the stroker to dash within, infinite while all of bounds is in it
+			//so outlines cached before a scroll still match
+			Rect StrokeArea(const Rect& bounds, const StrokeStyle& style) const;
+
+			//Batches share these, colorStep 0 paints every shape with colors[0]
+			void FillRectPoly(const Rect& rect, Pixel color);
+			void FillRects(const Rect* rects, const Pixel* colors, size_t colorStep, size_t count);
+			void FillEllipses(const Ellipse* ellipses, const Pixel* colors, size_t colorStep, size_t count);
+			//Records maskQuads from begin on as one command
+			void FillMasks(std::shared_ptr<const Mask> mask, size_t begin, Pixel color);
+			//Records spriteQuads from begin on as one command
+			void DrawSpriteQuads(std::shared_ptr<const Image> page, size_t begin);
+			//Adds the lit cells of a glyph with its pen at origin, for text drawn as shapes
+			void AddGlyphCells(std::uint32_t code, Point origin, float size);
+
+			void StrokeLines(
+				const Point* ends,
+				const Pixel* colors,
+				size_t colorStep,
+				size_t count,
+				float width,
+				const StrokeStyle& style);
+
+			void Record(Command&& command);
+			void Execute(const Command& command, const IntRect& area, Rasterizer& raster,
+			             const Line* lines, size_t lineCount);
+			void DrawTile(size_t tile, Rasterizer& raster);
+			void DropCommands();
+			//Clip and bands for a new target size
+			void FitTarget();
+		public:
+			Canvas(int width, int height);
+			~Canvas();
+
+			void resize(int width, int height);
+			//Draws into image from now on, what was recorded is dropped.
+			//A borrowed image lets the pixels live elsewhere, such as in a shared Image
+			void set_target(Image&& image);
+
+			//Pending commands are not in the target until flush
+			Image& get_target() { return target; }
+			const Image& get_target() const { return target; }
+
+			//0 uses every core, 1 draws on the calling thread as calls come in
+			void set_threads(unsigned count);
+			unsigned get_threads() const;
+
+			//Draws what was recorded since the last flush
+			void flush();
+
+			//Drawing only changes pixels inside rect, kept inside the target.
+			//Flushes first so what was recorded before keeps the clip it was made under.
+			void set_clip(const IntRect& rect);
+			void reset_clip();
+			const IntRect& get_clip() const { return clip; }
+
+			void set_transform(const Affine& matrix) { transform = matrix; }
+			const Affine& get_transform() const { return transform; }
+
+			void clear(Pixel color);
+
+			void fill_rect(Rect rect, Pixel color);
+			void fill_ellipse(const Ellipse& ellipse, Pixel color);
+			void fill_poly(const Point* points, size_t count, Pixel color, FillRule rule = FillRule::EvenOdd);
+
+			//Batches draw like one call per shape in order, colors holds one color per shape
+			void fill_rects(const Rect* rects, size_t count, Pixel color);
+			void fill_rects(const Rect* rects, const Pixel* colors, size_t count);
+			void fill_ellipses(const Ellipse* ellipses, size_t count, Pixel color);
+			void fill_ellipses(const Ellipse* ellipses, const Pixel* colors, size_t count);
+
+			void stroke_line(Point from, Point to, float width, Pixel color, const StrokeStyle& style = StrokeStyle());
+			void stroke_poly(
+				const Point* points,
+				size_t count,
+				bool closed,
+				float width,
+				Pixel color,
+				const StrokeStyle& style = StrokeStyle());
+			void stroke_ellipse(const Ellipse& ellipse, float width, Pixel color, const StrokeStyle& style = StrokeStyle());
+
+			//Line i runs from ends[2 * i] to ends[2 * i + 1]
+			void stroke_lines(const Point* ends, size_t count, float width, Pixel color, const StrokeStyle& style = StrokeStyle());
+			void stroke_lines(
+				const Point* ends,
+				const Pixel* colors,
+				size_t count,
+				float width,
+				const StrokeStyle& style = StrokeStyle());
+
+			//Every figure is filled as if closed
+			void fill_figures(const Figures& figures, Pixel color, FillRule rule);
+			//Figures are stroked into one outline so where they overlap is painted once.
+			//The outline is kept in figures and reused while width, style and the transform scale hold.
+			void stroke_figures(Figures& figures, float width, Pixel color, const StrokeStyle& style);
+
+			//The image is kept alive until it has been drawn. HighQuality samples the mip of the
+			//image closest to the drawn size, borrowed images are drawn Linear as they may change
+			void draw_image(
+				Rect rect,
+				std::shared_ptr<const Image> image,
+				float opacity = 1.f,
+				INTERPOLATION_MODE interpolation = INTERPOLATION_MODE::Linear);
+
+			//Draws like draw_image of each sprite's region in order, Linear, sprites whose region or
+			//page is missing are skipped. Pages are kept alive until drawn
+			void draw_sprites(
+				const std::shared_ptr<const Image>* pages,
+				size_t pageCount,
+				const AtlasRegion* regions,
+				size_t regionCount,
+				const Sprite* sprites,
+				size_t count);
+
+			//Text in the built-in face, size is the font size. Glyphs come from an atlas and are
+			//copied as coverage, text under a transform other than a translation or bigger than
+			//GlyphAtlas::c_max_size is filled as shapes
+			void draw_text(
+				const wchar_t* text,
+				size_t length,
+				Rect rect,
+				float size,
+				TEXT_ALIGN alignHorizontal,
+				TEXT_ALIGN alignVertical,
+				Pixel color);
+
+			void set_pixel(Point point, Pixel color);
+
+			//Blends straight into the target after flushing what was recorded before
+			void set_pixels(const Point* points, const Pixel* colors, size_t count);
+		};
+
+		inline Pixel BlendPixel(Pixel dst, Pixel src)
+		{
+			const std::uint32_t inv = 255 - (src >> 24);
+			std::uint32_t rb = (dst & 0x00FF00FF) * inv + 0x00800080;
+			std::uint32_t ag = ((dst >> 8) & 0x00FF00FF) * inv + 0x00800080;
+			rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+			ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+			return src + (rb | ag);
+		}
+
+		//Multiplies every channel of a premultiplied pixel by alpha / 255
+		inline Pixel ScalePixel(Pixel color, std::uint32_t alpha)
+		{
+			std::uint32_t rb = (color & 0x00FF00FF) * alpha + 0x00800080;
+			std::uint32_t ag = ((color >> 8) & 0x00FF00FF) * alpha + 0x00800080;
+			rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+			ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+			return rb | ag;
+		}
+
+		//Straight alpha 0xAARRGGBB to a premultiplied pixel
+		inline Pixel PremultiplyPacked(std::uint32_t color)
+		{
+			return (color & 0xFF000000) | (ScalePixel(color, color >> 24) & 0x00FFFFFF);
+		}
+	}
+}
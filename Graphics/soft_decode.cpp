@@ -0,0 +1,938 @@
+#include "soft_decode.h"
+#include "soft_span.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace graph
+{
+	namespace soft
+	{
+		//Bigger images are taken as broken rather than allocated
+		const size_t c_max_pixels = static_cast<size_t>(1) << 28;
+
+#ifndef _WIN32
+		std::string Utf8(const std::wstring& text)
+		{
+			std::string name;
+			for (size_t i = 0; i < text.size(); i++)
+			{
+				const auto c = static_cast<std::uint32_t>(text[i]);
+				if (c < 0x80)
+				{
+					name += static_cast<char>(c);
+				}
+				else if (c < 0x800)
+				{
+					name += static_cast<char>(0xC0 | c >> 6);
+					name += static_cast<char>(0x80 | (c & 0x3F));
+				}
+				else if (c < 0x10000)
+				{
+					name += static_cast<char>(0xE0 | c >> 12);
+					name += static_cast<char>(0x80 | (c >> 6 & 0x3F));
+					name += static_cast<char>(0x80 | (c & 0x3F));
+				}
+				else
+				{
+					name += static_cast<char>(0xF0 | c >> 18);
+					name += static_cast<char>(0x80 | (c >> 12 & 0x3F));
+					name += static_cast<char>(0x80 | (c >> 6 & 0x3F));
+					name += static_cast<char>(0x80 | (c & 0x3F));
+				}
+			}
+			return name;
+		}
+#endif
+
+		bool ReadFile(const std::wstring& path, std::vector<std::uint8_t>& data)
+		{
+#ifdef _WIN32
+			FILE* file = nullptr;
+			if (_wfopen_s(&file, path.c_str(), L"rb") != 0)
+			{
+				file = nullptr;
+			}
+#else
+			FILE* file = std::fopen(Utf8(path).c_str(), "rb");
+#endif
+			if (file == nullptr)
+			{
+				return false;
+			}
+			data.clear();
+			std::uint8_t buffer[1 << 16];
+			size_t read;
+			while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+			{
+				data.insert(data.end(), buffer, buffer + read);
+			}
+			const bool failed = std::ferror(file) != 0;
+			std::fclose(file);
+			return !failed;
+		}
+
+		//Deflate, RFC 1951
+
+		//LSB first, reading past the end gives zeros and is checked for after
+		struct BitReader
+		{
+			const std::uint8_t* data;
+			size_t size, pos;
+			std::uint64_t buffer;
+			int count;
+
+			void Need(const int bits)
+			{
+				while (count < bits)
+				{
+					const std::uint64_t byte = pos < size ? data[pos] : 0;
+					pos++;
+					buffer |= byte << count;
+					count += 8;
+				}
+			}
+
+			std::uint32_t Take(const int bits)
+			{
+				if (bits == 0)
+				{
+					return 0;
+				}
+				Need(bits);
+				const auto value = static_cast<std::uint32_t>(buffer & ((static_cast<std::uint64_t>(1) << bits) - 1));
+				buffer >>= bits;
+				count -= bits;
+				return value;
+			}
+
+			bool Overrun() const
+			{
+				return pos * 8 - static_cast<size_t>(count) > size * 8;
+			}
+		};
+
+		const int c_max_code_bits = 15;
+		//Codes up to this long are decoded with one table lookup
+		const int c_fast_bits = 10;
+
+		//Canonical Huffman code from code lengths
+		struct Huffman
+		{
+			std::uint16_t counts[c_max_code_bits + 1];
+			std::uint16_t symbols[288];
+			//Code length << 9 | symbol by the next c_fast_bits bits, 0 for longer codes
+			std::uint16_t fast[1 << c_fast_bits];
+
+			bool Build(const std::uint8_t* lengths, const int n)
+			{
+				std::fill(counts, counts + c_max_code_bits + 1, static_cast<std::uint16_t>(0));
+				for (int i = 0; i < n; i++)
+				{
+					counts[lengths[i]]++;
+				}
+				//Over-subscribed lengths are broken, incomplete ones are allowed
+				int left = 1;
+				for (int len = 1; len <= c_max_code_bits; len++)
+				{
+					left = (left << 1) - counts[len];
+					if (left < 0)
+					{
+						return false;
+					}
+				}
+				std::uint16_t offsets[c_max_code_bits + 1];
+				offsets[1] = 0;
+				for (int len = 1; len < c_max_code_bits; len++)
+				{
+					offsets[len + 1] = static_cast<std::uint16_t>(offsets[len] + counts[len]);
+				}
+				for (int i = 0; i < n; i++)
+				{
+					if (lengths[i] != 0)
+					{
+						symbols[offsets[lengths[i]]++] = static_cast<std::uint16_t>(i);
+					}
+				}
+				std::fill(fast, fast + (1 << c_fast_bits), static_cast<std::uint16_t>(0));
+				int code = 0, index = 0;
+				for (int len = 1; len <= c_fast_bits; len++)
+				{
+					for (int i = 0; i < counts[len]; i++, index++, code++)
+					{
+						//Codes are sent from their top bit, the reader is LSB first
+						int reversed = 0;
+						for (int b = 0; b < len; b++)
+						{
+							reversed |= (code >> b & 1) << (len - 1 - b);
+						}
+						const auto entry = static_cast<std::uint16_t>(len << 9 | symbols[index]);
+						for (int r = reversed; r < 1 << c_fast_bits; r += 1 << len)
+						{
+							fast[r] = entry;
+						}
+					}
+					code <<= 1;
+				}
+				return true;
+			}
+
+			//-1 for a code that is not in the table
+			int Decode(BitReader& in) const
+			{
+				in.Need(c_max_code_bits);
+				const std::uint16_t entry = fast[in.buffer & ((1 << c_fast_bits) - 1)];
+				if (entry != 0)
+				{
+					in.buffer >>= entry >> 9;
+					in.count -= entry >> 9;
+					return entry & 0x1FF;
+				}
+				int code = 0, first = 0, index = 0;
+				for (int len = 1; len <= c_max_code_bits; len++)
+				{
+					code |= static_cast<int>(in.Take(1));
+					const int count = counts[len];
+					if (code - first < count)
+					{
+						return symbols[index + code - first];
+					}
+					index += count;
+					first = (first + count) << 1;
+					code <<= 1;
+				}
+				return -1;
+			}
+		};
+
+		const std::uint16_t c_length_base[29] = {
+			3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+		};
+		const std::uint8_t c_length_extra[29] = {
+			0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+		};
+		const std::uint16_t c_distance_base[30] = {
+			1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+			4097, 6145, 8193, 12289, 16385, 24577
+		};
+		const std::uint8_t c_distance_extra[30] = {
+			0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+		};
+
+		bool InflateBlock(BitReader& in, const Huffman& lengths, const Huffman& distances, std::vector<std::uint8_t>& out)
+		{
+			for (;;)
+			{
+				const int symbol = lengths.Decode(in);
+				if (symbol < 0 || in.Overrun())
+				{
+					return false;
+				}
+				if (symbol < 256)
+				{
+					out.push_back(static_cast<std::uint8_t>(symbol));
+					continue;
+				}
+				if (symbol == 256)
+				{
+					return true;
+				}
+				const int lengthCode = symbol - 257;
+				if (lengthCode >= 29)
+				{
+					return false;
+				}
+				const size_t length = c_length_base[lengthCode] + in.Take(c_length_extra[lengthCode]);
+				const int distanceCode = distances.Decode(in);
+				if (distanceCode < 0 || distanceCode >= 30)
+				{
+					return false;
+				}
+				const size_t distance = c_distance_base[distanceCode] + in.Take(c_distance_extra[distanceCode]);
+				if (distance > out.size())
+				{
+					return false;
+				}
+				//Byte by byte, the copy may overlap what it writes
+				const size_t at = out.size();
+				out.resize(at + length);
+				std::uint8_t* dst = out.data() + at;
+				const std::uint8_t* src = dst - distance;
+				for (size_t i = 0; i < length; i++)
+				{
+					dst[i] = src[i];
+				}
+			}
+		}
+
+		bool Inflate(const std::uint8_t* data, const size_t size, std::vector<std::uint8_t>& out)
+		{
+			BitReader in{data, size, 0, 0, 0};
+			Huffman lengths, distances;
+			bool last = false;
+			while (!last)
+			{
+				last = in.Take(1) != 0;
+				const std::uint32_t type = in.Take(2);
+				if (type == 0)
+				{
+					in.Take(in.count % 8);
+					const std::uint32_t length = in.Take(16);
+					if ((length ^ in.Take(16)) != 0xFFFF)
+					{
+						return false;
+					}
+					for (std::uint32_t i = 0; i < length; i++)
+					{
+						out.push_back(static_cast<std::uint8_t>(in.Take(8)));
+					}
+				}
+				else if (type == 1)
+				{
+					std::uint8_t fixed[288 + 30];
+					std::fill(fixed, fixed + 144, static_cast<std::uint8_t>(8));
+					std::fill(fixed + 144, fixed + 256, static_cast<std::uint8_t>(9));
+					std::fill(fixed + 256, fixed + 280, static_cast<std::uint8_t>(7));
+					std::fill(fixed + 280, fixed + 288, static_cast<std::uint8_t>(8));
+					std::fill(fixed + 288, fixed + 318, static_cast<std::uint8_t>(5));
+					lengths.Build(fixed, 288);
+					distances.Build(fixed + 288, 30);
+					if (!InflateBlock(in, lengths, distances, out))
+					{
+						return false;
+					}
+				}
+				else if (type == 2)
+				{
+					const int literalCount = static_cast<int>(in.Take(5)) + 257;
+					const int distanceCount = static_cast<int>(in.Take(5)) + 1;
+					const int codeCount = static_cast<int>(in.Take(4)) + 4;
+					static const std::uint8_t c_order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+					std::uint8_t codeLengths[19] = {};
+					for (int i = 0; i < codeCount; i++)
+					{
+						codeLengths[c_order[i]] = static_cast<std::uint8_t>(in.Take(3));
+					}
+					Huffman codes;
+					if (literalCount > 286 || distanceCount > 30 || !codes.Build(codeLengths, 19))
+					{
+						return false;
+					}
+					std::uint8_t all[286 + 30];
+					int n = 0;
+					while (n < literalCount + distanceCount)
+					{
+						const int symbol = codes.Decode(in);
+						if (symbol < 0 || in.Overrun())
+						{
+							return false;
+						}
+						if (symbol < 16)
+						{
+							all[n++] = static_cast<std::uint8_t>(symbol);
+							continue;
+						}
+						std::uint8_t value = 0;
+						int repeat;
+						if (symbol == 16)
+						{
+							if (n == 0)
+							{
+								return false;
+							}
+							value = all[n - 1];
+							repeat = 3 + static_cast<int>(in.Take(2));
+						}
+						else if (symbol == 17)
+						{
+							repeat = 3 + static_cast<int>(in.Take(3));
+						}
+						else
+						{
+							repeat = 11 + static_cast<int>(in.Take(7));
+						}
+						if (n + repeat > literalCount + distanceCount)
+						{
+							return false;
+						}
+						std::fill(all + n, all + n + repeat, value);
+						n += repeat;
+					}
+					//A block without an end code cannot finish
+					if (all[256] == 0 || !lengths.Build(all, literalCount) ||
+						!distances.Build(all + literalCount, distanceCount) ||
+						!InflateBlock(in, lengths, distances, out))
+					{
+						return false;
+					}
+				}
+				else
+				{
+					return false;
+				}
+				if (in.Overrun())
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool InflateZlib(const std::uint8_t* data, const size_t size, std::vector<std::uint8_t>& out)
+		{
+			//Deflate without a preset dictionary, the Adler-32 at the end is not checked
+			if (size < 2 || (data[0] & 0x0F) != 8 || (data[0] << 8 | data[1]) % 31 != 0 || (data[1] & 0x20) != 0)
+			{
+				return false;
+			}
+			return Inflate(data + 2, size - 2, out);
+		}
+
+		std::uint32_t ReadBE32(const std::uint8_t* p)
+		{
+			return static_cast<std::uint32_t>(p[0]) << 24 | static_cast<std::uint32_t>(p[1]) << 16 |
+				static_cast<std::uint32_t>(p[2]) << 8 | p[3];
+		}
+
+		std::uint32_t ReadLE32(const std::uint8_t* p)
+		{
+			return static_cast<std::uint32_t>(p[3]) << 24 | static_cast<std::uint32_t>(p[2]) << 16 |
+				static_cast<std::uint32_t>(p[1]) << 8 | p[0];
+		}
+
+		std::uint16_t ReadLE16(const std::uint8_t* p)
+		{
+			return static_cast<std::uint16_t>(p[1] << 8 | p[0]);
+		}
+
+		Pixel PackRGBA(const std::uint32_t r, const std::uint32_t g, const std::uint32_t b, const std::uint32_t a)
+		{
+			return PremultiplyPacked(a << 24 | r << 16 | g << 8 | b);
+		}
+
+		bool ValidSize(const std::uint64_t width, const std::uint64_t height)
+		{
+			return width > 0 && height > 0 && width < (1u << 24) && height < (1u << 24) && width * height <= c_max_pixels;
+		}
+
+		//PNG, ISO 15948
+
+		std::uint8_t Paeth(const int a, const int b, const int c)
+		{
+			const int p = a + b - c;
+			const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+			if (pa <= pb && pa <= pc)
+			{
+				return static_cast<std::uint8_t>(a);
+			}
+			return static_cast<std::uint8_t>(pb <= pc ? b : c);
+		}
+
+		//Undoes the filters of rows rows of rowBytes each, every one led by its filter type
+		bool Unfilter(std::uint8_t* data, const size_t rows, const size_t rowBytes, const size_t pixelBytes, std::uint8_t* out)
+		{
+			const std::uint8_t* previous = nullptr;
+			const std::vector<std::uint8_t> zeros(rowBytes, 0);
+			for (size_t y = 0; y < rows; y++)
+			{
+				const std::uint8_t filter = data[y * (rowBytes + 1)];
+				const std::uint8_t* src = data + y * (rowBytes + 1) + 1;
+				std::uint8_t* dst = out + y * rowBytes;
+				//The row above the first is taken as zeros
+				const std::uint8_t* up = previous ? previous : zeros.data();
+				const size_t lead = std::min(pixelBytes, rowBytes);
+				switch (filter)
+				{
+					case 0:
+						std::memcpy(dst, src, rowBytes);
+						break;
+					case 1:
+						std::memcpy(dst, src, lead);
+						for (size_t x = lead; x < rowBytes; x++)
+						{
+							dst[x] = static_cast<std::uint8_t>(src[x] + dst[x - pixelBytes]);
+						}
+						break;
+					case 2:
+						for (size_t x = 0; x < rowBytes; x++)
+						{
+							dst[x] = static_cast<std::uint8_t>(src[x] + up[x]);
+						}
+						break;
+					case 3:
+						for (size_t x = 0; x < lead; x++)
+						{
+							dst[x] = static_cast<std::uint8_t>(src[x] + (up[x] >> 1));
+						}
+						for (size_t x = lead; x < rowBytes; x++)
+						{
+							dst[x] = static_cast<std::uint8_t>(src[x] + ((dst[x - pixelBytes] + up[x]) >> 1));
+						}
+						break;
+					case 4:
+						for (size_t x = 0; x < lead; x++)
+						{
+							dst[x] = static_cast<std::uint8_t>(src[x] + up[x]);
+						}
+						for (size_t x = lead; x < rowBytes; x++)
+						{
+							dst[x] = static_cast<std::uint8_t>(src[x] + Paeth(dst[x - pixelBytes], up[x], up[x - pixelBytes]));
+						}
+						break;
+					default:
+						return false;
+				}
+				previous = dst;
+			}
+			return true;
+		}
+
+		bool DecodePng(const std::uint8_t* data, const size_t size, Image& image)
+		{
+			size_t pos = 8;
+			std::uint32_t width = 0, height = 0;
+			int depth = 0, colorType = -1, interlace = 0;
+			std::vector<std::uint8_t> compressed;
+			Pixel palette[256];
+			std::fill(palette, palette + 256, PackRGBA(0, 0, 0, 255));
+			std::uint8_t paletteAlpha[256];
+			std::fill(paletteAlpha, paletteAlpha + 256, static_cast<std::uint8_t>(255));
+			bool hasKey = false;
+			std::uint32_t key[3] = {};
+			std::uint8_t rgb[256][3] = {};
+			bool ended = false;
+			while (!ended && pos + 12 <= size)
+			{
+				const std::uint32_t length = ReadBE32(data + pos);
+				const std::uint8_t* type = data + pos + 4;
+				const std::uint8_t* body = data + pos + 8;
+				if (length > size - pos - 12)
+				{
+					return false;
+				}
+				if (std::memcmp(type, "IHDR", 4) == 0 && length >= 13)
+				{
+					width = ReadBE32(body);
+					height = ReadBE32(body + 4);
+					depth = body[8];
+					colorType = body[9];
+					interlace = body[12];
+					if (body[10] != 0 || body[11] != 0 || interlace > 1)
+					{
+						return false;
+					}
+				}
+				else if (std::memcmp(type, "PLTE", 4) == 0)
+				{
+					for (std::uint32_t i = 0; i < length / 3 && i < 256; i++)
+					{
+						std::memcpy(rgb[i], body + 3 * i, 3);
+					}
+				}
+				else if (std::memcmp(type, "tRNS", 4) == 0)
+				{
+					if (colorType == 3)
+					{
+						std::memcpy(paletteAlpha, body, std::min<size_t>(length, 256));
+					}
+					else if (colorType == 0 && length >= 2)
+					{
+						hasKey = true;
+						key[0] = key[1] = key[2] = body[0] << 8 | body[1];
+					}
+					else if (colorType == 2 && length >= 6)
+					{
+						hasKey = true;
+						for (int c = 0; c < 3; c++)
+						{
+							key[c] = body[2 * c] << 8 | body[2 * c + 1];
+						}
+					}
+				}
+				else if (std::memcmp(type, "IDAT", 4) == 0)
+				{
+					compressed.insert(compressed.end(), body, body + length);
+				}
+				else if (std::memcmp(type, "IEND", 4) == 0)
+				{
+					ended = true;
+				}
+				pos += 12 + static_cast<size_t>(length);
+			}
+			int channels;
+			switch (colorType)
+			{
+				case 0:
+				case 3:
+					channels = 1;
+					break;
+				case 2:
+					channels = 3;
+					break;
+				case 4:
+					channels = 2;
+					break;
+				case 6:
+					channels = 4;
+					break;
+				default:
+					return false;
+			}
+			const bool depthValid = depth == 8 || depth == 16 ||
+				((colorType == 0 || colorType == 3) && (depth == 1 || depth == 2 || depth == 4));
+			if (!depthValid || (colorType == 3 && depth == 16) || !ValidSize(width, height))
+			{
+				return false;
+			}
+			for (int i = 0; i < 256; i++)
+			{
+				palette[i] = PackRGBA(rgb[i][0], rgb[i][1], rgb[i][2], paletteAlpha[i]);
+			}
+
+			const size_t bitsPerPixel = static_cast<size_t>(channels) * depth;
+			const size_t pixelBytes = std::max<size_t>(1, bitsPerPixel / 8);
+			const auto rowBytesOf = [&](const size_t w) { return (w * bitsPerPixel + 7) / 8; };
+			static const int c_start_x[7] = {0, 4, 0, 2, 0, 1, 0};
+			static const int c_start_y[7] = {0, 0, 4, 0, 2, 0, 1};
+			static const int c_step_x[7] = {8, 8, 4, 4, 2, 2, 1};
+			static const int c_step_y[7] = {8, 8, 8, 4, 4, 2, 2};
+			const int passes = interlace ? 7 : 1;
+			size_t expected = 0;
+			for (int p = 0; p < passes; p++)
+			{
+				const size_t stepX = interlace ? c_step_x[p] : 1, stepY = interlace ? c_step_y[p] : 1;
+				const size_t startX = interlace ? c_start_x[p] : 0, startY = interlace ? c_start_y[p] : 0;
+				const size_t w = width > startX ? (width - startX + stepX - 1) / stepX : 0;
+				const size_t h = height > startY ? (height - startY + stepY - 1) / stepY : 0;
+				if (w > 0 && h > 0)
+				{
+					expected += h * (rowBytesOf(w) + 1);
+				}
+			}
+			std::vector<std::uint8_t> raw;
+			raw.reserve(expected);
+			if (!InflateZlib(compressed.data(), compressed.size(), raw) || raw.size() < expected)
+			{
+				return false;
+			}
+
+			Image decoded(static_cast<int>(width), static_cast<int>(height));
+			const int maxValue = (1 << depth) - 1;
+			std::vector<std::uint8_t> rows;
+			size_t offset = 0;
+			for (int p = 0; p < passes; p++)
+			{
+				const size_t stepX = interlace ? c_step_x[p] : 1, stepY = interlace ? c_step_y[p] : 1;
+				const size_t startX = interlace ? c_start_x[p] : 0, startY = interlace ? c_start_y[p] : 0;
+				const size_t w = width > startX ? (width - startX + stepX - 1) / stepX : 0;
+				const size_t h = height > startY ? (height - startY + stepY - 1) / stepY : 0;
+				if (w == 0 || h == 0)
+				{
+					continue;
+				}
+				const size_t rowBytes = rowBytesOf(w);
+				rows.resize(h * rowBytes);
+				if (!Unfilter(raw.data() + offset, h, rowBytes, pixelBytes, rows.data()))
+				{
+					return false;
+				}
+				offset += h * (rowBytes + 1);
+				for (size_t y = 0; y < h; y++)
+				{
+					const std::uint8_t* row = rows.data() + y * rowBytes;
+					Pixel* dst = decoded.row(static_cast<int>(startY + y * stepY));
+					//The common 8 bit truecolor rows, the rest sample by sample below
+					if (depth == 8 && colorType == 6 && stepX == 1)
+					{
+						ConvertSpan(PIXEL_FORMAT::RGBA8, row, dst, w);
+						continue;
+					}
+					if (depth == 8 && colorType == 2 && !hasKey && stepX == 1)
+					{
+						ConvertSpan(PIXEL_FORMAT::RGB8, row, dst, w);
+						continue;
+					}
+					if (depth == 8 && colorType == 0 && !hasKey && stepX == 1)
+					{
+						ConvertSpan(PIXEL_FORMAT::Gray8, row, dst, w);
+						continue;
+					}
+					for (size_t x = 0; x < w; x++)
+					{
+						//Channel c of this pixel, 16 bit samples whole, smaller ones unpacked
+						const auto sample = [&](const int c) -> std::uint32_t
+						{
+							if (depth == 16)
+							{
+								const std::uint8_t* s = row + (x * channels + c) * 2;
+								return static_cast<std::uint32_t>(s[0] << 8 | s[1]);
+							}
+							if (depth == 8)
+							{
+								return row[x * channels + c];
+							}
+							const size_t bit = x * depth;
+							return row[bit / 8] >> (8 - depth - bit % 8) & maxValue;
+						};
+						//To 8 bits, the high byte of 16 bit samples
+						const auto to8 = [&](const std::uint32_t v) -> std::uint32_t
+						{
+							return depth == 16 ? v >> 8 : depth == 8 ? v : v * 255 / maxValue;
+						};
+						Pixel pixel;
+						switch (colorType)
+						{
+							case 0:
+							{
+								const std::uint32_t v = sample(0);
+								const std::uint32_t g = to8(v);
+								pixel = PackRGBA(g, g, g, hasKey && v == key[0] ? 0 : 255);
+								break;
+							}
+							case 2:
+							{
+								const std::uint32_t r = sample(0), g = sample(1), b = sample(2);
+								const bool keyed = hasKey && r == key[0] && g == key[1] && b == key[2];
+								pixel = PackRGBA(to8(r), to8(g), to8(b), keyed ? 0 : 255);
+								break;
+							}
+							case 3:
+								pixel = palette[sample(0) & 0xFF];
+								break;
+							case 4:
+							{
+								const std::uint32_t g = to8(sample(0));
+								pixel = PackRGBA(g, g, g, to8(sample(1)));
+								break;
+							}
+							default:
+								pixel = PackRGBA(to8(sample(0)), to8(sample(1)), to8(sample(2)), to8(sample(3)));
+								break;
+						}
+						dst[startX + x * stepX] = pixel;
+					}
+				}
+			}
+			image = std::move(decoded);
+			return true;
+		}
+
+		//BMP, the Windows bitmap file
+
+		//Bits of a channel mask scaled to 8 bits, 255 for an empty mask
+		std::uint32_t MaskChannel(const std::uint32_t value, const std::uint32_t mask)
+		{
+			if (mask == 0)
+			{
+				return 255;
+			}
+			int shift = 0;
+			while (!(mask >> shift & 1))
+			{
+				shift++;
+			}
+			const std::uint32_t max = mask >> shift;
+			return static_cast<std::uint32_t>((static_cast<std::uint64_t>((value & mask) >> shift) * 255 + max / 2) / max);
+		}
+
+		bool DecodeBmp(const std::uint8_t* data, const size_t size, Image& image)
+		{
+			if (size < 54)
+			{
+				return false;
+			}
+			const std::uint32_t pixelOffset = ReadLE32(data + 10);
+			const std::uint32_t headerSize = ReadLE32(data + 14);
+			const auto width = static_cast<std::int32_t>(ReadLE32(data + 18));
+			const auto rawHeight = static_cast<std::int32_t>(ReadLE32(data + 22));
+			const std::uint16_t bits = ReadLE16(data + 28);
+			const std::uint32_t compression = ReadLE32(data + 30);
+			const bool topDown = rawHeight < 0;
+			const std::int64_t height = topDown ? -static_cast<std::int64_t>(rawHeight) : rawHeight;
+			if (headerSize < 40 || width <= 0 || !ValidSize(static_cast<std::uint64_t>(width), static_cast<std::uint64_t>(height)) ||
+				(bits != 8 && bits != 24 && bits != 32) || (compression != 0 && compression != 3) ||
+				(compression == 3 && bits != 32))
+			{
+				return false;
+			}
+			//32 bit BI_RGB keeps its fourth byte unused
+			std::uint32_t masks[4] = {0x00FF0000, 0x0000FF00, 0x000000FF, 0};
+			if (compression == 3)
+			{
+				if (size < 14 + 40 + 12)
+				{
+					return false;
+				}
+				masks[0] = ReadLE32(data + 54);
+				masks[1] = ReadLE32(data + 58);
+				masks[2] = ReadLE32(data + 62);
+				masks[3] = headerSize >= 56 && size >= 70 ? ReadLE32(data + 66) : 0;
+			}
+			Pixel palette[256];
+			if (bits == 8)
+			{
+				std::uint32_t colors = ReadLE32(data + 46);
+				if (colors == 0 || colors > 256)
+				{
+					colors = 256;
+				}
+				const size_t at = 14 + static_cast<size_t>(headerSize);
+				if (at > size || (size - at) / 4 < colors)
+				{
+					return false;
+				}
+				std::fill(palette, palette + 256, PackRGBA(0, 0, 0, 255));
+				for (std::uint32_t i = 0; i < colors; i++)
+				{
+					const std::uint8_t* entry = data + at + 4 * i;
+					palette[i] = PackRGBA(entry[2], entry[1], entry[0], 255);
+				}
+			}
+			const size_t stride = (static_cast<size_t>(width) * bits / 8 + 3) & ~static_cast<size_t>(3);
+			if (pixelOffset > size || (size - pixelOffset) / stride < static_cast<size_t>(height))
+			{
+				return false;
+			}
+			Image decoded(width, static_cast<int>(height));
+			for (int y = 0; y < decoded.height(); y++)
+			{
+				const std::uint8_t* src = data + pixelOffset + stride * static_cast<size_t>(topDown ? y : decoded.height() - 1 - y);
+				Pixel* dst = decoded.row(y);
+				for (int x = 0; x < width; x++)
+				{
+					if (bits == 8)
+					{
+						dst[x] = palette[src[x]];
+					}
+					else if (bits == 24)
+					{
+						dst[x] = PackRGBA(src[3 * x + 2], src[3 * x + 1], src[3 * x], 255);
+					}
+					else
+					{
+						const std::uint32_t value = ReadLE32(src + 4 * x);
+						dst[x] = PackRGBA(
+						                  MaskChannel(value, masks[0]),
+						                  MaskChannel(value, masks[1]),
+						                  MaskChannel(value, masks[2]),
+						                  MaskChannel(value, masks[3]));
+					}
+				}
+			}
+			image = std::move(decoded);
+			return true;
+		}
+
+		//PPM and PGM, Netpbm
+
+		bool DecodePnm(const std::uint8_t* data, const size_t size, Image& image)
+		{
+			const bool plain = data[1] == '2' || data[1] == '3';
+			const int channels = data[1] == '2' || data[1] == '5' ? 1 : 3;
+			size_t pos = 2;
+			//Whitespace and comments are skipped, -1 for a missing or broken number
+			const auto number = [&]() -> std::int64_t
+			{
+				for (;;)
+				{
+					while (pos < size && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r' || data[pos] == '\n'))
+					{
+						pos++;
+					}
+					if (pos < size && data[pos] == '#')
+					{
+						while (pos < size && data[pos] != '\n')
+						{
+							pos++;
+						}
+						continue;
+					}
+					break;
+				}
+				if (pos >= size || data[pos] < '0' || data[pos] > '9')
+				{
+					return -1;
+				}
+				std::int64_t value = 0;
+				while (pos < size && data[pos] >= '0' && data[pos] <= '9' && value < (1 << 24))
+				{
+					value = value * 10 + (data[pos++] - '0');
+				}
+				return value;
+			};
+			const std::int64_t width = number();
+			const std::int64_t height = number();
+			const std::int64_t maxValue = number();
+			if (width <= 0 || height <= 0 || maxValue <= 0 || maxValue > 65535 ||
+				!ValidSize(static_cast<std::uint64_t>(width), static_cast<std::uint64_t>(height)))
+			{
+				return false;
+			}
+			//A single whitespace byte ends the header of the binary forms
+			pos++;
+			const size_t sampleBytes = maxValue > 255 ? 2 : 1;
+			const size_t count = static_cast<size_t>(width) * static_cast<size_t>(height) * channels;
+			if (!plain && (pos > size || (size - pos) / sampleBytes < count))
+			{
+				return false;
+			}
+			const auto to8 = [maxValue](const std::int64_t v)
+			{
+				return static_cast<std::uint32_t>((std::min(v, maxValue) * 255 + maxValue / 2) / maxValue);
+			};
+			Image decoded(static_cast<int>(width), static_cast<int>(height));
+			for (int y = 0; y < decoded.height(); y++)
+			{
+				Pixel* dst = decoded.row(y);
+				for (int x = 0; x < decoded.width(); x++)
+				{
+					std::uint32_t c[3];
+					for (int i = 0; i < channels; i++)
+					{
+						std::int64_t v;
+						if (plain)
+						{
+							v = number();
+							if (v < 0)
+							{
+								return false;
+							}
+						}
+						else if (sampleBytes == 2)
+						{
+							v = data[pos] << 8 | data[pos + 1];
+							pos += 2;
+						}
+						else
+						{
+							v = data[pos++];
+						}
+						c[i] = to8(v);
+					}
+					dst[x] = channels == 1 ? PackRGBA(c[0], c[0], c[0], 255) : PackRGBA(c[0], c[1], c[2], 255);
+				}
+			}
+			image = std::move(decoded);
+			return true;
+		}
+
+		bool DecodeImage(const std::uint8_t* data, const size_t size, Image& image)
+		{
+			static const std::uint8_t c_png_signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+			if (size >= 8 && std::memcmp(data, c_png_signature, 8) == 0)
+			{
+				return DecodePng(data, size, image);
+			}
+			if (size >= 2 && data[0] == 'B' && data[1] == 'M')
+			{
+				return DecodeBmp(data, size, image);
+			}
+			if (size >= 3 && data[0] == 'P' && data[1] >= '2' && data[1] <= '6' && data[1] != '4')
+			{
+				return DecodePnm(data, size, image);
+			}
+			return false;
+		}
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "soft_canvas.h"
+
+namespace graph
+{
+	namespace soft
+	{
+		//Decodes PNG, BMP or PPM/PGM by its signature into premultiplied pixels.
+		//PNG: every color type, bit depth and interlacing. BMP: 8 bit palettes and 24 or 32 bit pixels,
+		//uncompressed or with bit fields. PPM and PGM: binary and plain, any maximum value.
+		//False for other formats and broken data, image is then left as it was
+		bool DecodeImage(const std::uint8_t* data, size_t size, Image& image);
+
+#ifndef _WIN32
+		//File names are UTF-8 outside Windows
+		std::string Utf8(const std::wstring& text);
+#endif
+
+		//Whole file, false if it cannot be read
+		bool ReadFile(const std::wstring& path, std::vector<std::uint8_t>& data);
+
+		//Raw deflate data or a zlib stream appended to out, false if broken
+		bool Inflate(const std::uint8_t* data, size_t size, std::vector<std::uint8_t>& out);
+		bool InflateZlib(const std::uint8_t* data, size_t size, std::vector<std::uint8_t>& out);
+	}
+}
@@ -0,0 +1,355 @@
+#include "soft_encode.h"
+#ifndef _WIN32
+#include "soft_decode.h"
+#endif
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace graph
+{
+	namespace soft
+	{
+		const std::uint16_t c_length_base[29] = {
+			3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+		};
+		const std::uint8_t c_length_extra[29] = {
+			0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+		};
+		const std::uint16_t c_distance_base[30] = {
+			1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+			4097, 6145, 8193, 12289, 16385, 24577
+		};
+		const std::uint8_t c_distance_extra[30] = {
+			0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+		};
+
+		const int c_hash_bits = 15;
+		const size_t c_window = 32768;
+		const size_t c_max_match = 258;
+
+		//Codes of the fixed Huffman tables, bit reversed as deflate sends them
+		struct FixedCodes
+		{
+			std::uint16_t literal[288];
+			std::uint8_t literalBits[288];
+			std::uint8_t distance[30];
+			//Length 3 to 258 to its symbol's index in c_length_base
+			std::uint8_t lengthIndex[259];
+			//Distance minus one to its code, below 256 directly and above by its top bits
+			std::uint8_t nearDistance[256];
+			std::uint8_t farDistance[256];
+
+			static std::uint32_t Reverse(std::uint32_t code, const int bits)
+			{
+				std::uint32_t res = 0;
+				for (int i = 0; i < bits; i++)
+				{
+					res = res << 1 | (code & 1);
+					code >>= 1;
+				}
+				return res;
+			}
+
+			FixedCodes()
+			{
+				for (std::uint32_t i = 0; i < 288; i++)
+				{
+					const int bits = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+					const std::uint32_t code = i < 144 ? 0x30 + i : i < 256 ? 0x190 + i - 144 : i < 280 ? i - 256 : 0xC0 + i - 280;
+					literal[i] = static_cast<std::uint16_t>(Reverse(code, bits));
+					literalBits[i] = static_cast<std::uint8_t>(bits);
+				}
+				for (std::uint32_t i = 0; i < 30; i++)
+				{
+					distance[i] = static_cast<std::uint8_t>(Reverse(i, 5));
+				}
+				for (std::uint8_t i = 0; i < 29; i++)
+				{
+					const int end = i + 1 < 29 ? c_length_base[i + 1] : 259;
+					for (int length = c_length_base[i]; length < end; length++)
+					{
+						lengthIndex[length] = i;
+					}
+				}
+				for (std::uint8_t i = 0; i < 30; i++)
+				{
+					const size_t end = i + 1 < 30 ? c_distance_base[i + 1] : c_window + 1;
+					for (size_t d = c_distance_base[i]; d < end; d++)
+					{
+						if (d <= 256)
+						{
+							nearDistance[d - 1] = i;
+						}
+						else
+						{
+							farDistance[(d - 1) >> 7] = i;
+						}
+					}
+				}
+			}
+		};
+
+		struct BitWriter
+		{
+			std::vector<std::uint8_t>& out;
+			std::uint64_t buffer = 0;
+			int count = 0;
+
+			explicit BitWriter(std::vector<std::uint8_t>& out) : out(out) {}
+
+			void Put(const std::uint32_t bits, const int length)
+			{
+				buffer |= static_cast<std::uint64_t>(bits) << count;
+				count += length;
+				if (count >= 32)
+				{
+					const std::uint8_t bytes[4] = {
+						static_cast<std::uint8_t>(buffer), static_cast<std::uint8_t>(buffer >> 8),
+						static_cast<std::uint8_t>(buffer >> 16), static_cast<std::uint8_t>(buffer >> 24)
+					};
+					out.insert(out.end(), bytes, bytes + 4);
+					buffer >>= 32;
+					count -= 32;
+				}
+			}
+
+			void Flush()
+			{
+				for (; count > 0; count -= 8)
+				{
+					out.push_back(static_cast<std::uint8_t>(buffer));
+					buffer >>= 8;
+				}
+				buffer = 0;
+				count = 0;
+			}
+		};
+
+		std::uint32_t Load32(const std::uint8_t* p)
+		{
+			std::uint32_t v;
+			std::memcpy(&v, p, 4);
+			return v;
+		}
+
+		std::uint32_t Adler32(const std::uint8_t* data, size_t size)
+		{
+			std::uint32_t a = 1, b = 0;
+			while (size > 0)
+			{
+				//Sums stay below 2^32 for this many bytes between reductions
+				const size_t run = (std::min)(size, static_cast<size_t>(5552));
+				for (size_t i = 0; i < run; i++)
+				{
+					a += data[i];
+					b += a;
+				}
+				a %= 65521;
+				b %= 65521;
+				data += run;
+				size -= run;
+			}
+			return b << 16 | a;
+		}
+
+		void DeflateZlib(const std::uint8_t* data, const size_t size, std::vector<std::uint8_t>& out)
+		{
+			static const FixedCodes c_codes;
+			//32K window, fastest level
+			out.push_back(0x78);
+			out.push_back(0x01);
+			BitWriter bits(out);
+			//One final block with fixed codes
+			bits.Put(1, 1);
+			bits.Put(1, 2);
+			const auto literal = [&](const std::uint8_t byte)
+			{
+				bits.Put(c_codes.literal[byte], c_codes.literalBits[byte]);
+			};
+			std::vector<std::int64_t> head(static_cast<size_t>(1) << c_hash_bits, -static_cast<std::int64_t>(c_window) - 1);
+			size_t i = 0;
+			while (i + 4 <= size)
+			{
+				const std::uint32_t word = Load32(data + i);
+				const std::uint32_t hash = word * 2654435761u >> (32 - c_hash_bits);
+				const std::int64_t candidate = head[hash];
+				head[hash] = static_cast<std::int64_t>(i);
+				const size_t distance = i - static_cast<size_t>(candidate);
+				if (static_cast<std::int64_t>(i) - candidate > static_cast<std::int64_t>(c_window) || Load32(data + candidate) != word)
+				{
+					literal(data[i]);
+					i++;
+					continue;
+				}
+				const size_t limit = (std::min)(c_max_match, size - i);
+				size_t length = 4;
+				while (length < limit && data[i + length - distance] == data[i + length])
+				{
+					length++;
+				}
+				const std::uint8_t lengthIndex = c_codes.lengthIndex[length];
+				const std::uint32_t lengthSymbol = 257 + lengthIndex;
+				bits.Put(c_codes.literal[lengthSymbol], c_codes.literalBits[lengthSymbol]);
+				bits.Put(static_cast<std::uint32_t>(length - c_length_base[lengthIndex]), c_length_extra[lengthIndex]);
+				const std::uint8_t distanceCode = distance <= 256
+					                                  ? c_codes.nearDistance[distance - 1]
+					                                  : c_codes.farDistance[(distance - 1) >> 7];
+				bits.Put(c_codes.distance[distanceCode], 5);
+				bits.Put(static_cast<std::uint32_t>(distance - c_distance_base[distanceCode]), c_distance_extra[distanceCode]);
+				i += length;
+			}
+			for (; i < size; i++)
+			{
+				literal(data[i]);
+			}
+			bits.Put(c_codes.literal[256], c_codes.literalBits[256]);
+			bits.Flush();
+			const std::uint32_t adler = Adler32(data, size);
+			for (int shift = 24; shift >= 0; shift -= 8)
+			{
+				out.push_back(static_cast<std::uint8_t>(adler >> shift));
+			}
+		}
+
+		std::uint32_t Crc32(const std::uint8_t* data, const size_t size)
+		{
+			struct Table
+			{
+				std::uint32_t entries[256];
+
+				Table()
+				{
+					for (std::uint32_t i = 0; i < 256; i++)
+					{
+						std::uint32_t c = i;
+						for (int k = 0; k < 8; k++)
+						{
+							c = c & 1 ? 0xEDB88320u ^ c >> 1 : c >> 1;
+						}
+						entries[i] = c;
+					}
+				}
+			};
+			static const Table c_table;
+			std::uint32_t crc = 0xFFFFFFFFu;
+			for (size_t i = 0; i < size; i++)
+			{
+				crc = c_table.entries[(crc ^ data[i]) & 0xFF] ^ crc >> 8;
+			}
+			return crc ^ 0xFFFFFFFFu;
+		}
+
+		void PutBE32(std::vector<std::uint8_t>& out, const std::uint32_t value)
+		{
+			for (int shift = 24; shift >= 0; shift -= 8)
+			{
+				out.push_back(static_cast<std::uint8_t>(value >> shift));
+			}
+		}
+
+		//Length, type and data already in out from start, appends the CRC
+		void EndChunk(std::vector<std::uint8_t>& out, const size_t start)
+		{
+			const std::uint32_t length = static_cast<std::uint32_t>(out.size() - start - 8);
+			for (int k = 0; k < 4; k++)
+			{
+				out[start + k] = static_cast<std::uint8_t>(length >> (24 - 8 * k));
+			}
+			PutBE32(out, Crc32(out.data() + start + 4, out.size() - start - 4));
+		}
+
+		void EncodePng(const Image& image, std::vector<std::uint8_t>& out)
+		{
+			const int width = image.width(), height = image.height();
+			const size_t rowBytes = static_cast<size_t>(width) * 4;
+			//Each row straight RGBA, then filtered by whichever of none, sub and up gives
+			//the smallest sum of bytes taken as signed, the usual guess for what deflates best
+			std::vector<std::uint8_t> filtered((rowBytes + 1) * static_cast<size_t>(height));
+			//Rows start after 4 zero bytes so the left of the first pixel reads 0, the row above
+			//the first is zeros too
+			std::vector<std::uint8_t> rows[2] = {std::vector<std::uint8_t>(rowBytes + 4), std::vector<std::uint8_t>(rowBytes + 4)};
+			const auto cost = [](const int v) { return static_cast<std::uint32_t>(std::abs(static_cast<std::int8_t>(v))); };
+			for (int y = 0; y < height; y++)
+			{
+				std::uint8_t* const row = rows[y & 1].data() + 4;
+				const std::uint8_t* const above = rows[(y + 1) & 1].data() + 4;
+				const Pixel* src = image.row(y);
+				for (int x = 0; x < width; x++)
+				{
+					const Pixel p = src[x];
+					const std::uint32_t a = p >> 24;
+					std::uint32_t r = p >> 16 & 0xFF, g = p >> 8 & 0xFF, b = p & 0xFF;
+					if (a != 255 && a != 0)
+					{
+						r = (std::min)((r * 255 + a / 2) / a, 255u);
+						g = (std::min)((g * 255 + a / 2) / a, 255u);
+						b = (std::min)((b * 255 + a / 2) / a, 255u);
+					}
+					std::uint8_t* dst = &row[static_cast<size_t>(x) * 4];
+					dst[0] = static_cast<std::uint8_t>(r);
+					dst[1] = static_cast<std::uint8_t>(g);
+					dst[2] = static_cast<std::uint8_t>(b);
+					dst[3] = static_cast<std::uint8_t>(a);
+				}
+				std::uint32_t none = 0, sub = 0, up = 0;
+				for (size_t i = 0; i < rowBytes; i++)
+				{
+					none += cost(row[i]);
+					sub += cost(row[i] - row[i - 4]);
+					up += cost(row[i] - above[i]);
+				}
+				const int best = sub < none ? (up < sub ? 2 : 1) : (up < none ? 2 : 0);
+				std::uint8_t* dst = &filtered[(rowBytes + 1) * static_cast<size_t>(y)];
+				dst[0] = static_cast<std::uint8_t>(best);
+				dst++;
+				if (best == 0)
+				{
+					std::memcpy(dst, row, rowBytes);
+					continue;
+				}
+				const std::uint8_t* const base = best == 1 ? row - 4 : above;
+				for (size_t i = 0; i < rowBytes; i++)
+				{
+					dst[i] = static_cast<std::uint8_t>(row[i] - base[i]);
+				}
+			}
+
+			static const std::uint8_t c_signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+			out.assign(c_signature, c_signature + 8);
+			const auto beginChunk = [&](const char* type)
+			{
+				const size_t start = out.size();
+				out.resize(start + 4);
+				out.insert(out.end(), type, type + 4);
+				return start;
+			};
+			size_t start = beginChunk("IHDR");
+			PutBE32(out, static_cast<std::uint32_t>(width));
+			PutBE32(out, static_cast<std::uint32_t>(height));
+			//8 bit RGBA, deflate, adaptive filters, not interlaced
+			const std::uint8_t header[5] = {8, 6, 0, 0, 0};
+			out.insert(out.end(), header, header + 5);
+			EndChunk(out, start);
+			start = beginChunk("IDAT");
+			DeflateZlib(filtered.data(), filtered.size(), out);
+			EndChunk(out, start);
+			start = beginChunk("IEND");
+			EndChunk(out, start);
+		}
+
+		std::FILE* OpenForWriting(const std::wstring& path)
+		{
+#ifdef _WIN32
+			FILE* file = nullptr;
+			if (_wfopen_s(&file, path.c_str(), L"wb") != 0)
+			{
+				file = nullptr;
+			}
+			return file;
+#else
+			return std::fopen(Utf8(path).c_str(), "wb");
+#endif
+		}
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "soft_canvas.h"
+
+namespace graph
+{
+	namespace soft
+	{
+		//Zlib stream of data appended to out. Fixed Huffman codes and matches found by one
+		//hash probe a position: made for speed, frames are written as they come
+		void DeflateZlib(const std::uint8_t* data, size_t size, std::vector<std::uint8_t>& out);
+
+		//PNG of the premultiplied image as 8-bit RGBA, replacing what out held
+		void EncodePng(const Image& image, std::vector<std::uint8_t>& out);
+
+		//A new or emptied file opened for binary writing, nullptr if it cannot be
+		std::FILE* OpenForWriting(const std::wstring& path);
+	}
+}
@@ -0,0 +1,184 @@
+#include "soft_pool.h"
+#include <algorithm>
+
+namespace graph
+{
+	namespace soft
+	{
+		TaskPool::TaskPool(const unsigned threadCount)
+			: count(std::max(threadCount, 1u)), queues(new Queue[count])
+		{
+			for (unsigned i = 1; i < count; i++)
+			{
+				threads.emplace_back(&TaskPool::WorkerMain, this, i);
+			}
+		}
+
+		TaskPool::~TaskPool()
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				quit = true;
+			}
+			wake.notify_all();
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+		}
+
+		void TaskPool::WorkerMain(const unsigned worker)
+		{
+			unsigned seen = 0;
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					wake.wait(guard, [&] { return quit || generation != seen; });
+					if (quit)
+					{
+						return;
+					}
+					seen = generation;
+				}
+				Work(worker);
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					if (--busy == 0)
+					{
+						done.notify_one();
+					}
+				}
+			}
+		}
+
+		bool TaskPool::Pop(const unsigned worker, size_t& index)
+		{
+			Queue& queue = queues[worker];
+			std::lock_guard<std::mutex> guard(queue.lock);
+			if (queue.begin == queue.end)
+			{
+				return false;
+			}
+			index = queue.begin++;
+			return true;
+		}
+
+		bool TaskPool::Steal(const unsigned thief)
+		{
+			for (unsigned i = 1; i < count; i++)
+			{
+				Queue& victim = queues[(thief + i) % count];
+				size_t begin, end;
+				{
+					std::lock_guard<std::mutex> guard(victim.lock);
+					if (victim.begin == victim.end)
+					{
+						continue;
+					}
+					end = victim.end;
+					begin = end - (end - victim.begin + 1) / 2;
+					victim.end = begin;
+				}
+				Queue& own = queues[thief];
+				std::lock_guard<std::mutex> guard(own.lock);
+				own.begin = begin;
+				own.end = end;
+				return true;
+			}
+			return false;
+		}
+
+		void TaskPool::Work(const unsigned worker)
+		{
+			size_t index;
+			do
+			{
+				while (Pop(worker, index))
+				{
+					(*job)(index, worker);
+				}
+			}
+			while (Steal(worker));
+		}
+
+		void TaskPool::run(const size_t taskCount, const std::function<void(size_t, unsigned)>& func)
+		{
+			if (taskCount == 0)
+			{
+				return;
+			}
+			for (unsigned i = 0; i < count; i++)
+			{
+				queues[i].begin = taskCount * i / count;
+				queues[i].end = taskCount * (i + 1) / count;
+			}
+			if (count == 1)
+			{
+				job = &func;
+				Work(0);
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				job = &func;
+				busy = count - 1;
+				generation++;
+			}
+			wake.notify_all();
+			Work(0);
+			std::unique_lock<std::mutex> guard(lock);
+			done.wait(guard, [&] { return busy == 0; });
+		}
+
+		JobQueue::JobQueue(const unsigned threadCount)
+		{
+			for (unsigned i = 0; i < std::max(threadCount, 1u); i++)
+			{
+				threads.emplace_back(&JobQueue::WorkerMain, this);
+			}
+		}
+
+		JobQueue::~JobQueue()
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				quit = true;
+				jobs.clear();
+			}
+			wake.notify_all();
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+		}
+
+		void JobQueue::WorkerMain()
+		{
+			for (;;)
+			{
+				std::function<void()> job;
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					wake.wait(guard, [&] { return quit || !jobs.empty(); });
+					if (quit)
+					{
+						return;
+					}
+					job = std::move(jobs.front());
+					jobs.pop_front();
+				}
+				job();
+			}
+		}
+
+		void JobQueue::push(std::function<void()> job)
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				jobs.push_back(std::move(job));
+			}
+			wake.notify_one();
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace graph
+{
+	namespace soft
+	{
+		//Fixed set of threads running index ranges. Every worker starts with an even share
+		//of the range and steals half of what is left in another worker's share once its
+		//own runs out, so a few expensive tasks do not leave the other threads idle.
+		class TaskPool
+		{
+			struct Queue
+			{
+				std::mutex lock;
+				size_t begin = 0, end = 0;
+			};
+
+			unsigned count;
+			std::unique_ptr<Queue[]> queues;
+			std::vector<std::thread> threads;
+
+			std::mutex lock;
+			std::condition_variable wake;
+			std::condition_variable done;
+			const std::function<void(size_t, unsigned)>* job = nullptr;
+			unsigned generation = 0;
+			unsigned busy = 0;
+			bool quit = false;
+
+			void WorkerMain(unsigned worker);
+			void Work(unsigned worker);
+			bool Pop(unsigned worker, size_t& index);
+			bool Steal(unsigned thief);
+		public:
+			//threadCount includes the thread calling run
+			explicit TaskPool(unsigned threadCount);
+			~TaskPool();
+
+			TaskPool(const TaskPool&) = delete;
+			TaskPool& operator=(const TaskPool&) = delete;
+
+			unsigned size() const { return count; }
+
+			//Calls func(index, worker) for every index in [0, taskCount) and returns when all are done.
+			//The caller works as worker 0, worker is below size().
+			void run(size_t taskCount, const std::function<void(size_t, unsigned)>& func);
+		};
+
+		//Threads taking jobs first in first out, for work that finishes after the call queuing it.
+		//Jobs not started when the queue is destroyed are dropped, running ones are waited for.
+		class JobQueue
+		{
+			std::vector<std::thread> threads;
+			std::mutex lock;
+			std::condition_variable wake;
+			std::deque<std::function<void()>> jobs;
+			bool quit = false;
+
+			void WorkerMain();
+		public:
+			explicit JobQueue(unsigned threadCount);
+			~JobQueue();
+
+			JobQueue(const JobQueue&) = delete;
+			JobQueue& operator=(const JobQueue&) = delete;
+
+			void push(std::function<void()> job);
+		};
+	}
+}
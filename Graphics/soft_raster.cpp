@@ -0,0 +1,291 @@
+#include "soft_raster.h"
+#include <algorithm>
+#include <cmath>
+
+namespace graph
+{
+	namespace soft
+	{
+		IntRect Intersect(const IntRect& a, const IntRect& b)
+		{
+			return IntRect{
+				std::max(a.left, b.left),
+				std::max(a.top, b.top),
+				std::min(a.right, b.right),
+				std::min(a.bottom, b.bottom)
+			};
+		}
+
+		//24.8 fixed point, far enough off-screen that the clamp never shows
+		int ToSubpixel(float value)
+		{
+			const float limit = static_cast<float>(1 << 21);
+			if (!(value > -limit))
+			{
+				value = -limit;
+			}
+			else if (value > limit)
+			{
+				value = limit;
+			}
+			return static_cast<int>(std::floor(value * 256.f + 0.5f));
+		}
+
+		long long FloorDiv(const long long a, const long long b)
+		{
+			long long q = a / b;
+			if (a % b != 0 && (a < 0) != (b < 0))
+			{
+				q--;
+			}
+			return q;
+		}
+
+		void Rasterizer::set_clip(const IntRect& rect)
+		{
+			reset();
+			clip = rect;
+		}
+
+		void Rasterizer::reset()
+		{
+			cells.clear();
+			current = Cell{0, 0, 0, 0};
+			minRow = 0;
+			maxRow = -1;
+		}
+
+		void Rasterizer::FlushCell()
+		{
+			if ((current.cover == 0 && current.area == 0) || current.x >= clip.right)
+			{
+				return;
+			}
+			Cell cell = current;
+			if (cell.x < clip.left)
+			{
+				//Only the winding of cells left of the clip reaches inside
+				if (cell.cover == 0)
+				{
+					return;
+				}
+				cell.x = clip.left;
+				cell.area = 0;
+			}
+			if (cells.empty())
+			{
+				minRow = maxRow = cell.y;
+			}
+			else
+			{
+				minRow = std::min(minRow, cell.y);
+				maxRow = std::max(maxRow, cell.y);
+			}
+			cells.push_back(cell);
+		}
+
+		void Rasterizer::SetCell(const int x, const int y)
+		{
+			if (x != current.x || y != current.y)
+			{
+				FlushCell();
+				current = Cell{x, y, 0, 0};
+			}
+		}
+
+		//Part of a line inside pixel row y, y1 and y2 are 0-256 within the row
+		void Rasterizer::RenderRow(const int y, const int x1, const int y1, const int x2, const int y2)
+		{
+			int ex1 = x1 >> 8;
+			const int ex2 = x2 >> 8;
+			if (ex1 >= clip.right && ex2 >= clip.right)
+			{
+				return;
+			}
+			if (ex1 < clip.left && ex2 < clip.left)
+			{
+				SetCell(clip.left - 1, y);
+				current.cover += y2 - y1;
+				return;
+			}
+
+			const int fx1 = x1 & 255;
+			const int fx2 = x2 & 255;
+			SetCell(ex1, y);
+			if (ex1 == ex2)
+			{
+				const int delta = y2 - y1;
+				current.cover += delta;
+				current.area += (fx1 + fx2) * delta;
+				return;
+			}
+
+			//Walk the cells the line passes, the y where it leaves each cell is exact
+			int dx = x2 - x1;
+			int p, first, incr;
+			if (dx > 0)
+			{
+				p = (256 - fx1) * (y2 - y1);
+				first = 256;
+				incr = 1;
+			}
+			else
+			{
+				p = fx1 * (y2 - y1);
+				first = 0;
+				incr = -1;
+				dx = -dx;
+			}
+			int delta = p / dx;
+			int mod = p % dx;
+			if (mod < 0)
+			{
+				delta--;
+				mod += dx;
+			}
+			current.cover += delta;
+			current.area += (fx1 + first) * delta;
+			int yy = y1 + delta;
+			ex1 += incr;
+			SetCell(ex1, y);
+			if (ex1 != ex2)
+			{
+				p = 256 * (y2 - y1);
+				int lift = p / dx;
+				int rem = p % dx;
+				if (rem < 0)
+				{
+					lift--;
+					rem += dx;
+				}
+				mod -= dx;
+				while (ex1 != ex2)
+				{
+					delta = lift;
+					mod += rem;
+					if (mod >= 0)
+					{
+						mod -= dx;
+						delta++;
+					}
+					current.cover += delta;
+					current.area += 256 * delta;
+					yy += delta;
+					ex1 += incr;
+					SetCell(ex1, y);
+				}
+			}
+			delta = y2 - yy;
+			current.cover += delta;
+			current.area += (fx2 + 256 - first) * delta;
+		}
+
+		void Rasterizer::add_line(const Point from, const Point to)
+		{
+			const int x1 = ToSubpixel(from.x);
+			const int y1 = ToSubpixel(from.y);
+			const int x2 = ToSubpixel(to.x);
+			const int y2 = ToSubpixel(to.y);
+			if (y1 == y2)
+			{
+				return;
+			}
+			//Row crossings come from the end points only, never from where the clip cut
+			//the line, so rows outside the clip are skipped without changing the others
+			const long long dx = x2 - x1;
+			const long long dy = y2 - y1;
+			const auto xAt = [&](const int y) { return x1 + static_cast<int>(FloorDiv((y - y1) * dx, dy)); };
+			if (dy > 0)
+			{
+				const int last = std::min(y2 >> 8, clip.bottom - 1);
+				for (int row = std::max(y1 >> 8, clip.top); row <= last; row++)
+				{
+					const int top = std::max(y1, row << 8);
+					const int bottom = std::min(y2, (row + 1) << 8);
+					if (top != bottom)
+					{
+						RenderRow(row, xAt(top), top - (row << 8), xAt(bottom), bottom - (row << 8));
+					}
+				}
+			}
+			else
+			{
+				const int last = std::max(y2 >> 8, clip.top);
+				for (int row = std::min(y1 >> 8, clip.bottom - 1); row >= last; row--)
+				{
+					const int top = std::min(y1, (row + 1) << 8);
+					const int bottom = std::max(y2, row << 8);
+					if (top != bottom)
+					{
+						RenderRow(row, xAt(top), top - (row << 8), xAt(bottom), bottom - (row << 8));
+					}
+				}
+			}
+		}
+
+		void Rasterizer::add_contour(const Point* points, const size_t count)
+		{
+			if (count < 3)
+			{
+				return;
+			}
+			for (size_t i = 0; i + 1 < count; i++)
+			{
+				add_line(points[i], points[i + 1]);
+			}
+			add_line(points[count - 1], points[0]);
+		}
+
+		//Counting sort on rows, then each row on x
+		void Rasterizer::SortCells()
+		{
+			FlushCell();
+			current = Cell{0, 0, 0, 0};
+			sorted.resize(cells.size());
+			if (cells.empty())
+			{
+				return;
+			}
+			const size_t rows = static_cast<size_t>(maxRow - minRow + 1);
+			rowStart.assign(rows + 1, 0);
+			for (const Cell& cell : cells)
+			{
+				rowStart[cell.y - minRow + 1]++;
+			}
+			for (size_t i = 1; i <= rows; i++)
+			{
+				rowStart[i] += rowStart[i - 1];
+			}
+			for (const Cell& cell : cells)
+			{
+				sorted[rowStart[cell.y - minRow]++] = cell;
+			}
+			for (size_t i = rows; i > 0; i--)
+			{
+				rowStart[i] = rowStart[i - 1];
+			}
+			rowStart[0] = 0;
+			for (size_t i = 0; i < rows; i++)
+			{
+				std::sort(sorted.begin() + rowStart[i], sorted.begin() + rowStart[i + 1],
+				          [](const Cell& a, const Cell& b) { return a.x < b.x; });
+			}
+		}
+
+		//area is twice the covered subpixel area, 1 << 17 for a full pixel
+		int Rasterizer::Coverage(const int area, const FillRule rule)
+		{
+			//Magnitude first, so a contour gives the same pixels whichever way it winds
+			int cover = (area < 0 ? -area : area) >> 9;
+			if (rule == FillRule::EvenOdd)
+			{
+				cover &= 511;
+				if (cover > 256)
+				{
+					cover = 512 - cover;
+				}
+			}
+			return cover > 255 ? 255 : cover;
+		}
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "graph_types.h"
+
+namespace graph
+{
+	namespace soft
+	{
+		struct IntRect
+		{
+			int left, top, right, bottom;
+
+			bool empty() const { return right <= left || bottom <= top; }
+		};
+
+		IntRect Intersect(const IntRect& a, const IntRect& b);
+
+		enum class FillRule
+		{
+			NonZero,
+			//D2D1_FILL_MODE_ALTERNATE, what Direct2D path geometries use by default
+			EvenOdd
+		};
+
+		//Sparse scanline rasterizer with exact area coverage.
+		//Lines are accumulated into cells of (cover, area) in 24.8 fixed point, cells are
+		//swept row by row and turned into spans of 0-255 coverage. Memory is reused
+		//between shapes, adding a line never allocates once the buffers have grown.
+		//Clipping is exact: the cells of a pixel do not depend on the clip rect,
+		//so a shape drawn tile by tile gives the same pixels as drawn at once.
+		class Rasterizer
+		{
+			struct Cell
+			{
+				int x, y;
+				int cover, area;
+			};
+
+			IntRect clip{0, 0, 0, 0};
+			Cell current{0, 0, 0, 0};
+			int minRow = 0, maxRow = -1;
+
+			std::vector<Cell> cells;
+			std::vector<Cell> sorted;
+			std::vector<int> rowStart;
+
+			void SetCell(int x, int y);
+			void FlushCell();
+			void RenderRow(int y, int x1, int y1, int x2, int y2);
+			void SortCells();
+
+			static int Coverage(int area, FillRule rule);
+		public:
+			//Nothing outside clip is produced
+			void set_clip(const IntRect& rect);
+			const IntRect& get_clip() const { return clip; }
+
+			//Device pixel coordinates, contours must be closed for the result to make sense
+			void add_line(Point from, Point to);
+
+			//Closes the contour back to points[0]
+			void add_contour(const Point* points, size_t count);
+
+			bool empty() const { return cells.empty() && current.cover == 0 && current.area == 0; }
+
+			//Discards lines added since the last sweep
+			void reset();
+
+			//Calls span(y, x, count, coverage) for every covered run, rows top to bottom
+			//and runs left to right, then resets. coverage is 1-255.
+			template <typename SpanFunc>
+			void sweep(FillRule rule, SpanFunc&& span);
+		};
+
+		template <typename SpanFunc>
+		void Rasterizer::sweep(const FillRule rule, SpanFunc&& span)
+		{
+			SortCells();
+			for (int y = minRow; y <= maxRow; y++)
+			{
+				const Cell* cell = sorted.data() + rowStart[y - minRow];
+				const Cell* const end = sorted.data() + rowStart[y - minRow + 1];
+				int cover = 0;
+				while (cell != end)
+				{
+					const int x = cell->x;
+					int area = cell->area;
+					cover += cell->cover;
+					while (++cell != end && cell->x == x)
+					{
+						area += cell->area;
+						cover += cell->cover;
+					}
+					int spanStart = x;
+					if (area != 0)
+					{
+						const int alpha = Coverage(cover * 512 - area, rule);
+						if (alpha != 0)
+						{
+							span(y, x, 1, alpha);
+						}
+						spanStart = x + 1;
+					}
+					const int spanEnd = cell != end ? cell->x : clip.right;
+					if (spanStart < spanEnd)
+					{
+						const int alpha = Coverage(cover * 512, rule);
+						if (alpha != 0)
+						{
+							span(y, spanStart, spanEnd - spanStart, alpha);
+						}
+					}
+				}
+			}
+			reset();
+		}
+	}
+}
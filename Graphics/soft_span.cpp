@@ -0,0 +1,858 @@
+#include "soft_span.h"
+#include "soft_pool.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+#ifdef GRAPH_SOFT_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define GRAPH_TARGET_SSE2
+#define GRAPH_TARGET_AVX2
+#else
+#define GRAPH_TARGET_SSE2 __attribute__((target("sse2")))
+#define GRAPH_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace graph
+{
+	namespace soft
+	{
+		//Spans this long (4 MiB) skip the cache, they would only evict what is drawn next
+		const size_t c_stream_threshold = 1 << 20;
+
+		SIMD_LEVEL DetectSimdLevel()
+		{
+#ifdef GRAPH_SOFT_X86
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 0);
+			const int maxId = info[0];
+			__cpuid(info, 1);
+			const bool sse2 = (info[3] & (1 << 26)) != 0;
+			const bool osxsave = (info[2] & (1 << 27)) != 0;
+			const bool avx = (info[2] & (1 << 28)) != 0;
+			bool avx2 = false;
+			if (maxId >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+			{
+				__cpuidex(info, 7, 0);
+				avx2 = (info[1] & (1 << 5)) != 0;
+			}
+#else
+			__builtin_cpu_init();
+			const bool sse2 = __builtin_cpu_supports("sse2");
+			const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+			if (avx2)
+			{
+				return SIMD_LEVEL::AVX2;
+			}
+			if (sse2)
+			{
+				return SIMD_LEVEL::SSE2;
+			}
+#endif
+			return SIMD_LEVEL::Scalar;
+		}
+
+		const SIMD_LEVEL c_detected_level = DetectSimdLevel();
+		SIMD_LEVEL g_simd_level = c_detected_level;
+
+		SIMD_LEVEL GetSimdLevel()
+		{
+			return g_simd_level;
+		}
+
+		void SetSimdLevel(const SIMD_LEVEL level)
+		{
+			g_simd_level = std::min(level, c_detected_level);
+		}
+
+		void FillSpanOpaqueScalar(Pixel* dst, const size_t count, const Pixel color)
+		{
+			std::fill(dst, dst + count, color);
+		}
+
+		void BlendSpanScalar(Pixel* dst, const size_t count, const Pixel color)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				dst[i] = BlendPixel(dst[i], color);
+			}
+		}
+
+		void CompositeSpanScalar(Pixel* dst, const Pixel* src, const size_t count, const std::uint32_t alpha)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				const Pixel color = alpha == 255 ? src[i] : ScalePixel(src[i], alpha);
+				if ((color >> 24) == 255)
+				{
+					dst[i] = color;
+				}
+				else if (color != 0)
+				{
+					dst[i] = BlendPixel(dst[i], color);
+				}
+			}
+		}
+
+#ifdef GRAPH_SOFT_X86
+		GRAPH_TARGET_SSE2 void FillSpanOpaqueSSE2(Pixel* dst, size_t count, const Pixel color)
+		{
+			const __m128i c = _mm_set1_epi32(static_cast<int>(color));
+			if (count < 4)
+			{
+				FillSpanOpaqueScalar(dst, count, color);
+				return;
+			}
+			//Short spans: unaligned stores, the last one overlapping the previous
+			if (count < 64)
+			{
+				for (size_t i = 0; i + 4 < count; i += 4)
+				{
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), c);
+				}
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + count - 4), c);
+				return;
+			}
+			while (reinterpret_cast<std::uintptr_t>(dst) & 15)
+			{
+				*dst++ = color;
+				count--;
+			}
+			if (count >= c_stream_threshold)
+			{
+				for (; count >= 16; count -= 16, dst += 16)
+				{
+					_mm_stream_si128(reinterpret_cast<__m128i*>(dst), c);
+					_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 4), c);
+					_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 8), c);
+					_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 12), c);
+				}
+				_mm_sfence();
+			}
+			for (; count >= 16; count -= 16, dst += 16)
+			{
+				_mm_store_si128(reinterpret_cast<__m128i*>(dst), c);
+				_mm_store_si128(reinterpret_cast<__m128i*>(dst + 4), c);
+				_mm_store_si128(reinterpret_cast<__m128i*>(dst + 8), c);
+				_mm_store_si128(reinterpret_cast<__m128i*>(dst + 12), c);
+			}
+			for (; count >= 4; count -= 4, dst += 4)
+			{
+				_mm_store_si128(reinterpret_cast<__m128i*>(dst), c);
+			}
+			while (count--)
+			{
+				*dst++ = color;
+			}
+		}
+
+		GRAPH_TARGET_SSE2 void BlendSpanSSE2(Pixel* dst, size_t count, const Pixel color)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i src = _mm_set1_epi32(static_cast<int>(color));
+			const __m128i inv = _mm_set1_epi16(static_cast<short>(255 - (color >> 24)));
+			const __m128i bias = _mm_set1_epi16(0x80);
+			for (; count >= 4; count -= 4, dst += 4)
+			{
+				const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+				__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv), bias);
+				__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv), bias);
+				lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+				hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_add_epi8(_mm_packus_epi16(lo, hi), src));
+			}
+			BlendSpanScalar(dst, count, color);
+		}
+
+		GRAPH_TARGET_SSE2 void CompositeSpanSSE2(Pixel* dst, const Pixel* src, size_t count, const std::uint32_t alpha)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i bias = _mm_set1_epi16(0x80);
+			const __m128i scale = _mm_set1_epi16(static_cast<short>(alpha));
+			const __m128i full = _mm_set1_epi16(255);
+			//(x * y + 128) * 257 >> 16 per 16 bit lane, the rounding of ScalePixel and BlendPixel
+			const auto multiply = [&](const __m128i x, const __m128i y)
+			{
+				const __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, y), bias);
+				return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+			};
+			//255 - alpha of each pixel in all four of its lanes
+			const auto inverse = [&](const __m128i s)
+			{
+				const __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+				return _mm_sub_epi16(full, a);
+			};
+			for (; count >= 4; count -= 4, dst += 4, src += 4)
+			{
+				const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+				__m128i sLo = _mm_unpacklo_epi8(s, zero);
+				__m128i sHi = _mm_unpackhi_epi8(s, zero);
+				if (alpha != 255)
+				{
+					sLo = multiply(sLo, scale);
+					sHi = multiply(sHi, scale);
+				}
+				const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+				const __m128i lo = multiply(_mm_unpacklo_epi8(d, zero), inverse(sLo));
+				const __m128i hi = multiply(_mm_unpackhi_epi8(d, zero), inverse(sHi));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+				                 _mm_add_epi8(_mm_packus_epi16(lo, hi), _mm_packus_epi16(sLo, sHi)));
+			}
+			CompositeSpanScalar(dst, src, count, alpha);
+		}
+
+		GRAPH_TARGET_AVX2 void FillSpanOpaqueAVX2(Pixel* dst, size_t count, const Pixel color)
+		{
+			const __m256i c = _mm256_set1_epi32(static_cast<int>(color));
+			if (count < 8)
+			{
+				FillSpanOpaqueScalar(dst, count, color);
+				return;
+			}
+			if (count < 128)
+			{
+				for (size_t i = 0; i + 8 < count; i += 8)
+				{
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), c);
+				}
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + count - 8), c);
+				return;
+			}
+			while (reinterpret_cast<std::uintptr_t>(dst) & 31)
+			{
+				*dst++ = color;
+				count--;
+			}
+			if (count >= c_stream_threshold)
+			{
+				for (; count >= 32; count -= 32, dst += 32)
+				{
+					_mm256_stream_si256(reinterpret_cast<__m256i*>(dst), c);
+					_mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 8), c);
+					_mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 16), c);
+					_mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 24), c);
+				}
+				_mm_sfence();
+			}
+			for (; count >= 32; count -= 32, dst += 32)
+			{
+				_mm256_store_si256(reinterpret_cast<__m256i*>(dst), c);
+				_mm256_store_si256(reinterpret_cast<__m256i*>(dst + 8), c);
+				_mm256_store_si256(reinterpret_cast<__m256i*>(dst + 16), c);
+				_mm256_store_si256(reinterpret_cast<__m256i*>(dst + 24), c);
+			}
+			for (; count >= 8; count -= 8, dst += 8)
+			{
+				_mm256_store_si256(reinterpret_cast<__m256i*>(dst), c);
+			}
+			while (count--)
+			{
+				*dst++ = color;
+			}
+		}
+
+		GRAPH_TARGET_AVX2 void BlendSpanAVX2(Pixel* dst, size_t count, const Pixel color)
+		{
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i src = _mm256_set1_epi32(static_cast<int>(color));
+			const __m256i inv = _mm256_set1_epi16(static_cast<short>(255 - (color >> 24)));
+			const __m256i bias = _mm256_set1_epi16(0x80);
+			for (; count >= 8; count -= 8, dst += 8)
+			{
+				const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst));
+				__m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), inv), bias);
+				__m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), inv), bias);
+				lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+				hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst),
+				                    _mm256_add_epi8(_mm256_packus_epi16(lo, hi), src));
+			}
+			//Tail stays in this function, calling the SSE2 kernel from AVX code stalls on the transition
+			BlendSpanScalar(dst, count, color);
+		}
+#endif
+
+		static_assert(sizeof(Color) == 4 * sizeof(float), "Color is loaded as four floats");
+		static_assert(sizeof(Color32) == sizeof(std::uint32_t), "Color32 is loaded as a 32 bit word");
+
+		void PackColorsScalar(const Color* src, Color32* dst, const size_t count)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				dst[i] = Color32(src[i]);
+			}
+		}
+
+		void UnpackColorsScalar(const Color32* src, Color* dst, const size_t count)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				dst[i] = Color(src[i]);
+			}
+		}
+
+#ifdef GRAPH_SOFT_X86
+		GRAPH_TARGET_SSE2 void PackColorsSSE2(const Color* src, Color32* dst, size_t count)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.f);
+			const __m128 scale = _mm_set1_ps(255.f);
+			const __m128 half = _mm_set1_ps(0.5f);
+			//Same steps as the scalar code, max with zero second turns NaN into 0
+			const auto channels = [&](const Color* color)
+			{
+				__m128 v = _mm_loadu_ps(reinterpret_cast<const float*>(color));
+				v = _mm_min_ps(_mm_max_ps(v, zero), one);
+				v = _mm_add_ps(_mm_mul_ps(v, scale), half);
+				//r g b a to b g r a, the byte order of 0xAARRGGBB in memory
+				return _mm_cvttps_epi32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2)));
+			};
+			for (; count >= 4; count -= 4, src += 4, dst += 4)
+			{
+				const __m128i lo = _mm_packs_epi32(channels(src), channels(src + 1));
+				const __m128i hi = _mm_packs_epi32(channels(src + 2), channels(src + 3));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(lo, hi));
+			}
+			PackColorsScalar(src, dst, count);
+		}
+
+		GRAPH_TARGET_SSE2 void UnpackColorsSSE2(const Color32* src, Color* dst, size_t count)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128 scale = _mm_set1_ps(255.f);
+			//Divided rather than multiplied by 1 / 255, to round like Color(Color32)
+			const auto store = [&](Color* color, const __m128i bgra)
+			{
+				const __m128 v = _mm_div_ps(_mm_cvtepi32_ps(bgra), scale);
+				_mm_storeu_ps(reinterpret_cast<float*>(color), _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2)));
+			};
+			for (; count >= 4; count -= 4, src += 4, dst += 4)
+			{
+				const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+				const __m128i lo = _mm_unpacklo_epi8(p, zero);
+				const __m128i hi = _mm_unpackhi_epi8(p, zero);
+				store(dst, _mm_unpacklo_epi16(lo, zero));
+				store(dst + 1, _mm_unpackhi_epi16(lo, zero));
+				store(dst + 2, _mm_unpacklo_epi16(hi, zero));
+				store(dst + 3, _mm_unpackhi_epi16(hi, zero));
+			}
+			UnpackColorsScalar(src, dst, count);
+		}
+#endif
+
+		//Texels either side of a sample position along one axis, repeated past the edges,
+		//and the weight of the second in 1/128
+		inline void LinearTaps(const std::int64_t position, const int size, int& first, int& second, std::uint32_t& weight)
+		{
+			const std::int64_t texel = position >> 16;
+			weight = static_cast<std::uint32_t>(position >> 9) & 127;
+			//Inside but for the last texel in one compare
+			if (static_cast<std::uint64_t>(texel) < static_cast<std::uint64_t>(size - 1))
+			{
+				first = static_cast<int>(texel);
+				second = first + 1;
+				return;
+			}
+			first = second = texel < 0 ? 0 : size - 1;
+		}
+
+		//(a * (128 - weight) + b * weight + 64) >> 7 per channel, two channels per 16 bit half
+		inline Pixel LerpPixel(const Pixel a, const Pixel b, const std::uint32_t weight)
+		{
+			const std::uint32_t keep = 128 - weight;
+			const std::uint32_t rb = ((a & 0xFF00FF) * keep + (b & 0xFF00FF) * weight + 0x400040) >> 7 & 0xFF00FF;
+			const std::uint32_t ag = ((a >> 8 & 0xFF00FF) * keep + (b >> 8 & 0xFF00FF) * weight + 0x400040) >> 7 & 0xFF00FF;
+			return rb | ag << 8;
+		}
+
+		void SampleSpanLinearScalar(
+			Pixel* dst,
+			const Image& image,
+			std::int64_t u,
+			std::int64_t v,
+			const std::int64_t du,
+			const std::int64_t dv,
+			const size_t count)
+		{
+			for (size_t i = 0; i < count; i++, u += du, v += dv)
+			{
+				int x0, x1, y0, y1;
+				std::uint32_t wx, wy;
+				LinearTaps(u, image.width(), x0, x1, wx);
+				LinearTaps(v, image.height(), y0, y1, wy);
+				const Pixel* row0 = image.row(y0);
+				const Pixel* row1 = image.row(y1);
+				dst[i] = LerpPixel(LerpPixel(row0[x0], row0[x1], wx), LerpPixel(row1[x0], row1[x1], wx), wy);
+			}
+		}
+
+		void HalveSpanScalar(Pixel* dst, const Pixel* row0, const Pixel* row1, const size_t count)
+		{
+			for (size_t i = 0; i < count; i++, row0 += 2, row1 += 2)
+			{
+				const std::uint32_t rb = ((row0[0] & 0xFF00FF) + (row0[1] & 0xFF00FF) + (row1[0] & 0xFF00FF) +
+					(row1[1] & 0xFF00FF) + 0x20002) >> 2 & 0xFF00FF;
+				const std::uint32_t ag = ((row0[0] >> 8 & 0xFF00FF) + (row0[1] >> 8 & 0xFF00FF) + (row1[0] >> 8 & 0xFF00FF) +
+					(row1[1] >> 8 & 0xFF00FF) + 0x20002) >> 2 & 0xFF00FF;
+				dst[i] = rb | ag << 8;
+			}
+		}
+
+#ifdef GRAPH_SOFT_X86
+		GRAPH_TARGET_SSE2 void SampleSpanLinearSSE2(
+			Pixel* dst,
+			const Image& image,
+			std::int64_t u,
+			std::int64_t v,
+			const std::int64_t du,
+			const std::int64_t dv,
+			const size_t count)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i bias = _mm_set1_epi32(64);
+			//Channels of two texels interleaved, weighted and summed in 32 bit lanes by pmaddwd.
+			//weights holds 128 - weight and weight in the halves of every 32 bit lane
+			const auto lerp = [&](const __m128i pairs, const __m128i weights)
+			{
+				return _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(pairs, weights), bias), 7);
+			};
+			const auto weights = [](const std::uint32_t weight)
+			{
+				return _mm_set1_epi32(static_cast<int>((128 - weight) | weight << 16));
+			};
+			for (size_t i = 0; i < count; i++, u += du, v += dv)
+			{
+				int x0, x1, y0, y1;
+				std::uint32_t wx, wy;
+				LinearTaps(u, image.width(), x0, x1, wx);
+				LinearTaps(v, image.height(), y0, y1, wy);
+				const Pixel* row0 = image.row(y0);
+				const Pixel* row1 = image.row(y1);
+				const __m128i across = weights(wx);
+				const __m128i top = lerp(_mm_unpacklo_epi8(_mm_unpacklo_epi8(
+				                                                             _mm_cvtsi32_si128(static_cast<int>(row0[x0])),
+				                                                             _mm_cvtsi32_si128(static_cast<int>(row0[x1]))),
+				                                           zero), across);
+				const __m128i bottom = lerp(_mm_unpacklo_epi8(_mm_unpacklo_epi8(
+				                                                                _mm_cvtsi32_si128(static_cast<int>(row1[x0])),
+				                                                                _mm_cvtsi32_si128(static_cast<int>(row1[x1]))),
+				                                              zero), across);
+				//Both fit 16 bits, interleaved again for the vertical pass
+				const __m128i mixed = lerp(_mm_or_si128(top, _mm_slli_epi32(bottom, 16)), weights(wy));
+				const __m128i packed = _mm_packs_epi32(mixed, mixed);
+				dst[i] = static_cast<Pixel>(_mm_cvtsi128_si32(_mm_packus_epi16(packed, packed)));
+			}
+		}
+
+		GRAPH_TARGET_SSE2 void HalveSpanSSE2(Pixel* dst, const Pixel* row0, const Pixel* row1, size_t count)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i bias = _mm_set1_epi16(2);
+			for (; count >= 2; count -= 2, dst += 2, row0 += 4, row1 += 4)
+			{
+				const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0));
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1));
+				//Columns summed down, then pixel pairs summed across
+				const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+				const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+				const __m128i first = _mm_add_epi16(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+				const __m128i second = _mm_add_epi16(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+				const __m128i mean = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(first, second), bias), 2);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(mean, mean));
+			}
+			HalveSpanScalar(dst, row0, row1, count);
+		}
+#endif
+
+		//Bands of about this many pixels are converted by one task
+		const size_t c_convert_task_pixels = 1 << 16;
+
+		size_t FormatBytes(const PIXEL_FORMAT format)
+		{
+			switch (format)
+			{
+				case PIXEL_FORMAT::RGB8:
+					return 3;
+				case PIXEL_FORMAT::Gray8:
+					return 1;
+				case PIXEL_FORMAT::RGBA32Float:
+					return 4 * sizeof(float);
+				default:
+					return 4;
+			}
+		}
+
+		//Premultiplied from straight floats, NaN and what is below 0 clamp to 0
+		inline Pixel PremultiplyFloats(const float* rgba)
+		{
+			const auto clamp01 = [](const float value) { return value > 0.f ? (value < 1.f ? value : 1.f) : 0.f; };
+			const float alpha = clamp01(rgba[3]);
+			const auto channel = [&](const float value)
+			{
+				return static_cast<Pixel>(clamp01(value) * alpha * 255.f + 0.5f);
+			};
+			return static_cast<Pixel>(alpha * 255.f + 0.5f) << 24 | channel(rgba[0]) << 16 | channel(rgba[1]) << 8 | channel(rgba[2]);
+		}
+
+		void ConvertSpanScalar(const PIXEL_FORMAT format, const std::uint8_t* src, Pixel* dst, const size_t count)
+		{
+			switch (format)
+			{
+				case PIXEL_FORMAT::BGRA8Premultiplied:
+					std::memcpy(dst, src, count * sizeof(Pixel));
+					break;
+				case PIXEL_FORMAT::BGRA8:
+					for (size_t i = 0; i < count; i++, src += 4)
+					{
+						std::uint32_t color;
+						std::memcpy(&color, src, sizeof(color));
+						dst[i] = PremultiplyPacked(color);
+					}
+					break;
+				case PIXEL_FORMAT::RGBA8:
+					for (size_t i = 0; i < count; i++, src += 4)
+					{
+						dst[i] = PremultiplyPacked(static_cast<std::uint32_t>(src[3]) << 24 | src[0] << 16 | src[1] << 8 | src[2]);
+					}
+					break;
+				case PIXEL_FORMAT::RGB8:
+					for (size_t i = 0; i < count; i++, src += 3)
+					{
+						dst[i] = 0xFF000000 | src[0] << 16 | src[1] << 8 | src[2];
+					}
+					break;
+				case PIXEL_FORMAT::Gray8:
+					for (size_t i = 0; i < count; i++)
+					{
+						dst[i] = 0xFF000000 | src[i] * 0x010101u;
+					}
+					break;
+				case PIXEL_FORMAT::RGBA32Float:
+				{
+					const auto* floats = reinterpret_cast<const float*>(src);
+					for (size_t i = 0; i < count; i++, floats += 4)
+					{
+						dst[i] = PremultiplyFloats(floats);
+					}
+					break;
+				}
+			}
+		}
+
+#ifdef GRAPH_SOFT_X86
+		//Four straight 8 bit pixels premultiplied, red and blue swapped for RGBA8
+		GRAPH_TARGET_SSE2 void ConvertSpan8SSE2(const bool swap, const std::uint8_t* src, Pixel* dst, size_t count)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i bias = _mm_set1_epi16(0x80);
+			//Color lanes scale by alpha, the alpha lane by 255 which leaves it as it is
+			const __m128i colorLanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+			const __m128i alphaLanes = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+			const auto premultiply = [&](__m128i x)
+			{
+				if (swap)
+				{
+					x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+				}
+				const __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+				const __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, _mm_or_si128(_mm_and_si128(alpha, colorLanes), alphaLanes)), bias);
+				return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+			};
+			for (; count >= 4; count -= 4, src += 16, dst += 4)
+			{
+				const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+				                 _mm_packus_epi16(premultiply(_mm_unpacklo_epi8(s, zero)), premultiply(_mm_unpackhi_epi8(s, zero))));
+			}
+			ConvertSpanScalar(swap ? PIXEL_FORMAT::RGBA8 : PIXEL_FORMAT::BGRA8, src, dst, count);
+		}
+
+		GRAPH_TARGET_SSE2 void ConvertGraySSE2(const std::uint8_t* src, Pixel* dst, size_t count)
+		{
+			const __m128i opaque = _mm_set1_epi8(-1);
+			for (; count >= 16; count -= 16, src += 16, dst += 16)
+			{
+				const __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+				//g g words and g 255 words interleave into g g g 255
+				const __m128i twiceLo = _mm_unpacklo_epi8(g, g), twiceHi = _mm_unpackhi_epi8(g, g);
+				const __m128i alphaLo = _mm_unpacklo_epi8(g, opaque), alphaHi = _mm_unpackhi_epi8(g, opaque);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi16(twiceLo, alphaLo));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4), _mm_unpackhi_epi16(twiceLo, alphaLo));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8), _mm_unpacklo_epi16(twiceHi, alphaHi));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 12), _mm_unpackhi_epi16(twiceHi, alphaHi));
+			}
+			ConvertSpanScalar(PIXEL_FORMAT::Gray8, src, dst, count);
+		}
+
+		GRAPH_TARGET_SSE2 void ConvertFloatsSSE2(const float* src, Pixel* dst, size_t count)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.f);
+			const __m128 scale = _mm_set1_ps(255.f);
+			const __m128 half = _mm_set1_ps(0.5f);
+			const __m128 colorLanes = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+			const __m128 alphaLane = _mm_set_ps(1.f, 0.f, 0.f, 0.f);
+			//Same operations in the same order as PremultiplyFloats, then swizzled to B G R A
+			const auto pixel = [&](const float* rgba)
+			{
+				const __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(rgba), zero), one);
+				const __m128 alpha = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+				const __m128 scaled = _mm_mul_ps(v, _mm_or_ps(_mm_and_ps(alpha, colorLanes), alphaLane));
+				const __m128i channels = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(scaled, scale), half));
+				return _mm_shuffle_epi32(channels, _MM_SHUFFLE(3, 0, 1, 2));
+			};
+			for (; count >= 4; count -= 4, src += 16, dst += 4)
+			{
+				const __m128i lo = _mm_packs_epi32(pixel(src), pixel(src + 4));
+				const __m128i hi = _mm_packs_epi32(pixel(src + 8), pixel(src + 12));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(lo, hi));
+			}
+			ConvertSpanScalar(PIXEL_FORMAT::RGBA32Float, reinterpret_cast<const std::uint8_t*>(src), dst, count);
+		}
+
+		//Lambdas do not take the target of the function around them, this is ConvertSpan8SSE2's
+		GRAPH_TARGET_AVX2 inline __m256i PremultiplyWordsAVX2(__m256i x, const bool swap)
+		{
+			const __m256i colorLanes = _mm256_set_epi16(0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1);
+			const __m256i alphaLanes = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+			if (swap)
+			{
+				x = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+			}
+			const __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			const __m256i t = _mm256_add_epi16(
+			                                   _mm256_mullo_epi16(x, _mm256_or_si256(_mm256_and_si256(alpha, colorLanes), alphaLanes)),
+			                                   _mm256_set1_epi16(0x80));
+			return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+		}
+
+		GRAPH_TARGET_AVX2 void ConvertSpan8AVX2(const bool swap, const std::uint8_t* src, Pixel* dst, size_t count)
+		{
+			const __m256i zero = _mm256_setzero_si256();
+			for (; count >= 8; count -= 8, src += 32, dst += 8)
+			{
+				//Unpacking and packing both work within 128 bit lanes, pixels stay in order
+				const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst),
+				                    _mm256_packus_epi16(
+				                                        PremultiplyWordsAVX2(_mm256_unpacklo_epi8(s, zero), swap),
+				                                        PremultiplyWordsAVX2(_mm256_unpackhi_epi8(s, zero), swap)));
+			}
+			//Tail stays in this function, calling the SSE2 kernel from AVX code stalls on the transition
+			ConvertSpanScalar(swap ? PIXEL_FORMAT::RGBA8 : PIXEL_FORMAT::BGRA8, src, dst, count);
+		}
+
+		GRAPH_TARGET_AVX2 void ConvertRgbAVX2(const std::uint8_t* src, Pixel* dst, size_t count)
+		{
+			//Twelve bytes of four pixels per 128 bit lane spread to B G R and an opaque alpha
+			const __m256i spread = _mm256_setr_epi8(
+			                                        2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+			                                        2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+			const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+			//Sixteen bytes are read from byte 12 on, ten pixels left keep that inside the span
+			for (; count >= 10; count -= 8, src += 24, dst += 8)
+			{
+				const __m256i s = _mm256_inserti128_si256(
+				                                          _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))),
+				                                          _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12)),
+				                                          1);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_or_si256(_mm256_shuffle_epi8(s, spread), opaque));
+			}
+			ConvertSpanScalar(PIXEL_FORMAT::RGB8, src, dst, count);
+		}
+#endif
+
+		void FillSpanOpaque(Pixel* dst, const size_t count, const Pixel color)
+		{
+			switch (g_simd_level)
+			{
+#ifdef GRAPH_SOFT_X86
+				case SIMD_LEVEL::AVX2:
+					FillSpanOpaqueAVX2(dst, count, color);
+					return;
+				case SIMD_LEVEL::SSE2:
+					FillSpanOpaqueSSE2(dst, count, color);
+					return;
+#endif
+				default:
+					FillSpanOpaqueScalar(dst, count, color);
+			}
+		}
+
+		void BlendSpan(Pixel* dst, const size_t count, const Pixel color)
+		{
+			switch (g_simd_level)
+			{
+#ifdef GRAPH_SOFT_X86
+				case SIMD_LEVEL::AVX2:
+					BlendSpanAVX2(dst, count, color);
+					return;
+				case SIMD_LEVEL::SSE2:
+					BlendSpanSSE2(dst, count, color);
+					return;
+#endif
+				default:
+					BlendSpanScalar(dst, count, color);
+			}
+		}
+
+		void CompositeSpan(Pixel* dst, const Pixel* src, const size_t count, const std::uint32_t alpha)
+		{
+#ifdef GRAPH_SOFT_X86
+			//Sprites are short rows, the SSE2 kernel serves AVX2 as well
+			if (g_simd_level != SIMD_LEVEL::Scalar)
+			{
+				CompositeSpanSSE2(dst, src, count, alpha);
+				return;
+			}
+#endif
+			CompositeSpanScalar(dst, src, count, alpha);
+		}
+
+		void PackColors(const Color* src, Color32* dst, const size_t count)
+		{
+#ifdef GRAPH_SOFT_X86
+			//Four colors fill a register, the SSE2 kernel serves AVX2 as well
+			if (g_simd_level != SIMD_LEVEL::Scalar)
+			{
+				PackColorsSSE2(src, dst, count);
+				return;
+			}
+#endif
+			PackColorsScalar(src, dst, count);
+		}
+
+		void UnpackColors(const Color32* src, Color* dst, const size_t count)
+		{
+#ifdef GRAPH_SOFT_X86
+			if (g_simd_level != SIMD_LEVEL::Scalar)
+			{
+				UnpackColorsSSE2(src, dst, count);
+				return;
+			}
+#endif
+			UnpackColorsScalar(src, dst, count);
+		}
+
+		void SampleSpanLinear(
+			Pixel* dst,
+			const Image& image,
+			const std::int64_t u,
+			const std::int64_t v,
+			const std::int64_t du,
+			const std::int64_t dv,
+			const size_t count)
+		{
+#ifdef GRAPH_SOFT_X86
+			//Four texels per sample fill a register, the SSE2 kernel serves AVX2 as well
+			if (g_simd_level != SIMD_LEVEL::Scalar)
+			{
+				SampleSpanLinearSSE2(dst, image, u, v, du, dv, count);
+				return;
+			}
+#endif
+			SampleSpanLinearScalar(dst, image, u, v, du, dv, count);
+		}
+
+		void HalveSpan(Pixel* dst, const Pixel* row0, const Pixel* row1, const size_t count)
+		{
+#ifdef GRAPH_SOFT_X86
+			if (g_simd_level != SIMD_LEVEL::Scalar)
+			{
+				HalveSpanSSE2(dst, row0, row1, count);
+				return;
+			}
+#endif
+			HalveSpanScalar(dst, row0, row1, count);
+		}
+
+		void ConvertSpan(const PIXEL_FORMAT format, const void* src, Pixel* dst, const size_t count)
+		{
+			const auto* bytes = static_cast<const std::uint8_t*>(src);
+#ifdef GRAPH_SOFT_X86
+			const bool avx2 = g_simd_level == SIMD_LEVEL::AVX2;
+			if (g_simd_level != SIMD_LEVEL::Scalar)
+			{
+				switch (format)
+				{
+					case PIXEL_FORMAT::BGRA8:
+					case PIXEL_FORMAT::RGBA8:
+						if (avx2)
+						{
+							ConvertSpan8AVX2(format == PIXEL_FORMAT::RGBA8, bytes, dst, count);
+						}
+						else
+						{
+							ConvertSpan8SSE2(format == PIXEL_FORMAT::RGBA8, bytes, dst, count);
+						}
+						return;
+					//Spreading three bytes takes pshufb, SSE2 has none
+					case PIXEL_FORMAT::RGB8:
+						if (avx2)
+						{
+							ConvertRgbAVX2(bytes, dst, count);
+							return;
+						}
+						break;
+					//Bound by the stores, the SSE2 kernels serve AVX2 as well
+					case PIXEL_FORMAT::Gray8:
+						ConvertGraySSE2(bytes, dst, count);
+						return;
+					case PIXEL_FORMAT::RGBA32Float:
+						ConvertFloatsSSE2(static_cast<const float*>(src), dst, count);
+						return;
+					default:
+						break;
+				}
+			}
+#endif
+			ConvertSpanScalar(format, bytes, dst, count);
+		}
+
+		void ConvertPixels(
+			const PIXEL_FORMAT format,
+			const int width,
+			const int height,
+			const void* src,
+			const size_t srcPitch,
+			Pixel* dst,
+			const size_t dstPitch,
+			TaskPool* pool)
+		{
+			if (width <= 0 || height <= 0)
+			{
+				return;
+			}
+			const size_t bandRows = std::max<size_t>(c_convert_task_pixels / static_cast<size_t>(width), 1);
+			const size_t bands = (static_cast<size_t>(height) + bandRows - 1) / bandRows;
+			const std::function<void(size_t, unsigned)> band = [&](const size_t index, unsigned)
+			{
+				const size_t end = std::min(static_cast<size_t>(height), (index + 1) * bandRows);
+				for (size_t y = index * bandRows; y < end; y++)
+				{
+					ConvertSpan(
+					            format,
+					            static_cast<const std::uint8_t*>(src) + y * srcPitch,
+					            reinterpret_cast<Pixel*>(reinterpret_cast<std::uint8_t*>(dst) + y * dstPitch),
+					            static_cast<size_t>(width));
+				}
+			};
+			if (pool == nullptr || bands == 1)
+			{
+				for (size_t i = 0; i < bands; i++)
+				{
+					band(i, 0);
+				}
+				return;
+			}
+			pool->run(bands, band);
+		}
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include "soft_canvas.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define GRAPH_SOFT_X86 1
+#endif
+
+namespace graph
+{
+	namespace soft
+	{
+		enum class SIMD_LEVEL
+		{
+			Scalar,
+			SSE2,
+			AVX2
+		};
+
+		//Best level the running CPU supports, detected once
+		SIMD_LEVEL GetSimdLevel();
+
+		//Forces a lower level, for benchmarks and for comparing output between paths
+		void SetSimdLevel(SIMD_LEVEL level);
+
+		//dst[0, count) = color
+		void FillSpanOpaque(Pixel* dst, size_t count, Pixel color);
+
+		//dst[0, count) = color over dst[i], color is premultiplied.
+		//Rounds exactly like BlendPixel, every level gives identical output.
+		void BlendSpan(Pixel* dst, size_t count, Pixel color);
+
+		//dst[i] = src[i] scaled by alpha / 255 over dst[i], src is premultiplied.
+		//Rounds exactly like BlendPixel and ScalePixel, every level gives identical output.
+		void CompositeSpan(Pixel* dst, const Pixel* src, size_t count, std::uint32_t alpha);
+
+		//Picks FillSpanOpaque or BlendSpan from the alpha of color
+		inline void FillSpan(Pixel* dst, const size_t count, const Pixel color)
+		{
+			if ((color >> 24) == 0xFF)
+			{
+				FillSpanOpaque(dst, count, color);
+			}
+			else if ((color >> 24) != 0)
+			{
+				BlendSpan(dst, count, color);
+			}
+		}
+
+		//dst[i] = image sampled bilinearly at (u + i * du, v + i * dv), positions in 1/65536 texels
+		//from the center of texel (0, 0), edges repeat outward. Weights are rounded to 1/128,
+		//every level gives identical output
+		void SampleSpanLinear(
+			Pixel* dst,
+			const Image& image,
+			std::int64_t u,
+			std::int64_t v,
+			std::int64_t du,
+			std::int64_t dv,
+			size_t count);
+
+		//dst[i] = rounded mean of the 2x2 block at column 2 * i of row0 and row1,
+		//every level gives identical output
+		void HalveSpan(Pixel* dst, const Pixel* row0, const Pixel* row1, size_t count);
+
+		//Bytes a pixel of format takes
+		size_t FormatBytes(PIXEL_FORMAT format);
+
+		//dst[i] = pixel i of src in format, premultiplied. 8 bit channels round like PremultiplyPacked,
+		//floats like PremultiplyColor with NaN as 0. Every level gives identical output
+		void ConvertSpan(PIXEL_FORMAT format, const void* src, Pixel* dst, size_t count);
+
+		class TaskPool;
+
+		//ConvertSpan of every row, pitches are byte counts. With a pool, bands of rows are
+		//converted by its threads
+		void ConvertPixels(
+			PIXEL_FORMAT format,
+			int width,
+			int height,
+			const void* src,
+			size_t srcPitch,
+			Pixel* dst,
+			size_t dstPitch,
+			TaskPool* pool = nullptr);
+
+		//dst[i] = Color32(src[i]), every level gives identical output
+		void PackColors(const Color* src, Color32* dst, size_t count);
+
+		//dst[i] = Color(src[i]), every level gives identical output
+		void UnpackColors(const Color32* src, Color* dst, size_t count);
+	}
+}
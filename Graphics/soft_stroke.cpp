@@ -0,0 +1,584 @@
+#include "soft_stroke.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace graph
+{
+	namespace soft
+	{
+		//Dashes one stroke may be cut into, past it the stroke is drawn solid
+		const double c_max_dashes = 1 << 20;
+
+		Point operator+(const Point a, const Point b) { return Point{a.x + b.x, a.y + b.y}; }
+		Point operator-(const Point a, const Point b) { return Point{a.x - b.x, a.y - b.y}; }
+		Point operator*(const Point a, const float s) { return Point{a.x * s, a.y * s}; }
+		float Dot(const Point a, const Point b) { return a.x * b.x + a.y * b.y; }
+		float Cross(const Point a, const Point b) { return a.x * b.y - a.y * b.x; }
+
+		//Builds the pieces of one stroke into an Outline
+		class StrokeBuilder
+		{
+			const StrokeStyle& style;
+			const float half;
+			const float tolerance;
+			Outline& out;
+			std::vector<Point> piece;
+
+			void AddPiece()
+			{
+				if (piece.size() < 3)
+				{
+					piece.clear();
+					return;
+				}
+				float area = 0.f;
+				for (size_t i = 0, j = piece.size() - 1; i < piece.size(); j = i++)
+				{
+					area += Cross(piece[j], piece[i]);
+				}
+				if (area < 0.f)
+				{
+					std::reverse(piece.begin(), piece.end());
+				}
+				out.points.insert(out.points.end(), piece.begin(), piece.end());
+				out.ends.push_back(out.points.size());
+				piece.clear();
+			}
+
+			//Arc around center from angle a0 turning by sweep radians
+			void AddArc(const Point center, const float a0, const float sweep)
+			{
+				const float step = 2.f * std::acos(1.f - std::min(tolerance / half, 1.f));
+				const int count = std::max(1, std::min(256, static_cast<int>(std::ceil(std::fabs(sweep) / std::max(step, 1e-3f)))));
+				for (int i = 0; i <= count; i++)
+				{
+					const float a = a0 + sweep * static_cast<float>(i) / static_cast<float>(count);
+					piece.push_back(Point{center.x + half * std::cos(a), center.y + half * std::sin(a)});
+				}
+			}
+
+			//dir is the unit direction pointing out of the stroke at end
+			void AddCap(const Point end, const Point dir, const CAP_STYLE cap)
+			{
+				const Point normal{-dir.y * half, dir.x * half};
+				switch (cap)
+				{
+					case CAP_STYLE::Flat:
+						return;
+					case CAP_STYLE::Square:
+						piece = {end + normal, end + normal + dir * half, end - normal + dir * half, end - normal};
+						break;
+					case CAP_STYLE::Triangle:
+						piece = {end + normal, end + dir * half, end - normal};
+						break;
+					case CAP_STYLE::Round:
+					{
+						//normal is dir turned +90 degrees, turning back by 180 passes through dir
+						piece.push_back(end);
+						AddArc(end, std::atan2(normal.y, normal.x), -PI);
+						break;
+					}
+				}
+				AddPiece();
+			}
+
+			//Fills the outer side between the segments meeting at p
+			void AddJoin(const Point p, const Point d0, const Point d1)
+			{
+				const float turn = Cross(d0, d1);
+				const float cosine = Dot(d0, d1);
+				if (std::fabs(turn) < 1e-6f && cosine > 0.f)
+				{
+					return;
+				}
+				const float side = turn > 0.f ? -1.f : 1.f;
+				const Point n0 = Point{-d0.y, d0.x} * (half * side);
+				const Point n1 = Point{-d1.y, d1.x} * (half * side);
+				const Point a = p + n0;
+				const Point b = p + n1;
+				switch (style.line_join)
+				{
+					case LINE_JOIN::Bevel:
+						piece = {p, a, b};
+						break;
+					case LINE_JOIN::Round:
+					{
+						const float a0 = std::atan2(n0.y, n0.x);
+						float sweep = std::atan2(n1.y, n1.x) - a0;
+						if (sweep > PI)
+						{
+							sweep -= TWO_PI;
+						}
+						else if (sweep < -PI)
+						{
+							sweep += TWO_PI;
+						}
+						piece.push_back(p);
+						AddArc(p, a0, sweep);
+						break;
+					}
+					case LINE_JOIN::Miter:
+					case LINE_JOIN::MiterOrBevel:
+					{
+						//Miter length over half the width is 1 / cos(theta / 2)
+						const float limit = std::max(style.miter_limit, 1.f);
+						const float cosHalf = std::sqrt(std::max((1.f + Dot(n0, n1) / (half * half)) * 0.5f, 0.f));
+						if (cosHalf < 1e-4f)
+						{
+							piece = {p, a, b};
+							break;
+						}
+						const Point tip = p + (n0 + n1) * (1.f / (2.f * cosHalf * cosHalf));
+						if (cosHalf * limit >= 1.f)
+						{
+							piece = {p, a, tip, b};
+						}
+						else if (style.line_join == LINE_JOIN::MiterOrBevel)
+						{
+							piece = {p, a, b};
+						}
+						else
+						{
+							//Cut square to the bisector, limit half widths from p
+							const float t = (limit - cosHalf) / (1.f / cosHalf - cosHalf);
+							piece = {p, a, a + (tip - a) * t, b + (tip - b) * t, b};
+						}
+						break;
+					}
+				}
+				AddPiece();
+			}
+
+			void AddSegment(const Point from, const Point to, const Point dir)
+			{
+				const Point normal{-dir.y * half, dir.x * half};
+				piece = {from + normal, to + normal, to - normal, from - normal};
+				AddPiece();
+			}
+		public:
+			StrokeBuilder(const StrokeStyle& style, const float width, const float tolerance, Outline& out)
+				: style(style), half(width * 0.5f), tolerance(tolerance), out(out)
+			{
+			}
+
+			//points must not repeat, count >= 2
+			void polyline(const Point* points, const size_t count, const bool closed, const CAP_STYLE startCap, const CAP_STYLE endCap)
+			{
+				const size_t segments = closed ? count : count - 1;
+				Point first{0.f, 0.f}, previous{0.f, 0.f};
+				for (size_t i = 0; i < segments; i++)
+				{
+					const Point from = points[i];
+					const Point to = points[(i + 1) % count];
+					const Point delta = to - from;
+					const Point dir = delta * (1.f / std::sqrt(Dot(delta, delta)));
+					AddSegment(from, to, dir);
+					if (i == 0)
+					{
+						first = dir;
+					}
+					else
+					{
+						AddJoin(from, previous, dir);
+					}
+					previous = dir;
+				}
+				if (closed)
+				{
+					AddJoin(points[0], previous, first);
+					return;
+				}
+				AddCap(points[0], first * -1.f, startCap);
+				AddCap(points[count - 1], previous, endCap);
+			}
+
+			//A dash or line of zero length, only its caps show
+			void dot(const Point at, const Point dir, const CAP_STYLE startCap, const CAP_STYLE endCap)
+			{
+				if (startCap == CAP_STYLE::Round && endCap == CAP_STYLE::Round)
+				{
+					AddArc(at, 0.f, TWO_PI);
+					piece.pop_back();
+					AddPiece();
+					return;
+				}
+				AddCap(at, dir * -1.f, startCap);
+				AddCap(at, dir, endCap);
+			}
+		};
+
+		//Drops points closer than epsilon to the one before
+		void Dedupe(const Point* points, const size_t count, const bool closed, std::vector<Point>& res)
+		{
+			res.clear();
+			const float epsilon = 1e-5f;
+			for (size_t i = 0; i < count; i++)
+			{
+				if (res.empty() || std::fabs(points[i].x - res.back().x) > epsilon || std::fabs(points[i].y - res.back().y) > epsilon)
+				{
+					res.push_back(points[i]);
+				}
+			}
+			if (closed && res.size() > 1 &&
+				std::fabs(res[0].x - res.back().x) <= epsilon && std::fabs(res[0].y - res.back().y) <= epsilon)
+			{
+				res.pop_back();
+			}
+		}
+
+		//A segment of a polyline in doubles, enter to leave along it is inside a rect
+		struct Span
+		{
+			double origin[2], unit[2];
+			double length, enter, leave;
+		};
+
+		//enter is not below leave when the segment misses low to high
+		Span ClipSegment(const Point from, const Point to, const double* low, const double* high)
+		{
+			Span span;
+			span.origin[0] = from.x;
+			span.origin[1] = from.y;
+			const double delta[] = {to.x - span.origin[0], to.y - span.origin[1]};
+			span.length = std::sqrt(delta[0] * delta[0] + delta[1] * delta[1]);
+			span.unit[0] = delta[0] / span.length;
+			span.unit[1] = delta[1] / span.length;
+			span.enter = 0.0;
+			span.leave = span.length;
+			for (int axis = 0; axis < 2; axis++)
+			{
+				if (span.unit[axis] == 0.0)
+				{
+					if (!(span.origin[axis] >= low[axis] && span.origin[axis] <= high[axis]))
+					{
+						span.leave = -1.0;
+					}
+					continue;
+				}
+				double lowAt = (low[axis] - span.origin[axis]) / span.unit[axis];
+				double highAt = (high[axis] - span.origin[axis]) / span.unit[axis];
+				if (lowAt > highAt)
+				{
+					std::swap(lowAt, highAt);
+				}
+				span.enter = std::max(span.enter, lowAt);
+				span.leave = std::min(span.leave, highAt);
+			}
+			return span;
+		}
+
+		void StrokeOutline(
+			const Point* points,
+			const size_t count,
+			const bool closed,
+			const float width,
+			const StrokeStyle& style,
+			const float tolerance,
+			const Rect& visible,
+			Outline& out)
+		{
+			out.clear();
+			if (!(width > 0.f) || !std::isfinite(width) || count == 0)
+			{
+				return;
+			}
+			//A point that is not finite has no place to stroke from, the polyline draws nothing
+			for (size_t i = 0; i < count; i++)
+			{
+				if (!std::isfinite(points[i].x) || !std::isfinite(points[i].y))
+				{
+					return;
+				}
+			}
+			std::vector<Point> path;
+			Dedupe(points, count, closed, path);
+			StrokeBuilder builder(style, width, tolerance, out);
+
+			float total = 0.f;
+			for (float dash : style.dashes)
+			{
+				total += std::fabs(dash) * width;
+			}
+			//A pattern with no length, or one too long for a float, is drawn solid
+			if (style.dashes.empty() || !(total > 0.f) || !std::isfinite(total))
+			{
+				if (path.size() >= 2)
+				{
+					builder.polyline(path.data(), path.size(), closed && path.size() > 2, style.start_cap, style.end_cap);
+				}
+				else if (path.size() == 1 && !closed)
+				{
+					//Direct2D draws the caps of a zero length line facing along x
+					builder.dot(path[0], Point{1.f, 0.f}, style.start_cap, style.end_cap);
+				}
+				return;
+			}
+			if (path.size() < 2)
+			{
+				return;
+			}
+			if (closed)
+			{
+				path.push_back(path[0]);
+			}
+
+			//Skip dash_offset into the pattern. Lengths are doubles, a float stops moving along
+			//segments longer than 2^24 steps of a dash
+			const size_t patternSize = style.dashes.size();
+			size_t index = 0;
+			double remaining = std::fabs(style.dashes[0]) * width;
+			const auto advance = [&](double distance)
+			{
+				if (distance <= 0.0 || distance < remaining)
+				{
+					remaining -= std::max(distance, 0.0);
+					return;
+				}
+				distance = std::fmod(distance - remaining, static_cast<double>(total));
+				for (size_t step = 0; step <= patternSize; step++)
+				{
+					index = (index + 1) % patternSize;
+					remaining = std::fabs(style.dashes[index]) * width;
+					//Stops on a zero length dash as the walk below does, it is drawn as a dot
+					if (distance <= 0.0 || distance < remaining)
+					{
+						break;
+					}
+					distance -= remaining;
+				}
+				remaining -= std::min(distance, remaining);
+			};
+			double phase = std::fmod(static_cast<double>(style.dash_offset) * width, static_cast<double>(total));
+			advance(phase < 0.0 ? phase + total : phase);
+
+			//Only what can reach visible is dashed, the rest just moves the pattern along
+			const float reach = 0.5f * width * std::max(style.miter_limit, 1.5f) + tolerance;
+			const double low[] = {visible.left - reach, visible.top - reach};
+			const double high[] = {visible.right + reach, visible.bottom + reach};
+			//A pattern too fine to be drawn with a bounded number of dashes is drawn solid
+			double shown = 0.0;
+			for (size_t i = 0; i + 1 < path.size(); i++)
+			{
+				const Span span = ClipSegment(path[i], path[i + 1], low, high);
+				shown += std::max(span.leave - span.enter, 0.0);
+			}
+			if (shown / total * static_cast<double>(patternSize) > c_max_dashes)
+			{
+				const size_t size = closed ? path.size() - 1 : path.size();
+				builder.polyline(path.data(), size, closed && size > 2, style.start_cap, style.end_cap);
+				return;
+			}
+
+			std::vector<Point> dash;
+			const auto append = [&dash](const Point point)
+			{
+				if (dash.empty() || std::fabs(point.x - dash.back().x) > 1e-5f || std::fabs(point.y - dash.back().y) > 1e-5f)
+				{
+					dash.push_back(point);
+				}
+			};
+			bool atStart = true;
+			const auto endDash = [&](const Point dir, const bool atEnd)
+			{
+				const CAP_STYLE startCap = atStart && !closed ? style.start_cap : style.dash_cap;
+				const CAP_STYLE endCap = atEnd && !closed ? style.end_cap : style.dash_cap;
+				if (dash.size() >= 2)
+				{
+					builder.polyline(dash.data(), dash.size(), false, startCap, endCap);
+				}
+				else if (dash.size() == 1)
+				{
+					builder.dot(dash[0], dir, startCap, endCap);
+				}
+				dash.clear();
+			};
+			for (size_t i = 0; i + 1 < path.size(); i++)
+			{
+				const Span span = ClipSegment(path[i], path[i + 1], low, high);
+				const double length = span.length, enter = span.enter, leave = span.leave;
+				const Point dir{static_cast<float>(span.unit[0]), static_cast<float>(span.unit[1])};
+				const auto at = [&span](const double pos)
+				{
+					return Point{
+						static_cast<float>(span.origin[0] + span.unit[0] * pos),
+						static_cast<float>(span.origin[1] + span.unit[1] * pos)
+					};
+				};
+				if (!(enter < leave))
+				{
+					endDash(dir, false);
+					advance(length);
+					atStart = false;
+					continue;
+				}
+				if (enter > 0.0)
+				{
+					//The dash open from the last segment is cut where it leaves
+					endDash(dir, false);
+					advance(enter);
+					atStart = false;
+				}
+
+				//Walked from where the segment enters, far off endpoints would swallow each step
+				const double shownLength = leave - enter;
+				double pos = 0.0;
+				for (;;)
+				{
+					const bool on = index % 2 == 0;
+					if (on && dash.empty())
+					{
+						append(at(enter + pos));
+					}
+					if (remaining > shownLength - pos)
+					{
+						remaining -= shownLength - pos;
+						if (leave < length)
+						{
+							if (on)
+							{
+								append(at(leave));
+								endDash(dir, false);
+							}
+							advance(length - leave);
+							atStart = false;
+						}
+						else if (on)
+						{
+							append(path[i + 1]);
+						}
+						break;
+					}
+					pos += remaining;
+					if (on)
+					{
+						append(at(enter + pos));
+						endDash(dir, false);
+					}
+					atStart = false;
+					index = (index + 1) % patternSize;
+					remaining = std::fabs(style.dashes[index]) * width;
+				}
+			}
+			if (!dash.empty())
+			{
+				const Point delta = path.back() - path[path.size() - 2];
+				endDash(delta * (1.f / std::sqrt(Dot(delta, delta))), true);
+			}
+		}
+
+		std::uint64_t HashBytes(std::uint64_t hash, const void* data, const size_t size)
+		{
+			const auto* bytes = static_cast<const std::uint8_t*>(data);
+			for (size_t i = 0; i < size; i++)
+			{
+				hash = (hash ^ bytes[i]) * 1099511628211ull;
+			}
+			return hash;
+		}
+
+		const Outline& StrokeCache::stroke(
+			const Point* points,
+			const size_t count,
+			const bool closed,
+			const float width,
+			const StrokeStyle& style,
+			const float tolerance,
+			const Rect& visible,
+			Outline& scratch)
+		{
+			std::uint64_t hash = 14695981039346656037ull;
+			hash = HashBytes(hash, points, count * sizeof(Point));
+			hash = HashBytes(hash, &closed, sizeof(closed));
+			hash = HashBytes(hash, &width, sizeof(width));
+			hash = HashBytes(hash, &tolerance, sizeof(tolerance));
+			const int enums[] = {
+				static_cast<int>(style.start_cap),
+				static_cast<int>(style.end_cap),
+				static_cast<int>(style.dash_cap),
+				static_cast<int>(style.line_join)
+			};
+			hash = HashBytes(hash, enums, sizeof(enums));
+			hash = HashBytes(hash, &style.miter_limit, sizeof(style.miter_limit));
+			hash = HashBytes(hash, style.dashes.data(), style.dashes.size() * sizeof(float));
+			hash = HashBytes(hash, &style.dash_offset, sizeof(style.dash_offset));
+			hash = HashBytes(hash, &visible, sizeof(visible));
+
+			clock++;
+			const auto found = entries.find(hash);
+			if (found != entries.end())
+			{
+				Entry& entry = found->second;
+				if (entry.closed == closed && entry.width == width && entry.tolerance == tolerance &&
+					entry.input.size() == count && entry.style == style &&
+					std::memcmp(&entry.visible, &visible, sizeof(visible)) == 0 &&
+					std::memcmp(entry.input.data(), points, count * sizeof(Point)) == 0)
+				{
+					entry.lastUse = clock;
+					return entry.outline;
+				}
+			}
+
+			StrokeOutline(points, count, closed, width, style, tolerance, visible, scratch);
+			const size_t cost = count + scratch.points.size();
+			if (cost > budget / 4)
+			{
+				return scratch;
+			}
+			//Only the second sighting is stored, seen is emptied now and then
+			if (seen.size() > 4096)
+			{
+				seen.clear();
+			}
+			auto& sighting = seen[hash];
+			if (sighting == 0)
+			{
+				sighting = clock;
+				return scratch;
+			}
+			seen.erase(hash);
+
+			if (found != entries.end())
+			{
+				storedPoints -= found->second.input.size() + found->second.outline.points.size();
+				entries.erase(found);
+			}
+			storedPoints += cost;
+			while (storedPoints > budget)
+			{
+				Evict();
+			}
+			Entry& entry = entries[hash];
+			entry.input.assign(points, points + count);
+			entry.closed = closed;
+			entry.width = width;
+			entry.tolerance = tolerance;
+			entry.style = style;
+			entry.visible = visible;
+			entry.outline = scratch;
+			entry.lastUse = clock;
+			return entry.outline;
+		}
+
+		void StrokeCache::Evict()
+		{
+			auto oldest = entries.begin();
+			for (auto it = entries.begin(); it != entries.end(); ++it)
+			{
+				if (it->second.lastUse < oldest->second.lastUse)
+				{
+					oldest = it;
+				}
+			}
+			storedPoints -= oldest->second.input.size() + oldest->second.outline.points.size();
+			entries.erase(oldest);
+		}
+
+		void StrokeCache::clear()
+		{
+			entries.clear();
+			seen.clear();
+			storedPoints = 0;
+		}
+	}
+}
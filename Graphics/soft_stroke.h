@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "graph_types.h"
+
+namespace graph
+{
+	namespace soft
+	{
+		//Closed contours, contour i is points [ends[i - 1], ends[i])
+		struct Outline
+		{
+			std::vector<Point> points;
+			std::vector<size_t> ends;
+
+			void clear()
+			{
+				points.clear();
+				ends.clear();
+			}
+		};
+
+		//Turns a polyline into pieces to be filled with the nonzero rule: a quad per segment,
+		//a wedge per join and the caps, all wound the same way so overlaps merge.
+		//tolerance is the largest distance a round join or cap may be off the true arc.
+		//Dashes are only built where they can reach visible, pass an infinite rect for all of them.
+		void StrokeOutline(
+			const Point* points,
+			size_t count,
+			bool closed,
+			float width,
+			const StrokeStyle& style,
+			float tolerance,
+			const Rect& visible,
+			Outline& out);
+
+		//Outlines of polylines stroked more than once, looked up by their exact input.
+		//A polyline is only stored the second time it is seen, so geometry that changes
+		//every frame does not churn the cache.
+		class StrokeCache
+		{
+			struct Entry
+			{
+				std::vector<Point> input;
+				bool closed;
+				float width, tolerance;
+				StrokeStyle style;
+				Rect visible;
+				Outline outline;
+				std::uint64_t lastUse;
+			};
+
+			std::unordered_map<std::uint64_t, Entry> entries;
+			std::unordered_map<std::uint64_t, std::uint64_t> seen;
+			size_t storedPoints = 0;
+			size_t budget;
+			std::uint64_t clock = 0;
+
+			void Evict();
+		public:
+			//budget is the number of points, input and outline, kept at most
+			explicit StrokeCache(size_t budget = 1 << 20) : budget(budget) {}
+
+			//Strokes into scratch unless the outline is cached, returns the outline to fill
+			const Outline& stroke(
+				const Point* points,
+				size_t count,
+				bool closed,
+				float width,
+				const StrokeStyle& style,
+				float tolerance,
+				const Rect& visible,
+				Outline& scratch);
+
+			size_t size() const { return entries.size(); }
+
+			void clear();
+		};
+	}
+}
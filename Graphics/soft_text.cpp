@@ -0,0 +1,335 @@
+#include "soft_text.h"
+#include <algorithm>
+#include <cmath>
+
+namespace graph
+{
+	namespace soft
+	{
+		Mask::Mask(const int width, const int height) :
+			w(std::max(width, 0)),
+			h(std::max(height, 0)),
+			bits(static_cast<size_t>(w) * h, 0)
+		{
+		}
+
+		void Mask::clear()
+		{
+			std::fill(bits.begin(), bits.end(), static_cast<std::uint8_t>(0));
+		}
+
+		namespace builtin_font
+		{
+			//Printable ASCII from space to tilde
+			const std::uint8_t c_glyphs[95][c_rows] = {
+				{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+				{0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04},
+				{0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00},
+				{0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A},
+				{0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04},
+				{0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03},
+				{0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D},
+				{0x0C, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00},
+				{0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02},
+				{0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08},
+				{0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00},
+				{0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00},
+				{0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08},
+				{0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00},
+				{0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C},
+				{0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00},
+				{0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E},
+				{0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E},
+				{0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F},
+				{0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E},
+				{0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02},
+				{0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E},
+				{0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E},
+				{0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08},
+				{0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E},
+				{0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C},
+				{0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00},
+				{0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08},
+				{0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02},
+				{0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00},
+				{0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08},
+				{0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04},
+				{0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E},
+				{0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11},
+				{0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E},
+				{0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E},
+				{0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C},
+				{0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F},
+				{0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10},
+				{0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F},
+				{0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11},
+				{0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E},
+				{0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C},
+				{0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11},
+				{0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F},
+				{0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11},
+				{0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11},
+				{0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},
+				{0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10},
+				{0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D},
+				{0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11},
+				{0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E},
+				{0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},
+				{0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},
+				{0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04},
+				{0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A},
+				{0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11},
+				{0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04},
+				{0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F},
+				{0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E},
+				{0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00},
+				{0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E},
+				{0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00},
+				{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F},
+				{0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00},
+				{0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F},
+				{0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1E},
+				{0x00, 0x00, 0x0E, 0x10, 0x10, 0x11, 0x0E},
+				{0x01, 0x01, 0x0D, 0x13, 0x11, 0x11, 0x0F},
+				{0x00, 0x00, 0x0E, 0x11, 0x1F, 0x10, 0x0E},
+				{0x06, 0x09, 0x08, 0x1C, 0x08, 0x08, 0x08},
+				{0x00, 0x0F, 0x11, 0x11, 0x0F, 0x01, 0x0E},
+				{0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11},
+				{0x04, 0x00, 0x0C, 0x04, 0x04, 0x04, 0x0E},
+				{0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0C},
+				{0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12},
+				{0x0C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E},
+				{0x00, 0x00, 0x1A, 0x15, 0x15, 0x11, 0x11},
+				{0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11},
+				{0x00, 0x00, 0x0E, 0x11, 0x11, 0x11, 0x0E},
+				{0x00, 0x00, 0x1E, 0x11, 0x1E, 0x10, 0x10},
+				{0x00, 0x00, 0x0D, 0x13, 0x0F, 0x01, 0x01},
+				{0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10},
+				{0x00, 0x00, 0x0E, 0x10, 0x0E, 0x01, 0x1E},
+				{0x08, 0x08, 0x1C, 0x08, 0x08, 0x09, 0x06},
+				{0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0D},
+				{0x00, 0x00, 0x11, 0x11, 0x11, 0x0A, 0x04},
+				{0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0A},
+				{0x00, 0x00, 0x11, 0x0A, 0x04, 0x0A, 0x11},
+				{0x00, 0x00, 0x11, 0x11, 0x0F, 0x01, 0x0E},
+				{0x00, 0x00, 0x1F, 0x02, 0x04, 0x08, 0x1F},
+				{0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02},
+				{0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},
+				{0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08},
+				{0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00}
+			};
+
+			const std::uint8_t* Glyph(const std::uint32_t code)
+			{
+				if (code < 0x20 || code > 0x7E)
+				{
+					return c_glyphs['?' - 0x20];
+				}
+				return c_glyphs[code - 0x20];
+			}
+		}
+
+		void BreakLines(
+			const wchar_t* text,
+			const size_t length,
+			const float size,
+			const float maxWidth,
+			std::vector<TextLine>& lines)
+		{
+			lines.clear();
+			//Every glyph has the same advance, widths are counted in characters
+			const float advance = builtin_font::Advance(size);
+			size_t maxChars = static_cast<size_t>(-1);
+			if (maxWidth < 1e9f * advance)
+			{
+				maxChars = maxWidth >= advance ? static_cast<size_t>(maxWidth / advance) : 1;
+			}
+			const auto push = [&](const size_t begin, size_t end)
+			{
+				while (end > begin && text[end - 1] == L' ')
+				{
+					end--;
+				}
+				lines.push_back(TextLine{begin, end, static_cast<float>(end - begin) * advance});
+			};
+			size_t paragraph = 0;
+			while (paragraph <= length)
+			{
+				size_t end = paragraph;
+				while (end < length && text[end] != L'\n')
+				{
+					end++;
+				}
+				const size_t next = end + 1;
+				if (end > paragraph && text[end - 1] == L'\r')
+				{
+					end--;
+				}
+				size_t begin = paragraph;
+				while (end - begin > maxChars)
+				{
+					//Break after the last space that keeps the line in, or inside a word too long for one
+					size_t cut = begin + maxChars;
+					while (cut > begin && text[cut] != L' ')
+					{
+						cut--;
+					}
+					if (cut == begin)
+					{
+						cut = begin + maxChars;
+						push(begin, cut);
+						begin = cut;
+						continue;
+					}
+					push(begin, cut);
+					begin = cut;
+					while (begin < end && text[begin] == L' ')
+					{
+						begin++;
+					}
+				}
+				push(begin, end);
+				paragraph = next;
+			}
+		}
+
+		GlyphAtlas::GlyphAtlas(const int pageSize) :
+			pageSize(pageSize),
+			page(std::make_shared<Mask>(pageSize, pageSize))
+		{
+		}
+
+		bool GlyphAtlas::Place(const int width, const int height, int& u, int& v)
+		{
+			if (shelfX + width > pageSize)
+			{
+				shelfY += shelfHeight;
+				shelfX = 0;
+				shelfHeight = 0;
+			}
+			if (shelfY + height > pageSize)
+			{
+				return false;
+			}
+			u = shelfX;
+			v = shelfY;
+			shelfX += width;
+			shelfHeight = std::max(shelfHeight, height);
+			return true;
+		}
+
+		void GlyphAtlas::Rasterize(const std::uint8_t* rows, const float size, const int subpixel, Glyph& glyph)
+		{
+			using namespace builtin_font;
+			const float cell = Cell(size);
+			const float offset = static_cast<float>(subpixel) * 0.25f;
+			//Exact area of the lit cells in every pixel, cells never overlap so the areas add up
+			const auto overlap = [](const float from, const float to, const int pixel)
+			{
+				const auto p = static_cast<float>(pixel);
+				return std::max(0.f, std::min(to, p + 1.f) - std::max(from, p));
+			};
+			float columns[c_columns], rowsTop[c_rows];
+			for (int c = 0; c < c_columns; c++)
+			{
+				columns[c] = offset + static_cast<float>(c) * cell;
+			}
+			for (int r = 0; r < c_rows; r++)
+			{
+				rowsTop[r] = -static_cast<float>(c_rows - r) * cell;
+			}
+			for (int y = 0; y < glyph.height; y++)
+			{
+				std::uint8_t* dst = page->row(glyph.v + y) + glyph.u;
+				const int py = glyph.top + y;
+				for (int x = 0; x < glyph.width; x++)
+				{
+					const int px = glyph.left + x;
+					float coverage = 0.f;
+					for (int r = 0; r < c_rows; r++)
+					{
+						const float height = overlap(rowsTop[r], rowsTop[r] + cell, py);
+						if (rows[r] == 0 || height == 0.f)
+						{
+							continue;
+						}
+						for (int c = 0; c < c_columns; c++)
+						{
+							if (rows[r] & (0x10 >> c))
+							{
+								coverage += height * overlap(columns[c], columns[c] + cell, px);
+							}
+						}
+					}
+					dst[x] = static_cast<std::uint8_t>(std::min(coverage, 1.f) * 255.f + 0.5f);
+				}
+			}
+		}
+
+		const GlyphAtlas::Glyph* GlyphAtlas::get(const std::uint32_t code, const float size, const int subpixel)
+		{
+			using namespace builtin_font;
+			//Sizes are kept in sixteenths of a pixel, one built-in face so the font is its size
+			const auto sixteenths = static_cast<std::uint32_t>(size * 16.f + 0.5f);
+			const std::uint64_t key = static_cast<std::uint64_t>(sixteenths) << 32 |
+				static_cast<std::uint64_t>(code & 0x3FFFFFFF) << 2 | static_cast<std::uint32_t>(subpixel & 3);
+			const auto found = glyphs.find(key);
+			if (found != glyphs.end())
+			{
+				return found->second.width == 0 ? nullptr : &found->second;
+			}
+			const std::uint8_t* rows = builtin_font::Glyph(code);
+			int minColumn = c_columns, maxColumn = -1, minRow = c_rows, maxRow = -1;
+			for (int r = 0; r < c_rows; r++)
+			{
+				for (int c = 0; c < c_columns; c++)
+				{
+					if (rows[r] & (0x10 >> c))
+					{
+						minColumn = std::min(minColumn, c);
+						maxColumn = std::max(maxColumn, c);
+						minRow = std::min(minRow, r);
+						maxRow = std::max(maxRow, r);
+					}
+				}
+			}
+			const float quantized = static_cast<float>(sixteenths) / 16.f;
+			const float cell = Cell(quantized);
+			Glyph glyph{0, 0, 0, 0, 0, 0};
+			if (maxColumn >= 0 && cell > 0.f)
+			{
+				const float offset = static_cast<float>(subpixel & 3) * 0.25f;
+				glyph.left = static_cast<int>(std::floor(offset + static_cast<float>(minColumn) * cell));
+				glyph.top = static_cast<int>(std::floor(-static_cast<float>(c_rows - minRow) * cell));
+				glyph.width = static_cast<int>(std::ceil(offset + static_cast<float>(maxColumn + 1) * cell)) - glyph.left;
+				glyph.height = static_cast<int>(std::ceil(-static_cast<float>(c_rows - 1 - maxRow) * cell)) - glyph.top;
+			}
+			if (glyph.width == 0 || glyph.height == 0)
+			{
+				glyph.width = glyph.height = 0;
+				glyphs.emplace(key, glyph);
+				return nullptr;
+			}
+			if (!Place(glyph.width, glyph.height, glyph.u, glyph.v))
+			{
+				//Cleared in place when nothing recorded holds the page
+				if (page.use_count() == 1)
+				{
+					page->clear();
+				}
+				else
+				{
+					page = std::make_shared<Mask>(pageSize, pageSize);
+				}
+				glyphs.clear();
+				shelfX = shelfY = shelfHeight = 0;
+				if (!Place(glyph.width, glyph.height, glyph.u, glyph.v))
+				{
+					return nullptr;
+				}
+			}
+			Rasterize(rows, quantized, subpixel & 3, glyph);
+			return &glyphs.emplace(key, glyph).first->second;
+		}
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "graph_types.h"
+
+namespace graph
+{
+	namespace soft
+	{
+		//Where lines sit in their box, numbered like DirectWrite's alignments
+		enum class TEXT_ALIGN
+		{
+			Near,
+			Far,
+			Center
+		};
+
+		//Tightly packed 8 bit coverage
+		class Mask
+		{
+			int w = 0, h = 0;
+			std::vector<std::uint8_t> bits;
+		public:
+			Mask() = default;
+			Mask(int width, int height);
+
+			int width() const { return w; }
+			int height() const { return h; }
+
+			std::uint8_t* row(int y) { return bits.data() + static_cast<size_t>(y) * w; }
+			const std::uint8_t* row(int y) const { return bits.data() + static_cast<size_t>(y) * w; }
+
+			void clear();
+		};
+
+		//Copies width x height coverage from u, v of a mask to x, y of the target, in device pixels
+		struct MaskQuad
+		{
+			int x, y;
+			int u, v, width, height;
+		};
+
+		//The face text is drawn with on the CPU: a 5x7 bitmap font of printable ASCII scaled to the
+		//font size, anything else shows as '?'. Every glyph is made of square cells of size / 10,
+		//its advance is 6 cells and lines are 12 cells apart with the baseline 9 cells down.
+		namespace builtin_font
+		{
+			constexpr int c_columns = 5;
+			constexpr int c_rows = 7;
+
+			//Rows of the glyph for code, top first, bit 4 is the left column
+			const std::uint8_t* Glyph(std::uint32_t code);
+
+			inline float Cell(const float size) { return size / 10.f; }
+			inline float Advance(const float size) { return 6.f * Cell(size); }
+			inline float LineHeight(const float size) { return 12.f * Cell(size); }
+			inline float Ascent(const float size) { return 9.f * Cell(size); }
+		}
+
+		struct TextLine
+		{
+			//Characters [begin, end) of the text, trailing spaces left out
+			size_t begin, end;
+			float width;
+		};
+
+		//Breaks text at line feeds, and at spaces where a line would be wider than maxWidth.
+		//A word wider than maxWidth alone is broken between characters
+		void BreakLines(const wchar_t* text, size_t length, float size, float maxWidth, std::vector<TextLine>& lines);
+
+		//Glyph coverage rasterized once per size, glyph and quarter pixel offset, packed onto a
+		//page in shelves. A full page is replaced by an empty one, what was recorded with the old
+		//one keeps it alive until drawn.
+		class GlyphAtlas
+		{
+		public:
+			struct Glyph
+			{
+				int u, v, width, height;
+				//Offset of the coverage from the pen on the baseline
+				int left, top;
+			};
+		private:
+			int pageSize;
+			std::shared_ptr<Mask> page;
+			std::unordered_map<std::uint64_t, Glyph> glyphs;
+			int shelfX = 0, shelfY = 0, shelfHeight = 0;
+
+			bool Place(int width, int height, int& u, int& v);
+			void Rasterize(const std::uint8_t* rows, float size, int subpixel, Glyph& glyph);
+		public:
+			explicit GlyphAtlas(int pageSize = 1024);
+
+			//Glyphs bigger than this are filled as cells rather than kept
+			static constexpr float c_max_size = 128.f;
+
+			//nullptr for a glyph with no coverage. Getting one may replace the page,
+			//the glyphs got before are then on the old page
+			const Glyph* get(std::uint32_t code, float size, int subpixel);
+
+			const std::shared_ptr<Mask>& get_page() const { return page; }
+		};
+	}
+}
@@ -0,0 +1,149 @@
+#include "sprite_atlas.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include "soft_decode.h"
+
+namespace graph
+{
+	SkylinePacker::SkylinePacker(const int size) : size(size)
+	{
+		reset();
+	}
+
+	void SkylinePacker::reset()
+	{
+		skyline.assign(1, Segment{0, 0, size});
+	}
+
+	int SkylinePacker::Fit(size_t index, const int width) const
+	{
+		if (skyline[index].x + width > size)
+		{
+			return -1;
+		}
+		int top = 0;
+		for (int left = width; left > 0; index++)
+		{
+			top = std::max(top, skyline[index].y);
+			left -= skyline[index].width;
+		}
+		return top;
+	}
+
+	bool SkylinePacker::place(const int width, const int height, int& x, int& y)
+	{
+		if (width <= 0 || height <= 0 || width > size || height > size)
+		{
+			return false;
+		}
+		size_t best = skyline.size();
+		int bestTop = INT_MAX, bestX = INT_MAX, bestY = 0;
+		for (size_t i = 0; i < skyline.size(); i++)
+		{
+			const int top = Fit(i, width);
+			if (top < 0 || top + height > size)
+			{
+				continue;
+			}
+			if (top + height < bestTop || (top + height == bestTop && skyline[i].x < bestX))
+			{
+				best = i;
+				bestTop = top + height;
+				bestX = skyline[i].x;
+				bestY = top;
+			}
+		}
+		if (best == skyline.size())
+		{
+			return false;
+		}
+		x = bestX;
+		y = bestY;
+		skyline.insert(skyline.begin() + static_cast<std::ptrdiff_t>(best), Segment{x, bestTop, width});
+		//Segments under the new one are cut back to where it ends
+		const size_t next = best + 1;
+		while (next < skyline.size() && skyline[next].x < x + width)
+		{
+			Segment& segment = skyline[next];
+			const int covered = x + width - segment.x;
+			if (covered < segment.width)
+			{
+				segment.x += covered;
+				segment.width -= covered;
+				break;
+			}
+			skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(next));
+		}
+		for (size_t i = 0; i + 1 < skyline.size();)
+		{
+			if (skyline[i].y == skyline[i + 1].y)
+			{
+				skyline[i].width += skyline[i + 1].width;
+				skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(i + 1));
+			}
+			else
+			{
+				i++;
+			}
+		}
+		return true;
+	}
+
+	AtlasBuilder::AtlasBuilder(const int pageSize, const int padding) :
+		pageSize(std::max(pageSize, 1)), padding(std::max(padding, 0)) {}
+
+	int AtlasBuilder::add(const int width, const int height, const void* pixels, const size_t pitch)
+	{
+		if (width <= 0 || height <= 0 || width > pageSize - 2 * padding || height > pageSize - 2 * padding)
+		{
+			return -1;
+		}
+		const int outerWidth = width + 2 * padding, outerHeight = height + 2 * padding;
+		//Earlier pages first, small sprites fill the gaps bigger ones left
+		size_t page = 0;
+		int x = 0, y = 0;
+		while (page < packers.size() && !packers[page].place(outerWidth, outerHeight, x, y))
+		{
+			page++;
+		}
+		if (page == packers.size())
+		{
+			pages.emplace_back(pageSize, pageSize);
+			packers.emplace_back(pageSize);
+			packers.back().place(outerWidth, outerHeight, x, y);
+		}
+		soft::Image& target = pages[page];
+		const auto* src = static_cast<const std::uint8_t*>(pixels);
+		for (int row = -padding; row < height + padding; row++)
+		{
+			const auto* from = reinterpret_cast<const soft::Pixel*>(src + pitch * static_cast<size_t>(std::min(std::max(row, 0), height - 1)));
+			soft::Pixel* to = target.row(y + padding + row) + x + padding;
+			std::memcpy(to, from, static_cast<size_t>(width) * sizeof(soft::Pixel));
+			std::fill(to - padding, to, from[0]);
+			std::fill(to + width, to + width + padding, from[width - 1]);
+		}
+		regions.push_back(AtlasRegion{static_cast<std::uint32_t>(page), x + padding, y + padding, width, height});
+		return static_cast<int>(regions.size() - 1);
+	}
+
+	int AtlasBuilder::add(const soft::Image& image)
+	{
+		if (image.width() == 0 || image.height() == 0)
+		{
+			return -1;
+		}
+		return add(image.width(), image.height(), image.row(0), image.pitch());
+	}
+
+	int AtlasBuilder::add_file(const std::wstring& path)
+	{
+		std::vector<std::uint8_t> data;
+		soft::Image image;
+		if (!soft::ReadFile(path, data) || !soft::DecodeImage(data.data(), data.size(), image))
+		{
+			return -1;
+		}
+		return add(image);
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "graph_types.h"
+#include "soft_canvas.h"
+
+namespace graph
+{
+	//Bottom-left skyline packing: the top edge of what was placed is kept as segments, and a
+	//rectangle goes where its top ends lowest, left first on a tie
+	class SkylinePacker
+	{
+		struct Segment
+		{
+			int x, y, width;
+		};
+
+		int size;
+		std::vector<Segment> skyline;
+
+		//Top of a rectangle width wide whose left edge is segment index's, -1 if it does not fit
+		int Fit(size_t index, int width) const;
+	public:
+		explicit SkylinePacker(int size);
+
+		void reset();
+
+		//False if there is no room left for it
+		bool place(int width, int height, int& x, int& y);
+	};
+
+	//Packs many small images onto shared pages, for D2DGraphics::create_atlas to make into an
+	//atlas drawn with draw_sprites. Every sprite gets a border of its own edge pixels, so sampling
+	//next to it never picks up a neighbour.
+	class AtlasBuilder
+	{
+		int pageSize;
+		int padding;
+		std::vector<soft::Image> pages;
+		std::vector<SkylinePacker> packers;
+		std::vector<AtlasRegion> regions;
+	public:
+		explicit AtlasBuilder(int pageSize = 1024, int padding = 1);
+
+		//Index of the sprite, -1 if it is empty or does not fit on a page with its border.
+		//pixels are premultiplied BGRA8, pitch is byte count of a scanline
+		int add(int width, int height, const void* pixels, size_t pitch);
+		int add(const soft::Image& image);
+		//PNG, BMP or PPM/PGM, -1 also if it cannot be read
+		int add_file(const std::wstring& path);
+
+		size_t get_page_count() const { return pages.size(); }
+		const soft::Image& get_page(size_t page) const { return pages[page]; }
+
+		size_t get_sprite_count() const { return regions.size(); }
+		const AtlasRegion& get_region(size_t index) const { return regions[index]; }
+		const std::vector<AtlasRegion>& get_regions() const { return regions; }
+	};
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <string>
+#include <utility>
+#include "graph_types.h"
+#include "lru_table.h"
+
+namespace graph
+{
+	//What a text layout depends on, text points into the caller's string
+	struct TextLayoutKey
+	{
+		const wchar_t* text;
+		size_t length;
+		//Font::id, never shared by two fonts
+		std::uint64_t font;
+		float width, height;
+		std::uint32_t align_horizontal, align_vertical;
+	};
+
+	//Text layouts by the key they were made from, in an LruTable. Past the budget in bytes the
+	//least recently used layouts are dropped. Layout is only made, moved and destroyed here, so the
+	//logic runs the same with a stand-in for the backend's layout.
+	template <typename Layout>
+	class TextLayoutCache
+	{
+		//Rough cost of a layout, the backends do not report it
+		static constexpr size_t c_layout_bytes = 1024;
+		static constexpr size_t c_char_bytes = 64;
+
+		struct Entry
+		{
+			Layout layout;
+			std::wstring text;
+			std::uint64_t font;
+			float width, height;
+			std::uint32_t align_horizontal, align_vertical;
+			size_t bytes;
+		};
+
+		LruTable<Entry> table;
+		size_t budget;
+		TextLayoutCacheStats stats;
+
+		static std::uint32_t Bits(const float value)
+		{
+			std::uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+
+		static std::uint64_t Hash(const TextLayoutKey& key)
+		{
+			//FNV-1a over the text, then the rest folded in
+			std::uint64_t hash = 0xCBF29CE484222325ull;
+			const auto mix = [&hash](const std::uint64_t value)
+			{
+				hash = (hash ^ value) * 0x100000001B3ull;
+			};
+			for (size_t i = 0; i < key.length; i++)
+			{
+				mix(static_cast<std::uint64_t>(key.text[i]));
+			}
+			mix(key.font);
+			mix(static_cast<std::uint64_t>(Bits(key.width)) << 32 | Bits(key.height));
+			mix(static_cast<std::uint64_t>(key.align_horizontal) << 32 | key.align_vertical);
+			return hash ^ hash >> 29;
+		}
+
+		//Sizes compare by bits, the same way they hash
+		static bool Matches(const Entry& e, const TextLayoutKey& key)
+		{
+			return e.font == key.font && Bits(e.width) == Bits(key.width) && Bits(e.height) == Bits(key.height) &&
+				e.align_horizontal == key.align_horizontal && e.align_vertical == key.align_vertical &&
+				e.text.size() == key.length && std::wmemcmp(e.text.data(), key.text, key.length) == 0;
+		}
+
+		void EvictOldest()
+		{
+			stats.bytes -= table[table.get_oldest()].bytes;
+			table.erase_oldest();
+			stats.evictions++;
+			stats.size--;
+		}
+	public:
+		//budget in bytes by the cost estimate, the last layout made is kept even if it alone is over
+		explicit TextLayoutCache(const size_t budget) : budget(budget) {}
+
+		//The layout of key, made on a miss by make(Layout&), which returns false if it failed.
+		//nullptr if it did, failures are not kept. Valid until the next call
+		template <typename Make>
+		Layout* get(const TextLayoutKey& key, Make&& make)
+		{
+			const std::uint64_t hash = Hash(key);
+			std::uint32_t entry = table.find(hash, [&key](const Entry& e) { return Matches(e, key); });
+			if (entry != c_no_entry)
+			{
+				stats.hits++;
+				table.touch(entry);
+				return &table[entry].layout;
+			}
+			stats.misses++;
+			Layout layout;
+			if (!make(layout))
+			{
+				return nullptr;
+			}
+			const size_t bytes = c_layout_bytes + key.length * c_char_bytes;
+			while (table.get_oldest() != c_no_entry && stats.bytes + bytes > budget)
+			{
+				EvictOldest();
+			}
+			entry = table.insert(hash);
+			Entry& e = table[entry];
+			e.layout = std::move(layout);
+			e.text.assign(key.text, key.length);
+			e.font = key.font;
+			e.width = key.width;
+			e.height = key.height;
+			e.align_horizontal = key.align_horizontal;
+			e.align_vertical = key.align_vertical;
+			e.bytes = bytes;
+			stats.size++;
+			stats.bytes += bytes;
+			return &e.layout;
+		}
+
+		const TextLayoutCacheStats& get_stats() const { return stats; }
+
+		void reset_stats()
+		{
+			stats.hits = stats.misses = stats.evictions = 0;
+		}
+	};
+}
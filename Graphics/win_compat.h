@@ -0,0 +1,73 @@
+#pragma once
+//Stand-ins for the Windows names graph.h uses when Direct2D is unavailable,
+//only the software backend is built on such platforms
+#include <cstdint>
+
+struct ID2D1Brush;
+struct ID2D1Bitmap;
+struct ID2D1BitmapRenderTarget;
+struct IDWriteTextFormat;
+
+typedef std::uint8_t UINT8;
+typedef std::uint32_t UINT32;
+typedef unsigned int UINT;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+
+enum DWRITE_FONT_WEIGHT
+{
+	DWRITE_FONT_WEIGHT_THIN = 100,
+	DWRITE_FONT_WEIGHT_EXTRA_LIGHT = 200,
+	DWRITE_FONT_WEIGHT_ULTRA_LIGHT = 200,
+	DWRITE_FONT_WEIGHT_LIGHT = 300,
+	DWRITE_FONT_WEIGHT_SEMI_LIGHT = 350,
+	DWRITE_FONT_WEIGHT_NORMAL = 400,
+	DWRITE_FONT_WEIGHT_REGULAR = 400,
+	DWRITE_FONT_WEIGHT_MEDIUM = 500,
+	DWRITE_FONT_WEIGHT_DEMI_BOLD = 600,
+	DWRITE_FONT_WEIGHT_SEMI_BOLD = 600,
+	DWRITE_FONT_WEIGHT_BOLD = 700,
+	DWRITE_FONT_WEIGHT_EXTRA_BOLD = 800,
+	DWRITE_FONT_WEIGHT_ULTRA_BOLD = 800,
+	DWRITE_FONT_WEIGHT_BLACK = 900,
+	DWRITE_FONT_WEIGHT_HEAVY = 900,
+	DWRITE_FONT_WEIGHT_EXTRA_BLACK = 950,
+	DWRITE_FONT_WEIGHT_ULTRA_BLACK = 950
+};
+
+enum DWRITE_FONT_STYLE
+{
+	DWRITE_FONT_STYLE_NORMAL,
+	DWRITE_FONT_STYLE_OBLIQUE,
+	DWRITE_FONT_STYLE_ITALIC
+};
+
+enum DWRITE_FONT_STRETCH
+{
+	DWRITE_FONT_STRETCH_UNDEFINED = 0,
+	DWRITE_FONT_STRETCH_ULTRA_CONDENSED = 1,
+	DWRITE_FONT_STRETCH_EXTRA_CONDENSED = 2,
+	DWRITE_FONT_STRETCH_CONDENSED = 3,
+	DWRITE_FONT_STRETCH_SEMI_CONDENSED = 4,
+	DWRITE_FONT_STRETCH_NORMAL = 5,
+	DWRITE_FONT_STRETCH_MEDIUM = 5,
+	DWRITE_FONT_STRETCH_SEMI_EXPANDED = 6,
+	DWRITE_FONT_STRETCH_EXPANDED = 7,
+	DWRITE_FONT_STRETCH_EXTRA_EXPANDED = 8,
+	DWRITE_FONT_STRETCH_ULTRA_EXPANDED = 9
+};
+
+enum DWRITE_TEXT_ALIGNMENT
+{
+	DWRITE_TEXT_ALIGNMENT_LEADING,
+	DWRITE_TEXT_ALIGNMENT_TRAILING,
+	DWRITE_TEXT_ALIGNMENT_CENTER,
+	DWRITE_TEXT_ALIGNMENT_JUSTIFIED
+};
+
+enum DWRITE_PARAGRAPH_ALIGNMENT
+{
+	DWRITE_PARAGRAPH_ALIGNMENT_NEAR,
+	DWRITE_PARAGRAPH_ALIGNMENT_FAR,
+	DWRITE_PARAGRAPH_ALIGNMENT_CENTER
+};